@@ -15,6 +15,182 @@ extern "C" {
 JNIEXPORT jstring JNICALL Java_DramPufJni_genKey
   (JNIEnv *, jclass, jstring, jstring, jint, jint, jint, jobjectArray, jint, jstring, jint);
 
+/*
+ * Class:     DramPufJni
+ * Method:    genKeys
+ * Signature: (Ljava/lang/String;Ljava/lang/String;III[Ljava/lang/String;I[Ljava/lang/String;[I)[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_DramPufJni_genKeys
+  (JNIEnv *, jclass, jstring, jstring, jint, jint, jint, jobjectArray, jint, jobjectArray, jintArray);
+
+/*
+ * Class:     DramPufJni
+ * Method:    genKeyAsync
+ * Signature: (Ljava/lang/String;Ljava/lang/String;III[Ljava/lang/String;ILjava/lang/String;I)J
+ */
+JNIEXPORT jlong JNICALL Java_DramPufJni_genKeyAsync
+  (JNIEnv *, jclass, jstring, jstring, jint, jint, jint, jobjectArray, jint, jstring, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    keyState
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_DramPufJni_keyState
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    keyProgress
+ * Signature: (J)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_DramPufJni_keyProgress
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    pollKey
+ * Signature: (JJ)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_DramPufJni_pollKey
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    keyError
+ * Signature: (J)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_DramPufJni_keyError
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    cancelKey
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_cancelKey
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    releaseKey
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_releaseKey
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    startKeyPool
+ * Signature: (Ljava/lang/String;Ljava/lang/String;IIIIJD)V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_startKeyPool
+  (JNIEnv *, jclass, jstring, jstring, jint, jint, jint, jint, jlong, jdouble);
+
+/*
+ * Class:     DramPufJni
+ * Method:    addPoolChallenge
+ * Signature: ([Ljava/lang/String;I)V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_addPoolChallenge
+  (JNIEnv *, jclass, jobjectArray, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    poolAvailable
+ * Signature: ([Ljava/lang/String;I)I
+ */
+JNIEXPORT jint JNICALL Java_DramPufJni_poolAvailable
+  (JNIEnv *, jclass, jobjectArray, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    stopKeyPool
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_stopKeyPool
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     DramPufJni
+ * Method:    openCrpStore
+ * Signature: (Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_DramPufJni_openCrpStore
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     DramPufJni
+ * Method:    closeCrpStore
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_closeCrpStore
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     DramPufJni
+ * Method:    enrollCrp
+ * Signature: (JLjava/lang/String;[Ljava/lang/String;I[B[BI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_DramPufJni_enrollCrp
+  (JNIEnv *, jclass, jlong, jstring, jobjectArray, jint, jbyteArray, jbyteArray, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    verifyCrp
+ * Signature: (JLjava/lang/String;[Ljava/lang/String;I[BI)D
+ */
+JNIEXPORT jdouble JNICALL Java_DramPufJni_verifyCrp
+  (JNIEnv *, jclass, jlong, jstring, jobjectArray, jint, jbyteArray, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    identifyBoard
+ * Signature: (J[Ljava/lang/String;I[BID)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_DramPufJni_identifyBoard
+  (JNIEnv *, jclass, jlong, jobjectArray, jint, jbyteArray, jint, jdouble);
+
+/*
+ * Class:     DramPufJni
+ * Method:    latencyReport
+ * Signature: ()Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_DramPufJni_latencyReport
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     DramPufJni
+ * Method:    latencyStats
+ * Signature: (I)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_DramPufJni_latencyStats
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    dumpLatency
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_DramPufJni_dumpLatency
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     DramPufJni
+ * Method:    dumpLatencyOnSignal
+ * Signature: (Ljava/lang/String;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_DramPufJni_dumpLatencyOnSignal
+  (JNIEnv *, jclass, jstring, jint);
+
+/*
+ * Class:     DramPufJni
+ * Method:    resetLatency
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_DramPufJni_resetLatency
+  (JNIEnv *, jclass);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,9 +15,136 @@ public class DramPufJni {
         return genKey(serialPort, gpioChip, baud, rpiPowerPort, sleep, params, params.length, posFile, keySize);
     }
 
+    // One measurement, keys[i] has up to keySizes[i] bits of posFiles[i]; the keys are empty if it failed
+    public static native String[] genKeys(String serialPort, String gpioChip,
+                                          int baud, int rpiPowerPort, int sleep,
+                                          String[] params, int paramsSize,
+                                          String[] posFiles, int[] keySizes);
+
+    public static String[] genKeys(String serialPort, String gpioChip,
+                                   int baud, int rpiPowerPort, int sleep,
+                                   String[] params, String[] posFiles, int[] keySizes) {
+        return genKeys(serialPort, gpioChip, baud, rpiPowerPort, sleep, params, params.length, posFiles, keySizes);
+    }
+
+    // States returned by keyState, in the order of SerialReader::KeyState
+    public static final int KEY_QUEUED = 0;
+    public static final int KEY_RUNNING = 1;
+    public static final int KEY_DONE = 2;
+    public static final int KEY_FAILED = 3;
+    public static final int KEY_CANCELLED = 4;
+
+    // Starts generating a key in the background, the returned handle has to be passed to releaseKey eventually
+    public static native long genKeyAsync(String serialPort, String gpioChip,
+                                          int baud, int rpiPowerPort, int sleep,
+                                          String[] params, int paramsSize,
+                                          String posFile, int keySize);
+
+    public static long genKeyAsync(String serialPort, String gpioChip,
+                                   int baud, int rpiPowerPort, int sleep,
+                                   String[] params, String posFile, int keySize) {
+        return genKeyAsync(serialPort, gpioChip, baud, rpiPowerPort, sleep, params, params.length, posFile, keySize);
+    }
+
+    public static native int keyState(long handle);
+
+    // {phase (boot, prompt, decay, transfer, finish), bytes received, bytes expected}
+    public static native long[] keyProgress(long handle);
+
+    // Waits at most timeoutMs for the key, null if it is not ready yet, failed or was cancelled
+    public static native String pollKey(long handle, long timeoutMs);
+
+    public static native String keyError(long handle);
+
+    // Stops the measurement and powers off the board, returns immediately
+    public static native void cancelKey(long handle);
+
+    public static native void releaseKey(long handle);
+
+    // Keeps up to capacity measured responses per challenge in locked memory, genKey and genKeyAsync use them first
+    public static native void startKeyPool(String serialPort, String gpioChip,
+                                           int baud, int rpiPowerPort, int sleep,
+                                           int capacity, long maxAgeSeconds, double maxTemperatureDelta);
+
+    public static native void addPoolChallenge(String[] params, int paramsSize);
+
+    public static void addPoolChallenge(String[] params) {
+        addPoolChallenge(params, params.length);
+    }
+
+    public static native int poolAvailable(String[] params, int paramsSize);
+
+    public static int poolAvailable(String[] params) {
+        return poolAvailable(params, params.length);
+    }
+
+    // Stops refilling and zeroizes all responses
+    public static native void stopKeyPool();
+
+    // Opens a store of enrolled challenge-response pairs, the handle has to be passed to closeCrpStore eventually
+    public static native long openCrpStore(String path);
+
+    public static native void closeCrpStore(long store);
+
+    // response and mask are packed 8 bits per byte (MSB first), set mask bits are reliable; mask may be null
+    public static native boolean enrollCrp(long store, String board, String[] params, int paramsSize,
+                                           byte[] response, byte[] mask, int bits);
+
+    public static boolean enrollCrp(long store, String board, String[] params, byte[] response, byte[] mask,
+                                    int bits) {
+        return enrollCrp(store, board, params, params.length, response, mask, bits);
+    }
+
+    // Smallest masked fractional Hamming distance to the enrolled responses, NaN if none has as many bits
+    public static native double verifyCrp(long store, String board, String[] params, int paramsSize,
+                                          byte[] response, int bits);
+
+    public static boolean verifyCrp(long store, String board, String[] params, byte[] response, int bits,
+                                    double threshold) {
+        return verifyCrp(store, board, params, params.length, response, bits) <= threshold;
+    }
+
+    // The enrolled board whose response is closest to this one, null if none is within maxDistance
+    public static native String identifyBoard(long store, String[] params, int paramsSize, byte[] response,
+                                              int bits, double maxDistance);
+
+    public static String identifyBoard(long store, String[] params, byte[] response, int bits,
+                                       double maxDistance) {
+        return identifyBoard(store, params, params.length, response, bits, maxDistance);
+    }
+
+    // Latencies of every phase of all key generations so far and the events of the last one, tab-separated (us)
+    public static native String latencyReport();
+
+    // {count, min, max, mean, p50, p90, p99, p99.9} in us of one phase (power-off, power-up, boot, prompt, decay,
+    // transfer, finish, extract, total)
+    public static native long[] latencyStats(int phase);
+
+    public static native boolean dumpLatency(String path);
+
+    // Writes latencyReport() to path whenever the process receives signal (10 = SIGUSR1, which the JVM leaves alone)
+    public static native boolean dumpLatencyOnSignal(String path, int signal);
+
+    public static native void resetLatency();
+
+    // The params SerialReader --calibrate saved, one per line ('#' starts a comment), null if they cannot be read
+    public static String[] readParams(String path) {
+        try {
+            return java.nio.file.Files.readAllLines(java.nio.file.Paths.get(path)).stream()
+                    .map(String::trim)
+                    .filter(line -> !line.isEmpty() && !line.startsWith("#"))
+                    .toArray(String[]::new);
+        } catch (java.io.IOException e) {
+            return null;
+        }
+    }
+
     public static void main(String[] args) {
-        // Example parameters
-        String[] params = new String[]{"0", "0", "0", "C3", "C38", "00000000", "0", "0", "120"};
+        // Example parameters, or those of the last calibration
+        String[] params = readParams("calibration.params");
+        if (params == null) {
+            params = new String[]{"0", "0", "0", "C3", "C38", "00000000", "0", "0", "120"};
+        }
         String key = genKey("/dev/ttyS0", "gpiochip0", 115200, 2, 5, params, "stable.pos", 1024);
         System.out.println("Generated key: " + key);
     }
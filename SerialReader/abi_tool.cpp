@@ -0,0 +1,98 @@
+#include <args.hxx>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "puf.h"
+
+// Open file descriptors of this process
+static size_t openFds() {
+  size_t n = 0;
+  std::error_code error;
+  for (auto it = std::filesystem::directory_iterator("/proc/self/fd", error);
+       it != std::filesystem::directory_iterator(); it.increment(error)) {
+    n++;
+  }
+  return n;
+}
+
+// Measures rounds times through one session, returns how many more fds are open afterwards or -1
+static long leakedFds(const puf_session_config& config, const size_t rounds) {
+  puf_session* session = nullptr;
+  if (puf_session_open(&config, &session) != PUF_OK) return -1;
+  const char* params[] = {"4"};
+  unsigned char buffer[64];
+  size_t written;
+  // The first call may open what stays open for the whole process, e.g. the latency statistics
+  (void) puf_measure_into(session, params, 1, buffer, sizeof(buffer), &written);
+  const size_t before = openFds();
+  for (size_t i = 0; i < rounds; i++) (void) puf_measure_into(session, params, 1, buffer, sizeof(buffer), &written);
+  const size_t after = openFds();
+  puf_session_close(session);
+  return static_cast<long>(after) - static_cast<long>(before);
+}
+
+/*
+ * Repeated calls must not leak file descriptors, a host process keeps the library loaded for its whole life. By
+ * default the serial port is a pseudo terminal and the GPIO chip does not exist, so every call opens and gives up
+ * on the board; --serial and --gpio run the same against real hardware.
+ */
+static int check(const size_t rounds, const std::string& serial, const std::string& gpio) {
+  std::string port = serial;
+  int master = -1;
+  if (port.empty()) {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master == -1 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname(master) == nullptr) {
+      std::cerr << "Could not open a pseudo terminal" << std::endl;
+      return 1;
+    }
+    port = ptsname(master);
+  }
+  puf_session_config config{};
+  config.struct_size = sizeof(config);
+  config.serial_port = port.c_str();
+  config.gpio_chip = gpio.c_str();
+  config.baud = 115200;
+  config.relay_line = 2;
+  config.max_retries = 1;
+  config.watchdog = 1;
+  const long leaked = leakedFds(config, rounds);
+  if (master != -1) close(master);
+  if (leaked < 0) {
+    std::cerr << "Could not open a session" << std::endl;
+    return 1;
+  }
+  std::cout << leaked << " file descriptors leaked in " << rounds << " calls" << std::endl;
+  return leaked == 0 ? 0 : 1;
+}
+
+// Checks the C interface of the library (libpuf) as a host process uses it
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Checks the C interface of the library as a long-lived host process uses it.",
+    "Commands: check (calls puf_measure_into repeatedly, exits with 1 if the process has more open file "
+    "descriptors afterwards)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "check");
+  args::ValueFlag<size_t> roundsA(argsParser, "rounds", "check: calls per session", {'r', "rounds"}, 100);
+  args::ValueFlag<std::string> serialA(argsParser, "serial", "check: serial port, a pseudo terminal if empty",
+                                       {'s', "serial"}, "");
+  args::ValueFlag<std::string> gpioA(argsParser, "chip", "check: GPIO chip", {'g', "gpio"}, "puf-abi-check");
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  if (args::get(commandA) == "check") return check(args::get(roundsA), args::get(serialA), args::get(gpioA));
+  std::cerr << argsParser;
+  return 1;
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "archive.h"
+#include "bytes.h"
+
+static void putVarint(std::vector<unsigned char>& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<unsigned char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(v));
+}
+
+static bool getVarint(const unsigned char*& in, const unsigned char* end, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; in < end && shift < 64; shift += 7) {
+    const unsigned char b = *in++;
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static bool zero64(const unsigned char* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v == 0;
+}
+
+void SerialReader::packChunk(const unsigned char* in, const size_t size, std::vector<unsigned char>& out) {
+  size_t i = 0;
+  while (i < size) {
+    size_t z = i;
+    while (z + 8 <= size && zero64(in + z)) z += 8;
+    while (z < size && in[z] == 0) z++;
+    // The literal ends where the next run of at least four zero bytes starts, shorter runs are cheaper inline
+    size_t l = z;
+    int zeros = 0;
+    while (l < size) {
+      if (in[l] != 0) {
+        zeros = 0;
+      } else if (++zeros == 4) {
+        l -= 3;
+        break;
+      }
+      l++;
+    }
+    putVarint(out, z - i);
+    putVarint(out, l - z);
+    out.insert(out.end(), in + z, in + l);
+    i = l;
+  }
+}
+
+bool SerialReader::unpackChunk(const unsigned char* in, const size_t inSize, unsigned char* out, const size_t size) {
+  const unsigned char* end = in + inSize;
+  size_t o = 0;
+  while (in < end) {
+    uint64_t zeros, literal;
+    if (!getVarint(in, end, zeros) || !getVarint(in, end, literal)) return false;
+    if (zeros > size - o || literal > size - o - zeros || literal > static_cast<uint64_t>(end - in)) return false;
+    std::memset(out + o, 0, zeros);
+    o += zeros;
+    std::memcpy(out + o, in, literal);
+    o += literal;
+    in += literal;
+  }
+  return o == size;
+}
+
+SerialReader::ArchiveWriter::ArchiveWriter(std::string _path, std::string _reference, const size_t _chunkSize)
+  : path(std::move(_path)), referencePath(std::move(_reference)), chunkSize(_chunkSize > 0 ? _chunkSize : 1) {
+  if (referencePath.empty()) return;
+  reference = std::make_unique<DumpReader>(referencePath);
+  if (!reference->isOpen()) {
+    std::cerr << "Could not open reference " << referencePath << ", using the init value instead" << std::endl;
+    reference.reset();
+    return;
+  }
+  // Readers resolve the reference against the directory of the archive, so that is what it is stored relative to
+  const std::filesystem::path absolute = std::filesystem::absolute(referencePath).lexically_normal();
+  const auto rel = absolute.lexically_relative(std::filesystem::absolute(path).lexically_normal().parent_path());
+  storedReference = rel.empty() ? absolute.string() : rel.string();
+  if (storedReference.size() >= ARCHIVE_REFERENCE_SIZE) storedReference = absolute.string();
+  if (storedReference.size() >= ARCHIVE_REFERENCE_SIZE) {
+    std::cerr << "The path of reference " << referencePath << " is too long, using the init value instead" << std::endl;
+    reference.reset();
+  }
+}
+
+SerialReader::ArchiveWriter::~ArchiveWriter() {
+  if (fd != -1) end(false);
+}
+
+void SerialReader::ArchiveWriter::fail(const std::string& what) {
+  // The first error is the cause, the ones after it usually follow from it
+  if (error.empty()) error = what + ": " + std::strerror(errno);
+}
+
+bool SerialReader::ArchiveWriter::writeHeader(const int64_t endTime, const bool complete) const {
+  unsigned char header[ARCHIVE_HEADER_SIZE] = {};
+  std::memcpy(header, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  putU32(header + 8, ARCHIVE_VERSION);
+  putU32(header + 12, ARCHIVE_HEADER_SIZE);
+  putU32(header + 16, static_cast<uint32_t>(chunkSize));
+  putU32(header + 20, static_cast<uint32_t>(reference ? ArchiveBase::REFERENCE : ArchiveBase::INIT));
+  putU64(header + 24, size);
+  putU64(header + 32, pos);
+  putU32(header + 40, static_cast<uint32_t>(index.size() / ARCHIVE_INDEX_ENTRY));
+  putU32(header + 44, complete);
+  const Challenge& c = info.challenge;
+  const uint32_t fields[] = {
+    static_cast<uint32_t>(c.mode), static_cast<uint32_t>(c.addMode), static_cast<uint32_t>(c.funcLoc),
+    c.start, c.end, c.init,
+    static_cast<uint32_t>(c.decayFunc), static_cast<uint32_t>(c.interval), static_cast<uint32_t>(c.decay)
+  };
+  for (size_t i = 0; i < 9; i++) putU32(header + 48 + 4 * i, fields[i]);
+  Cell cell{};
+  if (!parseFrame(info.frame, cell)) cell = cellOf(c.start, c.addMode);
+  putU32(header + 84, cell.bank);
+  putU32(header + 88, cell.row);
+  putU32(header + 92, cell.col);
+  putU64(header + 96, info.startTime);
+  putU64(header + 104, endTime);
+  putString(header + 112, info.firmware, 64);
+  putString(header + 176, info.frame, 32);
+  if (reference) {
+    putU32(header + 208, crc32(0, reference->payload, reference->size));
+    putString(header + 216, storedReference, ARCHIVE_REFERENCE_SIZE);
+  }
+  return pwrite(fd, header, sizeof(header), 0) == sizeof(header);
+}
+
+void SerialReader::ArchiveWriter::begin(const DumpInfo& _info) {
+  if (fd != -1) end(false);
+  info = _info;
+  error.clear();
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    fail("could not create the file");
+    std::cerr << "Could not write " << path << ", " << error << std::endl;
+    return;
+  }
+  size = 0;
+  pos = ARCHIVE_HEADER_SIZE;
+  chunk.clear();
+  chunk.reserve(chunkSize);
+  index.clear();
+  if (!writeHeader(0, false)) fail("could not write the header");
+}
+
+void SerialReader::ArchiveWriter::flush() {
+  if (chunk.empty()) return;
+  packed.clear();
+  packChunk(chunk.data(), chunk.size(), packed);
+  unsigned char entry[ARCHIVE_INDEX_ENTRY] = {};
+  putU64(entry, pos);
+  putU32(entry + 8, static_cast<uint32_t>(packed.size()));
+  putU32(entry + 12, crc32(0, chunk.data(), chunk.size()));
+  index.insert(index.end(), entry, entry + sizeof(entry));
+  if (pwrite(fd, packed.data(), packed.size(), static_cast<off_t>(pos)) != static_cast<ssize_t>(packed.size())) {
+    fail("could not write a chunk");
+  }
+  pos += packed.size();
+  chunk.clear();
+}
+
+void SerialReader::ArchiveWriter::write(const char* data, size_t count) {
+  if (fd == -1) return;
+  const auto* in = reinterpret_cast<const unsigned char*>(data);
+  const uint32_t init = info.challenge.init;
+  // Words are sent big endian, so byte k of every word holds bits 31 - 8k to 24 - 8k of the init value
+  const unsigned char pattern[4] = {
+    static_cast<unsigned char>(init >> 24), static_cast<unsigned char>(init >> 16),
+    static_cast<unsigned char>(init >> 8), static_cast<unsigned char>(init)
+  };
+  while (count > 0) {
+    const size_t n = std::min(count, chunkSize - chunk.size());
+    const size_t at = chunk.size();
+    chunk.resize(at + n);
+    if (reference) {
+      for (size_t i = 0; i < n; i++) {
+        const uint64_t o = size + i;
+        chunk[at + i] = in[i] ^ (o < reference->size ? reference->payload[o] : 0);
+      }
+    } else {
+      for (size_t i = 0; i < n; i++) chunk[at + i] = in[i] ^ pattern[(size + i) & 3];
+    }
+    size += n;
+    in += n;
+    count -= n;
+    if (chunk.size() == chunkSize) flush();
+  }
+}
+
+void SerialReader::ArchiveWriter::end(const bool ok) {
+  if (fd == -1) return;
+  flush();
+  if (pwrite(fd, index.data(), index.size(), static_cast<off_t>(pos)) != static_cast<ssize_t>(index.size())) {
+    fail("could not write the index");
+  }
+  const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  if (!writeHeader(now, ok)) fail("could not write the header");
+  if (ftruncate(fd, static_cast<off_t>(pos + index.size())) != 0) fail("could not truncate the file");
+  // Some filesystems (e.g. NFS) only report a failed write when the file is closed
+  if (close(fd) != 0) fail("could not close the file");
+  fd = -1;
+  if (!error.empty()) std::cerr << "Could not write " << path << ", " << error << std::endl;
+}
+
+bool SerialReader::isArchive(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  char magic[sizeof(ARCHIVE_MAGIC)];
+  const bool ret = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                   std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+  close(fd);
+  return ret;
+}
+
+SerialReader::ArchiveReader::ArchiveReader(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size >= ARCHIVE_HEADER_SIZE) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m != MAP_FAILED) {
+      map = static_cast<const unsigned char*>(m);
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+  if (map == nullptr || std::memcmp(map, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) return;
+
+  chunkSize = getU32(map + 16);
+  base = getU32(map + 20) == 1 ? ArchiveBase::REFERENCE : ArchiveBase::INIT;
+  size = getU64(map + 24);
+  const uint64_t indexOffset = getU64(map + 32);
+  chunks = getU32(map + 40);
+  complete = getU32(map + 44) != 0;
+  Challenge& c = info.challenge;
+  c.mode = static_cast<int>(getU32(map + 48));
+  c.addMode = static_cast<int>(getU32(map + 52));
+  c.funcLoc = static_cast<int>(getU32(map + 56));
+  c.start = getU32(map + 60);
+  c.end = getU32(map + 64);
+  c.init = getU32(map + 68);
+  c.decayFunc = static_cast<int>(getU32(map + 72));
+  c.interval = static_cast<int>(getU32(map + 76));
+  c.decay = static_cast<int>(getU32(map + 80));
+  first = {getU32(map + 84), getU32(map + 88), getU32(map + 92)};
+  info.startTime = static_cast<int64_t>(getU64(map + 96));
+  endTime = static_cast<int64_t>(getU64(map + 104));
+  info.firmware = getString(map + 112, 64);
+  info.frame = getString(map + 176, 32);
+  info.payloadSize = size;
+  if (chunkSize == 0 || indexOffset > mapSize || chunks > (mapSize - indexOffset) / ARCHIVE_INDEX_ENTRY ||
+      chunks != (size + chunkSize - 1) / chunkSize) {
+    return;
+  }
+
+  if (base == ArchiveBase::REFERENCE) {
+    referencePath = getString(map + 216, ARCHIVE_REFERENCE_SIZE);
+    // Relative references are relative to the archive, like the dumps of one campaign directory
+    std::string resolved = referencePath;
+    if (!resolved.empty() && resolved[0] != '/' && path.find('/') != std::string::npos) {
+      resolved = path.substr(0, path.rfind('/') + 1) + resolved;
+    }
+    reference = std::make_unique<DumpReader>(resolved);
+    if (!reference->isOpen() || crc32(0, reference->payload, reference->size) != getU32(map + 208)) {
+      std::cerr << "Reference " << resolved << " of " << path << " is missing or has changed" << std::endl;
+      return;
+    }
+  }
+  index = map + indexOffset;
+  cache.resize(chunkSize);
+}
+
+SerialReader::ArchiveReader::~ArchiveReader() {
+  if (map != nullptr) munmap(const_cast<unsigned char*>(map), mapSize);
+}
+
+unsigned char SerialReader::ArchiveReader::baseAt(const uint64_t offset) const {
+  if (base == ArchiveBase::REFERENCE) {
+    return offset < reference->size ? reference->payload[offset] : 0;
+  }
+  return static_cast<unsigned char>(info.challenge.init >> 8 * (3 - (offset & 3)));
+}
+
+const unsigned char* SerialReader::ArchiveReader::decode(const uint32_t chunk) {
+  if (cached == chunk) return cache.data();
+  const unsigned char* entry = index + static_cast<size_t>(chunk) * ARCHIVE_INDEX_ENTRY;
+  const uint64_t offset = getU64(entry);
+  const uint32_t packedSize = getU32(entry + 8);
+  const size_t rawSize = std::min<uint64_t>(chunkSize, size - static_cast<uint64_t>(chunk) * chunkSize);
+  cached = -1;
+  if (offset > mapSize || packedSize > mapSize - offset) return nullptr;
+  if (!unpackChunk(map + offset, packedSize, cache.data(), rawSize)) return nullptr;
+  cached = chunk;
+  return cache.data();
+}
+
+size_t SerialReader::ArchiveReader::readDelta(uint64_t offset, unsigned char* out, size_t count) {
+  if (!isOpen() || offset >= size) return 0;
+  count = std::min<uint64_t>(count, size - offset);
+  size_t done = 0;
+  while (done < count) {
+    const auto chunk = static_cast<uint32_t>(offset / chunkSize);
+    const size_t within = offset % chunkSize;
+    const unsigned char* data = decode(chunk);
+    if (data == nullptr) return 0;
+    const size_t n = std::min<uint64_t>(count - done, std::min<uint64_t>(chunkSize, size - offset + within) - within);
+    std::memcpy(out + done, data + within, n);
+    done += n;
+    offset += n;
+  }
+  return done;
+}
+
+size_t SerialReader::ArchiveReader::read(const uint64_t offset, unsigned char* out, const size_t count) {
+  const size_t n = readDelta(offset, out, count);
+  if (base == ArchiveBase::REFERENCE) {
+    for (size_t i = 0; i < n; i++) out[i] ^= baseAt(offset + i);
+  } else {
+    unsigned char pattern[4];
+    for (int k = 0; k < 4; k++) pattern[k] = baseAt(k);
+    for (size_t i = 0; i < n; i++) out[i] ^= pattern[(offset + i) & 3];
+  }
+  return n;
+}
+
+bool SerialReader::ArchiveReader::verify() {
+  if (!isOpen()) return false;
+  for (uint32_t c = 0; c < chunks; c++) {
+    const unsigned char* data = decode(c);
+    if (data == nullptr) return false;
+    const size_t rawSize = std::min<uint64_t>(chunkSize, size - static_cast<uint64_t>(c) * chunkSize);
+    if (crc32(0, data, rawSize) != getU32(index + static_cast<size_t>(c) * ARCHIVE_INDEX_ENTRY + 12)) return false;
+  }
+  return true;
+}
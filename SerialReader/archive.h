@@ -0,0 +1,142 @@
+#pragma once
+
+#define ARCHIVE_MAGIC "PUFARC1"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 512
+#define ARCHIVE_INDEX_ENTRY 16
+#define ARCHIVE_CHUNK_SIZE (64 << 10)
+#define ARCHIVE_EXTENSION ".pufa"
+// Bytes of the header that hold the path of the reference dump, with its terminating zero
+#define ARCHIVE_REFERENCE_SIZE 256
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dump_file.h"
+#include "dump_sink.h"
+
+namespace SerialReader {
+  // What the payload is XOR'd against before it is compressed
+  enum class ArchiveBase { INIT, REFERENCE };
+
+  /*
+   * Compresses a chunk that is mostly zero (i.e. a dump XOR'd against what it is expected to be) as
+   * (varint zero bytes, varint literal bytes, literal bytes) records. Appends to out.
+   */
+  void packChunk(const unsigned char* in, size_t size, std::vector<unsigned char>& out);
+
+  // Returns false if the record stream is corrupt or does not decode to exactly size bytes
+  bool unpackChunk(const unsigned char* in, size_t inSize, unsigned char* out, size_t size);
+
+  /*
+   * Writes a dump as a seekable archive: the payload XOR'd against the init value of the challenge (or against a
+   * reference dump) in independently compressed chunks of ARCHIVE_CHUNK_SIZE bytes, followed by a chunk index.
+   *
+   * Header (ARCHIVE_HEADER_SIZE bytes, little endian):
+   *   "PUFARC1\0", u32 version, u32 header size, u32 chunk size, u32 base (0 = init value, 1 = reference),
+   *   u64 payload size, u64 index offset, u32 chunk count, u32 complete,
+   *   u32 mode, address mode, function location, start, end, init value, function, interval, decay,
+   *   u32 bank, row and column of the first word, i64 start and end time (ns since epoch),
+   *   char[64] firmware build, char[32] frame, u32 CRC-32 of the reference payload, u32 reserved,
+   *   char[256] path of the reference dump, relative to the directory of the archive unless it is absolute
+   * Index (chunk count entries of ARCHIVE_INDEX_ENTRY bytes): u64 offset, u32 packed size, u32 CRC-32 of the chunk
+   */
+  class ArchiveWriter : public DumpSink {
+  private:
+    const std::string path;
+    const std::string referencePath;
+    // referencePath as the header stores it
+    std::string storedReference;
+    const size_t chunkSize;
+    std::unique_ptr<DumpReader> reference;
+    int fd = -1;
+    DumpInfo info;
+    uint64_t size = 0;
+    uint64_t pos = 0;
+    std::vector<unsigned char> chunk;
+    std::vector<unsigned char> packed;
+    std::vector<unsigned char> index;
+    std::string error;
+
+    // Keeps the first error, with errno
+    void fail(const std::string& what);
+
+    void flush();
+
+    bool writeHeader(int64_t endTime, bool complete) const;
+
+  public:
+    // An empty reference XORs against the init value
+    explicit ArchiveWriter(std::string _path, std::string _reference = "", size_t _chunkSize = ARCHIVE_CHUNK_SIZE);
+
+    ~ArchiveWriter() override;
+
+    ArchiveWriter(const ArchiveWriter&) = delete;
+
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    void begin(const DumpInfo& _info) override;
+
+    void write(const char* data, size_t count) override;
+
+    // Reports an archive that could not be written completely on stderr, see getError()
+    void end(bool ok) override;
+
+    // Why the last archive could not be written completely, empty if it was
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+  };
+
+  // Random access into an archive, only the chunks that overlap a read are decompressed
+  class ArchiveReader {
+  private:
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    uint32_t chunkSize = 0;
+    uint32_t chunks = 0;
+    const unsigned char* index = nullptr;
+    std::unique_ptr<DumpReader> reference;
+    std::vector<unsigned char> cache;
+    int64_t cached = -1;
+
+    const unsigned char* decode(uint32_t chunk);
+
+  public:
+    DumpInfo info;
+    Cell first{};
+    int64_t endTime = 0;
+    ArchiveBase base = ArchiveBase::INIT;
+    std::string referencePath;
+    bool complete = false;
+    uint64_t size = 0;
+
+    explicit ArchiveReader(const std::string& path);
+
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader&) = delete;
+
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return index != nullptr;
+    }
+
+    // The byte of the base (init value or reference) at a payload offset
+    [[nodiscard]] unsigned char baseAt(uint64_t offset) const;
+
+    // Copies up to count payload bytes from offset, returns how many; 0 past the end or on a corrupt chunk
+    size_t read(uint64_t offset, unsigned char* out, size_t count);
+
+    // Like read, but leaves the bytes XOR'd against the base, i.e. the flipped bits
+    size_t readDelta(uint64_t offset, unsigned char* out, size_t count);
+
+    // Decodes every chunk and compares it with its CRC
+    [[nodiscard]] bool verify();
+  };
+
+  [[nodiscard]] bool isArchive(const std::string& path);
+}
@@ -0,0 +1,118 @@
+#include <args.hxx>
+#include <fstream>
+#include <string>
+#include <iostream>
+#include <vector>
+#include "archive.h"
+#include "dump_file.h"
+
+using namespace SerialReader;
+
+// Converts .bin dumps (raw or described) to archives and back, and reads byte ranges of archives
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Packs dumps into seekable archives and reads them back.",
+    "Commands: pack IN OUT, unpack IN OUT (raw .bin for the Java programs), cat IN (-s/-n range to stdout), info IN");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "pack, unpack, cat or info");
+  args::Positional<std::string> inA(argsParser, "in", "Input file");
+  args::Positional<std::string> outA(argsParser, "out", "Output file");
+  args::ValueFlag<std::string> referenceA(argsParser, "reference",
+                                          "XOR against this dump instead of the init value", {'r', "reference"}, "");
+  args::ValueFlag<std::string> initA(argsParser, "init",
+                                     "Init value (hex) of a raw dump, which does not record its challenge",
+                                     {'i', "init"}, "");
+  args::ValueFlag<size_t> chunkA(argsParser, "chunk", "Chunk size in bytes", {'k', "chunk"}, ARCHIVE_CHUNK_SIZE);
+  args::ValueFlag<uint64_t> startA(argsParser, "start", "First payload byte to cat", {'s', "start"}, 0);
+  args::ValueFlag<uint64_t> countA(argsParser, "count", "Number of payload bytes to cat (0 = all)", {'n', "count"},
+                                   0);
+  args::Flag deltaA(argsParser, "delta", "cat the flipped bits (payload XOR base) instead of the payload",
+                    {'d', "delta"});
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  const std::string& in = args::get(inA);
+  const std::string& out = args::get(outA);
+
+  if (command == "pack") {
+    const DumpReader dump(in);
+    if (!dump.isOpen() || out.empty()) {
+      std::cerr << "Could not read " << in << std::endl;
+      return 1;
+    }
+    ArchiveWriter writer(out, args::get(referenceA), args::get(chunkA));
+    DumpInfo info = dump.info;
+    info.payloadSize = dump.size;
+    if (!args::get(initA).empty()) {
+      info.challenge.init = static_cast<uint32_t>(std::stoul(args::get(initA), nullptr, 16));
+    }
+    writer.begin(info);
+    writer.write(reinterpret_cast<const char*>(dump.payload), dump.size);
+    writer.end(true);
+    return 0;
+  }
+
+  ArchiveReader archive(in);
+  if (!archive.isOpen()) {
+    std::cerr << "Could not read archive " << in << std::endl;
+    return 1;
+  }
+
+  if (command == "info") {
+    const Challenge& c = archive.info.challenge;
+    std::cout << "payload " << archive.size << " bytes" << (archive.complete ? "" : " (incomplete)") << std::endl
+      << "params " << c.mode << ' ' << c.addMode << ' ' << c.funcLoc << ' ' << std::hex << std::uppercase
+      << c.start << ' ' << c.end << ' ' << c.init << std::dec << ' ' << c.decayFunc << ' ' << c.interval << ' '
+      << c.decay << std::endl
+      << "frame " << archive.info.frame << std::endl
+      << "firmware " << archive.info.firmware << std::endl
+      << "base " << (archive.base == ArchiveBase::INIT ? "init value" : archive.referencePath) << std::endl
+      << "chunks " << (archive.verify() ? "ok" : "CORRUPT") << std::endl;
+    return 0;
+  }
+
+  std::vector<unsigned char> buffer(ARCHIVE_CHUNK_SIZE);
+  if (command == "unpack") {
+    std::ofstream file(out, std::ios::binary);
+    file << archive.info.frame;
+    for (uint64_t offset = 0; offset < archive.size;) {
+      const size_t n = archive.read(offset, buffer.data(), buffer.size());
+      if (n == 0) {
+        std::cerr << "Corrupt chunk at " << offset << std::endl;
+        return 1;
+      }
+      file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(n));
+      offset += n;
+    }
+    return file ? 0 : 1;
+  }
+
+  if (command == "cat") {
+    const uint64_t end = args::get(countA) > 0 ? args::get(startA) + args::get(countA) : archive.size;
+    for (uint64_t offset = args::get(startA); offset < end && offset < archive.size;) {
+      const size_t want = static_cast<size_t>(std::min<uint64_t>(buffer.size(), end - offset));
+      const size_t n = args::get(deltaA) ? archive.readDelta(offset, buffer.data(), want)
+                                         : archive.read(offset, buffer.data(), want);
+      if (n == 0) {
+        std::cerr << "Corrupt chunk at " << offset << std::endl;
+        return 1;
+      }
+      std::cout.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(n));
+      offset += n;
+    }
+    return 0;
+  }
+
+  std::cerr << argsParser;
+  return 1;
+}
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <args.hxx>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "bit_gather.h"
+#include "bit_kernels.h"
+#include "capture.h"
+#include "challenge.h"
+#include "dump_file.h"
+#include "key_sink.h"
+#include "parser.h"
+#include "runner.h"
+#include "runnerc.h"
+#ifdef COMPILE_JNI
+#include "DramPufJni.h"
+#include "jni_convert.h"
+#endif
+
+using namespace SerialReader;
+
+namespace {
+  struct Result {
+    std::string name;
+    // Parameters of the case, in the order they are printed
+    std::vector<std::pair<std::string, uint64_t>> params;
+    uint64_t iterations = 0;
+    double seconds = 0;
+    // Bytes one iteration processes, 0 if throughput means nothing for the case
+    double bytes = 0;
+
+    [[nodiscard]] std::string key() const {
+      std::string k = name;
+      for (const auto& [param, value] : params) k += '/' + param + '=' + std::to_string(value);
+      return k;
+    }
+
+    [[nodiscard]] double nsPerOp() const {
+      return seconds * 1e9 / static_cast<double>(iterations);
+    }
+  };
+
+  // Counts what the runner hands on and throws it away
+  class NullSink : public DumpSink {
+  public:
+    uint64_t received = 0;
+
+    void begin(const DumpInfo&) override {}
+
+    void write(const char*, const size_t size) override {
+      received += size;
+    }
+
+    void end(bool) override {}
+  };
+
+  // The runner prints its progress to stdout, which would end up in the JSON
+  class Quiet {
+  private:
+    std::ostringstream discard;
+    std::streambuf* saved;
+
+  public:
+    Quiet() : saved(std::cout.rdbuf(discard.rdbuf())) {}
+
+    ~Quiet() {
+      std::cout.rdbuf(saved);
+    }
+  };
+}
+
+// Repeats call for at least minTime seconds after a warm-up
+static Result measure(std::string name, std::vector<std::pair<std::string, uint64_t>> params, const double bytes,
+                      const double minTime, const std::function<void()>& call) {
+  Result r{std::move(name), std::move(params), 0, 0, bytes};
+  call();
+  const auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed{};
+  do {
+    call();
+    r.iterations++;
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed.count() < minTime);
+  r.seconds = elapsed.count();
+  return r;
+}
+
+static std::vector<std::string> paramsFor(const int mode, const size_t bytes) {
+  char end[9];
+  std::snprintf(end, sizeof(end), "%08X", static_cast<uint32_t>(PUF_LOW_START + bytes));
+  return {std::to_string(mode), "0", "0", "C3", end, "00000000", "0", "0", "1"};
+}
+
+/*
+ * What the firmware prints for one measurement, as in a capture: boot messages, the prompts of the kernel, the
+ * markers and then the transfer, recorded in reads of BUFFER_SIZE bytes.
+ */
+static void writeCapture(const std::string& path, const std::string& transfer, const int prompts) {
+  std::string t = "\x16\x16\x16" "Booting Raspberry Pi...\nBUILD DATE: Jan  1 2024 12:00:00\n\x16\x16\x16$|";
+  for (int i = 0; i < prompts; i++) t += "Enter param|: x\r\n";
+  t += "puf init complete\ndisable Refresh\nManually refreshdecay completed\n\x16\x16\x16&|" + transfer;
+  CaptureWriter writer(path, 115200);
+  for (size_t i = 0; i < t.size(); i += BUFFER_SIZE) {
+    writer.record(t.data() + i, std::min<size_t>(BUFFER_SIZE, t.size() - i));
+  }
+}
+
+static std::string randomPayload(std::mt19937_64& random, const size_t size) {
+  std::string payload(size, '\0');
+  // Mostly the init value with a few decayed bits, like a real dump
+  for (auto& c : payload) c = random() % 8 == 0 ? static_cast<char>(1 << random() % 8) : '\0';
+  return payload;
+}
+
+static std::string writePositions(const std::string& path, std::mt19937_64& random, const uint64_t bits,
+                                  const size_t count) {
+  std::vector<uint64_t> positions;
+  positions.reserve(count);
+  for (size_t i = 0; i < count; i++) positions.push_back(random() % bits);
+  std::sort(positions.begin(), positions.end());
+  positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+  std::ofstream out(path);
+  for (const uint64_t p : positions) out << p << '\n';
+  return path;
+}
+
+// Runner::loop over a replayed capture, i.e. marker scanning, the frame, and copying or scanning the transfer
+static void benchLoop(std::vector<Result>& results, const std::string& dir, const std::vector<size_t>& sizes,
+                      const double minTime) {
+  std::mt19937_64 random(3);
+  for (const size_t size : sizes) {
+    const std::vector<std::string> params = paramsFor(0, size);
+    const Challenge challenge = Challenge::fromParams(params);
+    const std::string payload = randomPayload(random, challenge.payloadSize());
+    const std::string path = dir + "/puf-bench-dump.cap";
+    writeCapture(path, "0C3000000," + payload + "|&" + std::to_string(payload.size() / 4) + "|$\n",
+                 challenge.prompts());
+    Parser parser({.params = params, .maxRetries = 0, .watchdog = false, .replayFile = path});
+    results.push_back(measure("loop/dump", {{"bytes", payload.size()}}, static_cast<double>(payload.size()), minTime,
+                              [&] {
+                                const Quiet quiet;
+                                Runner runner(parser);
+                                NullSink sink;
+                                run(runner, parser, sink);
+                              }));
+    unlink(path.c_str());
+
+    // Summaries are scanned byte by byte for "|&"
+    std::string summary;
+    const std::vector<std::string> summaryParams = paramsFor(1, size);
+    for (size_t i = 0; summary.size() < size / 8; i++) {
+      char word[32];
+      std::snprintf(word, sizeof(word), "%d%04X%03X=%d,", static_cast<int>(random() % 8),
+                    static_cast<unsigned>(random() % 0x4000), static_cast<unsigned>(random() % 0x400),
+                    static_cast<int>(1 + random() % 3));
+      summary += word;
+    }
+    writeCapture(path, summary + "|&", Challenge::fromParams(summaryParams).prompts());
+    Parser summaryParser({.params = summaryParams, .maxRetries = 0, .watchdog = false, .replayFile = path});
+    results.push_back(measure("loop/summary", {{"bytes", summary.size()}}, static_cast<double>(summary.size()),
+                              minTime, [&] {
+                                const Quiet quiet;
+                                Runner runner(summaryParser);
+                                NullSink sink;
+                                run(runner, summaryParser, sink);
+                              }));
+    unlink(path.c_str());
+  }
+}
+
+// Picking a key out of a whole payload (extractBits) and while it streams in (KeySink), at several densities
+static void benchExtract(std::vector<Result>& results, const std::string& dir, const std::vector<size_t>& sizes,
+                         const std::vector<size_t>& keyBits, const double minTime) {
+  std::mt19937_64 random(4);
+  for (const size_t size : sizes) {
+    const std::string payload = randomPayload(random, size);
+    for (const size_t bits : keyBits) {
+      const std::string pos = writePositions(dir + "/puf-bench.pos", random, size * 8ULL, bits);
+      const int keySize = static_cast<int>(bits);
+      results.push_back(measure("extract/bits", {{"bytes", size}, {"positions", bits}}, static_cast<double>(size),
+                                minTime, [&] {
+                                  std::string key = extractBits(payload.data(), payload.size(), pos, keySize);
+                                  if (key.empty()) std::cerr << "no key" << std::endl;
+                                }));
+      results.push_back(measure("extract/stream", {{"bytes", size}, {"positions", bits}}, static_cast<double>(size),
+                                minTime, [&] {
+                                  KeySink sink({{pos, keySize}});
+                                  sink.begin(DumpInfo());
+                                  for (size_t i = 0; i < payload.size(); i += BUFFER_SIZE) {
+                                    sink.write(payload.data() + i, std::min<size_t>(BUFFER_SIZE, payload.size() - i));
+                                  }
+                                  sink.end(true);
+                                }));
+      unlink(pos.c_str());
+    }
+  }
+}
+
+static void benchPositions(std::vector<Result>& results, const std::string& dir, const std::vector<size_t>& counts,
+                           const double minTime) {
+  std::mt19937_64 random(5);
+  for (const size_t count : counts) {
+    const std::string pos = writePositions(dir + "/puf-bench.pos", random, 1ULL << 32, count);
+    results.push_back(measure("positions/load", {{"positions", count}}, 0, minTime, [&] {
+      const KeyPositions p = KeyPositions::load(pos, static_cast<int>(count));
+      if (p.size() == 0) std::cerr << "no positions" << std::endl;
+    }));
+    unlink(pos.c_str());
+  }
+}
+
+// DumpWriter from begin to end, fed in chunks as the runner would with reads of that size
+static void benchWriter(std::vector<Result>& results, const std::string& dir, const size_t size,
+                        const std::vector<size_t>& chunks, const double minTime) {
+  std::mt19937_64 random(6);
+  const std::string payload = randomPayload(random, size);
+  const std::string path = dir + "/puf-bench.bin";
+  DumpInfo info;
+  info.challenge = Challenge::fromParams(paramsFor(0, size));
+  info.frame = "0C3000000,";
+  info.payloadSize = size;
+  for (const DumpFormat format : {DumpFormat::RAW, DumpFormat::DESCRIBED}) {
+    for (const size_t chunk : chunks) {
+      results.push_back(measure(format == DumpFormat::RAW ? "writer/raw" : "writer/described",
+                                {{"bytes", size}, {"chunk", chunk}}, static_cast<double>(size), minTime, [&] {
+                                  DumpWriter writer(path, format);
+                                  writer.begin(info);
+                                  for (size_t i = 0; i < payload.size(); i += chunk) {
+                                    writer.write(payload.data() + i, std::min(chunk, payload.size() - i));
+                                  }
+                                  writer.end(true);
+                                }));
+    }
+  }
+  unlink(path.c_str());
+}
+
+/*
+ * What a call through gen_key costs besides the measurement: turning the C strings into params, setting up the
+ * runner, loading the pos file and copying the key out, on the smallest dump. DramPufJni.genKey adds only the
+ * string conversions of the JVM to this.
+ */
+static void benchEntry(std::vector<Result>& results, const std::string& dir, const double minTime) {
+  std::mt19937_64 random(7);
+  const std::vector<std::string> params = paramsFor(0, 1024);
+  const std::string payload = randomPayload(random, Challenge::fromParams(params).payloadSize());
+  const std::string path = dir + "/puf-bench-entry.cap";
+  writeCapture(path, "0C3000000," + payload + "|&" + std::to_string(payload.size() / 4) + "|$\n",
+               Challenge::fromParams(params).prompts());
+  const std::string pos = writePositions(dir + "/puf-bench.pos", random, payload.size() * 8ULL, 256);
+  std::vector<const char*> cParams;
+  for (const auto& param : params) cParams.push_back(param.c_str());
+  results.push_back(measure("entry/replay_key", {{"bytes", payload.size()}, {"positions", 256}}, 0, minTime, [&] {
+    const Quiet quiet;
+    char* key = replay_key(path.c_str(), 0, cParams.data(), static_cast<int>(cParams.size()), pos.c_str(), 256);
+    delete[] key;
+  }));
+  const char* posFiles[] = {pos.c_str(), pos.c_str(), pos.c_str(), pos.c_str()};
+  const int keySizes[] = {256, 256, 256, 256};
+  results.push_back(measure("entry/replay_keys", {{"bytes", payload.size()}, {"keys", 4}}, 0, minTime, [&] {
+    const Quiet quiet;
+    char** keys = replay_keys(path.c_str(), 0, cParams.data(), static_cast<int>(cParams.size()), posFiles, keySizes,
+                              4);
+    free_keys(keys, 4);
+  }));
+  unlink(path.c_str());
+  unlink(pos.c_str());
+}
+
+#ifdef COMPILE_JNI
+/*
+ * The marshalling of the JNI functions, in a JVM started through the invocation API: params and responses
+ * converted from Java, keys converted to Java. The local references a case creates are deleted every iteration,
+ * as returning to Java would.
+ */
+static void benchJni(std::vector<Result>& results, const double minTime) {
+  JavaVM* vm = nullptr;
+  JNIEnv* env = nullptr;
+  JavaVMInitArgs vmArgs{};
+  vmArgs.version = JNI_VERSION_1_8;
+  vmArgs.ignoreUnrecognized = JNI_TRUE;
+  if (JNI_CreateJavaVM(&vm, reinterpret_cast<void**>(&env), &vmArgs) != JNI_OK) {
+    std::cerr << "Could not start a JVM, skipping the jni cases" << std::endl;
+    return;
+  }
+  std::mt19937_64 random(11);
+  const std::vector<std::string> params = paramsFor(0, 1024);
+  std::vector<const char*> cParams;
+  for (const auto& param : params) cParams.push_back(param.c_str());
+  jobjectArray jParams = toJavaStrings(env, cParams.data(), static_cast<jsize>(cParams.size()));
+  results.push_back(measure("jni/params", {{"strings", params.size()}}, 0, minTime, [&] {
+    const std::vector<std::string> converted = toStrings(env, jParams, static_cast<jint>(params.size()));
+  }));
+
+  for (const uint64_t bits : {256, 4096, 65536}) {
+    std::string key(bits, '0');
+    for (auto& c : key) c = static_cast<char>('0' + random() % 2);
+    results.push_back(measure("jni/key", {{"bits", bits}}, static_cast<double>(bits), minTime, [&] {
+      env->DeleteLocalRef(env->NewStringUTF(key.c_str()));
+    }));
+    const std::vector<const char*> keys(4, key.c_str());
+    results.push_back(measure("jni/keys", {{"bits", bits}, {"keys", keys.size()}},
+                              static_cast<double>(bits * keys.size()), minTime, [&] {
+      env->DeleteLocalRef(toJavaStrings(env, keys.data(), static_cast<jsize>(keys.size())));
+    }));
+    const std::string response = randomPayload(random, bits / 8);
+    jbyteArray jResponse = env->NewByteArray(static_cast<jsize>(response.size()));
+    env->SetByteArrayRegion(jResponse, 0, static_cast<jsize>(response.size()),
+                            reinterpret_cast<const jbyte*>(response.data()));
+    results.push_back(measure("jni/response", {{"bits", bits}}, static_cast<double>(bits / 8), minTime, [&] {
+      const std::vector<unsigned char> converted = toBytes(env, jResponse, static_cast<jint>(bits));
+    }));
+    env->DeleteLocalRef(jResponse);
+  }
+
+  results.push_back(measure("jni/latency_stats", {}, 0, minTime, [&] {
+    env->DeleteLocalRef(Java_DramPufJni_latencyStats(env, nullptr, 0));
+  }));
+  env->DeleteLocalRef(jParams);
+  vm->DestroyJavaVM();
+}
+#endif
+
+static void printJson(std::ostream& out, const std::vector<Result>& results) {
+  out << "{\n  \"tool\": \"puf-bench\",\n  \"version\": 1,\n  \"time\": " << std::time(nullptr)
+      << ",\n  \"kernels\": \"" << bitKernels().name << "\",\n  \"gather\": \"" << gatherKernel()
+      << "\",\n  \"results\": [\n";
+  // One result per line, so that compare (and grep) can read them without a JSON parser
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    char numbers[160];
+    std::snprintf(numbers, sizeof(numbers), "\"iterations\": %llu, \"seconds\": %.6f, \"ns_per_op\": %.1f, "
+                  "\"mb_per_s\": %.2f", static_cast<unsigned long long>(r.iterations), r.seconds, r.nsPerOp(),
+                  r.bytes > 0 ? r.bytes * static_cast<double>(r.iterations) / r.seconds / 1e6 : 0.0);
+    out << "    {\"key\": \"" << r.key() << "\", \"name\": \"" << r.name << '"';
+    for (const auto& [param, value] : r.params) out << ", \"" << param << "\": " << value;
+    out << ", " << numbers << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+  }
+  out << "  ]\n}\n";
+}
+
+// ns_per_op of every result of a file written by printJson, by key
+static std::map<std::string, double> readJson(const std::string& path) {
+  std::map<std::string, double> ret;
+  std::ifstream in(path);
+  for (std::string line; std::getline(in, line);) {
+    const size_t key = line.find("\"key\": \"");
+    const size_t ns = line.find("\"ns_per_op\": ");
+    if (key == std::string::npos || ns == std::string::npos) continue;
+    const size_t start = key + 8;
+    ret[line.substr(start, line.find('"', start) - start)] = std::stod(line.substr(ns + 13));
+  }
+  return ret;
+}
+
+// Times of NEW against OLD per case; exits with 1 if a case got slower than the threshold allows
+static int compare(const std::string& oldPath, const std::string& newPath, const double threshold) {
+  const auto before = readJson(oldPath);
+  const auto after = readJson(newPath);
+  if (before.empty() || after.empty()) {
+    std::cerr << "Could not read " << (before.empty() ? oldPath : newPath) << std::endl;
+    return 1;
+  }
+  int slower = 0;
+  std::printf("%-56s %14s %14s %8s\n", "case", "old ns/op", "new ns/op", "ratio");
+  for (const auto& [key, ns] : after) {
+    const auto it = before.find(key);
+    if (it == before.end()) {
+      std::printf("%-56s %14s %14.1f %8s\n", key.c_str(), "-", ns, "new");
+      continue;
+    }
+    const double ratio = ns / it->second;
+    const bool regressed = ratio > 1 + threshold;
+    slower += regressed;
+    std::printf("%-56s %14.1f %14.1f %7.2fx%s\n", key.c_str(), it->second, ns, ratio, regressed ? " slower" : "");
+  }
+  return slower > 0 ? 1 : 0;
+}
+
+// Benchmarks the hot paths of the receiver and writes the results as JSON
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Benchmarks the receiver: the runner loop on replayed captures, key extraction, pos file loading, the dump "
+    "writer, the cost of a gen_key call and, built with COMPILE_JNI, the JNI conversions.",
+    "Commands: run (writes JSON to stdout or -o), compare OLD NEW (ns per operation of both runs, exits with 1 if a "
+    "case got slower by more than --threshold)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "run or compare");
+  args::PositionalList<std::string> filesA(argsParser, "files", "compare: old and new results");
+  args::ValueFlag<std::string> outA(argsParser, "file", "run: write the results here instead of stdout", {'o', "out"});
+  args::ValueFlag<std::string> dirA(argsParser, "dir", "run: where to put captures and dumps", {"dir"}, "/tmp");
+  args::ValueFlag<std::string> filterA(argsParser, "prefix", "run: only cases whose name starts with this",
+                                       {'f', "filter"}, "");
+  args::ValueFlag<double> minTimeA(argsParser, "seconds", "run: minimal time per case", {"min-time"}, 0.2);
+  args::Flag quickA(argsParser, "quick", "run: small inputs only", {"quick"});
+  args::ValueFlag<double> thresholdA(argsParser, "share", "compare: slowdown that counts as a regression",
+                                     {"threshold"}, 0.1);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  if (command == "compare" && args::get(filesA).size() == 2) {
+    return compare(args::get(filesA)[0], args::get(filesA)[1], args::get(thresholdA));
+  }
+  if (command != "run") {
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const bool quick = args::get(quickA);
+  const std::string& dir = args::get(dirA);
+  const std::string& filter = args::get(filterA);
+  const double minTime = args::get(minTimeA);
+  const auto selected = [&filter](const std::string& group) {
+    return filter.empty() || group.rfind(filter, 0) == 0 || filter.rfind(group, 0) == 0;
+  };
+  const std::vector<size_t> sizes = quick ? std::vector<size_t>{1 << 16, 1 << 20}
+                                          : std::vector<size_t>{1 << 16, 1 << 20, 16 << 20};
+  std::vector<Result> results;
+  if (selected("loop")) benchLoop(results, dir, sizes, minTime);
+  if (selected("extract")) benchExtract(results, dir, sizes, {256, 4096, 65536}, minTime);
+  if (selected("positions")) {
+    benchPositions(results, dir, quick ? std::vector<size_t>{1024, 65536} : std::vector<size_t>{1024, 65536, 1 << 20},
+                   minTime);
+  }
+  if (selected("writer")) benchWriter(results, dir, quick ? 1 << 20 : 16 << 20, {64, BUFFER_SIZE, 1 << 16}, minTime);
+  if (selected("entry")) benchEntry(results, dir, minTime);
+#ifdef COMPILE_JNI
+  if (selected("jni")) benchJni(results, minTime);
+#endif
+  // A filter on a whole case name keeps only that case
+  results.erase(std::remove_if(results.begin(), results.end(), [&filter](const Result& r) {
+    return !filter.empty() && r.key().rfind(filter, 0) != 0 && filter.rfind(r.name, 0) != 0 &&
+           r.name.rfind(filter, 0) != 0;
+  }), results.end());
+
+  if (outA) {
+    std::ofstream out(args::get(outA));
+    printJson(out, results);
+    if (!out) {
+      std::cerr << "Could not write " << args::get(outA) << std::endl;
+      return 1;
+    }
+  } else {
+    printJson(std::cout, results);
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <fstream>
+#include "bit_gather.h"
+#include "bit_kernels.h"
+
+void SerialReader::KeyPositions::add(const uint64_t bit) {
+  const auto mask = static_cast<uint8_t>(0x80 >> bit % 8);
+  if (offsets.size() % 8 == 0) batchMasks.push_back(0);
+  batchMasks.back() |= static_cast<uint64_t>(mask) << 8 * (7 - offsets.size() % 8);
+  offsets.push_back(bit / 8);
+  masks.push_back(mask);
+}
+
+SerialReader::KeyPositions SerialReader::KeyPositions::load(const std::string& posFile, const int keySize) {
+  KeyPositions ret;
+  std::ifstream in(posFile);
+  if (keySize <= 0) return ret;
+  ret.offsets.reserve(keySize);
+  ret.masks.reserve(keySize);
+  ret.batchMasks.reserve((keySize + 7) / 8);
+  long long bit;
+  long long last = -1;
+  while (static_cast<int>(ret.size()) < keySize && in >> bit && bit > last) {
+    ret.add(static_cast<uint64_t>(bit));
+    last = bit;
+  }
+  return ret;
+}
+
+size_t SerialReader::gatherBits(const unsigned char* payload, const size_t size, const KeyPositions& positions,
+                                unsigned char* out) {
+  // Positions are ascending, so the ones inside the payload come first
+  const size_t n = std::lower_bound(positions.offsets.begin(), positions.offsets.end(), size) -
+                   positions.offsets.begin();
+  bitKernels().gather(payload, positions.offsets.data(), positions.masks.data(), positions.batchMasks.data(), n / 8,
+                      out);
+  if (n % 8 != 0) {
+    unsigned char byte = 0;
+    for (size_t i = n / 8 * 8; i < n; i++) {
+      byte |= static_cast<unsigned char>(((payload[positions.offsets[i]] & positions.masks[i]) != 0) << (7 - i % 8));
+    }
+    out[n / 8] = byte;
+  }
+  return n;
+}
+
+const char* SerialReader::gatherKernel() {
+  return bitKernels().gatherName;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SerialReader {
+  /*
+   * The positions of a pos file, prepared for gatherBits: byte offset and mask of every bit, plus the masks of each
+   * batch of 8 positions as one word (first position in the most significant byte).
+   */
+  struct KeyPositions {
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> masks;
+    std::vector<uint64_t> batchMasks;
+
+    [[nodiscard]] size_t size() const {
+      return offsets.size();
+    }
+
+    void add(uint64_t bit);
+
+    /*
+     * Reads up to keySize positions. Like the sequential scan it replaces, reading stops at the first position that
+     * does not come after the one before it.
+     */
+    static KeyPositions load(const std::string& posFile, int keySize);
+  };
+
+  /*
+   * Picks the bits at positions out of payload into out, MSB first, so out needs (positions.size() + 7) / 8 bytes.
+   * Returns the number of bits, which is less than positions.size() if positions point beyond the payload.
+   */
+  size_t gatherBits(const unsigned char* payload, size_t size, const KeyPositions& positions, unsigned char* out);
+
+  // The kernel gatherBits picked for this CPU: "bmi2", "neon" or "scalar"
+  const char* gatherKernel();
+}
@@ -0,0 +1,502 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "bit_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KERNELS_NEON
+#endif
+
+// Vectors of words for the generic kernels, GCC lowers their operators to the instruction set of the caller
+typedef uint64_t Vec128 __attribute__((vector_size(16)));
+typedef uint64_t Vec256 __attribute__((vector_size(32)));
+typedef uint64_t Vec512 __attribute__((vector_size(64)));
+
+// What the counting kernels count: ones of a, ones of a ^ b, or ones of (a ^ b) & mask
+enum Count { ONES, DIFFERENT, MASKED };
+
+// Generic kernels: a word type (or vector of words) V processes words from i on, the rest is left to the caller
+
+template<typename V>
+[[gnu::always_inline]] static inline size_t xorWords(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t i,
+                                                      const size_t words) {
+  for (; i + sizeof(V) / 8 <= words; i += sizeof(V) / 8) {
+    V x;
+    V y;
+    std::memcpy(&x, a + i, sizeof(V));
+    std::memcpy(&y, b + i, sizeof(V));
+    x ^= y;
+    std::memcpy(out + i, &x, sizeof(V));
+  }
+  return i;
+}
+
+template<typename V>
+[[gnu::always_inline]] static inline size_t incrementWords(uint64_t* const* planes, const uint32_t count,
+                                                            const uint64_t* carry, size_t i, const size_t words) {
+  for (; i + sizeof(V) / 8 <= words; i += sizeof(V) / 8) {
+    V c;
+    std::memcpy(&c, carry + i, sizeof(V));
+    // Ripple carry adder over the planes, counters that overflow keep the carry and stay at their maximum
+    for (uint32_t k = 0; k < count; k++) {
+      V counter;
+      std::memcpy(&counter, planes[k] + i, sizeof(V));
+      const V next = counter & c;
+      counter ^= c;
+      std::memcpy(planes[k] + i, &counter, sizeof(V));
+      c = next;
+    }
+    for (uint32_t k = 0; k < count; k++) {
+      V counter;
+      std::memcpy(&counter, planes[k] + i, sizeof(V));
+      counter |= c;
+      std::memcpy(planes[k] + i, &counter, sizeof(V));
+    }
+  }
+  return i;
+}
+
+// Compares bit-sliced counters with threshold from the most significant plane down
+template<typename V>
+[[gnu::always_inline]] static inline void compareCounters(const V* counter, const uint32_t count,
+                                                           const uint32_t threshold, V& less, V& equal) {
+  less = V{};
+  equal = ~V{};
+  for (uint32_t k = count; k-- > 0;) {
+    if (threshold >> k & 1) {
+      less |= equal & ~counter[k];
+      equal &= counter[k];
+    } else {
+      equal &= ~counter[k];
+    }
+  }
+}
+
+template<typename V>
+[[gnu::always_inline]] static inline size_t atMostWords(const uint64_t* const* planes, const uint32_t count,
+                                                         const uint32_t threshold, uint64_t* out, size_t i,
+                                                         const size_t words) {
+  for (; i + sizeof(V) / 8 <= words; i += sizeof(V) / 8) {
+    V counter[32];
+    for (uint32_t k = 0; k < count; k++) std::memcpy(&counter[k], planes[k] + i, sizeof(V));
+    V less;
+    V equal;
+    compareCounters(counter, count, threshold, less, equal);
+    less |= equal;
+    std::memcpy(out + i, &less, sizeof(V));
+  }
+  return i;
+}
+
+template<typename V>
+[[gnu::always_inline]] static inline size_t majorityWords(const uint64_t* const* inputs, const size_t count,
+                                                           uint64_t* out, size_t i, const size_t words) {
+  // Counters wide enough for count, so nothing overflows
+  const auto planes = static_cast<uint32_t>(64 - __builtin_clzll(count));
+  for (; i + sizeof(V) / 8 <= words; i += sizeof(V) / 8) {
+    V counter[64];
+    for (uint32_t k = 0; k < planes; k++) counter[k] = V{};
+    for (size_t j = 0; j < count; j++) {
+      V c;
+      std::memcpy(&c, inputs[j] + i, sizeof(V));
+      for (uint32_t k = 0; k < planes; k++) {
+        const V next = counter[k] & c;
+        counter[k] ^= c;
+        c = next;
+      }
+    }
+    // At least (count + 1) / 2 ones is the same as not at most (count + 1) / 2 - 1
+    V less;
+    V equal;
+    compareCounters(counter, planes, static_cast<uint32_t>((count + 1) / 2 - 1), less, equal);
+    less = ~(less | equal);
+    std::memcpy(out + i, &less, sizeof(V));
+  }
+  return i;
+}
+
+// Scalar kernels, also the tails of the vector ones
+
+template<Count C>
+static uint64_t countScalar(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  uint64_t n = 0;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t x;
+    std::memcpy(&x, a + i, 8);
+    if constexpr (C != ONES) {
+      uint64_t y;
+      std::memcpy(&y, b + i, 8);
+      x ^= y;
+    }
+    if constexpr (C == MASKED) {
+      uint64_t m;
+      std::memcpy(&m, mask + i, 8);
+      x &= m;
+    }
+    n += __builtin_popcountll(x);
+  }
+  return n;
+}
+
+static void xorScalar(uint64_t* out, const uint64_t* a, const uint64_t* b, const size_t words) {
+  xorWords<uint64_t>(out, a, b, 0, words);
+}
+
+static void incrementScalar(uint64_t* const* planes, const uint32_t count, const uint64_t* carry,
+                            const size_t words) {
+  incrementWords<uint64_t>(planes, count, carry, 0, words);
+}
+
+static void atMostScalar(const uint64_t* const* planes, const uint32_t count, const uint32_t threshold,
+                         uint64_t* out, const size_t words) {
+  atMostWords<uint64_t>(planes, count, threshold, out, 0, words);
+}
+
+static void majorityScalar(const uint64_t* const* inputs, const size_t count, uint64_t* out, const size_t words) {
+  if (count == 0) {
+    std::memset(out, 0, words * 8);
+    return;
+  }
+  majorityWords<uint64_t>(inputs, count, out, 0, words);
+}
+
+static void spreadScalar(const unsigned char* data, const size_t count, uint64_t* words, const uint64_t run) {
+  for (size_t i = 0; i < count; i++, words += 8) {
+    const unsigned char byte = data[i];
+    if (byte == 0) continue;
+    for (int bit = 0; bit < 8; bit++) {
+      if (byte & 0x80 >> bit) words[bit] |= run;
+    }
+  }
+}
+
+static void gatherScalar(const unsigned char* payload, const uint64_t* offsets, const uint8_t* masks,
+                         const uint64_t*, const size_t batches, unsigned char* out) {
+  for (size_t b = 0; b < batches; b++, offsets += 8, masks += 8) {
+    unsigned char byte = 0;
+    for (int i = 0; i < 8; i++) byte = static_cast<unsigned char>(byte << 1 | ((payload[offsets[i]] & masks[i]) != 0));
+    out[b] = byte;
+  }
+}
+
+#ifdef KERNELS_X86
+// The same loop, but the popcount becomes one instruction instead of a bit-twiddling sequence
+template<Count C>
+__attribute__((target("popcnt")))
+static uint64_t countPopcnt(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  uint64_t n = 0;
+  for (size_t i = 0; i < words; i++) {
+    uint64_t x;
+    std::memcpy(&x, a + i, 8);
+    if constexpr (C != ONES) {
+      uint64_t y;
+      std::memcpy(&y, b + i, 8);
+      x ^= y;
+    }
+    if constexpr (C == MASKED) {
+      uint64_t m;
+      std::memcpy(&m, mask + i, 8);
+      x &= m;
+    }
+    n += __builtin_popcountll(x);
+  }
+  return n;
+}
+
+// Looks up the bits of each nibble with vpshufb and sums the byte counts with vpsadbw
+template<Count C>
+__attribute__((target("avx2,popcnt")))
+static uint64_t countAvx2(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i sum = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= words; i += 4) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    if constexpr (C != ONES) x = _mm256_xor_si256(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+    if constexpr (C == MASKED) {
+      x = _mm256_and_si256(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i)));
+    }
+    const __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low)),
+                                          _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+    sum = _mm256_add_epi64(sum, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + countPopcnt<C>(a + i, b + i, mask + i, words - i);
+}
+
+// vpopcntq counts 8 words at once, a masked load takes care of the tail
+template<Count C>
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static uint64_t countAvx512(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  __m512i sum = _mm512_setzero_si512();
+  for (size_t i = 0; i < words; i += 8) {
+    const auto k = static_cast<__mmask8>(words - i >= 8 ? 0xFF : (1U << (words - i)) - 1);
+    __m512i x = _mm512_maskz_loadu_epi64(k, a + i);
+    if constexpr (C != ONES) x = _mm512_xor_si512(x, _mm512_maskz_loadu_epi64(k, b + i));
+    if constexpr (C == MASKED) x = _mm512_and_si512(x, _mm512_maskz_loadu_epi64(k, mask + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+  }
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, sum);
+  uint64_t n = 0;
+  for (const uint64_t lane : lanes) n += lane;
+  return n;
+}
+
+__attribute__((target("avx2")))
+static void xorAvx2(uint64_t* out, const uint64_t* a, const uint64_t* b, const size_t words) {
+  xorWords<uint64_t>(out, a, b, xorWords<Vec256>(out, a, b, 0, words), words);
+}
+
+__attribute__((target("avx2")))
+static void incrementAvx2(uint64_t* const* planes, const uint32_t count, const uint64_t* carry, const size_t words) {
+  incrementWords<uint64_t>(planes, count, carry, incrementWords<Vec256>(planes, count, carry, 0, words), words);
+}
+
+__attribute__((target("avx2")))
+static void atMostAvx2(const uint64_t* const* planes, const uint32_t count, const uint32_t threshold, uint64_t* out,
+                       const size_t words) {
+  atMostWords<uint64_t>(planes, count, threshold, out,
+                        atMostWords<Vec256>(planes, count, threshold, out, 0, words), words);
+}
+
+__attribute__((target("avx2")))
+static void majorityAvx2(const uint64_t* const* inputs, const size_t count, uint64_t* out, const size_t words) {
+  if (count == 0) {
+    std::memset(out, 0, words * 8);
+    return;
+  }
+  majorityWords<uint64_t>(inputs, count, out, majorityWords<Vec256>(inputs, count, out, 0, words), words);
+}
+
+// Compares a broadcast of the byte with the 8 bit masks and ORs run into the words that matched
+__attribute__((target("avx2")))
+static void spreadAvx2(const unsigned char* data, const size_t count, uint64_t* words, const uint64_t run) {
+  const __m256i high = _mm256_setr_epi64x(0x80, 0x40, 0x20, 0x10);
+  const __m256i low = _mm256_setr_epi64x(0x08, 0x04, 0x02, 0x01);
+  const __m256i r = _mm256_set1_epi64x(static_cast<long long>(run));
+  for (size_t i = 0; i < count; i++, words += 8) {
+    if (data[i] == 0) continue;
+    const __m256i byte = _mm256_set1_epi64x(data[i]);
+    auto* w = reinterpret_cast<__m256i*>(words);
+    const __m256i h = _mm256_cmpeq_epi64(_mm256_and_si256(byte, high), high);
+    const __m256i l = _mm256_cmpeq_epi64(_mm256_and_si256(byte, low), low);
+    _mm256_storeu_si256(w, _mm256_or_si256(_mm256_loadu_si256(w), _mm256_and_si256(h, r)));
+    _mm256_storeu_si256(w + 1, _mm256_or_si256(_mm256_loadu_si256(w + 1), _mm256_and_si256(l, r)));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void xorAvx512(uint64_t* out, const uint64_t* a, const uint64_t* b, const size_t words) {
+  xorWords<uint64_t>(out, a, b, xorWords<Vec512>(out, a, b, 0, words), words);
+}
+
+__attribute__((target("avx512f")))
+static void incrementAvx512(uint64_t* const* planes, const uint32_t count, const uint64_t* carry,
+                            const size_t words) {
+  incrementWords<uint64_t>(planes, count, carry, incrementWords<Vec512>(planes, count, carry, 0, words), words);
+}
+
+__attribute__((target("avx512f")))
+static void atMostAvx512(const uint64_t* const* planes, const uint32_t count, const uint32_t threshold,
+                         uint64_t* out, const size_t words) {
+  atMostWords<uint64_t>(planes, count, threshold, out,
+                        atMostWords<Vec512>(planes, count, threshold, out, 0, words), words);
+}
+
+__attribute__((target("avx512f")))
+static void majorityAvx512(const uint64_t* const* inputs, const size_t count, uint64_t* out, const size_t words) {
+  if (count == 0) {
+    std::memset(out, 0, words * 8);
+    return;
+  }
+  majorityWords<uint64_t>(inputs, count, out, majorityWords<Vec512>(inputs, count, out, 0, words), words);
+}
+
+// vptestmq turns the byte into a mask of the 8 words to OR run into
+__attribute__((target("avx512f")))
+static void spreadAvx512(const unsigned char* data, const size_t count, uint64_t* words, const uint64_t run) {
+  const __m512i bits = _mm512_setr_epi64(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  const __m512i r = _mm512_set1_epi64(static_cast<long long>(run));
+  for (size_t i = 0; i < count; i++, words += 8) {
+    if (data[i] == 0) continue;
+    const __mmask8 k = _mm512_test_epi64_mask(_mm512_set1_epi64(data[i]), bits);
+    const __m512i w = _mm512_loadu_si512(words);
+    _mm512_storeu_si512(words, _mm512_mask_or_epi64(w, k, w, r));
+  }
+}
+
+// Every byte of the word has a single bit in its mask, so PEXT packs the 8 bits in one instruction
+__attribute__((target("bmi2")))
+static void gatherBmi2(const unsigned char* payload, const uint64_t* offsets, const uint8_t*,
+                       const uint64_t* batchMasks, const size_t batches, unsigned char* out) {
+  for (size_t b = 0; b < batches; b++, offsets += 8) {
+    const uint64_t word = static_cast<uint64_t>(payload[offsets[0]]) << 56 |
+                          static_cast<uint64_t>(payload[offsets[1]]) << 48 |
+                          static_cast<uint64_t>(payload[offsets[2]]) << 40 |
+                          static_cast<uint64_t>(payload[offsets[3]]) << 32 |
+                          static_cast<uint64_t>(payload[offsets[4]]) << 24 |
+                          static_cast<uint64_t>(payload[offsets[5]]) << 16 |
+                          static_cast<uint64_t>(payload[offsets[6]]) << 8 |
+                          static_cast<uint64_t>(payload[offsets[7]]);
+    out[b] = static_cast<unsigned char>(_pext_u64(word, batchMasks[b]));
+  }
+}
+#endif
+
+#ifdef KERNELS_NEON
+// Counts 16 bytes at a time with vcnt and widens the byte counts pairwise into two 64 bit accumulators
+template<Count C>
+static uint64_t countNeon(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  uint64x2_t sum = vdupq_n_u64(0);
+  size_t i = 0;
+  for (; i + 2 <= words; i += 2) {
+    uint8x16_t x = vld1q_u8(reinterpret_cast<const uint8_t*>(a + i));
+    if constexpr (C != ONES) x = veorq_u8(x, vld1q_u8(reinterpret_cast<const uint8_t*>(b + i)));
+    if constexpr (C == MASKED) x = vandq_u8(x, vld1q_u8(reinterpret_cast<const uint8_t*>(mask + i)));
+    sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(vcntq_u8(x))));
+  }
+  return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1) + countScalar<C>(a + i, b + i, mask + i, words - i);
+}
+
+static void xorNeon(uint64_t* out, const uint64_t* a, const uint64_t* b, const size_t words) {
+  xorWords<uint64_t>(out, a, b, xorWords<Vec128>(out, a, b, 0, words), words);
+}
+
+static void incrementNeon(uint64_t* const* planes, const uint32_t count, const uint64_t* carry, const size_t words) {
+  incrementWords<uint64_t>(planes, count, carry, incrementWords<Vec128>(planes, count, carry, 0, words), words);
+}
+
+static void atMostNeon(const uint64_t* const* planes, const uint32_t count, const uint32_t threshold, uint64_t* out,
+                       const size_t words) {
+  atMostWords<uint64_t>(planes, count, threshold, out,
+                        atMostWords<Vec128>(planes, count, threshold, out, 0, words), words);
+}
+
+static void majorityNeon(const uint64_t* const* inputs, const size_t count, uint64_t* out, const size_t words) {
+  if (count == 0) {
+    std::memset(out, 0, words * 8);
+    return;
+  }
+  majorityWords<uint64_t>(inputs, count, out, majorityWords<Vec128>(inputs, count, out, 0, words), words);
+}
+
+// Tests each gathered byte against its mask and sums the lane weights; vpadd also exists on 32 bit ARM
+static void gatherNeon(const unsigned char* payload, const uint64_t* offsets, const uint8_t* masks,
+                       const uint64_t*, const size_t batches, unsigned char* out) {
+  static const uint8_t weights[8] = {128, 64, 32, 16, 8, 4, 2, 1};
+  const uint8x8_t weight = vld1_u8(weights);
+  uint8_t bytes[8];
+  for (size_t b = 0; b < batches; b++, offsets += 8, masks += 8) {
+    for (int i = 0; i < 8; i++) bytes[i] = payload[offsets[i]];
+    uint8x8_t bits = vand_u8(vtst_u8(vld1_u8(bytes), vld1_u8(masks)), weight);
+    bits = vpadd_u8(bits, bits);
+    bits = vpadd_u8(bits, bits);
+    bits = vpadd_u8(bits, bits);
+    out[b] = vget_lane_u8(bits, 0);
+  }
+}
+#endif
+
+// The counting kernels with the signatures of BitKernels
+template<uint64_t (*F)(const uint64_t*, const uint64_t*, const uint64_t*, size_t)>
+static uint64_t ones(const uint64_t* a, const size_t words) {
+  return F(a, a, a, words);
+}
+
+template<uint64_t (*F)(const uint64_t*, const uint64_t*, const uint64_t*, size_t)>
+static uint64_t different(const uint64_t* a, const uint64_t* b, const size_t words) {
+  return F(a, b, b, words);
+}
+
+static std::vector<SerialReader::BitKernels> detect() {
+  std::vector<SerialReader::BitKernels> ret;
+  SerialReader::BitKernels k{
+    "scalar", "scalar", ones<countScalar<ONES>>, different<countScalar<DIFFERENT>>, countScalar<MASKED>, xorScalar,
+    incrementScalar, atMostScalar, majorityScalar, spreadScalar, gatherScalar
+  };
+  ret.push_back(k);
+#ifdef KERNELS_X86
+  // Runs during static initialization, possibly before libgcc had a look at the CPU
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("bmi2")) {
+    k.gatherName = "bmi2";
+    k.gather = gatherBmi2;
+  }
+  if (!__builtin_cpu_supports("popcnt")) return ret;
+  k.name = "popcnt";
+  k.popcount = ones<countPopcnt<ONES>>;
+  k.distance = different<countPopcnt<DIFFERENT>>;
+  k.maskedDistance = countPopcnt<MASKED>;
+  ret.push_back(k);
+  if (__builtin_cpu_supports("avx2")) {
+    k.name = "avx2";
+    k.popcount = ones<countAvx2<ONES>>;
+    k.distance = different<countAvx2<DIFFERENT>>;
+    k.maskedDistance = countAvx2<MASKED>;
+    k.bitXor = xorAvx2;
+    k.increment = incrementAvx2;
+    k.atMost = atMostAvx2;
+    k.majority = majorityAvx2;
+    k.spread = spreadAvx2;
+    ret.push_back(k);
+  }
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+    k.name = "avx512";
+    k.popcount = ones<countAvx512<ONES>>;
+    k.distance = different<countAvx512<DIFFERENT>>;
+    k.maskedDistance = countAvx512<MASKED>;
+    k.bitXor = xorAvx512;
+    k.increment = incrementAvx512;
+    k.atMost = atMostAvx512;
+    k.majority = majorityAvx512;
+    k.spread = spreadAvx512;
+    ret.push_back(k);
+  }
+#endif
+#ifdef KERNELS_NEON
+  // Spreading stays scalar: most bytes of a dump have no bit set, and those are skipped either way
+  k.name = "neon";
+  k.gatherName = "neon";
+  k.popcount = ones<countNeon<ONES>>;
+  k.distance = different<countNeon<DIFFERENT>>;
+  k.maskedDistance = countNeon<MASKED>;
+  k.bitXor = xorNeon;
+  k.increment = incrementNeon;
+  k.atMost = atMostNeon;
+  k.majority = majorityNeon;
+  k.gather = gatherNeon;
+  ret.push_back(k);
+#endif
+  return ret;
+}
+
+const std::vector<const SerialReader::BitKernels*>& SerialReader::availableKernels() {
+  static const std::vector<BitKernels> sets = detect();
+  static const std::vector<const BitKernels*> ret = [] {
+    std::vector<const BitKernels*> pointers;
+    for (const auto& set : sets) pointers.push_back(&set);
+    return pointers;
+  }();
+  return ret;
+}
+
+const SerialReader::BitKernels& SerialReader::bitKernels() {
+  static const BitKernels* chosen = [] {
+    const auto& sets = availableKernels();
+    if (const char* name = std::getenv(KERNELS_ENV); name != nullptr) {
+      for (const auto* set : sets) {
+        if (set->name == std::string(name)) return set;
+      }
+    }
+    return sets.back();
+  }();
+  return *chosen;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Names a kernel set (see availableKernels) to use instead of the fastest one, e.g. to compare results
+#define KERNELS_ENV "PUF_KERNELS"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SerialReader {
+  /*
+   * The bit operations the analysis tools share, in one implementation per instruction set. Word arguments may be
+   * unaligned (they are loaded with memcpy), so byte buffers such as payloads can be passed as they are. Kernels
+   * that write never read their output first, except where noted.
+   */
+  struct BitKernels {
+    // "scalar", "popcnt", "avx2", "avx512" or "neon"
+    const char* name;
+    // The gather kernel is picked on its own: "scalar", "bmi2" or "neon"
+    const char* gatherName;
+
+    // Set bits of a
+    uint64_t (*popcount)(const uint64_t* a, size_t words);
+
+    // Bits in which a and b differ
+    uint64_t (*distance)(const uint64_t* a, const uint64_t* b, size_t words);
+
+    // Bits in which a and b differ among the bits set in mask
+    uint64_t (*maskedDistance)(const uint64_t* a, const uint64_t* b, const uint64_t* mask, size_t words);
+
+    // out = a ^ b; out may be a or b
+    void (*bitXor)(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words);
+
+    /*
+     * Adds carry (one bit per counter) to bit-sliced counters, planes[0] holding the least significant bit of
+     * every counter, and count at most 32. Counters that would overflow stay at their maximum. Reads and writes the
+     * planes.
+     */
+    void (*increment)(uint64_t* const* planes, uint32_t count, const uint64_t* carry, size_t words);
+
+    // Sets the bits of out whose bit-sliced counter (as for increment) is at most threshold
+    void (*atMost)(const uint64_t* const* planes, uint32_t count, uint32_t threshold, uint64_t* out, size_t words);
+
+    // Sets the bits of out that are set in at least half of the count inputs (none if count is 0)
+    void (*majority)(const uint64_t* const* inputs, size_t count, uint64_t* out, size_t words);
+
+    /*
+     * Transposes bytes into words: bit i (MSB first) of data[j] sets the bits in run of words[8 * j + i]. Reads and
+     * writes the words.
+     */
+    void (*spread)(const unsigned char* data, size_t count, uint64_t* words, uint64_t run);
+
+    /*
+     * Packs batches of 8 bits MSB first into out: bit i of batch b is payload[offsets[8 * b + i]] & masks[8 * b + i],
+     * batchMasks[b] holds the 8 masks with the first one in the most significant byte.
+     */
+    void (*gather)(const unsigned char* payload, const uint64_t* offsets, const uint8_t* masks,
+                   const uint64_t* batchMasks, size_t batches, unsigned char* out);
+  };
+
+  // The fastest kernels this CPU runs, or the ones KERNELS_ENV names; picked once
+  const BitKernels& bitKernels();
+
+  // Every kernel set this CPU runs, scalar first and the fastest last
+  const std::vector<const BitKernels*>& availableKernels();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Little endian fields of the file formats, independent of the host
+namespace SerialReader {
+  inline void putU32(unsigned char* p, const uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<unsigned char>(v >> 8 * i);
+  }
+
+  inline void putU64(unsigned char* p, const uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<unsigned char>(v >> 8 * i);
+  }
+
+  inline uint32_t getU32(const unsigned char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(p[i]) << 8 * i;
+    return v;
+  }
+
+  inline uint64_t getU64(const unsigned char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(p[i]) << 8 * i;
+    return v;
+  }
+
+  // NUL-terminated text in a fixed size field, cut off if too long
+  inline void putString(unsigned char* p, const std::string& s, const size_t size) {
+    std::memcpy(p, s.data(), s.size() < size - 1 ? s.size() : size - 1);
+  }
+
+  inline std::string getString(const unsigned char* p, const size_t size) {
+    return {reinterpret_cast<const char*>(p), strnlen(reinterpret_cast<const char*>(p), size)};
+  }
+}
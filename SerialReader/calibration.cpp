@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "calibration.h"
+#include "runner.h"
+
+SerialReader::DecayCalibration::DecayCalibration(const double _target, const int _start, const double _tolerance)
+  : target(_target), tolerance(_tolerance),
+    start(std::clamp(_start, CALIBRATION_MIN_DECAY, CALIBRATION_MAX_DECAY)) {}
+
+void SerialReader::DecayCalibration::add(const CalibrationPoint& point) {
+  points.push_back(point);
+}
+
+// Densities of 0 and 1 are moved half a bit inwards, so that every measurement has a finite logit
+static double logit(const double density, const uint64_t bits) {
+  const double half = bits > 0 ? 0.5 / static_cast<double>(bits) : 1e-9;
+  const double d = std::clamp(density, half, 1 - half);
+  return std::log(d / (1 - d));
+}
+
+// log(decay) at which the line through a and b reaches y
+static double fit(const SerialReader::CalibrationPoint& a, const SerialReader::CalibrationPoint& b, const double y) {
+  const double xa = std::log(a.decay), xb = std::log(b.decay);
+  const double ya = logit(a.density(), a.bits), yb = logit(b.density(), b.bits);
+  if (ya == yb) return (xa + xb) / 2;
+  return xa + (y - ya) * (xb - xa) / (yb - ya);
+}
+
+std::optional<int> SerialReader::DecayCalibration::next() const {
+  if (points.empty()) return start;
+  if (points.size() >= CALIBRATION_STEPS || converged()) return std::nullopt;
+  const double y = logit(target, points.back().bits);
+  // Closest measurements below and above the target
+  const CalibrationPoint* lo = nullptr;
+  const CalibrationPoint* hi = nullptr;
+  for (const auto& p : points) {
+    if (p.density() < target && (lo == nullptr || p.decay > lo->decay)) lo = &p;
+    if (p.density() >= target && (hi == nullptr || p.decay < hi->decay)) hi = &p;
+  }
+
+  double x;
+  int min, max;
+  if (lo != nullptr && hi != nullptr) {
+    if (hi->decay - lo->decay <= 1) return std::nullopt;
+    const double xl = std::log(lo->decay), xh = std::log(hi->decay);
+    x = std::clamp(fit(*lo, *hi, y), xl + (xh - xl) / 10, xh - (xh - xl) / 10);
+    min = lo->decay + 1;
+    max = hi->decay - 1;
+  } else {
+    // Extend from the two measurements closest to the target, in the direction it lies in
+    const bool longer = hi == nullptr;
+    std::vector<const CalibrationPoint*> sorted;
+    for (const auto& p : points) sorted.push_back(&p);
+    std::sort(sorted.begin(), sorted.end(), [longer](const CalibrationPoint* a, const CalibrationPoint* b) {
+      return longer ? a->decay > b->decay : a->decay < b->decay;
+    });
+    const CalibrationPoint& edge = *sorted[0];
+    if (longer ? edge.decay >= CALIBRATION_MAX_DECAY : edge.decay <= CALIBRATION_MIN_DECAY) return std::nullopt;
+    const double xe = std::log(edge.decay);
+    x = sorted.size() > 1 && sorted[1]->decay != edge.decay ? fit(*sorted[1], edge, y) : NAN;
+    const double step = std::log(2.0), leap = std::log(16.0);
+    if (std::isnan(x)) x = longer ? xe + 2 * step : xe - 2 * step;
+    x = longer ? std::clamp(x, xe + step, xe + leap) : std::clamp(x, xe - leap, xe - step);
+    min = longer ? edge.decay + 1 : CALIBRATION_MIN_DECAY;
+    max = longer ? CALIBRATION_MAX_DECAY : edge.decay - 1;
+  }
+  const int decay = std::clamp(static_cast<int>(std::lround(std::exp(x))), min, max);
+  for (const auto& p : points) {
+    if (p.decay == decay) return std::nullopt;
+  }
+  return decay;
+}
+
+const SerialReader::CalibrationPoint* SerialReader::DecayCalibration::best() const {
+  const CalibrationPoint* result = nullptr;
+  for (const auto& p : points) {
+    if (result == nullptr || std::abs(p.density() - target) < std::abs(result->density() - target)) result = &p;
+  }
+  return result;
+}
+
+bool SerialReader::DecayCalibration::converged() const {
+  const CalibrationPoint* b = best();
+  return b != nullptr && std::abs(b->density() - target) <= tolerance * target;
+}
+
+void SerialReader::DensitySink::begin(const DumpInfo& _info) {
+  info = _info;
+  summary = !info.challenge.isDump();
+  stats = DumpStats(info.challenge.init);
+  set = FlipSet();
+  parser.reset();
+  complete = false;
+}
+
+void SerialReader::DensitySink::write(const char* data, const size_t size) {
+  if (summary) {
+    parser.feed(data, size);
+  } else {
+    stats.add(reinterpret_cast<const unsigned char*>(data), size);
+  }
+}
+
+void SerialReader::DensitySink::end(const bool ok) {
+  if (summary) parser.finish();
+  complete = ok;
+}
+
+SerialReader::CalibrationPoint SerialReader::DensitySink::point() const {
+  CalibrationPoint p;
+  p.decay = info.challenge.decay;
+  if (summary) {
+    for (const uint8_t count : set.counts) p.flips += count;
+    // puf_read_ext reads every word of the range, also those outside of the PUF ranges
+    const Challenge& c = info.challenge;
+    p.bits = c.end > c.start ? (static_cast<uint64_t>(c.end - c.start) + 3) / 4 * 32 : 0;
+  } else {
+    p.flips = stats.flips;
+    p.bits = stats.size * 8;
+  }
+  return p;
+}
+
+std::vector<std::string> SerialReader::withDecay(const std::vector<std::string>& params, const int decay) {
+  std::vector<std::string> result = params;
+  if (result.size() <= CALIBRATION_DECAY_PARAM) result.resize(CALIBRATION_DECAY_PARAM + 1, "0");
+  result[CALIBRATION_DECAY_PARAM] = std::to_string(decay);
+  return result;
+}
+
+bool SerialReader::readParams(const std::string& path, std::vector<std::string>& params) {
+  std::ifstream in(path);
+  if (!in) return false;
+  params.clear();
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    params.push_back(line);
+  }
+  return !in.bad();
+}
+
+bool SerialReader::writeParams(const std::string& path, const std::vector<std::string>& params,
+                               const std::string& comment) {
+  std::ofstream out(path);
+  if (!comment.empty()) out << "# " << comment << '\n';
+  for (const auto& param : params) out << param << '\n';
+  out.flush();
+  return static_cast<bool>(out);
+}
+
+int SerialReader::calibrate(Parser& parser) {
+  const Challenge challenge = Challenge::fromParams(parser.getParams());
+  if (challenge.mode != 0 && challenge.mode != 1) {
+    std::cerr << "Calibrating needs the params of a dump (mode 0) or a summary (mode 1)" << std::endl;
+    return 1;
+  }
+  if (challenge.mode == 1 && challenge.init != 0) {
+    std::cerr << "Summaries count set bits, calibrate them with the init value 0" << std::endl;
+    return 1;
+  }
+  if (parser.getCalibrate() <= 0 || parser.getCalibrate() >= 1) {
+    std::cerr << "The target density has to be between 0 and 1" << std::endl;
+    return 1;
+  }
+
+  DecayCalibration calibration(parser.getCalibrate(), challenge.decay);
+  Runner runner(parser);
+  while (const std::optional<int> decay = calibration.next()) {
+    Parser measurement(parser, withDecay(parser.getParams(), *decay));
+    DensitySink sink;
+    if (!run(runner, measurement, sink) || !sink.isComplete()) {
+      std::cerr << "No measurement at " << *decay << " s"
+        << (runner.getFailure().empty() ? "" : ": " + runner.getFailure()) << std::endl;
+      break;
+    }
+    const CalibrationPoint point = sink.point();
+    calibration.add(point);
+    std::cout << "decay " << point.decay << " s: " << point.flips << " of " << point.bits << " bits flipped ("
+      << point.density() << ")" << std::endl;
+  }
+  runner.release();
+
+  const CalibrationPoint* best = calibration.best();
+  if (best == nullptr) return 1;
+  std::ostringstream comment;
+  comment << "density " << best->density() << " at " << best->decay << " s (target " << parser.getCalibrate()
+    << ", " << calibration.getPoints().size() << " measurements)";
+  const std::string& path = parser.getCalibration().empty() ? CALIBRATION_FILE : parser.getCalibration();
+  if (!writeParams(path, withDecay(parser.getParams(), best->decay), comment.str())) {
+    std::cerr << "Could not write " << path << std::endl;
+    return 1;
+  }
+  std::cout << "Decay " << best->decay << " s, " << comment.str() << ", written to " << path << std::endl;
+  return calibration.converged() ? 0 : 1;
+}
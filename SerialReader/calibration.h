@@ -0,0 +1,112 @@
+#pragma once
+
+// Measurements (boots) a calibration may take before it settles for the closest one
+#define CALIBRATION_STEPS 8
+// Relative deviation from the target density that is close enough
+#define CALIBRATION_TOLERANCE 0.1
+// Range of decay times (s) a calibration tries
+#define CALIBRATION_MIN_DECAY 1
+#define CALIBRATION_MAX_DECAY 3600
+// Index of the decay time in the params, see Challenge::fromParams
+#define CALIBRATION_DECAY_PARAM 8
+#define CALIBRATION_FILE "calibration.params"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "catalog.h"
+#include "dump_sink.h"
+#include "flips.h"
+#include "parser.h"
+
+namespace SerialReader {
+  // Flipped bits of one measurement
+  struct CalibrationPoint {
+    int decay = 0;
+    uint64_t flips = 0;
+    uint64_t bits = 0;
+
+    [[nodiscard]] double density() const {
+      return bits > 0 ? static_cast<double>(flips) / static_cast<double>(bits) : 0;
+    }
+  };
+
+  /*
+   * Picks the decay times to measure until the density of flipped bits is close to target. Retention times of DRAM
+   * cells are roughly log-normal, so logit(density) is taken as linear in log(decay): the next decay time comes from
+   * the line through the closest measurements below and above the target. Guesses stay within the middle 80% of
+   * that bracket (in log(decay)), which shrinks it at least as fast as bisection even where the fit is poor. Until
+   * the target is bracketed the line through the last two measurements is extended, by a factor of 2 to 16.
+   */
+  class DecayCalibration {
+  private:
+    const double target;
+    const double tolerance;
+    const int start;
+    std::vector<CalibrationPoint> points;
+
+  public:
+    DecayCalibration(double _target, int _start, double _tolerance = CALIBRATION_TOLERANCE);
+
+    void add(const CalibrationPoint& point);
+
+    // The decay time to measure next, none once the target was met or cannot be approached any further
+    [[nodiscard]] std::optional<int> next() const;
+
+    // The measurement closest to the target, null before the first one
+    [[nodiscard]] const CalibrationPoint* best() const;
+
+    // Whether the best measurement is within the tolerance
+    [[nodiscard]] bool converged() const;
+
+    [[nodiscard]] const std::vector<CalibrationPoint>& getPoints() const {
+      return points;
+    }
+  };
+
+  /*
+   * Counts the flipped bits of one transfer: the bits of a dump (mode 0) that differ from the init value, or the
+   * bits a summary (mode 1) reports per weak word. The firmware counts set bits there, so summaries only measure
+   * decay with an init value of 0.
+   */
+  class DensitySink : public DumpSink {
+  private:
+    DumpInfo info;
+    DumpStats stats;
+    FlipSet set;
+    SummaryParser parser{set};
+    bool summary = false;
+    bool complete = false;
+
+  public:
+    void begin(const DumpInfo& _info) override;
+
+    void write(const char* data, size_t size) override;
+
+    void end(bool ok) override;
+
+    // Whether a transfer ended with "|&"
+    [[nodiscard]] bool isComplete() const {
+      return complete;
+    }
+
+    [[nodiscard]] CalibrationPoint point() const;
+  };
+
+  // The params with the decay time replaced, filled up with "0" up to it
+  std::vector<std::string> withDecay(const std::vector<std::string>& params, int decay);
+
+  // One param per line as -p takes them, lines starting with '#' are comments; false if the file cannot be read
+  bool readParams(const std::string& path, std::vector<std::string>& params);
+
+  bool writeParams(const std::string& path, const std::vector<std::string>& params, const std::string& comment = "");
+
+  /*
+   * Measures the region of the params (a dump or summary) at the decay times DecayCalibration picks, one boot
+   * each, and writes the params with the decay time closest to parser.getCalibrate() to parser.getCalibration()
+   * (CALIBRATION_FILE if empty).
+   * Returns the exit code: 0 if the density is within the tolerance, 1 otherwise.
+   */
+  int calibrate(Parser& parser);
+}
@@ -0,0 +1,94 @@
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture.h"
+
+SerialReader::CaptureWriter::CaptureWriter(const std::string& path, const int baud)
+  : file(path, std::ios::binary | std::ios::trunc), last(Clock::now()) {
+  const auto start = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  char header[CAPTURE_MAGIC_SIZE + 12] = CAPTURE_MAGIC;
+  for (int i = 0; i < 4; i++) header[CAPTURE_MAGIC_SIZE + i] = static_cast<char>(baud >> 8 * i);
+  for (int i = 0; i < 8; i++) header[CAPTURE_MAGIC_SIZE + 4 + i] = static_cast<char>(start >> 8 * i);
+  file.write(header, sizeof(header));
+}
+
+void SerialReader::CaptureWriter::writeVarint(uint64_t value) {
+  char buf[10];
+  int n = 0;
+  do {
+    buf[n++] = static_cast<char>((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+    value >>= 7;
+  } while (value != 0);
+  file.write(buf, n);
+}
+
+void SerialReader::CaptureWriter::record(const char* data, const size_t size) {
+  const auto now = Clock::now();
+  writeVarint(std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+  writeVarint(size);
+  file.write(data, static_cast<std::streamsize>(size));
+  last = now;
+}
+
+SerialReader::CaptureReader::CaptureReader(const std::string& path, const bool _realtime)
+  : realtime(_realtime), due(std::chrono::steady_clock::now()) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size >= CAPTURE_MAGIC_SIZE + 12) {
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      data = static_cast<const unsigned char*>(map);
+      size = st.st_size;
+      madvise(map, size, MADV_SEQUENTIAL);
+    }
+  }
+  close(fd);
+  if (data == nullptr) return;
+  if (std::memcmp(data, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0) {
+    munmap(const_cast<unsigned char*>(data), size);
+    data = nullptr;
+    return;
+  }
+  for (int i = 0; i < 4; i++) baud |= data[CAPTURE_MAGIC_SIZE + i] << 8 * i;
+  pos = CAPTURE_MAGIC_SIZE + 12;
+}
+
+SerialReader::CaptureReader::~CaptureReader() {
+  if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+}
+
+bool SerialReader::CaptureReader::readVarint(uint64_t& value) {
+  value = 0;
+  for (int shift = 0; pos < size && shift < 64; shift += 7) {
+    const unsigned char b = data[pos++];
+    value |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+ssize_t SerialReader::CaptureReader::read(char* buf, const size_t count) {
+  if (data == nullptr) return -1;
+  if (chunkLeft == 0) {
+    uint64_t delay, chunk;
+    if (!readVarint(delay) || !readVarint(chunk)) {
+      pos = size;
+      return 0;
+    }
+    chunkLeft = chunk <= size - pos ? chunk : size - pos;
+    if (realtime) {
+      due += std::chrono::microseconds(delay);
+      std::this_thread::sleep_until(due);
+    }
+  }
+  const size_t n = count < chunkLeft ? count : chunkLeft;
+  std::memcpy(buf, data + pos, n);
+  pos += n;
+  chunkLeft -= n;
+  return static_cast<ssize_t>(n);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#define CAPTURE_MAGIC "SRCAP01"
+#define CAPTURE_MAGIC_SIZE 8
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <sys/types.h>
+
+namespace SerialReader {
+  /*
+   * Capture file layout (little endian):
+   *   "SRCAP01\0", u32 baud, u64 start time (ns since epoch)
+   *   then for every successful read(): varint delay since the previous read (us), varint size, data
+   */
+  class CaptureWriter {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    std::ofstream file;
+    Clock::time_point last;
+
+    void writeVarint(uint64_t value);
+
+  public:
+    CaptureWriter(const std::string& path, int baud);
+
+    [[nodiscard]] bool isOpen() const {
+      return file.is_open();
+    }
+
+    void record(const char* data, size_t size);
+  };
+
+  class CaptureReader {
+  private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    size_t chunkLeft = 0;
+    int baud = 0;
+    bool realtime;
+    std::chrono::steady_clock::time_point due;
+
+    bool readVarint(uint64_t& value);
+
+  public:
+    CaptureReader(const std::string& path, bool _realtime);
+
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return data != nullptr;
+    }
+
+    [[nodiscard]] int getBaudRate() const {
+      return baud;
+    }
+
+    [[nodiscard]] bool eof() const {
+      return chunkLeft == 0 && pos >= size;
+    }
+
+    // Behaves like read() on the serial port, returns at most one recorded chunk
+    ssize_t read(char* buf, size_t count);
+  };
+}
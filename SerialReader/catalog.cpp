@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "bit_kernels.h"
+#include "catalog.h"
+#include "dump_file.h"
+
+double SerialReader::readTemperature(const std::string& sensor) {
+  std::ifstream file(sensor);
+  double milli;
+  if (!(file >> milli)) return NAN;
+  return milli / 1000;
+}
+
+SerialReader::DumpStats::DumpStats(const uint32_t _init) {
+  for (int i = 0; i < 12; i++) pattern[i] = static_cast<unsigned char>(_init >> (24 - 8 * (i % 4)));
+}
+
+void SerialReader::DumpStats::add(const unsigned char* data, size_t count) {
+  crc = crc32(crc, data, count);
+  // Byte by byte up to the next multiple of 8 of the payload offset, then 8 bytes at a time
+  while (count > 0 && size % 8 != 0) {
+    ones += __builtin_popcount(*data);
+    flips += __builtin_popcount(*data ^ pattern[size % 4]);
+    data++;
+    count--;
+    size++;
+  }
+  // Aligned to the pattern now, so whole words are compared with a block of init words
+  uint64_t base[64];
+  for (auto& word : base) std::memcpy(&word, pattern, sizeof(word));
+  const BitKernels& kernels = bitKernels();
+  while (count >= 8) {
+    const size_t words = std::min<size_t>(count / 8, 64);
+    const auto* block = reinterpret_cast<const uint64_t*>(data);
+    ones += kernels.popcount(block, words);
+    flips += kernels.distance(block, base, words);
+    data += words * 8;
+    count -= words * 8;
+    size += words * 8;
+  }
+  for (; count > 0; data++, count--, size++) {
+    ones += __builtin_popcount(*data);
+    flips += __builtin_popcount(*data ^ pattern[size % 4]);
+  }
+}
+
+double SerialReader::CatalogEntry::weight() const {
+  return size > 0 ? static_cast<double>(ones) / static_cast<double>(size * 8) : 0;
+}
+
+double SerialReader::CatalogEntry::flipRate() const {
+  return size > 0 ? static_cast<double>(flips) / static_cast<double>(size * 8) : 0;
+}
+
+bool SerialReader::CatalogQuery::matches(const CatalogEntry& entry) const {
+  const Challenge& c = entry.challenge;
+  if (!board.empty() && entry.board != board) return false;
+  if (start && c.start != *start) return false;
+  if (end && c.end != *end) return false;
+  if (init && c.init != *init) return false;
+  if (decay && c.decay != *decay) return false;
+  // Unknown temperatures only match an unrestricted query
+  if (std::isnan(entry.temperature)) {
+    if (std::isfinite(minTemperature) || std::isfinite(maxTemperature)) return false;
+  } else if (entry.temperature < minTemperature || entry.temperature > maxTemperature) {
+    return false;
+  }
+  return entry.startTime >= since && entry.startTime <= until;
+}
+
+static std::string clean(std::string s) {
+  for (char& ch : s) {
+    if (ch == '\t' || ch == '\n' || ch == '\r') ch = ' ';
+  }
+  return s;
+}
+
+static std::string format(const SerialReader::CatalogEntry& e) {
+  const SerialReader::Challenge& c = e.challenge;
+  std::ostringstream line;
+  line << clean(e.path) << '\t' << clean(e.board) << '\t' << c.mode << '\t' << c.addMode << '\t' << c.funcLoc
+       << std::hex << std::uppercase << std::setfill('0')
+       << '\t' << std::setw(8) << c.start << '\t' << std::setw(8) << c.end << '\t' << std::setw(8) << c.init
+       << std::dec << std::setfill(' ')
+       << '\t' << c.decayFunc << '\t' << c.interval << '\t' << c.decay
+       << '\t' << e.first.bank << '\t' << e.first.row << '\t' << e.first.col
+       << '\t' << e.startTime << '\t' << e.endTime << '\t' << std::fixed << std::setprecision(3) << e.temperature
+       << '\t' << e.size << '\t' << e.ones << '\t' << e.flips
+       << std::hex << std::uppercase << std::setfill('0') << '\t' << std::setw(8) << e.crc
+       << std::dec << '\t' << e.mtime << '\t' << clean(e.firmware) << '\n';
+  return line.str();
+}
+
+static bool parse(const std::string& line, SerialReader::CatalogEntry& e) {
+  std::vector<std::string> f;
+  std::string::size_type from = 0;
+  for (std::string::size_type tab; (tab = line.find('\t', from)) != std::string::npos; from = tab + 1) {
+    f.push_back(line.substr(from, tab - from));
+  }
+  f.push_back(line.substr(from));
+  if (f.size() < 23) return false;
+  const auto i = [&f](const int n) { return std::strtoll(f[n].c_str(), nullptr, 10); };
+  const auto u = [&f](const int n) { return std::strtoull(f[n].c_str(), nullptr, 10); };
+  const auto x = [&f](const int n) { return static_cast<uint32_t>(std::strtoul(f[n].c_str(), nullptr, 16)); };
+  SerialReader::Challenge& c = e.challenge;
+  e.path = f[0];
+  e.board = f[1];
+  c.mode = static_cast<int>(i(2));
+  c.addMode = static_cast<int>(i(3));
+  c.funcLoc = static_cast<int>(i(4));
+  c.start = x(5);
+  c.end = x(6);
+  c.init = x(7);
+  c.decayFunc = static_cast<int>(i(8));
+  c.interval = static_cast<int>(i(9));
+  c.decay = static_cast<int>(i(10));
+  e.first = {static_cast<uint32_t>(u(11)), static_cast<uint32_t>(u(12)), static_cast<uint32_t>(u(13))};
+  e.startTime = i(14);
+  e.endTime = i(15);
+  e.temperature = std::strtod(f[16].c_str(), nullptr);
+  e.size = u(17);
+  e.ones = u(18);
+  e.flips = u(19);
+  e.crc = x(20);
+  e.mtime = i(21);
+  e.firmware = f[22];
+  return true;
+}
+
+static int64_t modified(const struct stat& st) {
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+SerialReader::Catalog::Catalog(std::string _file) : file(std::move(_file)) {
+  directory = std::filesystem::absolute(file).lexically_normal().parent_path().string();
+}
+
+std::string SerialReader::Catalog::relative(const std::string& path) const {
+  const auto rel = std::filesystem::absolute(path).lexically_normal().lexically_relative(directory);
+  return rel.empty() ? path : rel.string();
+}
+
+std::string SerialReader::Catalog::resolve(const CatalogEntry& entry) const {
+  const std::filesystem::path path(entry.path);
+  if (path.is_absolute()) return entry.path;
+  return std::filesystem::proximate(std::filesystem::path(directory) / path).string();
+}
+
+bool SerialReader::Catalog::load() {
+  entries.clear();
+  std::ifstream in(file);
+  if (!in) return !std::filesystem::exists(file);
+  std::unordered_map<std::string, size_t> at;
+  std::string line;
+  while (std::getline(in, line)) {
+    CatalogEntry entry;
+    if (line.empty() || line.rfind("path\t", 0) == 0 || !parse(line, entry)) continue;
+    if (const auto it = at.find(entry.path); it != at.end()) {
+      entries[it->second] = std::move(entry);
+    } else {
+      at.emplace(entry.path, entries.size());
+      entries.push_back(std::move(entry));
+    }
+  }
+  return true;
+}
+
+bool SerialReader::Catalog::add(CatalogEntry entry) {
+  entry.path = relative(entry.path);
+  const int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd == -1) return false;
+  flock(fd, LOCK_EX);
+  struct stat st{};
+  std::string text = format(entry);
+  if (fstat(fd, &st) == 0 && st.st_size == 0) text = CATALOG_COLUMNS "\n" + text;
+  // One write, so that readers never see half a line of another SerialReader
+  const bool ok = ::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+  flock(fd, LOCK_UN);
+  close(fd);
+  if (!ok) return false;
+  for (auto& e : entries) {
+    if (e.path == entry.path) {
+      e = std::move(entry);
+      return true;
+    }
+  }
+  entries.push_back(std::move(entry));
+  return true;
+}
+
+const SerialReader::CatalogEntry* SerialReader::Catalog::find(const std::string& path) const {
+  const std::string rel = relative(path);
+  for (const auto& e : entries) {
+    if (e.path == rel) return &e;
+  }
+  return nullptr;
+}
+
+std::vector<SerialReader::CatalogEntry> SerialReader::Catalog::select(const CatalogQuery& query) const {
+  std::vector<CatalogEntry> ret;
+  for (const auto& e : entries) {
+    if (query.matches(e)) ret.push_back(e);
+  }
+  return ret;
+}
+
+bool SerialReader::describe(const std::string& path, const Challenge* challenge, CatalogEntry& entry) {
+  struct stat st{};
+  if (stat(path.c_str(), &st) != 0) return false;
+  const DumpReader dump(path);
+  if (!dump.isOpen()) return false;
+  entry.path = path;
+  entry.first = dump.first;
+  entry.firmware = dump.info.firmware;
+  entry.mtime = modified(st);
+  if (dump.described) {
+    entry.challenge = dump.info.challenge;
+    entry.startTime = dump.info.startTime;
+    entry.endTime = dump.endTime;
+  } else {
+    if (challenge != nullptr) {
+      entry.challenge = *challenge;
+    } else {
+      // Nothing says how the dump was made, 0 marks the init value and decay as unknown
+      entry.challenge = dump.info.challenge;
+      entry.challenge.init = 0;
+      entry.challenge.decay = 0;
+    }
+    entry.startTime = entry.mtime;
+    entry.endTime = entry.mtime;
+  }
+  DumpStats stats(entry.challenge.init);
+  stats.add(dump.payload, dump.size);
+  entry.size = stats.size;
+  entry.ones = stats.ones;
+  entry.flips = stats.flips;
+  entry.crc = stats.crc;
+  return true;
+}
+
+bool SerialReader::unchanged(const std::string& path, const CatalogEntry& entry) {
+  struct stat st{};
+  return stat(path.c_str(), &st) == 0 && modified(st) == entry.mtime;
+}
+
+void SerialReader::CatalogSink::begin(const DumpInfo& _info) {
+  info = _info;
+  stats = DumpStats(info.challenge.init);
+  inner.begin(info);
+}
+
+void SerialReader::CatalogSink::write(const char* data, const size_t count) {
+  stats.add(reinterpret_cast<const unsigned char*>(data), count);
+  inner.write(data, count);
+}
+
+void SerialReader::CatalogSink::end(const bool ok) {
+  inner.end(ok);
+  // Summaries (mode 1) are no dumps
+  if (!ok || info.payloadSize == 0) return;
+  CatalogEntry entry;
+  entry.path = path;
+  entry.board = board;
+  entry.challenge = info.challenge;
+  parseFrame(info.frame, entry.first);
+  entry.startTime = info.startTime;
+  entry.endTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count();
+  entry.temperature = sensor.empty() ? NAN : readTemperature(sensor);
+  entry.size = stats.size;
+  entry.ones = stats.ones;
+  entry.flips = stats.flips;
+  entry.crc = stats.crc;
+  entry.firmware = info.firmware;
+  struct stat st{};
+  if (stat(path.c_str(), &st) == 0) entry.mtime = modified(st);
+  catalog.add(std::move(entry));
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#define CATALOG_NAME "catalog.tsv"
+#define CATALOG_COLUMNS "path\tboard\tmode\taddMode\tfuncLoc\tstart\tend\tinit\tdecayFunc\tinterval\tdecay\t" \
+                        "bank\trow\tcol\tstartTime\tendTime\ttemperature\tsize\tones\tflips\tcrc\tmtime\tfirmware"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+#include "challenge.h"
+#include "dump_sink.h"
+
+namespace SerialReader {
+  // Reads a temperature in millidegrees Celsius (e.g. /sys/class/thermal/.../temp), NAN if there is none
+  double readTemperature(const std::string& sensor);
+
+  // Summary of a payload that is accumulated while it streams in
+  struct DumpStats {
+    uint64_t size = 0;
+    // Hamming weight of the payload
+    uint64_t ones = 0;
+    // Hamming distance to the init value the firmware wrote, i.e. the number of decayed bits
+    uint64_t flips = 0;
+    // CRC-32 of the payload, the same as in the footer of described dumps
+    uint32_t crc = 0;
+
+    explicit DumpStats(uint32_t _init = 0);
+
+    void add(const unsigned char* data, size_t count);
+
+  private:
+    // The init value as the payload has it, big endian and repeated so that it can be read at any offset
+    unsigned char pattern[12]{};
+  };
+
+  // One dump in the catalog
+  struct CatalogEntry {
+    // Relative to the directory of the catalog when read from or written to one, otherwise as given
+    std::string path;
+    std::string board;
+    Challenge challenge;
+    Cell first{};
+    // Nanoseconds since the epoch, of "&|" and "|&" or of the file modification for raw dumps
+    int64_t startTime = 0;
+    int64_t endTime = 0;
+    // Degrees Celsius at the end of the measurement, NAN if unknown
+    double temperature = NAN;
+    uint64_t size = 0;
+    uint64_t ones = 0;
+    uint64_t flips = 0;
+    uint32_t crc = 0;
+    // Modification time (ns) of the file when it was cataloged, to notice that it changed
+    int64_t mtime = 0;
+    std::string firmware;
+
+    // Hamming weight as a fraction of the payload bits
+    [[nodiscard]] double weight() const;
+
+    // Share of the bits that decayed
+    [[nodiscard]] double flipRate() const;
+  };
+
+  // Selects entries, every field that is set has to match
+  struct CatalogQuery {
+    std::string board;
+    std::optional<uint32_t> start;
+    std::optional<uint32_t> end;
+    std::optional<uint32_t> init;
+    std::optional<int> decay;
+    double minTemperature = -std::numeric_limits<double>::infinity();
+    double maxTemperature = std::numeric_limits<double>::infinity();
+    int64_t since = std::numeric_limits<int64_t>::min();
+    int64_t until = std::numeric_limits<int64_t>::max();
+
+    [[nodiscard]] bool matches(const CatalogEntry& entry) const;
+  };
+
+  /*
+   * Index of dumps in a tab separated file (CATALOG_COLUMNS) that is only ever appended to, so several
+   * SerialReaders can share it. An entry for a path replaces earlier ones. Hex columns (start, end, init, crc)
+   * are written without a prefix like the params.
+   */
+  class Catalog {
+  private:
+    const std::string file;
+    std::string directory;
+    std::vector<CatalogEntry> entries;
+
+    [[nodiscard]] std::string relative(const std::string& path) const;
+
+  public:
+    explicit Catalog(std::string _file);
+
+    // (Re)reads the file, false if it exists but could not be read
+    bool load();
+
+    // Appends an entry (path as given, i.e. relative to the working directory) under an exclusive lock
+    bool add(CatalogEntry entry);
+
+    // Path as given, i.e. relative to the working directory
+    [[nodiscard]] const CatalogEntry* find(const std::string& path) const;
+
+    [[nodiscard]] std::vector<CatalogEntry> select(const CatalogQuery& query) const;
+
+    // Resolves the path of an entry against the working directory
+    [[nodiscard]] std::string resolve(const CatalogEntry& entry) const;
+
+    [[nodiscard]] const std::vector<CatalogEntry>& getEntries() const {
+      return entries;
+    }
+  };
+
+  /*
+   * Describes a dump file, reading all of it. Raw dumps do not record their challenge, so it is taken from
+   * challenge (if any) and the times from the modification time. False if the file could not be read.
+   */
+  bool describe(const std::string& path, const Challenge* challenge, CatalogEntry& entry);
+
+  // Whether a cataloged file still has the modification time it had when it was cataloged
+  [[nodiscard]] bool unchanged(const std::string& path, const CatalogEntry& entry);
+
+  // Passes the transfer on and catalogs it once it completed
+  class CatalogSink : public DumpSink {
+  private:
+    DumpSink& inner;
+    Catalog& catalog;
+    const std::string path;
+    const std::string board;
+    const std::string sensor;
+    DumpInfo info;
+    DumpStats stats;
+
+  public:
+    CatalogSink(DumpSink& _inner, Catalog& _catalog, std::string _path, std::string _board, std::string _sensor)
+      : inner(_inner), catalog(_catalog), path(std::move(_path)), board(std::move(_board)),
+        sensor(std::move(_sensor)) {}
+
+    void begin(const DumpInfo& _info) override;
+
+    void write(const char* data, size_t count) override;
+
+    void end(bool ok) override;
+  };
+}
@@ -0,0 +1,135 @@
+#include <args.hxx>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "catalog.h"
+
+using namespace SerialReader;
+
+static uint32_t hex(const std::string& s) {
+  return static_cast<uint32_t>(std::stoul(s, nullptr, 16));
+}
+
+// Catalogs existing dumps and selects dumps by how they were measured, without reading them
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Indexes dumps with cached summary statistics and selects dumps from the index.",
+    "Commands: add FILE... (skips files that did not change), list (filtered, -P for paths only), "
+    "verify (rehashes files and reports those that changed)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "add, list or verify");
+  args::PositionalList<std::string> filesA(argsParser, "files", "Dumps to add");
+  args::ValueFlag<std::string> catalogA(argsParser, "catalog", "Catalog file", {'c', "catalog"}, CATALOG_NAME);
+  args::ValueFlag<std::string> boardA(argsParser, "board", "Board (add: of the files, list: to select)",
+                                      {'b', "board"}, "");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params",
+                                           "add: params the raw files were measured with", {'p', "params"});
+  args::Flag rehashA(argsParser, "rehash", "add: also reread files that did not change", {"rehash"});
+  args::ValueFlag<std::string> startA(argsParser, "start", "list: start address (hex)", {"start"}, "");
+  args::ValueFlag<std::string> endA(argsParser, "end", "list: end address (hex)", {"end"}, "");
+  args::ValueFlag<std::string> initA(argsParser, "init", "list: init value (hex)", {"init"}, "");
+  args::ValueFlag<int> decayA(argsParser, "decay", "list: decay time", {"decay"}, -1);
+  args::ValueFlag<double> minTempA(argsParser, "min", "list: minimum temperature", {"min-temp"},
+                                   -std::numeric_limits<double>::infinity());
+  args::ValueFlag<double> maxTempA(argsParser, "max", "list: maximum temperature", {"max-temp"},
+                                   std::numeric_limits<double>::infinity());
+  args::ValueFlag<int64_t> sinceA(argsParser, "since", "list: measured at or after (s since epoch)", {"since"}, 0);
+  args::ValueFlag<int64_t> untilA(argsParser, "until", "list: measured at or before (s since epoch)", {"until"}, 0);
+  args::Flag pathsA(argsParser, "paths", "list: print only the paths, to pass them on to other tools",
+                    {'P', "paths"});
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  Catalog catalog(args::get(catalogA));
+  if (!catalog.load()) {
+    std::cerr << "Could not read " << args::get(catalogA) << std::endl;
+    return 1;
+  }
+
+  if (command == "add") {
+    const Challenge given = Challenge::fromParams(args::get(paramsA));
+    int ret = 0;
+    for (const auto& file : args::get(filesA)) {
+      const CatalogEntry* known = catalog.find(file);
+      if (known != nullptr && !rehashA && unchanged(file, *known)) continue;
+      // Raw dumps do not know their challenge, without params it stays what it was cataloged with
+      const Challenge* challenge = known != nullptr ? &known->challenge : nullptr;
+      if (!args::get(paramsA).empty()) challenge = &given;
+      CatalogEntry entry;
+      if (!describe(file, challenge, entry)) {
+        std::cerr << "Could not read " << file << std::endl;
+        ret = 1;
+        continue;
+      }
+      entry.board = args::get(boardA);
+      if (known != nullptr) {
+        // Keep what only the measurement itself knew
+        if (entry.board.empty()) entry.board = known->board;
+        entry.temperature = known->temperature;
+      }
+      if (!catalog.add(entry)) {
+        std::cerr << "Could not write " << args::get(catalogA) << std::endl;
+        return 1;
+      }
+    }
+    return ret;
+  }
+
+  if (command == "list") {
+    CatalogQuery query;
+    query.board = args::get(boardA);
+    if (!args::get(startA).empty()) query.start = hex(args::get(startA));
+    if (!args::get(endA).empty()) query.end = hex(args::get(endA));
+    if (!args::get(initA).empty()) query.init = hex(args::get(initA));
+    if (args::get(decayA) >= 0) query.decay = args::get(decayA);
+    query.minTemperature = args::get(minTempA);
+    query.maxTemperature = args::get(maxTempA);
+    if (sinceA) query.since = args::get(sinceA) * 1000000000;
+    if (untilA) query.until = args::get(untilA) * 1000000000;
+    if (!pathsA) std::cout << "path\tboard\tstart\tend\tinit\tdecay\ttemperature\tsize\tweight\tflips\tcrc\n";
+    for (const auto& e : catalog.select(query)) {
+      if (pathsA) {
+        std::cout << catalog.resolve(e) << '\n';
+        continue;
+      }
+      const Challenge& c = e.challenge;
+      std::cout << catalog.resolve(e) << '\t' << e.board << std::hex << std::uppercase << std::setfill('0')
+        << '\t' << std::setw(8) << c.start << '\t' << std::setw(8) << c.end << '\t' << std::setw(8) << c.init
+        << std::dec << '\t' << c.decay << '\t' << std::fixed << std::setprecision(1) << e.temperature
+        << '\t' << e.size << '\t' << std::setprecision(6) << e.weight() << '\t' << e.flips
+        << std::hex << '\t' << std::setw(8) << e.crc << std::dec << '\n';
+    }
+    return 0;
+  }
+
+  if (command == "verify") {
+    int ret = 0;
+    for (const auto& e : catalog.getEntries()) {
+      const std::string path = catalog.resolve(e);
+      CatalogEntry now;
+      if (!describe(path, &e.challenge, now)) {
+        std::cout << "missing\t" << path << '\n';
+        ret = 1;
+      } else if (now.size != e.size || now.crc != e.crc) {
+        std::cout << "changed\t" << path << '\n';
+        ret = 1;
+      }
+    }
+    return ret;
+  }
+
+  std::cerr << argsParser;
+  return 1;
+}
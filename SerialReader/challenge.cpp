@@ -0,0 +1,166 @@
+#include "bytes.h"
+#include "challenge.h"
+
+static int parseDigit(const std::string& s, const int fallback) {
+  int result = fallback;
+  for (const char c : s) {
+    if (c >= '0' && c <= '9') result = c - '0';
+  }
+  return result;
+}
+
+static int parseDecimal(const std::string& s, const int fallback) {
+  int result = 0;
+  bool found = false;
+  for (const char c : s) {
+    if (c >= '0' && c <= '9') {
+      result = result * 10 + (c - '0');
+      found = true;
+    }
+  }
+  return found ? result : fallback;
+}
+
+static int hexValue(const char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static uint32_t parseHex(const std::string& s) {
+  uint32_t result = 0;
+  for (const char c : s) {
+    if (const int v = hexValue(c); v >= 0) result = result << 4 | v;
+  }
+  return result;
+}
+
+// Same as getaddress(): missing digits are filled up with zeros from the right
+static uint32_t parseAddress(const std::string& s) {
+  uint32_t address = 0;
+  int digits = 0;
+  for (const char c : s) {
+    if (const int v = hexValue(c); v >= 0) {
+      address = address << 4 | v;
+      digits++;
+    }
+  }
+  if (digits == 0 || digits > 8) return PUF_LOW_START;
+  return address << 4 * (8 - digits);
+}
+
+SerialReader::Challenge SerialReader::Challenge::fromParams(const std::vector<std::string>& params) {
+  Challenge c;
+  if (params.empty()) return c;
+  c.mode = parseDigit(params[0], 0);
+  if (c.mode == 4) return c; // TestCustom() does not ask for anything else
+  c.end = 0;
+  c.decayFunc = 0;
+  c.interval = 0;
+  c.decay = 60;
+  if (params.size() > 1) c.addMode = parseDigit(params[1], 0);
+  if (params.size() > 2) c.funcLoc = parseDigit(params[2], 0);
+  if (params.size() > 3) c.start = parseAddress(params[3]);
+  if (params.size() > 4) c.end = parseAddress(params[4]);
+  if (params.size() > 5) c.init = parseHex(params[5]);
+  if (params.size() > 6) c.decayFunc = parseDigit(params[6], 0);
+  if (params.size() > 7) c.interval = parseDecimal(params[7], 1);
+  if (params.size() > 8) c.decay = parseDecimal(params[8], 60);
+  return c;
+}
+
+int SerialReader::Challenge::prompts() const {
+  return mode == 4 ? 1 : 9;
+}
+
+bool SerialReader::Challenge::hasTransfer() const {
+  return mode == 0 || mode == 1 || mode == 4 || mode == 5;
+}
+
+bool SerialReader::Challenge::isDump() const {
+  return mode == 0 || mode == 4;
+}
+
+bool SerialReader::Challenge::isSurvey() const {
+  return mode == 5;
+}
+
+// Number of words start + 4 * k with k < n that lie within [lo, hi)
+static uint64_t wordsWithin(const uint64_t start, const uint64_t n, const uint64_t lo, const uint64_t hi) {
+  const uint64_t first = start >= lo ? 0 : (lo - start + 3) / 4;
+  uint64_t last = start >= hi ? 0 : (hi - start + 3) / 4;
+  if (last > n) last = n;
+  return last > first ? last - first : 0;
+}
+
+size_t SerialReader::Challenge::payloadSize() const {
+  if (end <= start) return 0;
+  // puf_read_all steps through [start, end) in words and skips everything outside of the PUF ranges
+  const uint64_t words = (static_cast<uint64_t>(end - start) + 3) / 4;
+  return 4 * (wordsWithin(start, words, PUF_LOW_START, PUF_LOW_END) +
+              wordsWithin(start, words, PUF_HIGH_START, PUF_HIGH_END));
+}
+
+// First word start + 4 * k that lies at or above lo
+static uint64_t firstWithin(const uint64_t start, const uint64_t lo) {
+  return start >= lo ? start : start + (lo - start + 3) / 4 * 4;
+}
+
+uint32_t SerialReader::Challenge::addressAt(const uint64_t offset) const {
+  const uint64_t words = (static_cast<uint64_t>(end - start) + 3) / 4;
+  const uint64_t low = wordsWithin(start, words, PUF_LOW_START, PUF_LOW_END);
+  const uint64_t word = offset / 4;
+  if (word < low) return static_cast<uint32_t>(firstWithin(start, PUF_LOW_START) + 4 * word);
+  return static_cast<uint32_t>(firstWithin(start, PUF_HIGH_START) + 4 * (word - low));
+}
+
+SerialReader::Cell SerialReader::cellOf(const uint32_t address, const int addMode) {
+  if (addMode == 0) {
+    return {(address & 0x1c000000) >> 26, (address & 0x03fff000) >> 12, (address & 0x00000ffc) >> 2};
+  }
+  return {(address & 0x00007000) >> 12, (address & 0x1fff8000) >> 15, (address & 0x00000ffc) >> 2};
+}
+
+uint32_t SerialReader::addressOf(const Cell& cell, const int addMode) {
+  if (addMode == 0) {
+    return 0xC0000000 | cell.bank << 26 | cell.row << 12 | cell.col << 2;
+  }
+  return 0xC0000000 | cell.row << 15 | cell.bank << 12 | cell.col << 2;
+}
+
+bool SerialReader::parseFrame(const std::string& frame, Cell& cell) {
+  if (frame.size() < 8) return false;
+  for (size_t i = 0; i < 8; i++) {
+    if (hexValue(frame[i]) < 0) return false;
+  }
+  cell.bank = frame[0] - '0';
+  cell.row = parseHex(frame.substr(1, 4));
+  cell.col = parseHex(frame.substr(5, 3));
+  return true;
+}
+
+void SerialReader::putChallenge(unsigned char* p, const Challenge& c) {
+  const uint32_t fields[] = {static_cast<uint32_t>(c.mode), static_cast<uint32_t>(c.addMode),
+                             static_cast<uint32_t>(c.funcLoc), c.start, c.end, c.init,
+                             static_cast<uint32_t>(c.decayFunc), static_cast<uint32_t>(c.interval),
+                             static_cast<uint32_t>(c.decay)};
+  for (const uint32_t field : fields) {
+    putU32(p, field);
+    p += 4;
+  }
+}
+
+SerialReader::Challenge SerialReader::getChallenge(const unsigned char* p) {
+  Challenge c;
+  c.mode = static_cast<int>(getU32(p));
+  c.addMode = static_cast<int>(getU32(p + 4));
+  c.funcLoc = static_cast<int>(getU32(p + 8));
+  c.start = getU32(p + 12);
+  c.end = getU32(p + 16);
+  c.init = getU32(p + 20);
+  c.decayFunc = static_cast<int>(getU32(p + 24));
+  c.interval = static_cast<int>(getU32(p + 28));
+  c.decay = static_cast<int>(getU32(p + 32));
+  return c;
+}
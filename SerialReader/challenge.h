@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PUF_LOW_START 0xC3000000
+#define PUF_LOW_END 0xCF000000
+#define PUF_HIGH_START 0xD0000000
+#define PUF_HIGH_END 0xE0000000
+#define CHALLENGE_SIZE 36
+
+namespace SerialReader {
+  // DRAM coordinates of a word, see PufAddress.h
+  struct Cell {
+    uint32_t bank;
+    uint32_t row;
+    uint32_t col;
+  };
+
+  // addMode 0 is BRC (bank 28:26, row 25:12), 1 is RBC (row 28:15, bank 14:12); the column is 11:2 in both
+  Cell cellOf(uint32_t address, int addMode);
+
+  uint32_t addressOf(const Cell& cell, int addMode);
+
+  // Parses the "%d%04X%03X" coordinates puf_read_all prints in front of the payload
+  bool parseFrame(const std::string& frame, Cell& cell);
+
+  /*
+   * The challenge as the firmware will understand it, decoded from the params sent to the kernel.
+   * Parsing mirrors kernel/func/getparam.c, so e.g. "C38" becomes 0xC3800000.
+   */
+  struct Challenge {
+    int mode = 4;
+    int addMode = 0;
+    int funcLoc = 0;
+    uint32_t start = PUF_LOW_START;
+    uint32_t end = 0xC4000000;
+    uint32_t init = 0;
+    int decayFunc = 1;
+    int interval = 1;
+    int decay = 600;
+
+    static Challenge fromParams(const std::vector<std::string>& params);
+
+    // Number of "|:" prompts the kernel will print for this mode
+    [[nodiscard]] int prompts() const;
+
+    // Whether the firmware frames its output with "&|" and "|&" (modes 0, 1, 4 and 5)
+    [[nodiscard]] bool hasTransfer() const;
+
+    // Whether the transfer is the binary memory dump of puf_read_all
+    [[nodiscard]] bool isDump() const;
+
+    // Whether the transfer is the flip count per row of puf_read_survey
+    [[nodiscard]] bool isSurvey() const;
+
+    // Number of bytes puf_read_all sends between the "," and "|&"
+    [[nodiscard]] size_t payloadSize() const;
+
+    // Address of the word a payload byte belongs to, the words outside of the PUF ranges are not in the payload
+    [[nodiscard]] uint32_t addressAt(uint64_t offset) const;
+  };
+
+  // The fields of a challenge in file headers: mode, address mode, function location, start, end, init value,
+  // function, interval and decay as little endian u32, CHALLENGE_SIZE bytes
+  void putChallenge(unsigned char* p, const Challenge& c);
+
+  Challenge getChallenge(const unsigned char* p);
+}
@@ -0,0 +1,225 @@
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "bit_kernels.h"
+#include "bytes.h"
+#include "crp.h"
+
+uint64_t SerialReader::maskedDistance(const uint64_t* a, const uint64_t* b, const uint64_t* mask, const size_t words) {
+  return bitKernels().maskedDistance(a, b, mask, words);
+}
+
+const char* SerialReader::distanceKernel() {
+  return bitKernels().name;
+}
+
+static std::string challengeKey(const SerialReader::Challenge& challenge) {
+  unsigned char fields[CHALLENGE_SIZE];
+  SerialReader::putChallenge(fields, challenge);
+  return {reinterpret_cast<const char*>(fields), sizeof(fields)};
+}
+
+// Board and challenge as one lookup key
+static std::string keyOf(const std::string& board, const SerialReader::Challenge& challenge) {
+  return board + '\0' + challengeKey(challenge);
+}
+
+void SerialReader::toWords(const unsigned char* data, const uint32_t bits, uint64_t* words) {
+  const size_t bytes = (bits + 7) / 8;
+  std::memset(words, 0, (bytes + 7) / 8 * 8);
+  std::memcpy(words, data, bytes);
+  if (bits % 8 != 0) {
+    reinterpret_cast<unsigned char*>(words)[bytes - 1] &= static_cast<unsigned char>(0xFF00 >> bits % 8);
+  }
+}
+
+SerialReader::CrpStore::CrpStore(std::string _file) : file(std::move(_file)) {}
+
+void SerialReader::CrpStore::insert(const Crp& crp) {
+  auto& list = groups[keyOf(crp.board, crp.challenge)];
+  Group* group = nullptr;
+  for (auto& g : list) {
+    if (g.bits == crp.bits) group = &g;
+  }
+  if (group == nullptr) {
+    group = &list.emplace_back();
+    group->bits = crp.bits;
+    group->words = (crp.bits + 63) / 64;
+  }
+  const size_t words = group->words;
+  group->responses.resize(group->responses.size() + words);
+  group->masks.resize(group->masks.size() + words);
+  uint64_t* response = group->responses.data() + group->responses.size() - words;
+  uint64_t* mask = group->masks.data() + group->masks.size() - words;
+  toWords(crp.response.data(), crp.bits, response);
+  if (crp.mask.empty()) {
+    const std::vector<unsigned char> all((crp.bits + 7) / 8, 0xFF);
+    toWords(all.data(), crp.bits, mask);
+  } else {
+    toWords(crp.mask.data(), crp.bits, mask);
+  }
+  group->weights.push_back(bitKernels().popcount(mask, words));
+  count++;
+  if (const auto it = fleets.find(challengeKey(crp.challenge) + std::to_string(crp.bits)); it != fleets.end()) {
+    it->second->index.add(reinterpret_cast<const unsigned char*>(response),
+                          reinterpret_cast<const unsigned char*>(mask));
+    it->second->boards.push_back(crp.board);
+  }
+}
+
+SerialReader::CrpStore::Fleet& SerialReader::CrpStore::fleet(const Challenge& challenge, const uint32_t bits) const {
+  const std::string challengeFields = challengeKey(challenge);
+  auto& ret = fleets[challengeFields + std::to_string(bits)];
+  if (ret) return *ret;
+  ret = std::make_unique<Fleet>(bits);
+  for (const auto& [key, list] : groups) {
+    if (key.size() <= challengeFields.size() ||
+        key.compare(key.size() - challengeFields.size(), challengeFields.size(), challengeFields) != 0) {
+      continue;
+    }
+    const std::string board = key.substr(0, key.size() - challengeFields.size() - 1);
+    for (const auto& group : list) {
+      if (group.bits != bits) continue;
+      // The words hold the packed bytes in order, so they can be indexed as they are
+      for (size_t i = 0; i < group.size(); i++) {
+        ret->index.add(reinterpret_cast<const unsigned char*>(group.responses.data() + i * group.words),
+                       reinterpret_cast<const unsigned char*>(group.masks.data() + i * group.words));
+        ret->boards.push_back(board);
+      }
+    }
+  }
+  return *ret;
+}
+
+bool SerialReader::CrpStore::load() {
+  std::lock_guard lock(mutex);
+  groups.clear();
+  fleets.clear();
+  count = 0;
+  std::ifstream in(file, std::ios::binary);
+  if (!in) return true;
+  const std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (data.empty()) return true;
+  if (data.size() < CRP_HEADER_SIZE || std::memcmp(data.data(), CRP_MAGIC, sizeof(CRP_MAGIC)) != 0) return false;
+  size_t offset = getU32(data.data() + 12);
+  while (offset + CRP_RECORD_SIZE <= data.size()) {
+    const unsigned char* record = data.data() + offset;
+    Crp crp;
+    crp.bits = getU32(record);
+    const bool masked = getU32(record + 4) != 0;
+    crp.enrolled = static_cast<int64_t>(getU64(record + 8));
+    crp.board = getString(record + 16, CRP_BOARD_SIZE);
+    crp.challenge = getChallenge(record + 16 + CRP_BOARD_SIZE);
+    const size_t bytes = (crp.bits + 7) / 8;
+    const size_t end = offset + CRP_RECORD_SIZE + bytes * (masked ? 2 : 1);
+    // A record that was cut off ends the store
+    if (crp.bits == 0 || end > data.size()) break;
+    crp.response.assign(record + CRP_RECORD_SIZE, record + CRP_RECORD_SIZE + bytes);
+    if (masked) crp.mask.assign(record + CRP_RECORD_SIZE + bytes, record + CRP_RECORD_SIZE + 2 * bytes);
+    insert(crp);
+    offset = end;
+  }
+  return true;
+}
+
+bool SerialReader::CrpStore::enroll(const Crp& crp) {
+  const size_t bytes = (crp.bits + 7) / 8;
+  if (crp.bits == 0 || crp.response.size() != bytes || (!crp.mask.empty() && crp.mask.size() != bytes) ||
+      crp.board.size() >= CRP_BOARD_SIZE) {
+    return false;
+  }
+  std::vector<unsigned char> record(CRP_RECORD_SIZE);
+  putU32(record.data(), crp.bits);
+  putU32(record.data() + 4, crp.mask.empty() ? 0 : 1);
+  const int64_t enrolled = crp.enrolled != 0 ? crp.enrolled : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+  putU64(record.data() + 8, static_cast<uint64_t>(enrolled));
+  putString(record.data() + 16, crp.board, CRP_BOARD_SIZE);
+  putChallenge(record.data() + 16 + CRP_BOARD_SIZE, crp.challenge);
+  record.insert(record.end(), crp.response.begin(), crp.response.end());
+  record.insert(record.end(), crp.mask.begin(), crp.mask.end());
+
+  const int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd == -1) return false;
+  flock(fd, LOCK_EX);
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size == 0) {
+    unsigned char header[CRP_HEADER_SIZE]{};
+    std::memcpy(header, CRP_MAGIC, sizeof(CRP_MAGIC));
+    putU32(header + 8, CRP_VERSION);
+    putU32(header + 12, CRP_HEADER_SIZE);
+    record.insert(record.begin(), header, header + sizeof(header));
+  }
+  // One write, so that a concurrent reader never sees half a record
+  const bool ok = ::write(fd, record.data(), record.size()) == static_cast<ssize_t>(record.size());
+  flock(fd, LOCK_UN);
+  close(fd);
+  if (!ok) return false;
+  std::lock_guard lock(mutex);
+  insert(crp);
+  return true;
+}
+
+std::vector<double> SerialReader::CrpStore::distances(const std::string& board, const Challenge& challenge,
+                                                      const unsigned char* response, const uint32_t bits) const {
+  std::vector<double> ret;
+  if (response == nullptr || bits == 0) return ret;
+  std::lock_guard lock(mutex);
+  const auto it = groups.find(keyOf(board, challenge));
+  if (it == groups.end()) return ret;
+  for (const auto& group : it->second) {
+    if (group.bits != bits) continue;
+    std::vector<uint64_t> words(group.words);
+    toWords(response, bits, words.data());
+    ret.reserve(group.size());
+    for (size_t i = 0; i < group.size(); i++) {
+      const uint64_t d = maskedDistance(words.data(), group.responses.data() + i * group.words,
+                                        group.masks.data() + i * group.words, group.words);
+      ret.push_back(group.weights[i] != 0 ? static_cast<double>(d) / static_cast<double>(group.weights[i]) : 1);
+    }
+    explicit_bzero(words.data(), words.size() * sizeof(uint64_t));
+  }
+  return ret;
+}
+
+SerialReader::CrpMatch SerialReader::CrpStore::verify(const std::string& board, const Challenge& challenge,
+                                                      const unsigned char* response, const uint32_t bits,
+                                                      const double threshold) const {
+  CrpMatch ret;
+  const std::vector<double> all = distances(board, challenge, response, bits);
+  ret.compared = all.size();
+  for (size_t i = 0; i < all.size(); i++) {
+    if (all[i] < ret.distance || i == 0) {
+      ret.distance = all[i];
+      ret.index = i;
+    }
+  }
+  ret.accepted = ret.compared > 0 && ret.distance <= threshold;
+  return ret;
+}
+
+SerialReader::CrpIdentity SerialReader::CrpStore::identify(const Challenge& challenge,
+                                                            const unsigned char* response, const uint32_t bits,
+                                                            const double maxDistance) const {
+  CrpIdentity ret;
+  if (response == nullptr || bits == 0) return ret;
+  std::lock_guard lock(mutex);
+  const Fleet& f = fleet(challenge, bits);
+  const IdentifyMatch match = f.index.nearest(response, maxDistance);
+  ret.found = match.found;
+  ret.distance = match.distance;
+  ret.candidates = match.candidates;
+  ret.enrolled = f.index.size();
+  if (match.found) ret.board = f.boards[match.id];
+  return ret;
+}
+
+size_t SerialReader::CrpStore::size() const {
+  std::lock_guard lock(mutex);
+  return count;
+}
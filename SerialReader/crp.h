@@ -0,0 +1,139 @@
+#pragma once
+
+#define CRP_MAGIC "PUFCRPS"
+#define CRP_VERSION 1
+#define CRP_HEADER_SIZE 64
+#define CRP_RECORD_SIZE 128
+#define CRP_BOARD_SIZE 64
+#define CRP_EXTENSION ".pufc"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "challenge.h"
+#include "identify.h"
+
+namespace SerialReader {
+  // Masked Hamming distance: bits that differ between a and b where mask is set, over words 64 bit words
+  uint64_t maskedDistance(const uint64_t* a, const uint64_t* b, const uint64_t* mask, size_t words);
+
+  // The kernel set maskedDistance uses on this CPU (see bitKernels)
+  const char* distanceKernel();
+
+  // Packed bits as zero-padded words, (bits + 63) / 64 of them; bits beyond the last one are cleared
+  void toWords(const unsigned char* data, uint32_t bits, uint64_t* words);
+
+  // One enrolled challenge-response pair
+  struct Crp {
+    std::string board;
+    Challenge challenge;
+    // Packed MSB first like gatherBits' output, (bits + 7) / 8 bytes each
+    std::vector<unsigned char> response;
+    // Set bits are reliable and take part in the distance, an empty mask counts all bits
+    std::vector<unsigned char> mask;
+    uint32_t bits = 0;
+    // Nanoseconds since the epoch
+    int64_t enrolled = 0;
+  };
+
+  // Outcome of checking a fresh response against the CRPs of its board and challenge
+  struct CrpMatch {
+    // Number of enrolled CRPs that were compared
+    size_t compared = 0;
+    // Smallest masked fractional Hamming distance, 1 if nothing was compared
+    double distance = 1;
+    // Index of the closest CRP among the compared ones, in enrollment order
+    size_t index = 0;
+    bool accepted = false;
+  };
+
+  // Which board a response came from
+  struct CrpIdentity {
+    bool found = false;
+    std::string board;
+    // Masked fractional Hamming distance to the closest CRP of the board
+    double distance = 1;
+    // CRPs of the challenge the response was compared with, and how many were enrolled
+    size_t candidates = 0;
+    size_t enrolled = 0;
+  };
+
+  /*
+   * Store of enrolled CRPs in a file that is only ever appended to, like the catalog. The CRPs of a board and
+   * challenge are kept in contiguous word arrays, so that verifying a response is one XOR, AND and popcount per
+   * 64 bits and CRP.
+   *
+   * Layout (little endian): header (CRP_HEADER_SIZE bytes) "PUFCRPS\0", u32 version, u32 header size; then per
+   * CRP a record of CRP_RECORD_SIZE bytes: u32 bits, u32 mask present, u64 enrollment time, board
+   * (CRP_BOARD_SIZE bytes, NUL-terminated), challenge (CHALLENGE_SIZE bytes), reserved; followed by the response
+   * and, if present, the mask, (bits + 7) / 8 bytes each.
+   */
+  class CrpStore {
+  private:
+    // The CRPs of one board, challenge and response length
+    struct Group {
+      uint32_t bits = 0;
+      size_t words = 0;
+      std::vector<uint64_t> responses;
+      std::vector<uint64_t> masks;
+      // Set bits of every mask, the denominator of the fractional distance
+      std::vector<uint64_t> weights;
+
+      [[nodiscard]] size_t size() const {
+        return weights.size();
+      }
+    };
+
+    // Identification index over the CRPs of all boards for one challenge and response length
+    struct Fleet {
+      IdentifyIndex index;
+      std::vector<std::string> boards;
+
+      explicit Fleet(const uint32_t bits) : index(bits) {}
+    };
+
+    const std::string file;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::vector<Group>> groups;
+    // Built on the first identification of a challenge, then kept up to date by enroll
+    mutable std::unordered_map<std::string, std::unique_ptr<Fleet>> fleets;
+    size_t count = 0;
+
+    void insert(const Crp& crp);
+
+    Fleet& fleet(const Challenge& challenge, uint32_t bits) const;
+
+  public:
+    explicit CrpStore(std::string _file);
+
+    // (Re)reads the file, false if it exists but is not a CRP store
+    bool load();
+
+    // Appends a CRP to the file under an exclusive lock and to the index, false on error
+    bool enroll(const Crp& crp);
+
+    /*
+     * Compares a response (packed like Crp::response) with the CRPs of board and challenge that have the same
+     * number of bits. Accepted if the closest one is at most threshold away.
+     */
+    [[nodiscard]] CrpMatch verify(const std::string& board, const Challenge& challenge,
+                                  const unsigned char* response, uint32_t bits, double threshold) const;
+
+    // Masked fractional Hamming distance to each CRP of board and challenge with bits bits, in enrollment order
+    [[nodiscard]] std::vector<double> distances(const std::string& board, const Challenge& challenge,
+                                                const unsigned char* response, uint32_t bits) const;
+
+    /*
+     * Finds the board whose CRP of challenge is closest to a response of bits bits, if it is at most maxDistance
+     * away, without comparing with every board (see IdentifyIndex).
+     */
+    [[nodiscard]] CrpIdentity identify(const Challenge& challenge, const unsigned char* response, uint32_t bits,
+                                       double maxDistance) const;
+
+    [[nodiscard]] size_t size() const;
+  };
+}
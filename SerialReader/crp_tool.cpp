@@ -0,0 +1,209 @@
+#include <args.hxx>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include "bit_gather.h"
+#include "crp.h"
+#include "dump_file.h"
+#include "identify.h"
+#include "transposed.h"
+
+using namespace SerialReader;
+
+// Response of a dump: the bits at the pos file's positions, or all of the payload without one
+static std::vector<unsigned char> responseOf(const DumpReader& dump, const KeyPositions* positions, uint32_t& bits) {
+  if (positions == nullptr) {
+    bits = static_cast<uint32_t>(dump.size * 8);
+    return {dump.payload, dump.payload + dump.size};
+  }
+  std::vector<unsigned char> ret((positions->size() + 7) / 8);
+  bits = static_cast<uint32_t>(gatherBits(dump.payload, dump.size, *positions, ret.data()));
+  ret.resize((bits + 7) / 8);
+  return ret;
+}
+
+/*
+ * Identifies noisy responses in fleets of random boards with random reliability masks, the noise being every
+ * unreliable bit plus as many reliable ones as the tolerance allows. Exits with 1 if a board is not found or a
+ * lookup compares more than a tenth of the fleet.
+ */
+static int check() {
+  constexpr size_t boards = 5000;
+  constexpr size_t lookups = 200;
+  constexpr double tolerance = 0.06;
+  std::mt19937 random(1);
+  int ret = 0;
+  for (const uint32_t bits : {256U, 1020U, 1024U}) {
+    const size_t bytes = (bits + 7) / 8;
+    IdentifyIndex index(bits);
+    std::vector<std::vector<unsigned char>> responses, masks;
+    for (size_t i = 0; i < boards; i++) {
+      std::vector<unsigned char> response(bytes), mask(bytes, 0);
+      for (auto& byte : response) byte = static_cast<unsigned char>(random());
+      // About 5% of the bits are unreliable, on different positions for every board
+      for (uint32_t k = 0; k < bits; k++) {
+        if (random() % 20 != 0) mask[k / 8] |= static_cast<unsigned char>(0x80 >> k % 8);
+      }
+      index.add(response.data(), mask.data());
+      responses.push_back(std::move(response));
+      masks.push_back(std::move(mask));
+    }
+    size_t found = 0;
+    size_t candidates = 0;
+    for (size_t i = 0; i < lookups; i++) {
+      std::vector<unsigned char> query = responses[i];
+      uint32_t reliable = 0;
+      for (size_t j = 0; j < bytes; j++) {
+        query[j] ^= static_cast<unsigned char>(~masks[i][j]);
+        reliable += std::popcount(masks[i][j]);
+      }
+      auto errors = static_cast<uint32_t>(tolerance * reliable);
+      for (uint32_t k = 0; k < bits && errors > 0; k += 7) {
+        if (masks[i][k / 8] & 0x80 >> k % 8) {
+          query[k / 8] ^= static_cast<unsigned char>(0x80 >> k % 8);
+          errors--;
+        }
+      }
+      const IdentifyMatch match = index.nearest(query.data(), tolerance);
+      if (match.found && match.id == i) found++;
+      candidates += match.candidates;
+    }
+    std::cout << bits << " bits: found " << found << " of " << lookups << ", compared " << candidates / lookups
+      << " of " << boards << " per lookup" << std::endl;
+    if (found != lookups || candidates / lookups > boards / 10) ret = 1;
+  }
+  return ret;
+}
+
+// Enrolls dumps as challenge-response pairs and verifies fresh dumps against them
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Stores enrolled challenge-response pairs and verifies fresh responses by masked fractional Hamming distance.",
+    "Commands: enroll STORE DUMP... (--transposed masks the bits that were not stable), verify STORE DUMP... "
+    "(exits with 1 if a dump was rejected), identify STORE DUMP... (finds the board of each dump, -t is the "
+    "largest distance to consider), check (identifies noisy responses in random fleets, exits with 1 if one is "
+    "missed or a lookup compares too much of the fleet)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "enroll, verify, identify or check");
+  args::Positional<std::string> storeA(argsParser, "store", "CRP store");
+  args::PositionalList<std::string> filesA(argsParser, "dumps", "Dumps to enroll or verify");
+  args::ValueFlag<std::string> boardA(argsParser, "board", "Board the dumps were measured on", {'b', "board"}, "");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params", "Params the raw dumps were measured with",
+                                           {'p', "params"});
+  args::ValueFlag<std::string> posA(argsParser, "pos", "Use only the bits of a pos file as the response",
+                                    {"pos"}, "");
+  args::ValueFlag<int> keySizeA(argsParser, "bits", "Number of positions to read from the pos file",
+                                {'k', "key-size"}, 1024);
+  args::ValueFlag<std::string> transposedA(argsParser, "store",
+                                           "enroll: transposed store of the challenge the mask is taken from",
+                                           {"transposed"}, "");
+  args::ValueFlag<uint32_t> stableA(argsParser, "runs", "enroll: runs a reliable bit may differ from its majority",
+                                    {'s', "stable-threshold"}, 0);
+  args::ValueFlag<double> thresholdA(argsParser, "distance",
+                                     "verify, identify: largest accepted fractional distance", {'t', "threshold"},
+                                     0.1);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  if (command == "check") return check();
+  if (command != "enroll" && command != "verify" && command != "identify") {
+    std::cerr << argsParser;
+    return 1;
+  }
+  CrpStore store(args::get(storeA));
+  if (!store.load()) {
+    std::cerr << "Could not read " << args::get(storeA) << std::endl;
+    return 1;
+  }
+  std::optional<KeyPositions> positions;
+  if (!args::get(posA).empty()) positions = KeyPositions::load(args::get(posA), args::get(keySizeA));
+  std::optional<TransposedReader> transposed;
+  if (!args::get(transposedA).empty()) {
+    transposed.emplace(args::get(transposedA));
+    if (!transposed->isOpen()) {
+      std::cerr << "Could not read " << args::get(transposedA) << std::endl;
+      return 1;
+    }
+  }
+
+  int ret = 0;
+  for (const auto& file : args::get(filesA)) {
+    const DumpReader dump(file);
+    if (!dump.isOpen()) {
+      std::cerr << "Could not read " << file << std::endl;
+      ret = 1;
+      continue;
+    }
+    const Challenge challenge = dump.described || args::get(paramsA).empty()
+                                  ? dump.info.challenge
+                                  : Challenge::fromParams(args::get(paramsA));
+    uint32_t bits = 0;
+    std::vector<unsigned char> response = responseOf(dump, positions ? &*positions : nullptr, bits);
+
+    if (command == "enroll") {
+      Crp crp;
+      crp.board = args::get(boardA);
+      crp.challenge = challenge;
+      crp.bits = bits;
+      crp.response = response;
+      if (transposed) {
+        crp.mask.assign(response.size(), 0);
+        for (uint32_t k = 0; k < bits; k++) {
+          const uint64_t bit = positions ? positions->offsets[k] * 8 + (__builtin_clz(positions->masks[k]) - 24)
+                                         : k;
+          if (bit < transposed->size * 8 && transposed->isStable(bit, args::get(stableA))) {
+            crp.mask[k / 8] |= static_cast<unsigned char>(0x80 >> k % 8);
+          }
+        }
+      }
+      if (!store.enroll(crp)) {
+        std::cerr << "Could not enroll " << file << std::endl;
+        ret = 1;
+      }
+    } else if (command == "identify") {
+      const auto start = std::chrono::steady_clock::now();
+      const CrpIdentity identity = store.identify(challenge, response.data(), bits, args::get(thresholdA));
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+      if (identity.found) {
+        std::cout << file << '\t' << identity.board << "\tdistance " << identity.distance;
+      } else {
+        std::cout << file << "\tunknown";
+        ret = 1;
+      }
+      std::cout << " (compared " << identity.candidates << " of " << identity.enrolled << ", " << us << " us)"
+        << std::endl;
+    } else {
+      const auto start = std::chrono::steady_clock::now();
+      const CrpMatch match = store.verify(args::get(boardA), challenge, response.data(), bits,
+                                          args::get(thresholdA));
+      const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+      if (match.compared == 0) {
+        std::cout << file << "\tnot enrolled" << std::endl;
+      } else {
+        std::cout << file << '\t' << (match.accepted ? "accepted" : "rejected") << "\tdistance " << match.distance
+          << " to #" << match.index << " of " << match.compared << " (" << us << " us, " << distanceKernel() << ")"
+          << std::endl;
+      }
+      if (!match.accepted) ret = 1;
+    }
+    explicit_bzero(response.data(), response.size());
+  }
+  return ret;
+}
@@ -1,6 +1,21 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
 #include "DramPufJni.h"
+#include "crp.h"
+#include "jni_convert.h"
+#include "key_pool.h"
+#include "keygen.h"
+#include "latency.h"
 #include "runnerc.h"
 
+using SerialReader::toBytes;
+using SerialReader::toString;
+using SerialReader::toStrings;
+
 JNIEXPORT jstring JNICALL Java_DramPufJni_genKey
 (JNIEnv* env, jclass this_obj, jstring _serial_port, jstring _gpio_chip,
  const jint _baud, const jint _rpi_power_port, const jint _sleep, jobjectArray _params,
@@ -33,3 +48,197 @@ JNIEXPORT jstring JNICALL Java_DramPufJni_genKey
 
   return jret;
 }
+
+JNIEXPORT jobjectArray JNICALL Java_DramPufJni_genKeys
+(JNIEnv* env, jclass, jstring _serial_port, jstring _gpio_chip,
+ const jint _baud, const jint _rpi_power_port, const jint _sleep, jobjectArray _params,
+ const jint _params_size, jobjectArray _pos_files, jintArray _key_sizes) {
+  const jsize count = std::min(env->GetArrayLength(_pos_files), env->GetArrayLength(_key_sizes));
+  const std::vector<std::string> params = toStrings(env, _params, _params_size);
+  const std::vector<std::string> posFiles = toStrings(env, _pos_files, count);
+  std::vector<const char*> paramPtrs, posPtrs;
+  for (const auto& param : params) paramPtrs.push_back(param.c_str());
+  for (const auto& posFile : posFiles) posPtrs.push_back(posFile.c_str());
+  std::vector<jint> keySizes(count);
+  env->GetIntArrayRegion(_key_sizes, 0, count, keySizes.data());
+  const std::vector<int> sizes(keySizes.begin(), keySizes.end());
+
+  char** keys = gen_keys(toString(env, _serial_port).c_str(), toString(env, _gpio_chip).c_str(), _baud,
+                         _rpi_power_port, _sleep, paramPtrs.data(), static_cast<int>(paramPtrs.size()),
+                         posPtrs.data(), sizes.data(), count);
+  jobjectArray ret = SerialReader::toJavaStrings(env, keys, count);
+  free_keys(keys, count);
+  return ret;
+}
+
+static std::shared_ptr<SerialReader::KeyRequest>& toRequest(const jlong handle) {
+  return *reinterpret_cast<std::shared_ptr<SerialReader::KeyRequest>*>(handle);
+}
+
+JNIEXPORT jlong JNICALL Java_DramPufJni_genKeyAsync
+(JNIEnv* env, jclass, jstring _serial_port, jstring _gpio_chip,
+ const jint _baud, const jint _rpi_power_port, const jint _sleep, jobjectArray _params,
+ const jint _params_size, jstring _pos_file, const jint _key_size) {
+  const SerialReader::Parser parser({
+    .serialPort = toString(env, _serial_port), .gpioChip = toString(env, _gpio_chip), .baudRate = _baud,
+    .usbPort = _rpi_power_port, .usbSleep = _sleep, .params = toStrings(env, _params, _params_size)
+  });
+  // The Java side owns one reference until releaseKey, the measuring thread holds another
+  return reinterpret_cast<jlong>(new std::shared_ptr(
+    SerialReader::genKeyAsync(parser, toString(env, _pos_file), _key_size)));
+}
+
+JNIEXPORT jint JNICALL Java_DramPufJni_keyState
+(JNIEnv*, jclass, const jlong handle) {
+  return static_cast<jint>(toRequest(handle)->getState());
+}
+
+JNIEXPORT jlongArray JNICALL Java_DramPufJni_keyProgress
+(JNIEnv* env, jclass, const jlong handle) {
+  const SerialReader::KeyProgress progress = toRequest(handle)->getProgress();
+  const jlong values[] = {
+    static_cast<jlong>(progress.phase), static_cast<jlong>(progress.bytes), static_cast<jlong>(progress.total)
+  };
+  jlongArray ret = env->NewLongArray(3);
+  env->SetLongArrayRegion(ret, 0, 3, values);
+  return ret;
+}
+
+JNIEXPORT jstring JNICALL Java_DramPufJni_pollKey
+(JNIEnv* env, jclass, const jlong handle, const jlong timeout) {
+  const auto& request = toRequest(handle);
+  if (!request->wait(std::chrono::milliseconds(timeout > 0 ? timeout : 0))) return nullptr;
+  if (request->getState() != SerialReader::KeyState::DONE) return nullptr;
+  return env->NewStringUTF(request->getKey().c_str());
+}
+
+JNIEXPORT jstring JNICALL Java_DramPufJni_keyError
+(JNIEnv* env, jclass, const jlong handle) {
+  return env->NewStringUTF(toRequest(handle)->getError().c_str());
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_cancelKey
+(JNIEnv*, jclass, const jlong handle) {
+  toRequest(handle)->cancel();
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_releaseKey
+(JNIEnv*, jclass, const jlong handle) {
+  delete &toRequest(handle);
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_startKeyPool
+(JNIEnv* env, jclass, jstring _serial_port, jstring _gpio_chip,
+ const jint _baud, const jint _rpi_power_port, const jint _sleep,
+ const jint _capacity, const jlong _max_age, const jdouble _max_temperature_delta) {
+  const SerialReader::Parser board({
+    .serialPort = toString(env, _serial_port), .gpioChip = toString(env, _gpio_chip), .baudRate = _baud,
+    .usbPort = _rpi_power_port, .usbSleep = _sleep
+  });
+  SerialReader::PoolPolicy policy;
+  policy.capacity = _capacity;
+  policy.maxAge = std::chrono::seconds(_max_age);
+  policy.maxTemperatureDelta = _max_temperature_delta;
+  SerialReader::setKeyPool(std::make_shared<SerialReader::KeyPool>(board, policy));
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_addPoolChallenge
+(JNIEnv* env, jclass, jobjectArray _params, const jint _params_size) {
+  if (const auto pool = SerialReader::getKeyPool()) {
+    pool->addChallenge(toStrings(env, _params, _params_size));
+  }
+}
+
+JNIEXPORT jint JNICALL Java_DramPufJni_poolAvailable
+(JNIEnv* env, jclass, jobjectArray _params, const jint _params_size) {
+  const auto pool = SerialReader::getKeyPool();
+  return pool ? static_cast<jint>(pool->available(toStrings(env, _params, _params_size))) : 0;
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_stopKeyPool
+(JNIEnv*, jclass) {
+  SerialReader::setKeyPool(nullptr);
+}
+
+JNIEXPORT jlong JNICALL Java_DramPufJni_openCrpStore
+(JNIEnv* env, jclass, jstring _path) {
+  auto store = std::make_unique<SerialReader::CrpStore>(toString(env, _path));
+  if (!store->load()) return 0;
+  return reinterpret_cast<jlong>(store.release());
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_closeCrpStore
+(JNIEnv*, jclass, const jlong store) {
+  delete reinterpret_cast<SerialReader::CrpStore*>(store);
+}
+
+JNIEXPORT jboolean JNICALL Java_DramPufJni_enrollCrp
+(JNIEnv* env, jclass, const jlong store, jstring _board, jobjectArray _params, const jint _params_size,
+ jbyteArray _response, jbyteArray _mask, const jint _bits) {
+  if (store == 0) return JNI_FALSE;
+  SerialReader::Crp crp;
+  crp.board = toString(env, _board);
+  crp.challenge = SerialReader::Challenge::fromParams(toStrings(env, _params, _params_size));
+  crp.response = toBytes(env, _response, _bits);
+  crp.mask = toBytes(env, _mask, _bits);
+  crp.bits = _bits > 0 ? _bits : 0;
+  return reinterpret_cast<SerialReader::CrpStore*>(store)->enroll(crp) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jdouble JNICALL Java_DramPufJni_verifyCrp
+(JNIEnv* env, jclass, const jlong store, jstring _board, jobjectArray _params, const jint _params_size,
+ jbyteArray _response, const jint _bits) {
+  std::vector<unsigned char> response = toBytes(env, _response, _bits);
+  if (store == 0 || response.empty()) return std::nan("");
+  const SerialReader::CrpMatch match = reinterpret_cast<SerialReader::CrpStore*>(store)->verify(
+    toString(env, _board), SerialReader::Challenge::fromParams(toStrings(env, _params, _params_size)),
+    response.data(), _bits, 0);
+  explicit_bzero(response.data(), response.size());
+  return match.compared > 0 ? match.distance : std::nan("");
+}
+
+JNIEXPORT jstring JNICALL Java_DramPufJni_identifyBoard
+(JNIEnv* env, jclass, const jlong store, jobjectArray _params, const jint _params_size, jbyteArray _response,
+ const jint _bits, const jdouble _max_distance) {
+  std::vector<unsigned char> response = toBytes(env, _response, _bits);
+  if (store == 0 || response.empty()) return nullptr;
+  const SerialReader::CrpIdentity identity = reinterpret_cast<SerialReader::CrpStore*>(store)->identify(
+    SerialReader::Challenge::fromParams(toStrings(env, _params, _params_size)), response.data(), _bits,
+    _max_distance);
+  explicit_bzero(response.data(), response.size());
+  return identity.found ? env->NewStringUTF(identity.board.c_str()) : nullptr;
+}
+
+JNIEXPORT jstring JNICALL Java_DramPufJni_latencyReport
+(JNIEnv* env, jclass) {
+  return env->NewStringUTF(SerialReader::latencyStats().report().c_str());
+}
+
+JNIEXPORT jlongArray JNICALL Java_DramPufJni_latencyStats
+(JNIEnv* env, jclass, const jint phase) {
+  if (phase < 0 || phase >= LATENCY_PHASES) return nullptr;
+  const SerialReader::LatencySummary s =
+    SerialReader::latencyStats()[static_cast<SerialReader::LatencyPhase>(phase)].summary();
+  const jlong values[] = {
+    static_cast<jlong>(s.count), static_cast<jlong>(s.min), static_cast<jlong>(s.max), std::llround(s.mean),
+    static_cast<jlong>(s.p50), static_cast<jlong>(s.p90), static_cast<jlong>(s.p99), static_cast<jlong>(s.p999)
+  };
+  jlongArray ret = env->NewLongArray(8);
+  env->SetLongArrayRegion(ret, 0, 8, values);
+  return ret;
+}
+
+JNIEXPORT jboolean JNICALL Java_DramPufJni_dumpLatency
+(JNIEnv* env, jclass, jstring _path) {
+  return SerialReader::latencyStats().dump(toString(env, _path)) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_DramPufJni_dumpLatencyOnSignal
+(JNIEnv* env, jclass, jstring _path, const jint signal) {
+  return SerialReader::dumpLatencyOnSignal(toString(env, _path), signal) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_DramPufJni_resetLatency
+(JNIEnv*, jclass) {
+  SerialReader::latencyStats().reset();
+}
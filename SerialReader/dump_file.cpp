@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "archive.h"
+#include "bytes.h"
+#include "dump_file.h"
+
+uint32_t SerialReader::crc32(uint32_t crc, const unsigned char* data, const size_t size) {
+  static uint32_t table[256];
+  static const bool init = [] {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ c >> 1 : c >> 1;
+      table[i] = c;
+    }
+    return true;
+  }();
+  (void) init;
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+  return ~crc;
+}
+
+SerialReader::DumpWriter::DumpWriter(std::string _path, const DumpFormat _format)
+  : path(std::move(_path)), format(_format) {}
+
+SerialReader::DumpWriter::~DumpWriter() {
+  if (fd != -1) end(false);
+}
+
+void SerialReader::DumpWriter::reserve(const uint64_t size) {
+  if (size <= fileSize) return;
+  if (fallocate(fd, 0, 0, static_cast<off_t>(size)) != 0) {
+    // A full disk or quota has to fail the dump here, writing to the mapping of a sparse file would raise SIGBUS
+    if (errno != EOPNOTSUPP) {
+      fail("could not allocate " + std::to_string(size) + " bytes");
+      return;
+    }
+    // Filesystems without fallocate (e.g. vfat) fall back to a sparse file, which put() only writes with pwrite
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      fail("could not grow the file");
+      return;
+    }
+    allocated = false;
+  }
+  fileSize = size;
+}
+
+void SerialReader::DumpWriter::unmap() {
+  if (window == nullptr) return;
+  munmap(window, windowSize);
+  window = nullptr;
+}
+
+void SerialReader::DumpWriter::map(const uint64_t offset) {
+  unmap();
+  windowOffset = offset / DUMP_WINDOW_SIZE * DUMP_WINDOW_SIZE;
+  windowSize = static_cast<size_t>(std::min<uint64_t>(DUMP_WINDOW_SIZE, fileSize - windowOffset));
+  void* m = mmap(nullptr, windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(windowOffset));
+  if (m == MAP_FAILED) {
+    windowSize = 0;
+    return;
+  }
+  window = static_cast<char*>(m);
+  madvise(window, windowSize, MADV_SEQUENTIAL);
+}
+
+void SerialReader::DumpWriter::put(const char* data, size_t size) {
+  while (size > 0) {
+    if (window == nullptr || pos >= windowOffset + windowSize) {
+      if (pos + size > fileSize) {
+        // Summaries do not announce their size, so those grow a window at a time
+        reserve(info.payloadSize == 0 ? (pos + size + DUMP_WINDOW_SIZE - 1) / DUMP_WINDOW_SIZE * DUMP_WINDOW_SIZE
+                                      : pos + size);
+      }
+      // The rest of the dump is lost once the file could not grow
+      if (!error.empty()) return;
+      if (allocated) map(pos);
+      if (window == nullptr) {
+        // Could not map (e.g. out of address space) or the file is sparse, write directly instead
+        const ssize_t n = pwrite(fd, data, size, static_cast<off_t>(pos));
+        if (n <= 0) {
+          fail("could not write the payload");
+          return;
+        }
+        pos += n;
+        data += n;
+        size -= n;
+        continue;
+      }
+    }
+    const size_t n = std::min<uint64_t>(size, windowOffset + windowSize - pos);
+    std::memcpy(window + (pos - windowOffset), data, n);
+    pos += n;
+    data += n;
+    size -= n;
+  }
+}
+
+void SerialReader::DumpWriter::fail(const std::string& what) {
+  // The first error is the cause, the ones after it usually follow from it
+  if (error.empty()) error = what + ": " + std::strerror(errno);
+}
+
+bool SerialReader::DumpWriter::writeHeader(const int64_t endTime) const {
+  unsigned char header[DUMP_HEADER_SIZE] = {};
+  std::memcpy(header, DUMP_MAGIC, sizeof(DUMP_MAGIC));
+  putU32(header + 8, DUMP_VERSION);
+  putU32(header + 12, DUMP_HEADER_SIZE);
+  putU64(header + 16, payloadOffset);
+  putU64(header + 24, pos > payloadOffset ? pos - payloadOffset : 0);
+  const Challenge& c = info.challenge;
+  const uint32_t fields[] = {
+    static_cast<uint32_t>(c.mode), static_cast<uint32_t>(c.addMode), static_cast<uint32_t>(c.funcLoc),
+    c.start, c.end, c.init,
+    static_cast<uint32_t>(c.decayFunc), static_cast<uint32_t>(c.interval), static_cast<uint32_t>(c.decay)
+  };
+  for (size_t i = 0; i < 9; i++) putU32(header + 32 + 4 * i, fields[i]);
+  Cell cell{};
+  if (!parseFrame(info.frame, cell)) cell = cellOf(c.start, c.addMode);
+  putU32(header + 68, cell.bank);
+  putU32(header + 72, cell.row);
+  putU32(header + 76, cell.col);
+  putU64(header + 80, info.startTime);
+  putU64(header + 88, endTime);
+  putString(header + 96, info.firmware, 64);
+  putString(header + 160, info.frame, 32);
+  return pwrite(fd, header, sizeof(header), 0) == sizeof(header);
+}
+
+void SerialReader::DumpWriter::begin(const DumpInfo& _info) {
+  if (fd != -1) end(false);
+  info = _info;
+  error.clear();
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    fail("could not create the file");
+    std::cerr << "Could not write " << path << ", " << error << std::endl;
+    return;
+  }
+  fileSize = 0;
+  allocated = true;
+  crc = 0;
+  if (format == DumpFormat::DESCRIBED) {
+    payloadOffset = DUMP_HEADER_SIZE;
+    pos = payloadOffset;
+    reserve(payloadOffset + info.payloadSize + (info.payloadSize > 0 ? DUMP_FOOTER_SIZE : 0));
+    if (!writeHeader(0)) fail("could not write the header");
+  } else {
+    pos = 0;
+    reserve(info.frame.size() + info.payloadSize);
+    put(info.frame.data(), info.frame.size());
+    payloadOffset = pos;
+  }
+}
+
+void SerialReader::DumpWriter::write(const char* data, const size_t size) {
+  if (fd == -1) return;
+  if (format == DumpFormat::DESCRIBED) {
+    crc = crc32(crc, reinterpret_cast<const unsigned char*>(data), size);
+  }
+  put(data, size);
+}
+
+void SerialReader::DumpWriter::end(const bool ok) {
+  if (fd == -1) return;
+  unmap();
+  if (format == DumpFormat::DESCRIBED) {
+    const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!writeHeader(now)) fail("could not write the header");
+    if (ok) {
+      unsigned char footer[DUMP_FOOTER_SIZE] = {};
+      std::memcpy(footer, DUMP_FOOTER_MAGIC, sizeof(DUMP_FOOTER_MAGIC));
+      putU64(footer + 8, pos - payloadOffset);
+      putU32(footer + 16, crc);
+      if (pwrite(fd, footer, sizeof(footer), static_cast<off_t>(pos)) != sizeof(footer)) {
+        fail("could not write the footer");
+      }
+      pos += sizeof(footer);
+    }
+  }
+  // Drops whatever was preallocated but never received
+  if (ftruncate(fd, static_cast<off_t>(pos)) != 0) fail("could not truncate the file");
+  // Some filesystems (e.g. NFS) only report a failed write when the file is closed
+  if (close(fd) != 0) fail("could not close the file");
+  fd = -1;
+  if (!error.empty()) std::cerr << "Could not write " << path << ", " << error << std::endl;
+}
+
+SerialReader::DumpReader::DumpReader(const std::string& path) {
+  if (isArchive(path)) {
+    ArchiveReader archive(path);
+    if (!archive.isOpen()) return;
+    decoded.resize(archive.size);
+    if (archive.read(0, decoded.data(), decoded.size()) != decoded.size()) return;
+    described = true;
+    verified = archive.complete && archive.verify();
+    info = archive.info;
+    first = archive.first;
+    endTime = archive.endTime;
+    payload = decoded.data();
+    size = decoded.size();
+    return;
+  }
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m != MAP_FAILED) {
+      map = static_cast<const unsigned char*>(m);
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+  if (map == nullptr) return;
+
+  if (mapSize >= DUMP_HEADER_SIZE && std::memcmp(map, DUMP_MAGIC, sizeof(DUMP_MAGIC)) == 0) {
+    const uint64_t offset = getU64(map + 16);
+    const uint64_t length = getU64(map + 24);
+    if (offset > mapSize || length > mapSize - offset) return;
+    described = true;
+    Challenge& c = info.challenge;
+    c.mode = static_cast<int>(getU32(map + 32));
+    c.addMode = static_cast<int>(getU32(map + 36));
+    c.funcLoc = static_cast<int>(getU32(map + 40));
+    c.start = getU32(map + 44);
+    c.end = getU32(map + 48);
+    c.init = getU32(map + 52);
+    c.decayFunc = static_cast<int>(getU32(map + 56));
+    c.interval = static_cast<int>(getU32(map + 60));
+    c.decay = static_cast<int>(getU32(map + 64));
+    first = {getU32(map + 68), getU32(map + 72), getU32(map + 76)};
+    info.startTime = static_cast<int64_t>(getU64(map + 80));
+    endTime = static_cast<int64_t>(getU64(map + 88));
+    info.firmware = getString(map + 96, 64);
+    info.frame = getString(map + 160, 32);
+    info.payloadSize = length;
+    payload = map + offset;
+    size = length;
+    return;
+  }
+
+  // Raw dumps only carry the coordinates of their first word, BRC is assumed for its address
+  size_t comma = 0;
+  while (comma < mapSize && comma < 32 && map[comma] != ',') comma++;
+  if (comma < mapSize && map[comma] == ',') {
+    info.frame.assign(reinterpret_cast<const char*>(map), comma + 1);
+    parseFrame(info.frame, first);
+    payload = map + comma + 1;
+    size = mapSize - comma - 1;
+  } else {
+    payload = map;
+    size = mapSize;
+  }
+  info.challenge.mode = 0;
+  info.challenge.start = addressOf(first, 0);
+  info.challenge.end = info.challenge.start + static_cast<uint32_t>(size);
+  info.payloadSize = size;
+}
+
+SerialReader::DumpReader::~DumpReader() {
+  if (map != nullptr) munmap(const_cast<unsigned char*>(map), mapSize);
+}
+
+bool SerialReader::DumpReader::verify() const {
+  if (!described) return isOpen();
+  if (map == nullptr) return verified;
+  const size_t footer = payload - map + size;
+  if (footer + DUMP_FOOTER_SIZE > mapSize) return false;
+  if (std::memcmp(map + footer, DUMP_FOOTER_MAGIC, sizeof(DUMP_FOOTER_MAGIC)) != 0) return false;
+  if (getU64(map + footer + 8) != size) return false;
+  return getU32(map + footer + 16) == crc32(0, payload, size);
+}
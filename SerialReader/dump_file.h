@@ -0,0 +1,117 @@
+#pragma once
+
+#define DUMP_MAGIC "PUFDUMP"
+#define DUMP_FOOTER_MAGIC "PUFEND"
+#define DUMP_VERSION 1
+#define DUMP_HEADER_SIZE 512
+#define DUMP_FOOTER_SIZE 24
+#define DUMP_WINDOW_SIZE (8 << 20)
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dump_sink.h"
+
+namespace SerialReader {
+  // ARCHIVE is written by ArchiveWriter, see archive.h
+  enum class DumpFormat { RAW, DESCRIBED, ARCHIVE };
+
+  uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size);
+
+  /*
+   * Writes a dump through a sliding mmap window into a file that is preallocated to its final size.
+   *
+   * RAW is the classic layout (frame text followed by the payload) the Java tools understand.
+   * DESCRIBED starts with a DUMP_HEADER_SIZE byte header (little endian):
+   *   "PUFDUMP\0", u32 version, u32 header size, u64 payload offset, u64 payload size,
+   *   u32 mode, address mode, function location, start, end, init value, function, interval, decay,
+   *   u32 bank, row and column of the first word, i64 start and end time (ns since epoch),
+   *   char[64] firmware build, char[32] frame
+   * and ends with a DUMP_FOOTER_SIZE byte footer:
+   *   "PUFEND\0\0", u64 payload size, u32 CRC-32 of the payload, u32 reserved
+   */
+  class DumpWriter : public DumpSink {
+  private:
+    const std::string path;
+    const DumpFormat format;
+    int fd = -1;
+    DumpInfo info;
+    uint64_t fileSize = 0;
+    uint64_t pos = 0;
+    uint64_t payloadOffset = 0;
+    uint32_t crc = 0;
+    char* window = nullptr;
+    uint64_t windowOffset = 0;
+    size_t windowSize = 0;
+    // False once the file had to grow without fallocate, its pages are then written with pwrite only
+    bool allocated = true;
+    std::string error;
+
+    // Keeps the first error, with errno
+    void fail(const std::string& what);
+
+    void reserve(uint64_t size);
+
+    void map(uint64_t offset);
+
+    void unmap();
+
+    void put(const char* data, size_t size);
+
+    bool writeHeader(int64_t endTime) const;
+
+  public:
+    DumpWriter(std::string _path, DumpFormat _format);
+
+    ~DumpWriter() override;
+
+    DumpWriter(const DumpWriter&) = delete;
+
+    DumpWriter& operator=(const DumpWriter&) = delete;
+
+    void begin(const DumpInfo& _info) override;
+
+    void write(const char* data, size_t size) override;
+
+    // Reports a file that could not be written completely on stderr, see getError()
+    void end(bool ok) override;
+
+    // Why the last dump could not be written completely, empty if it was
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+  };
+
+  // Read-only mapping of a dump written in either format, archives (see archive.h) are decoded into memory
+  class DumpReader {
+  private:
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    std::vector<unsigned char> decoded;
+    bool verified = false;
+
+  public:
+    bool described = false;
+    DumpInfo info;
+    Cell first{};
+    int64_t endTime = 0;
+    const unsigned char* payload = nullptr;
+    size_t size = 0;
+
+    explicit DumpReader(const std::string& path);
+
+    ~DumpReader();
+
+    DumpReader(const DumpReader&) = delete;
+
+    DumpReader& operator=(const DumpReader&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return payload != nullptr;
+    }
+
+    // Compares the footer with the payload, raw dumps have nothing to compare against and always pass
+    [[nodiscard]] bool verify() const;
+  };
+}
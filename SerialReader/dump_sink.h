@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include "challenge.h"
+
+namespace SerialReader {
+  // Everything known about a measurement when its transfer starts
+  struct DumpInfo {
+    Challenge challenge;
+    // What the firmware printed between "&|" and the payload, e.g. "0000000," for puf_read_all
+    std::string frame;
+    // The "BUILD DATE" line the firmware printed while booting
+    std::string firmware;
+    // Nanoseconds since the epoch at "&|"
+    int64_t startTime = 0;
+    // Number of payload bytes, 0 if the firmware does not announce it (summaries)
+    size_t payloadSize = 0;
+  };
+
+  // Receives the transfer of one measurement, i.e. everything between "&|" and "|&"
+  class DumpSink {
+  public:
+    virtual ~DumpSink() = default;
+
+    virtual void begin(const DumpInfo& info) = 0;
+
+    virtual void write(const char* data, size_t size) = 0;
+
+    // ok is false if the measurement was aborted before "|&"
+    virtual void end(bool ok) = 0;
+  };
+
+  // Writes frame and payload unchanged, i.e. the classic .bin layout
+  class StreamSink : public DumpSink {
+  private:
+    std::ostream& out;
+    std::string::size_type mark = 0;
+
+  public:
+    explicit StreamSink(std::ostream& _out) : out(_out) {}
+
+    void begin(const DumpInfo& info) override {
+      if (const auto* o = dynamic_cast<std::ostringstream*>(&out)) {
+        mark = o->str().size();
+      }
+      out << info.frame;
+    }
+
+    void write(const char* data, const size_t size) override {
+      out.write(data, static_cast<std::streamsize>(size));
+    }
+
+    void end(const bool ok) override {
+      // Throw away what an aborted transfer left in memory, a file keeps it for inspection
+      if (auto* o = dynamic_cast<std::ostringstream*>(&out); o != nullptr && !ok) {
+        std::string str = o->str();
+        str.resize(mark);
+        o->str(str);
+        o->seekp(0, std::ios::end);
+      }
+      out.flush();
+    }
+  };
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include "dump_file.h"
+#include "dump_view.h"
+
+// First word start + 4 * k that lies at or above lo
+static uint32_t firstWithin(const uint32_t start, const uint32_t lo) {
+  return start >= lo ? start : start + (lo - start + 3) / 4 * 4;
+}
+
+SerialReader::DumpView::DumpView(const unsigned char* _data, const size_t _size, const Challenge& challenge)
+  : data(_data), size(_size), addMode(challenge.addMode) {
+  // Same walk as Challenge::addressAt, but bounded by the payload instead of the end address
+  lowStart = firstWithin(challenge.start, PUF_LOW_START);
+  highStart = firstWithin(challenge.start, PUF_HIGH_START);
+  if (lowStart < PUF_LOW_END) lowWords = std::min<uint64_t>(words(), (PUF_LOW_END - lowStart + 3) / 4);
+}
+
+// Raw dumps only know the coordinates of their first word, which mean another address in RBC
+static SerialReader::Challenge challengeOf(const SerialReader::DumpReader& reader, const std::optional<int> addMode) {
+  SerialReader::Challenge c = reader.info.challenge;
+  if (!reader.described) {
+    c.addMode = addMode.value_or(0);
+    c.start = addressOf(reader.first, c.addMode);
+  }
+  return c;
+}
+
+SerialReader::DumpView::DumpView(const DumpReader& reader, const std::optional<int> addMode)
+  : DumpView(reader.payload, reader.size, challengeOf(reader, addMode)) {}
+
+SerialReader::DumpWord SerialReader::DumpView::at(const uint64_t index) const {
+  DumpWord w;
+  w.index = index;
+  w.address = address(index);
+  w.cell = cellOf(w.address, addMode);
+  if (data != nullptr) w.value = word(index);
+  return w;
+}
+
+SerialReader::DumpRow SerialReader::DumpView::row(const uint64_t index) const {
+  const uint32_t a = address(index);
+  const Cell c = cellOf(a, addMode);
+  // Bank and row change at every 4 KiB boundary in both modes, so do the PUF ranges
+  const uint64_t regionEnd = index < lowWords ? lowWords : words();
+  const uint64_t pageEnd = index + (0x1000 - (a & 0xFFF) + 3) / 4;
+  return {c.bank, c.row, c.col, index, static_cast<uint32_t>(std::min(regionEnd, pageEnd) - index)};
+}
+
+// Lowest address at or above address whose bank bits are bank, 2^32 if there is none
+static uint64_t nextInBank(const uint64_t address, const uint32_t bank, const int addMode) {
+  if (addMode == 0) {
+    // Bank 28:26; above the bank bits every PUF address is 110
+    const uint32_t b = address >> 26 & 7;
+    if (b == bank) return address;
+    return b < bank ? (address & 0xE0000000) | static_cast<uint64_t>(bank) << 26 : 1ULL << 32;
+  }
+  // Bank 14:12 repeats every 32 KiB
+  const uint32_t b = address >> 12 & 7;
+  if (b == bank) return address;
+  const uint64_t base = (address & ~0x7FFFULL) + (b < bank ? 0 : 0x8000);
+  return base | bank << 12;
+}
+
+uint64_t SerialReader::DumpView::seek(const uint32_t address, const std::optional<uint32_t> bank) const {
+  uint64_t a = address;
+  while (true) {
+    if (bank) a = nextInBank(a, *bank, addMode);
+    if (a >= 1ULL << 32) return words();
+    uint64_t index;
+    if (lowWords > 0 && a < lowStart + 4 * lowWords) {
+      index = a <= lowStart ? 0 : (a - lowStart + 3) / 4;
+    } else {
+      index = lowWords + (a <= highStart ? 0 : (a - highStart + 3) / 4);
+    }
+    if (index >= words()) return words();
+    // Skipping the gap between the PUF ranges may have led into another bank
+    if (!bank || cell(index).bank == *bank) return index;
+    a = this->address(index);
+  }
+}
+
+std::optional<uint64_t> SerialReader::DumpView::find(const uint32_t address) const {
+  const uint64_t index = seek(address, std::nullopt);
+  if (index < words() && this->address(index) == address) return index;
+  return std::nullopt;
+}
+
+SerialReader::DumpView::RowIterator::RowIterator(const DumpView* _view, const std::optional<uint32_t> _bank)
+  : view(_view), bank(_bank) {
+  if (view->words() == 0) return;
+  load(bank ? view->seek(view->address(0), bank) : 0);
+}
+
+void SerialReader::DumpView::RowIterator::load(const uint64_t index) {
+  done = index >= view->words();
+  if (!done) current = view->row(index);
+}
+
+SerialReader::DumpView::RowIterator& SerialReader::DumpView::RowIterator::operator++() {
+  uint64_t next = current.first + current.words;
+  if (bank && next < view->words() && view->cell(next).bank != *bank) next = view->seek(view->address(next), bank);
+  load(next);
+  return *this;
+}
+
+SerialReader::DumpView::WordIterator::WordIterator(const DumpView* _view, RowIterator _row,
+                                                  const std::optional<uint32_t> _column)
+  : view(_view), column(_column), row(_row) {
+  settle();
+}
+
+void SerialReader::DumpView::WordIterator::settle() {
+  for (; row != std::default_sentinel; ++row) {
+    if (!column) {
+      index = row->first;
+      last = index + row->words;
+      break;
+    }
+    if (row->contains(*column)) {
+      index = row->first + (*column - row->col);
+      last = index + 1;
+      break;
+    }
+  }
+  if (row != std::default_sentinel) current = view->at(index);
+}
+
+SerialReader::DumpView::WordIterator& SerialReader::DumpView::WordIterator::operator++() {
+  if (++index < last) {
+    current = view->at(index);
+    return *this;
+  }
+  ++row;
+  settle();
+  return *this;
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <span>
+#include "challenge.h"
+
+namespace SerialReader {
+  class DumpReader;
+
+  // One word of a dump and where it lies in DRAM
+  struct DumpWord {
+    // Index of the word in the payload, its bytes start at 4 * index
+    uint64_t index = 0;
+    uint32_t address = 0;
+    Cell cell{};
+    // As mmio_read32 returned it, puf_read_all sends it big endian
+    uint32_t value = 0;
+  };
+
+  // Words of a dump at consecutive addresses in one row of one bank, i.e. up to a 4 KiB page under BRC and RBC
+  struct DumpRow {
+    uint32_t bank = 0;
+    uint32_t row = 0;
+    // Column of the first word
+    uint32_t col = 0;
+    // Payload index of the first word
+    uint64_t first = 0;
+    uint32_t words = 0;
+
+    [[nodiscard]] bool contains(const uint32_t column) const {
+      return column >= col && column - col < words;
+    }
+  };
+
+  /*
+   * The payload of a dump addressed by word, bit and DRAM cell, without copying it. The view only points into the
+   * memory it was made from (the mapping of a DumpReader, which decodes archives into memory instead), so it must
+   * not outlive it. Iterating allocates nothing: rows and words are computed from the start address as
+   * puf_read_all walks it, skipping the addresses outside of the PUF ranges.
+   *
+   * Bits are numbered as in pos files: bit i is bit 7 - i % 8 of byte i / 8, so bit 0 is the most significant bit
+   * of the first word and bit 32 * w + k is bit 31 - k of the DRAM word w.
+   */
+  class DumpView {
+  private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    int addMode = 0;
+    uint32_t lowStart = PUF_LOW_START;
+    uint64_t lowWords = 0;
+    uint32_t highStart = PUF_HIGH_START;
+
+    // Index of the first word at or after address that lies in bank (any if empty), words() if there is none
+    [[nodiscard]] uint64_t seek(uint32_t address, std::optional<uint32_t> bank) const;
+
+  public:
+    // Rows in payload order, optionally only those of one bank
+    class RowIterator {
+    private:
+      const DumpView* view = nullptr;
+      std::optional<uint32_t> bank;
+      DumpRow current{};
+      bool done = true;
+
+      void load(uint64_t index);
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = DumpRow;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const DumpRow*;
+      using reference = const DumpRow&;
+
+      RowIterator() = default;
+
+      RowIterator(const DumpView* _view, std::optional<uint32_t> _bank);
+
+      reference operator*() const {
+        return current;
+      }
+
+      pointer operator->() const {
+        return &current;
+      }
+
+      RowIterator& operator++();
+
+      RowIterator operator++(int) {
+        RowIterator before = *this;
+        ++*this;
+        return before;
+      }
+
+      bool operator==(std::default_sentinel_t) const {
+        return done;
+      }
+    };
+
+    // Words in payload order; with a column, only the word of that column in each row
+    class WordIterator {
+    private:
+      const DumpView* view = nullptr;
+      std::optional<uint32_t> column;
+      RowIterator row;
+      uint64_t index = 0;
+      uint64_t last = 0;
+      DumpWord current{};
+
+      // Enters the current row, or the next one that has a wanted word
+      void settle();
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = DumpWord;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const DumpWord*;
+      using reference = const DumpWord&;
+
+      WordIterator() = default;
+
+      WordIterator(const DumpView* _view, RowIterator _row, std::optional<uint32_t> _column);
+
+      reference operator*() const {
+        return current;
+      }
+
+      pointer operator->() const {
+        return &current;
+      }
+
+      WordIterator& operator++();
+
+      WordIterator operator++(int) {
+        WordIterator before = *this;
+        ++*this;
+        return before;
+      }
+
+      bool operator==(std::default_sentinel_t) const {
+        return row == std::default_sentinel;
+      }
+    };
+
+    // What rows(), cells() and column() return, to be used in range-based for loops; it points to the view
+    template<typename Iterator>
+    struct Range {
+      Iterator first;
+
+      Iterator begin() const {
+        return first;
+      }
+
+      std::default_sentinel_t end() const {
+        return {};
+      }
+    };
+
+    DumpView() = default;
+
+    /*
+     * A payload as puf_read_all sent it from challenge.start on, in challenge.addMode; only the start address and
+     * the address mode of the challenge are used. data may be null to only walk the layout.
+     */
+    DumpView(const unsigned char* _data, size_t _size, const Challenge& challenge);
+
+    /*
+     * The payload of reader. Raw dumps do not record their address mode, their start address is recomputed from
+     * the coordinates of the frame for addMode, which is BRC (0) unless given.
+     */
+    explicit DumpView(const DumpReader& reader, std::optional<int> addMode = std::nullopt);
+
+    [[nodiscard]] std::span<const unsigned char> bytes() const {
+      return {data, size};
+    }
+
+    // The bytes of the words of row
+    [[nodiscard]] std::span<const unsigned char> bytes(const DumpRow& row) const {
+      return {data + 4 * row.first, 4 * static_cast<size_t>(row.words)};
+    }
+
+    [[nodiscard]] int getAddMode() const {
+      return addMode;
+    }
+
+    // Whole words, a trailing partial word of a truncated dump is only reachable through bytes() and bit()
+    [[nodiscard]] uint64_t words() const {
+      return size / 4;
+    }
+
+    [[nodiscard]] uint64_t bits() const {
+      return static_cast<uint64_t>(size) * 8;
+    }
+
+    [[nodiscard]] uint32_t word(const uint64_t index) const {
+      const unsigned char* p = data + 4 * index;
+      return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+             static_cast<uint32_t>(p[2]) << 8 | p[3];
+    }
+
+    [[nodiscard]] bool bit(const uint64_t index) const {
+      return data[index / 8] >> (7 - index % 8) & 1;
+    }
+
+    [[nodiscard]] uint32_t address(const uint64_t index) const {
+      return index < lowWords ? lowStart + static_cast<uint32_t>(4 * index)
+                              : highStart + static_cast<uint32_t>(4 * (index - lowWords));
+    }
+
+    [[nodiscard]] Cell cell(const uint64_t index) const {
+      return cellOf(address(index), addMode);
+    }
+
+    // Everything known about the word at index
+    [[nodiscard]] DumpWord at(uint64_t index) const;
+
+    // Index of the word at address, if the dump has it
+    [[nodiscard]] std::optional<uint64_t> find(uint32_t address) const;
+
+    [[nodiscard]] std::optional<uint64_t> find(const Cell& cell) const {
+      return find(addressOf(cell, addMode));
+    }
+
+    // The row the word at index belongs to, from that word on; index has to be below words()
+    [[nodiscard]] DumpRow row(uint64_t index) const;
+
+    [[nodiscard]] Range<RowIterator> rows(std::optional<uint32_t> bank = std::nullopt) const {
+      return {RowIterator(this, bank)};
+    }
+
+    // Every word (of bank, if given) in payload order
+    [[nodiscard]] Range<WordIterator> cells(std::optional<uint32_t> bank = std::nullopt) const {
+      return {WordIterator(this, RowIterator(this, bank), std::nullopt)};
+    }
+
+    // The words of one column in every row (of bank, if given) that has it
+    [[nodiscard]] Range<WordIterator> column(const uint32_t col, std::optional<uint32_t> bank = std::nullopt) const {
+      return {WordIterator(this, RowIterator(this, bank), col)};
+    }
+  };
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bytes.h"
+#include "flips.h"
+
+void SerialReader::FlipSet::add(const Cell& cell, const uint32_t count) {
+  keys.push_back(flipKey(cell));
+  counts.push_back(static_cast<uint8_t>(std::min<uint32_t>(count, 255)));
+}
+
+void SerialReader::FlipSet::sort() {
+  std::vector<std::pair<uint32_t, uint8_t>> words(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) words[i] = {keys[i], counts[i]};
+  std::sort(words.begin(), words.end());
+  keys.clear();
+  counts.clear();
+  for (const auto& [key, count] : words) {
+    if (!keys.empty() && keys.back() == key) {
+      counts.back() = count;
+      continue;
+    }
+    keys.push_back(key);
+    counts.push_back(count);
+  }
+}
+
+bool SerialReader::FlipSet::write(const std::string& path, const Challenge& challenge, const int64_t startTime) const {
+  std::vector<uint32_t> rows;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (rows.empty() || rows[rows.size() - 2] != keys[i] >> 10) {
+      rows.push_back(keys[i] >> 10);
+      rows.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  std::vector<unsigned char> data(FLIP_HEADER_SIZE + rows.size() * 4 + keys.size() * 5);
+  unsigned char* p = data.data();
+  std::memcpy(p, FLIP_MAGIC, sizeof(FLIP_MAGIC));
+  putU32(p + 8, FLIP_VERSION);
+  putU32(p + 12, FLIP_HEADER_SIZE);
+  putU32(p + 16, static_cast<uint32_t>(keys.size()));
+  putU32(p + 20, static_cast<uint32_t>(rows.size() / 2));
+  putChallenge(p + 24, challenge);
+  putU64(p + 64, static_cast<uint64_t>(startTime));
+  p += FLIP_HEADER_SIZE;
+  for (const uint32_t v : rows) {
+    putU32(p, v);
+    p += 4;
+  }
+  for (const uint32_t key : keys) {
+    putU32(p, key);
+    p += 4;
+  }
+  std::memcpy(p, counts.data(), counts.size());
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+  return static_cast<bool>(out);
+}
+
+SerialReader::FlipSet SerialReader::intersect(const FlipView& a, const FlipView& b) {
+  FlipSet ret;
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size && j < b.size) {
+    if (a.keys[i] < b.keys[j]) {
+      i++;
+    } else if (b.keys[j] < a.keys[i]) {
+      j++;
+    } else {
+      ret.keys.push_back(a.keys[i]);
+      ret.counts.push_back(std::min(a.counts[i++], b.counts[j++]));
+    }
+  }
+  return ret;
+}
+
+SerialReader::FlipSet SerialReader::unite(const FlipView& a, const FlipView& b) {
+  FlipSet ret;
+  ret.keys.reserve(a.size + b.size);
+  ret.counts.reserve(a.size + b.size);
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size || j < b.size) {
+    if (j == b.size || (i < a.size && a.keys[i] < b.keys[j])) {
+      ret.keys.push_back(a.keys[i]);
+      ret.counts.push_back(a.counts[i++]);
+    } else if (i == a.size || b.keys[j] < a.keys[i]) {
+      ret.keys.push_back(b.keys[j]);
+      ret.counts.push_back(b.counts[j++]);
+    } else {
+      ret.keys.push_back(a.keys[i]);
+      ret.counts.push_back(std::max(a.counts[i++], b.counts[j++]));
+    }
+  }
+  return ret;
+}
+
+SerialReader::FlipSet SerialReader::subtract(const FlipView& a, const FlipView& b) {
+  FlipSet ret;
+  size_t j = 0;
+  for (size_t i = 0; i < a.size; i++) {
+    while (j < b.size && b.keys[j] < a.keys[i]) j++;
+    if (j < b.size && b.keys[j] == a.keys[i]) continue;
+    ret.keys.push_back(a.keys[i]);
+    ret.counts.push_back(a.counts[i]);
+  }
+  return ret;
+}
+
+SerialReader::SummaryParser::SummaryParser(FlipSet& set) : TokenParser([&set](const std::string& token) {
+  const size_t eq = token.find('=');
+  Cell cell{};
+  uint32_t count = 0;
+  // "%d%04X%03X": the bank is whatever comes before the last 7 digits
+  if (eq == std::string::npos || eq < 8 || !parseNumber(token, 0, eq - 7, 10, cell.bank) ||
+      !parseNumber(token, eq - 7, eq - 3, 16, cell.row) || !parseNumber(token, eq - 3, eq, 16, cell.col) ||
+      !parseNumber(token, eq + 1, token.size(), 10, count) || cell.bank > 7 || cell.row > 0x3FFF ||
+      cell.col > 0x3FF || count == 0) {
+    return false;
+  }
+  set.add(cell, count);
+  return true;
+}) {}
+
+void SerialReader::FlipSink::begin(const DumpInfo& _info) {
+  info = _info;
+  summary = info.payloadSize == 0 && info.challenge.mode == 1;
+  set.keys.clear();
+  set.counts.clear();
+  parser.reset();
+  inner.begin(info);
+}
+
+void SerialReader::FlipSink::write(const char* data, const size_t count) {
+  if (summary) parser.feed(data, count);
+  inner.write(data, count);
+}
+
+void SerialReader::FlipSink::end(const bool ok) {
+  inner.end(ok);
+  if (summary && ok) {
+    parser.finish();
+    set.sort();
+    if (!set.write(path, info.challenge, info.startTime)) std::cerr << "Could not write " << path << std::endl;
+  }
+  summary = false;
+}
+
+SerialReader::FlipIndex::FlipIndex(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size >= FLIP_HEADER_SIZE) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m != MAP_FAILED) {
+      map = static_cast<const unsigned char*>(m);
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+  if (map == nullptr) return;
+  words.size = getU32(map + 16);
+  rows = getU32(map + 20);
+  if (std::memcmp(map, FLIP_MAGIC, sizeof(FLIP_MAGIC)) != 0 ||
+      mapSize != FLIP_HEADER_SIZE + static_cast<uint64_t>(rows) * 8 + words.size * 5) {
+    munmap(const_cast<unsigned char*>(map), mapSize);
+    map = nullptr;
+    return;
+  }
+  challenge = getChallenge(map + 24);
+  startTime = static_cast<int64_t>(getU64(map + 64));
+  // Mapped as they are, the fields are little endian like the host
+  rowTable = reinterpret_cast<const uint32_t*>(map + FLIP_HEADER_SIZE);
+  words.keys = rowTable + 2 * static_cast<size_t>(rows);
+  words.counts = reinterpret_cast<const uint8_t*>(words.keys + words.size);
+}
+
+SerialReader::FlipIndex::~FlipIndex() {
+  if (map != nullptr) munmap(const_cast<unsigned char*>(map), mapSize);
+}
+
+size_t SerialReader::FlipIndex::lowerRow(const uint32_t rowKey) const {
+  size_t lo = 0;
+  size_t hi = rows;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if (rowTable[2 * mid] < rowKey) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < rows ? rowTable[2 * lo + 1] : words.size;
+}
+
+SerialReader::FlipView SerialReader::FlipIndex::range(const uint32_t bank, const uint32_t firstRow,
+                                                      const uint32_t lastRow) const {
+  if (bank > 7 || firstRow > lastRow || firstRow > 0x3FFF) return {};
+  const size_t from = lowerRow(bank << 14 | firstRow);
+  const size_t to = lowerRow((bank << 14 | std::min<uint32_t>(lastRow, 0x3FFF)) + 1);
+  return {words.keys + from, words.counts + from, to - from};
+}
+
+uint32_t SerialReader::FlipIndex::count(const Cell& cell) const {
+  const FlipView row = range(cell.bank, cell.row, cell.row);
+  const uint32_t key = flipKey(cell);
+  const uint32_t* it = std::lower_bound(row.keys, row.keys + row.size, key);
+  return it != row.keys + row.size && *it == key ? row.counts[it - row.keys] : 0;
+}
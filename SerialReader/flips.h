@@ -0,0 +1,135 @@
+#pragma once
+
+#define FLIP_MAGIC "PUFFLIP"
+#define FLIP_VERSION 1
+#define FLIP_HEADER_SIZE 128
+#define FLIP_EXTENSION ".flips"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "challenge.h"
+#include "dump_sink.h"
+#include "token_parser.h"
+
+namespace SerialReader {
+  // Bank 26:24, row 23:10, column 9:0, so that keys sort by bank, row and column
+  inline uint32_t flipKey(const Cell& cell) {
+    return cell.bank << 24 | cell.row << 10 | cell.col;
+  }
+
+  inline Cell flipCell(const uint32_t key) {
+    return {key >> 24, key >> 10 & 0x3FFF, key & 0x3FF};
+  }
+
+  // Sorted weak words, either owned by a FlipSet or mapped from a FlipIndex
+  struct FlipView {
+    const uint32_t* keys = nullptr;
+    // Flipped bits of each word
+    const uint8_t* counts = nullptr;
+    size_t size = 0;
+  };
+
+  // Weak words of one or more summaries, in memory
+  struct FlipSet {
+    std::vector<uint32_t> keys;
+    std::vector<uint8_t> counts;
+
+    void add(const Cell& cell, uint32_t count);
+
+    // Sorts by key; a word that was added twice keeps its higher count
+    void sort();
+
+    [[nodiscard]] FlipView view() const {
+      return {keys.data(), counts.data(), keys.size()};
+    }
+
+    // Writes the set (sorted) as a flip index, false on error
+    bool write(const std::string& path, const Challenge& challenge, int64_t startTime = 0) const;
+  };
+
+  // Words that are weak in both, with the lower count
+  FlipSet intersect(const FlipView& a, const FlipView& b);
+
+  // Words that are weak in either, with the higher count
+  FlipSet unite(const FlipView& a, const FlipView& b);
+
+  // Words of a that are not weak in b
+  FlipSet subtract(const FlipView& a, const FlipView& b);
+
+  /*
+   * Parses the text puf_read_ext prints between "&|" and "|&": "%d%04X%03X=%04d" (bank, row, column, flipped
+   * bits) per weak word, separated by ",". Text can be fed in pieces of any size.
+   */
+  class SummaryParser : public TokenParser {
+  public:
+    explicit SummaryParser(FlipSet& set);
+  };
+
+  // Passes the transfer on and writes a summary (mode 1) as a flip index once it completed
+  class FlipSink : public DumpSink {
+  private:
+    DumpSink& inner;
+    const std::string path;
+    DumpInfo info;
+    FlipSet set;
+    SummaryParser parser{set};
+    bool summary = false;
+
+  public:
+    FlipSink(DumpSink& _inner, std::string _path) : inner(_inner), path(std::move(_path)) {}
+
+    void begin(const DumpInfo& _info) override;
+
+    void write(const char* data, size_t count) override;
+
+    void end(bool ok) override;
+  };
+
+  /*
+   * Read-only mapping of a flip index. Rows (bank and row) point to their first word, so a range of rows is
+   * found by a binary search in the row table instead of in the words.
+   *
+   * Layout (little endian): header (FLIP_HEADER_SIZE bytes) "PUFFLIP\0", u32 version, u32 header size,
+   * u32 words, u32 rows, challenge (CHALLENGE_SIZE bytes), u64 start time at 64; then per row u32 bank << 14 | row
+   * and u32 index of its first word; then the u32 key (see flipKey) of every word and finally its u8 count.
+   */
+  class FlipIndex {
+  private:
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    const uint32_t* rowTable = nullptr;
+    FlipView words;
+
+    // Index of the first word of the first row at or after rowKey (bank << 14 | row)
+    [[nodiscard]] size_t lowerRow(uint32_t rowKey) const;
+
+  public:
+    Challenge challenge;
+    int64_t startTime = 0;
+    uint32_t rows = 0;
+
+    explicit FlipIndex(const std::string& path);
+
+    ~FlipIndex();
+
+    FlipIndex(const FlipIndex&) = delete;
+
+    FlipIndex& operator=(const FlipIndex&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return map != nullptr;
+    }
+
+    [[nodiscard]] const FlipView& all() const {
+      return words;
+    }
+
+    // Weak words of bank in rows firstRow to lastRow (inclusive)
+    [[nodiscard]] FlipView range(uint32_t bank, uint32_t firstRow, uint32_t lastRow) const;
+
+    // Flipped bits of a word, 0 if it is not weak
+    [[nodiscard]] uint32_t count(const Cell& cell) const;
+  };
+}
@@ -0,0 +1,132 @@
+#include <args.hxx>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dump_file.h"
+#include "flips.h"
+
+using namespace SerialReader;
+
+static void print(const FlipView& view) {
+  for (size_t i = 0; i < view.size; i++) {
+    const Cell cell = flipCell(view.keys[i]);
+    std::cout << cell.bank << '\t' << cell.row << '\t' << cell.col << '\t' << static_cast<int>(view.counts[i])
+      << std::endl;
+  }
+}
+
+// Indexes the weak words of summaries (mode 1) and combines the indexes of several runs
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Builds sparse indexes of the weak words a summary (mode 1) reports and combines them across runs.",
+    "Commands: build INDEX SUMMARY... (all summaries into one index), info INDEX, range INDEX (words by bank and "
+    "rows), intersect|union|diff INDEX A B... (words weak in every run, in any run, or in A but in none of the "
+    "others)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "build, info, range, intersect, union or diff");
+  args::Positional<std::string> indexA(argsParser, "index", "Flip index");
+  args::PositionalList<std::string> filesA(argsParser, "files", "Summaries or flip indexes");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params", "build: params the raw summaries were measured with",
+                                           {'p', "params"});
+  args::ValueFlag<uint32_t> bankA(argsParser, "bank", "range: bank", {"bank"}, 0);
+  args::ValueFlag<uint32_t> firstRowA(argsParser, "row", "range: first row", {"first-row"}, 0);
+  args::ValueFlag<uint32_t> lastRowA(argsParser, "row", "range: last row", {"last-row"},
+                                     std::numeric_limits<uint32_t>::max());
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  const std::string& path = args::get(indexA);
+  const std::vector<std::string>& files = args::get(filesA);
+
+  if (command == "build" && !files.empty()) {
+    FlipSet set;
+    SummaryParser summary(set);
+    Challenge challenge;
+    int64_t startTime = 0;
+    for (const auto& file : files) {
+      const DumpReader dump(file);
+      if (!dump.isOpen()) {
+        std::cerr << "Could not read " << file << std::endl;
+        return 1;
+      }
+      if (file == files.front()) {
+        challenge = dump.described || args::get(paramsA).empty() ? dump.info.challenge
+                                                                 : Challenge::fromParams(args::get(paramsA));
+        startTime = dump.info.startTime;
+      }
+      // A raw summary starts with a weak word that DumpReader took for the frame of a dump
+      if (!dump.described) summary.feed(dump.info.frame.data(), dump.info.frame.size());
+      summary.feed(reinterpret_cast<const char*>(dump.payload), dump.size);
+      summary.finish();
+    }
+    set.sort();
+    if (!set.write(path, challenge, startTime)) {
+      std::cerr << "Could not write " << path << std::endl;
+      return 1;
+    }
+    std::cout << set.keys.size() << " weak words";
+    if (summary.getMalformed() > 0) std::cout << ", skipped " << summary.getMalformed() << " malformed";
+    std::cout << std::endl;
+    return 0;
+  }
+
+  if (command == "intersect" || command == "union" || command == "diff") {
+    if (files.size() < 2) {
+      std::cerr << argsParser;
+      return 1;
+    }
+    std::vector<std::unique_ptr<FlipIndex>> runs;
+    for (const auto& file : files) {
+      runs.push_back(std::make_unique<FlipIndex>(file));
+      if (!runs.back()->isOpen()) {
+        std::cerr << "Could not read " << file << std::endl;
+        return 1;
+      }
+    }
+    FlipSet set;
+    FlipView acc = runs[0]->all();
+    for (size_t i = 1; i < runs.size(); i++) {
+      const FlipView& next = runs[i]->all();
+      set = command == "intersect" ? intersect(acc, next) : command == "union" ? unite(acc, next)
+                                                                               : subtract(acc, next);
+      acc = set.view();
+    }
+    if (!set.write(path, runs[0]->challenge, runs[0]->startTime)) {
+      std::cerr << "Could not write " << path << std::endl;
+      return 1;
+    }
+    std::cout << set.keys.size() << " weak words" << std::endl;
+    return 0;
+  }
+
+  const FlipIndex index(path);
+  if (!index.isOpen()) {
+    std::cerr << "Could not read " << path << std::endl;
+    return 1;
+  }
+  if (command == "info") {
+    std::cout << index.all().size << " weak words in " << index.rows << " rows" << std::endl;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < index.all().size; i++) bits += index.all().counts[i];
+    std::cout << bits << " flipped bits" << std::endl;
+    return 0;
+  }
+  if (command == "range") {
+    print(index.range(args::get(bankA), args::get(firstRowA), args::get(lastRowA)));
+    return 0;
+  }
+  std::cerr << argsParser;
+  return 1;
+}
@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <linux/serial.h>
 #include <sys/ioctl.h>
 #include "gpio_utils.h"
 
@@ -153,3 +154,18 @@ void SerialReader::serialPuts(const int fd, const char* s) {
 void SerialReader::serialFlush(const int fd) {
   tcflush(fd, TCIOFLUSH);
 }
+
+bool SerialReader::serialLowLatency(const int fd) {
+  serial_struct serial{};
+  if (ioctl(fd, TIOCGSERIAL, &serial) == -1)
+    return false;
+  serial.flags |= ASYNC_LOW_LATENCY;
+  return ioctl(fd, TIOCSSERIAL, &serial) != -1;
+}
+
+long long SerialReader::serialOverruns(const int fd) {
+  serial_icounter_struct counters{};
+  if (ioctl(fd, TIOCGICOUNT, &counters) == -1)
+    return -1;
+  return static_cast<long long>(counters.overrun) + counters.buf_overrun;
+}
@@ -6,4 +6,10 @@ namespace SerialReader {
   void serialPuts(int fd, const char* s);
 
   void serialFlush(int fd);
+
+  // Asks the tty driver to push received bytes to readers immediately, returns false if unsupported
+  bool serialLowLatency(int fd);
+
+  // Sum of the hardware and tty buffer overruns since the port was opened, -1 if the driver does not count them
+  long long serialOverruns(int fd);
 }
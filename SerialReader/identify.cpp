@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include "bit_kernels.h"
+#include "crp.h"
+#include "identify.h"
+
+SerialReader::IdentifyIndex::IdentifyIndex(const uint32_t _bits, const uint32_t _width)
+  : bits(_bits), width(std::clamp<uint32_t>(_width / 8 * 8, 8, 32)), words((_bits + 63) / 64) {
+  tables.resize(((bits + 7) / 8 * 8 + width - 1) / width);
+}
+
+uint32_t SerialReader::IdentifyIndex::substring(const unsigned char* response, const size_t index) const {
+  const size_t first = index * width / 8;
+  const size_t last = std::min<size_t>(first + width / 8, (bits + 7) / 8);
+  uint32_t ret = 0;
+  for (size_t i = first; i < last; i++) ret = ret << 8 | response[i];
+  return ret;
+}
+
+uint32_t SerialReader::IdentifyIndex::substringBits(const size_t index) const {
+  const size_t bytes = (bits + 7) / 8;
+  const size_t first = index * width / 8;
+  const size_t length = std::min<size_t>(width / 8, bytes - first) * 8;
+  uint32_t ret = length == 32 ? ~0U : (1U << length) - 1;
+  if (first * 8 + length == bytes * 8 && bits % 8 != 0) ret &= ~((1U << (8 - bits % 8)) - 1);
+  return ret;
+}
+
+uint32_t SerialReader::IdentifyIndex::add(const unsigned char* response, const unsigned char* mask) {
+  const auto id = static_cast<uint32_t>(size());
+  responses.resize(responses.size() + words);
+  masks.resize(masks.size() + words);
+  uint64_t* r = responses.data() + responses.size() - words;
+  uint64_t* m = masks.data() + masks.size() - words;
+  toWords(response, bits, r);
+  if (mask != nullptr) {
+    toWords(mask, bits, m);
+  } else {
+    const std::vector<unsigned char> all((bits + 7) / 8, 0xFF);
+    toWords(all.data(), bits, m);
+  }
+  weights.push_back(bitKernels().popcount(m, words));
+  size_t unexpanded = 0;
+  for (size_t t = 0; t < tables.size(); t++) {
+    const uint32_t valid = substringBits(t);
+    const uint32_t value = substring(reinterpret_cast<const unsigned char*>(r), t) & valid;
+    uint32_t unreliable = ~substring(reinterpret_cast<const unsigned char*>(m), t) & valid;
+    // The lowest unreliable bits are expanded, any others stay as measured
+    uint32_t expanded = 0;
+    for (int k = 0; k < IDENTIFY_MAX_EXPANSION && unreliable != 0; k++) {
+      expanded |= unreliable & -unreliable;
+      unreliable &= unreliable - 1;
+    }
+    unexpanded += std::popcount(unreliable);
+    // Every subset of the expanded bits, the empty one last
+    uint32_t subset = expanded;
+    do {
+      tables[t][(value & ~expanded) | subset].push_back(id);
+      subset = (subset - 1) & expanded;
+    } while (subset != expanded);
+  }
+  if (excess.size() <= unexpanded) excess.resize(unexpanded + 1);
+  excess[unexpanded].push_back(id);
+  return id;
+}
+
+// Calls f with every value that differs from v in at most radius of the lowest width bits, v itself first
+template<typename F>
+static void neighbours(const uint32_t v, const uint32_t width, const uint32_t radius, const uint32_t from, F&& f) {
+  f(v);
+  if (radius == 0) return;
+  for (uint32_t b = from; b < width; b++) neighbours(v ^ 1U << b, width, radius - 1, b + 1, f);
+}
+
+SerialReader::IdentifyMatch SerialReader::IdentifyIndex::nearest(const unsigned char* response,
+                                                                 const double maxDistance) const {
+  IdentifyMatch ret;
+  if (size() == 0) return ret;
+  std::vector<uint64_t> query(words);
+  toWords(response, bits, query.data());
+
+  std::vector<uint32_t> candidates;
+  const auto errors = static_cast<uint32_t>(std::max(0.0, maxDistance) * bits);
+  const uint32_t radius = errors / static_cast<uint32_t>(tables.size());
+  const size_t probes = tables.size() * (radius == 0 ? 1 : 1 + width);
+  if (radius > IDENTIFY_MAX_RADIUS || probes > size()) {
+    candidates.resize(size());
+    for (uint32_t id = 0; id < size(); id++) candidates[id] = id;
+  } else {
+    std::vector<bool> seen(size());
+    const auto take = [&](const std::vector<uint32_t>& ids) {
+      for (const uint32_t id : ids) {
+        if (seen[id]) continue;
+        seen[id] = true;
+        candidates.push_back(id);
+      }
+    };
+    const auto* bytes = reinterpret_cast<const unsigned char*>(query.data());
+    for (size_t t = 0; t < tables.size(); t++) {
+      const auto& table = tables[t];
+      // The last substring may be shorter
+      const uint32_t w = std::min<uint32_t>(width, ((bits + 7) / 8 - t * width / 8) * 8);
+      neighbours(substring(bytes, t), w, radius, 0, [&](const uint32_t v) {
+        if (const auto it = table.find(v); it != table.end()) take(it->second);
+      });
+    }
+    // An entry with excess x is found by the probes if errors + x < (radius + 1) * m, the others are compared anyway
+    const size_t covered = (radius + 1) * tables.size() - 1 - errors;
+    for (size_t x = covered + 1; x < excess.size(); x++) take(excess[x]);
+  }
+
+  ret.candidates = candidates.size();
+  for (const uint32_t id : candidates) {
+    const uint64_t d = maskedDistance(query.data(), responses.data() + id * words, masks.data() + id * words, words);
+    const double distance = weights[id] != 0 ? static_cast<double>(d) / static_cast<double>(weights[id]) : 1;
+    if (distance <= maxDistance && (!ret.found || distance < ret.distance)) {
+      ret.found = true;
+      ret.id = id;
+      ret.distance = distance;
+    }
+  }
+  explicit_bzero(query.data(), query.size() * sizeof(uint64_t));
+  return ret;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// Bits per substring, a multiple of 8 up to 32
+#define IDENTIFY_WIDTH 16
+// Substrings are probed up to this many flipped bits, beyond that a lookup compares with every entry instead
+#define IDENTIFY_MAX_RADIUS 1
+// An entry is hashed under every value of up to this many unreliable bits of a substring
+#define IDENTIFY_MAX_EXPANSION 4
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace SerialReader {
+  struct IdentifyMatch {
+    bool found = false;
+    uint32_t id = 0;
+    // Masked fractional Hamming distance of the entry
+    double distance = 1;
+    // Entries whose distance was computed, i.e. how much of the fleet the lookup did not skip
+    size_t candidates = 0;
+  };
+
+  /*
+   * Multi-index hash over responses of the same length, to find the nearest one without comparing with all of
+   * them. A response is split into m substrings of width bits, each with its own hash table. Entries are only
+   * compared on their reliable bits, so an entry is hashed under every value its unreliable bits in a substring can
+   * take, for up to IDENTIFY_MAX_EXPANSION of them; its further unreliable bits (its excess) are hashed as
+   * measured. If the reliable bits of an entry differ from a query in at most r bits, the hashed bits of one
+   * substring differ in at most (r + excess) / m of them, so probing every substring within r / m finds every entry
+   * whose excess keeps that the same, and the few others are compared anyway. If that takes more probes than
+   * there are entries, or r / m is above IDENTIFY_MAX_RADIUS, every entry is compared instead.
+   */
+  class IdentifyIndex {
+  private:
+    const uint32_t bits;
+    const uint32_t width;
+    const size_t words;
+    std::vector<std::unordered_map<uint32_t, std::vector<uint32_t>>> tables;
+    // Entries by their excess, the unreliable bits that were not expanded
+    std::vector<std::vector<uint32_t>> excess;
+    std::vector<uint64_t> responses;
+    std::vector<uint64_t> masks;
+    std::vector<uint64_t> weights;
+
+    [[nodiscard]] uint32_t substring(const unsigned char* response, size_t index) const;
+
+    // The bits of a substring that are part of a response, the last one may be shorter or end in padding
+    [[nodiscard]] uint32_t substringBits(size_t index) const;
+
+  public:
+    explicit IdentifyIndex(uint32_t _bits, uint32_t _width = IDENTIFY_WIDTH);
+
+    // Adds a response packed MSB first, mask (nullptr for all bits) marks the reliable bits; returns its id
+    uint32_t add(const unsigned char* response, const unsigned char* mask);
+
+    /*
+     * The entry with the smallest masked fractional distance, if it is at most maxDistance. Every entry whose
+     * reliable bits differ from response in at most maxDistance * bits bits is considered, which includes every
+     * entry within maxDistance.
+     */
+    [[nodiscard]] IdentifyMatch nearest(const unsigned char* response, double maxDistance) const;
+
+    [[nodiscard]] size_t size() const {
+      return weights.size();
+    }
+
+    [[nodiscard]] uint32_t getBits() const {
+      return bits;
+    }
+  };
+}
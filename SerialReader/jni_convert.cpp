@@ -0,0 +1,40 @@
+#include "jni_convert.h"
+
+std::string SerialReader::toString(JNIEnv* env, jstring str) {
+  const char* chars = env->GetStringUTFChars(str, nullptr);
+  std::string ret(chars);
+  env->ReleaseStringUTFChars(str, chars);
+  return ret;
+}
+
+std::vector<std::string> SerialReader::toStrings(JNIEnv* env, jobjectArray array, const jint size) {
+  std::vector<std::string> ret;
+  ret.reserve(size);
+  for (int i = 0; i < size; ++i) {
+    const auto str = reinterpret_cast<jstring>(env->GetObjectArrayElement(array, i));
+    ret.push_back(toString(env, str));
+    // Local references only go away when the native method returns, callers may convert in a loop
+    env->DeleteLocalRef(str);
+  }
+  return ret;
+}
+
+std::vector<unsigned char> SerialReader::toBytes(JNIEnv* env, jbyteArray array, const jint bits) {
+  std::vector<unsigned char> ret;
+  if (array == nullptr || bits <= 0) return ret;
+  const jsize size = (bits + 7) / 8;
+  if (env->GetArrayLength(array) < size) return ret;
+  ret.resize(size);
+  env->GetByteArrayRegion(array, 0, size, reinterpret_cast<jbyte*>(ret.data()));
+  return ret;
+}
+
+jobjectArray SerialReader::toJavaStrings(JNIEnv* env, const char* const* strings, const jsize count) {
+  jobjectArray ret = env->NewObjectArray(count, env->FindClass("java/lang/String"), nullptr);
+  for (jsize i = 0; i < count; ++i) {
+    jstring str = env->NewStringUTF(strings[i]);
+    env->SetObjectArrayElement(ret, i, str);
+    env->DeleteLocalRef(str);
+  }
+  return ret;
+}
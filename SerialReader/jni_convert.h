@@ -0,0 +1,20 @@
+#pragma once
+
+#include <jni.h>
+#include <string>
+#include <vector>
+
+namespace SerialReader {
+  // Conversions between Java and C++ values of the JNI functions in drampufjni.cpp
+
+  [[nodiscard]] std::string toString(JNIEnv* env, jstring str);
+
+  // The first size strings of array
+  [[nodiscard]] std::vector<std::string> toStrings(JNIEnv* env, jobjectArray array, jint size);
+
+  // The bytes that hold bits bits of array, empty if it is null or too short
+  [[nodiscard]] std::vector<unsigned char> toBytes(JNIEnv* env, jbyteArray array, jint bits);
+
+  // A String[] of count strings, e.g. keys
+  [[nodiscard]] jobjectArray toJavaStrings(JNIEnv* env, const char* const* strings, jsize count);
+}
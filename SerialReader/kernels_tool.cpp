@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <args.hxx>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "bit_kernels.h"
+
+using namespace SerialReader;
+
+// Random words at an odd byte offset, so that the kernels see unaligned pointers as they get from payloads
+struct Buffer {
+  std::vector<unsigned char> bytes;
+  size_t words;
+  size_t offset;
+
+  Buffer(std::mt19937_64& random, const size_t _words, const size_t shift)
+    : bytes(_words * 8 + 8), words(_words), offset(shift % 8) {
+    for (auto& b : bytes) b = static_cast<unsigned char>(random());
+  }
+
+  uint64_t* data() {
+    return reinterpret_cast<uint64_t*>(bytes.data() + offset);
+  }
+
+  // Sparse words, like the flips of a dump or the carries of a fold
+  void thin(std::mt19937_64& random) {
+    for (size_t i = 0; i < words; i++) {
+      uint64_t w;
+      std::memcpy(&w, data() + i, 8);
+      w &= random() & random();
+      std::memcpy(data() + i, &w, 8);
+    }
+  }
+};
+
+static std::string words(const uint64_t* p, const size_t n) {
+  return {reinterpret_cast<const char*>(p), n * 8};
+}
+
+// Compares every kernel set with the scalar one on random inputs of many lengths and alignments
+static int check(const size_t rounds) {
+  const auto& sets = availableKernels();
+  const BitKernels& scalar = *sets.front();
+  std::mt19937_64 random(1);
+  size_t failures = 0;
+  const auto fail = [&](const BitKernels& set, const char* kernel, const size_t n) {
+    if (failures++ < 20) std::cerr << set.name << ' ' << kernel << " differs for " << n << " words" << std::endl;
+  };
+  for (size_t round = 0; round < rounds; round++) {
+    const size_t n = round < 80 ? round : random() % 2000;
+    Buffer a(random, n, random());
+    Buffer b(random, n, random());
+    Buffer mask(random, n, random());
+    const auto count = static_cast<uint32_t>(1 + random() % 32);
+    std::vector<Buffer> planes;
+    for (uint32_t k = 0; k < count; k++) planes.emplace_back(random, n, random());
+    // Mostly low counters, so that increments both carry and saturate
+    for (uint32_t k = 1; k < count; k++) planes[k].thin(random);
+    Buffer carry(random, n, random());
+    const auto threshold = static_cast<uint32_t>(random() % (count < 32 ? 1ULL << count : 1ULL << 32));
+    const size_t inputs = random() % 70;
+    std::vector<Buffer> runs;
+    std::vector<const uint64_t*> runPointers;
+    for (size_t j = 0; j < inputs; j++) runs.emplace_back(random, n, random());
+    for (auto& run : runs) runPointers.push_back(run.data());
+    std::vector<unsigned char> payload(n * 8 + 1);
+    for (auto& byte : payload) byte = random() % 3 == 0 ? 0 : static_cast<unsigned char>(random());
+    const uint64_t runBit = 1ULL << random() % 64;
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> masks;
+    std::vector<uint64_t> batchMasks;
+    for (size_t i = 0; i < n / 8 * 8; i++) {
+      offsets.push_back(random() % payload.size());
+      masks.push_back(static_cast<uint8_t>(0x80 >> random() % 8));
+      if (i % 8 == 0) batchMasks.push_back(0);
+      batchMasks.back() |= static_cast<uint64_t>(masks.back()) << 8 * (7 - i % 8);
+    }
+
+    std::vector<uint64_t> expected(n + 1);
+    std::vector<uint64_t> actual(n + 1);
+    std::vector<uint64_t> spreadExpected(n * 64 + 1);
+    std::vector<unsigned char> gatherExpected(n + 1);
+    scalar.bitXor(expected.data(), a.data(), b.data(), n);
+    scalar.spread(payload.data(), n * 8, spreadExpected.data(), runBit);
+    scalar.gather(payload.data(), offsets.data(), masks.data(), batchMasks.data(), n / 8, gatherExpected.data());
+    std::vector<uint64_t> atMostExpected(n + 1);
+    std::vector<const uint64_t*> planePointers;
+    for (auto& plane : planes) planePointers.push_back(plane.data());
+    scalar.atMost(planePointers.data(), count, threshold, atMostExpected.data(), n);
+    std::vector<uint64_t> majorityExpected(n + 1);
+    scalar.majority(runPointers.data(), inputs, majorityExpected.data(), n);
+    std::vector<std::string> incremented;
+    {
+      std::vector<Buffer> copy = planes;
+      std::vector<uint64_t*> pointers;
+      for (auto& plane : copy) pointers.push_back(plane.data());
+      scalar.increment(pointers.data(), count, carry.data(), n);
+      for (auto& plane : copy) incremented.push_back(words(plane.data(), n));
+    }
+
+    for (const BitKernels* set : sets) {
+      if (set->popcount(a.data(), n) != scalar.popcount(a.data(), n)) fail(*set, "popcount", n);
+      if (set->distance(a.data(), b.data(), n) != scalar.distance(a.data(), b.data(), n)) fail(*set, "distance", n);
+      if (set->maskedDistance(a.data(), b.data(), mask.data(), n) !=
+          scalar.maskedDistance(a.data(), b.data(), mask.data(), n)) {
+        fail(*set, "maskedDistance", n);
+      }
+      set->bitXor(actual.data(), a.data(), b.data(), n);
+      if (words(actual.data(), n) != words(expected.data(), n)) fail(*set, "bitXor", n);
+      Buffer inPlace = a;
+      set->bitXor(inPlace.data(), inPlace.data(), b.data(), n);
+      if (words(inPlace.data(), n) != words(expected.data(), n)) fail(*set, "bitXor in place", n);
+
+      std::vector<Buffer> copy = planes;
+      std::vector<uint64_t*> pointers;
+      for (auto& plane : copy) pointers.push_back(plane.data());
+      set->increment(pointers.data(), count, carry.data(), n);
+      for (uint32_t k = 0; k < count; k++) {
+        if (words(copy[k].data(), n) != incremented[k]) {
+          fail(*set, "increment", n);
+          break;
+        }
+      }
+      set->atMost(planePointers.data(), count, threshold, actual.data(), n);
+      if (words(actual.data(), n) != words(atMostExpected.data(), n)) fail(*set, "atMost", n);
+      set->majority(runPointers.data(), inputs, actual.data(), n);
+      if (words(actual.data(), n) != words(majorityExpected.data(), n)) fail(*set, "majority", n);
+
+      std::vector<uint64_t> spread(n * 64 + 1);
+      set->spread(payload.data(), n * 8, spread.data(), runBit);
+      if (spread != spreadExpected) fail(*set, "spread", n);
+      std::vector<unsigned char> gathered(n + 1);
+      set->gather(payload.data(), offsets.data(), masks.data(), batchMasks.data(), n / 8, gathered.data());
+      if (gathered != gatherExpected) fail(*set, "gather", n);
+    }
+  }
+  std::cout << "Checked";
+  for (const BitKernels* set : sets) std::cout << ' ' << set->name << " (gather " << set->gatherName << ')';
+  std::cout << " in " << rounds << " rounds: " << (failures == 0 ? "all equal" : std::to_string(failures) + " failures")
+    << std::endl;
+  return failures == 0 ? 0 : 1;
+}
+
+// Throughput of every kernel in every set over n words, in GB/s of input
+static void bench(const size_t n) {
+  std::mt19937_64 random(2);
+  Buffer a(random, n, 0);
+  Buffer b(random, n, 0);
+  Buffer mask(random, n, 0);
+  std::vector<uint64_t> out(n);
+  constexpr uint32_t planeCount = 4;
+  std::vector<Buffer> planes;
+  for (uint32_t k = 0; k < planeCount; k++) planes.emplace_back(random, n, 0);
+  for (auto& plane : planes) plane.thin(random);
+  std::vector<uint64_t*> planePointers;
+  for (auto& plane : planes) planePointers.push_back(plane.data());
+  Buffer carry(random, n, 0);
+  carry.thin(random);
+  std::vector<Buffer> runs;
+  for (int j = 0; j < 15; j++) runs.emplace_back(random, n / 8 + 1, 0);
+  std::vector<const uint64_t*> runPointers;
+  for (auto& run : runs) runPointers.push_back(run.data());
+  std::vector<unsigned char> payload(n);
+  for (auto& byte : payload) byte = random() % 4 == 0 ? static_cast<unsigned char>(random()) : 0;
+  std::vector<uint64_t> transposed(n * 8);
+  std::vector<uint64_t> offsets;
+  std::vector<uint8_t> masks;
+  std::vector<uint64_t> batchMasks;
+  for (size_t i = 0; i < n / 8 * 8; i++) {
+    offsets.push_back(i);
+    masks.push_back(static_cast<uint8_t>(0x80 >> random() % 8));
+    if (i % 8 == 0) batchMasks.push_back(0);
+    batchMasks.back() |= static_cast<uint64_t>(masks.back()) << 8 * (7 - i % 8);
+  }
+  std::vector<unsigned char> gathered(n / 8 + 1);
+  volatile uint64_t sink = 0;
+
+  // Kernel, bytes of input per call, call
+  const std::vector<std::tuple<const char*, double, std::function<void(const BitKernels&)>>> kernels = {
+    {"popcount", n * 8.0, [&](const BitKernels& k) { sink = sink + k.popcount(a.data(), n); }},
+    {"distance", n * 16.0, [&](const BitKernels& k) { sink = sink + k.distance(a.data(), b.data(), n); }},
+    {"maskedDistance", n * 24.0,
+     [&](const BitKernels& k) { sink = sink + k.maskedDistance(a.data(), b.data(), mask.data(), n); }},
+    {"bitXor", n * 16.0, [&](const BitKernels& k) { k.bitXor(out.data(), a.data(), b.data(), n); }},
+    {"increment", n * 8.0 * (planeCount + 1),
+     [&](const BitKernels& k) { k.increment(planePointers.data(), planeCount, carry.data(), n); }},
+    {"atMost", n * 8.0 * planeCount, [&](const BitKernels& k) {
+      k.atMost(planePointers.data(), planeCount, 3, out.data(), n);
+    }},
+    {"majority", (n / 8 + 1) * 8.0 * runPointers.size(), [&](const BitKernels& k) {
+      k.majority(runPointers.data(), runPointers.size(), out.data(), n / 8 + 1);
+    }},
+    {"spread", static_cast<double>(n), [&](const BitKernels& k) { k.spread(payload.data(), n, transposed.data(), 1); }},
+    {"gather", n / 8 * 8.0, [&](const BitKernels& k) {
+      k.gather(payload.data(), offsets.data(), masks.data(), batchMasks.data(), n / 8, gathered.data());
+    }},
+  };
+  std::printf("%-16s", "GB/s");
+  for (const BitKernels* set : availableKernels()) std::printf("%10s", set->name);
+  std::printf("\n");
+  for (const auto& [name, bytes, call] : kernels) {
+    std::printf("%-16s", name);
+    for (const BitKernels* set : availableKernels()) {
+      // Repeats the call for at least 100 ms after a warm-up
+      call(*set);
+      size_t calls = 0;
+      const auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed{};
+      do {
+        call(*set);
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed.count() < 0.1);
+      std::printf("%10.2f", bytes * static_cast<double>(calls) / elapsed.count() / 1e9);
+    }
+    std::printf("\n");
+  }
+  std::cout << "Picked: " << bitKernels().name << " (gather " << bitKernels().gatherName << ')' << std::endl;
+}
+
+// Checks that every kernel set this CPU runs computes the same, and measures how fast each one is
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Checks and benchmarks the bit kernels of every instruction set this CPU supports.",
+    "Commands: check (compares every kernel set with the scalar one, exits with 1 on a difference), bench. "
+    "Set " KERNELS_ENV " to a kernel set name to make the tools use it instead of the fastest one.");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "check or bench");
+  args::ValueFlag<size_t> roundsA(argsParser, "rounds", "check: random inputs to compare on", {'r', "rounds"}, 500);
+  args::ValueFlag<size_t> wordsA(argsParser, "words", "bench: input size in 64 bit words", {'n', "words"}, 1 << 16);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  if (command == "check") return check(args::get(roundsA));
+  if (command == "bench") {
+    bench(std::max<size_t>(args::get(wordsA), 8));
+    return 0;
+  }
+  std::cerr << argsParser;
+  return 1;
+}
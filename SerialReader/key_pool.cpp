@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include "catalog.h"
+#include "dump_sink.h"
+#include "key_pool.h"
+#include "keygen.h"
+#include "runner.h"
+
+static std::mutex poolMutex;
+static std::shared_ptr<SerialReader::KeyPool> pool;
+
+SerialReader::SecureBuffer::SecureBuffer(const size_t _capacity) {
+  if (_capacity == 0) return;
+  void* m = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) return;
+  data = static_cast<unsigned char*>(m);
+  capacity = _capacity;
+  // A response must never end up in swap or in a core dump
+  locked = mlock(data, capacity) == 0;
+  madvise(data, capacity, MADV_DONTDUMP);
+}
+
+SerialReader::SecureBuffer::~SecureBuffer() {
+  if (data == nullptr) return;
+  explicit_bzero(data, capacity);
+  if (locked) munlock(data, capacity);
+  munmap(data, capacity);
+}
+
+void SerialReader::SecureBuffer::append(const char* src, const size_t count) {
+  const size_t n = count < capacity - size ? count : capacity - size;
+  std::memcpy(data + size, src, n);
+  size += n;
+}
+
+namespace {
+  // Collects one dump into locked memory
+  class PoolSink : public SerialReader::DumpSink {
+  public:
+    std::unique_ptr<SerialReader::SecureBuffer> response;
+    bool complete = false;
+
+    void begin(const SerialReader::DumpInfo& info) override {
+      complete = false;
+      response.reset();
+      // Only dumps announce their size, summaries cannot be locked up front
+      if (info.payloadSize == 0) return;
+      response = std::make_unique<SerialReader::SecureBuffer>(info.frame.size() + info.payloadSize);
+      if (!response->isLocked()) {
+        std::cerr << "Could not lock " << info.frame.size() + info.payloadSize
+          << " bytes for the key pool, raise RLIMIT_MEMLOCK" << std::endl;
+        response.reset();
+        return;
+      }
+      response->append(info.frame.data(), info.frame.size());
+    }
+
+    void write(const char* data, const size_t size) override {
+      if (response) response->append(data, size);
+    }
+
+    void end(const bool ok) override {
+      complete = ok && response != nullptr;
+      if (!ok) response.reset();
+    }
+  };
+}
+
+SerialReader::KeyPool::KeyPool(const Parser& _board, PoolPolicy _policy)
+  : board(_board), policy(std::move(_policy)) {
+  thread = std::thread([this] { refill(); });
+}
+
+SerialReader::KeyPool::~KeyPool() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+    if (current != nullptr) current->cancel();
+    changed.notify_all();
+  }
+  thread.join();
+}
+
+void SerialReader::KeyPool::addChallenge(const std::vector<std::string>& params) {
+  std::lock_guard lock(mutex);
+  for (const auto& slot : slots) {
+    if (slot.parser.getParams() == params) return;
+  }
+  slots.push_back({Parser(board, params), {}});
+  changed.notify_all();
+}
+
+double SerialReader::KeyPool::temperature() const {
+  return readTemperature(policy.sensor);
+}
+
+bool SerialReader::KeyPool::usable(const Entry& entry, const double now) const {
+  if (std::chrono::steady_clock::now() - entry.measured >= policy.maxAge) return false;
+  if (policy.maxTemperatureDelta <= 0) return true;
+  // Without a reading on either side there is nothing to compare, so the response is kept
+  return std::isnan(now) || std::isnan(entry.temperature) ||
+         std::fabs(now - entry.temperature) <= policy.maxTemperatureDelta;
+}
+
+std::chrono::steady_clock::time_point SerialReader::KeyPool::purge() {
+  const double now = temperature();
+  auto next = std::chrono::steady_clock::time_point::max();
+  for (auto& slot : slots) {
+    for (auto it = slot.entries.begin(); it != slot.entries.end();) {
+      if (usable(*it, now)) {
+        next = std::min(next, it->measured + policy.maxAge);
+        ++it;
+      } else {
+        it = slot.entries.erase(it);
+      }
+    }
+  }
+  return next;
+}
+
+std::unique_ptr<SerialReader::KeyPool::Entry> SerialReader::KeyPool::measure(Parser& parser) {
+  // Wait for the board like a key request would, but give up as soon as the pool is stopped
+  std::unique_lock lock(boardMutex(), std::defer_lock);
+  while (!lock.try_lock_for(std::chrono::milliseconds(100))) {
+    std::lock_guard guard(mutex);
+    if (stopping) return nullptr;
+  }
+  try {
+    Runner runner(parser);
+    {
+      std::lock_guard guard(mutex);
+      if (stopping) return nullptr;
+      current = &runner;
+    }
+    PoolSink sink;
+    const bool measured = run(runner, parser, sink);
+    {
+      std::lock_guard guard(mutex);
+      current = nullptr;
+    }
+    runner.release();
+    if (!measured || !sink.complete) return nullptr;
+    return std::make_unique<Entry>(Entry{std::move(sink.response), std::chrono::steady_clock::now(), temperature()});
+  } catch (const std::exception& e) {
+    // The serial port or the GPIO chip could not be opened; refill() tries again after POOL_RETRY_DELAY
+    std::cerr << "Key pool: " << e.what() << std::endl;
+    std::lock_guard guard(mutex);
+    current = nullptr;
+    return nullptr;
+  }
+}
+
+void SerialReader::KeyPool::refill() {
+  std::unique_lock lock(mutex);
+  int failures = 0;
+  while (!stopping) {
+    const auto expiry = purge();
+    Slot* next = nullptr;
+    for (auto& slot : slots) {
+      if (slot.entries.size() < policy.capacity && (next == nullptr || slot.entries.size() < next->entries.size())) {
+        next = &slot;
+      }
+    }
+    if (next == nullptr) {
+      // Full, sleep until something is taken, added or expires
+      changed.wait_until(lock, std::min(expiry, std::chrono::steady_clock::now() + policy.maxAge));
+      continue;
+    }
+    Parser parser = next->parser;
+    lock.unlock();
+    auto entry = measure(parser);
+    lock.lock();
+    if (entry) {
+      // Slots are never removed, so next is still valid
+      next->entries.push_back(std::move(*entry));
+      failures = 0;
+    } else if (!stopping) {
+      const auto delay = std::chrono::seconds(POOL_RETRY_DELAY) * (1 << std::min(failures++, POOL_MAX_BACKOFF));
+      changed.wait_for(lock, delay, [this] { return stopping; });
+    }
+  }
+  slots.clear();
+}
+
+bool SerialReader::KeyPool::take(const std::vector<std::string>& params, const std::string& posFile,
+                                 const int keySize, std::string& key) {
+  std::lock_guard lock(mutex);
+  const double now = temperature();
+  for (auto& slot : slots) {
+    if (slot.parser.getParams() != params) continue;
+    while (!slot.entries.empty()) {
+      // Erasing the entry zeroizes the response, used or not
+      const Entry entry = std::move(slot.entries.front());
+      slot.entries.pop_front();
+      changed.notify_all();
+      if (usable(entry, now)) {
+        key = extractKey(entry.response->get(), entry.response->size, posFile, keySize);
+        return true;
+      }
+    }
+    return false;
+  }
+  return false;
+}
+
+size_t SerialReader::KeyPool::available(const std::vector<std::string>& params) const {
+  std::lock_guard lock(mutex);
+  const double now = temperature();
+  for (const auto& slot : slots) {
+    if (slot.parser.getParams() != params) continue;
+    size_t count = 0;
+    for (const auto& entry : slot.entries) {
+      if (usable(entry, now)) count++;
+    }
+    return count;
+  }
+  return 0;
+}
+
+void SerialReader::setKeyPool(std::shared_ptr<KeyPool> _pool) {
+  std::lock_guard lock(poolMutex);
+  pool = std::move(_pool);
+}
+
+std::shared_ptr<SerialReader::KeyPool> SerialReader::getKeyPool() {
+  std::lock_guard lock(poolMutex);
+  return pool;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#define POOL_SENSOR "/sys/class/thermal/thermal_zone0/temp"
+#define POOL_RETRY_DELAY 60
+// Failures in a row double the delay up to this many times
+#define POOL_MAX_BACKOFF 5
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parser.h"
+
+namespace SerialReader {
+  class Runner;
+
+  // Anonymous memory that is locked into RAM, excluded from core dumps and zeroized when freed
+  class SecureBuffer {
+  private:
+    unsigned char* data = nullptr;
+    size_t capacity = 0;
+    bool locked = false;
+
+  public:
+    size_t size = 0;
+
+    explicit SecureBuffer(size_t _capacity);
+
+    ~SecureBuffer();
+
+    SecureBuffer(const SecureBuffer&) = delete;
+
+    SecureBuffer& operator=(const SecureBuffer&) = delete;
+
+    // Whether the memory could be mapped and mlock'd
+    [[nodiscard]] bool isLocked() const {
+      return locked;
+    }
+
+    [[nodiscard]] const char* get() const {
+      return reinterpret_cast<const char*>(data);
+    }
+
+    // Copies as much as still fits
+    void append(const char* src, size_t count);
+  };
+
+  struct PoolPolicy {
+    // Responses kept per challenge
+    size_t capacity = 2;
+    // Responses older than this are zeroized and measured again
+    std::chrono::seconds maxAge{3600};
+    // Responses measured at a temperature this far from the current one are discarded (0 = ignore temperature)
+    double maxTemperatureDelta = 0;
+    // File with a temperature in millidegrees Celsius, e.g. of a sensor next to the sender
+    std::string sensor = POOL_SENSOR;
+  };
+
+  /*
+   * Keeps a few measured responses per challenge in locked memory, so a key can be extracted without waiting
+   * for the board. A background thread measures whatever challenge has the fewest responses left.
+   * Each response is used for one key only and zeroized afterwards.
+   */
+  class KeyPool {
+  private:
+    struct Entry {
+      std::unique_ptr<SecureBuffer> response;
+      std::chrono::steady_clock::time_point measured;
+      // Degrees Celsius at the time of the measurement, NaN if the sensor could not be read
+      double temperature;
+    };
+
+    struct Slot {
+      Parser parser;
+      std::list<Entry> entries;
+    };
+
+    const Parser board;
+    const PoolPolicy policy;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::list<Slot> slots;
+    bool stopping = false;
+    Runner* current = nullptr;
+    std::thread thread;
+
+    void refill();
+
+    std::unique_ptr<Entry> measure(Parser& parser);
+
+    // Drops all expired responses, returns when the next one expires
+    std::chrono::steady_clock::time_point purge();
+
+    [[nodiscard]] double temperature() const;
+
+    [[nodiscard]] bool usable(const Entry& entry, double now) const;
+
+  public:
+    // board gives the serial port, GPIO and timing settings, its params are ignored
+    KeyPool(const Parser& _board, PoolPolicy _policy);
+
+    // Stops refilling and zeroizes all responses
+    ~KeyPool();
+
+    KeyPool(const KeyPool&) = delete;
+
+    KeyPool& operator=(const KeyPool&) = delete;
+
+    // Starts keeping responses for the challenge given by params
+    void addChallenge(const std::vector<std::string>& params);
+
+    // Extracts a key from the oldest usable response for params, false if there is none
+    bool take(const std::vector<std::string>& params, const std::string& posFile, int keySize, std::string& key);
+
+    // Usable responses currently held for params
+    [[nodiscard]] size_t available(const std::vector<std::string>& params) const;
+  };
+
+  // gen_key and genKeyAsync are served from this pool first, nullptr disables it
+  void setKeyPool(std::shared_ptr<KeyPool> pool);
+
+  std::shared_ptr<KeyPool> getKeyPool();
+}
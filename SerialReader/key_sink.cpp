@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstring>
+#include "bit_gather.h"
+#include "key_sink.h"
+
+SerialReader::KeySink::KeySink(const std::vector<KeySpec>& specs) {
+  packed.resize(specs.size());
+  picked.resize(specs.size());
+  for (size_t k = 0; k < specs.size(); k++) {
+    const KeyPositions p = KeyPositions::load(specs[k].posFile, specs[k].keySize);
+    packed[k].resize((p.size() + 7) / 8);
+    for (size_t i = 0; i < p.size(); i++) {
+      positions.push_back({p.offsets[i], static_cast<uint32_t>(k), static_cast<uint32_t>(i), p.masks[i]});
+    }
+  }
+  // Every pos file is ascending already, so a stable sort keeps the bits of each key in order
+  std::stable_sort(positions.begin(), positions.end(), [](const Position& a, const Position& b) {
+    return a.offset < b.offset;
+  });
+}
+
+SerialReader::KeySink::~KeySink() {
+  clear();
+}
+
+void SerialReader::KeySink::clear() {
+  for (auto& key : packed) explicit_bzero(key.data(), key.size());
+  std::fill(picked.begin(), picked.end(), 0);
+  next = 0;
+  received = 0;
+  complete = false;
+}
+
+void SerialReader::KeySink::begin(const DumpInfo&) {
+  clear();
+}
+
+void SerialReader::KeySink::write(const char* data, const size_t size) {
+  const uint64_t end = received + size;
+  for (; next < positions.size() && positions[next].offset < end; next++) {
+    const Position& p = positions[next];
+    if (static_cast<unsigned char>(data[p.offset - received]) & p.mask) {
+      packed[p.key][p.bit / 8] |= static_cast<unsigned char>(0x80 >> p.bit % 8);
+    }
+    picked[p.key]++;
+  }
+  received = end;
+}
+
+void SerialReader::KeySink::end(const bool ok) {
+  if (!ok) {
+    clear();
+    return;
+  }
+  complete = true;
+}
+
+std::string SerialReader::KeySink::key(const size_t i) const {
+  if (!complete) return {};
+  std::string result(picked[i], '0');
+  for (size_t b = 0; b < picked[i]; b++) {
+    result[b] = static_cast<char>('0' + (packed[i][b / 8] >> (7 - b % 8) & 1));
+  }
+  return result;
+}
+
+std::vector<std::string> SerialReader::extractKeys(const char* payload, const size_t size,
+                                                   const std::vector<KeySpec>& specs) {
+  KeySink sink(specs);
+  sink.begin(DumpInfo());
+  sink.write(payload, size);
+  sink.end(true);
+  std::vector<std::string> keys;
+  keys.reserve(sink.keys());
+  for (size_t i = 0; i < sink.keys(); i++) keys.push_back(sink.key(i));
+  return keys;
+}
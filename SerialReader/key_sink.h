@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dump_sink.h"
+
+namespace SerialReader {
+  // A pos file and how many of its positions make up one key
+  struct KeySpec {
+    std::string posFile;
+    int keySize = 0;
+  };
+
+  /*
+   * Picks several keys out of a dump while it streams in, without keeping the payload. The positions of all pos
+   * files are merged into one ascending list, so every chunk is visited once no matter how many keys there are;
+   * a position used by several keys is listed once per key. Each pos file is read like KeyPositions::load reads
+   * it. A failed attempt discards what was picked, the keys are only there after a transfer that ended with "|&".
+   */
+  class KeySink : public DumpSink {
+  private:
+    struct Position {
+      uint64_t offset;
+      uint32_t key;
+      uint32_t bit;
+      uint8_t mask;
+    };
+
+    std::vector<Position> positions;
+    std::vector<std::vector<unsigned char>> packed;
+    // Bits of each key picked so far, fewer than its positions if they lie beyond the payload
+    std::vector<size_t> picked;
+    size_t next = 0;
+    uint64_t received = 0;
+    bool complete = false;
+
+    void clear();
+
+  public:
+    explicit KeySink(const std::vector<KeySpec>& specs);
+
+    KeySink(const KeySink&) = delete;
+
+    KeySink& operator=(const KeySink&) = delete;
+
+    ~KeySink() override;
+
+    void begin(const DumpInfo& info) override;
+
+    void write(const char* data, size_t size) override;
+
+    void end(bool ok) override;
+
+    [[nodiscard]] bool isComplete() const {
+      return complete;
+    }
+
+    [[nodiscard]] size_t keys() const {
+      return packed.size();
+    }
+
+    // Key i as '0' and '1', MSB first like extractBits; empty unless a transfer completed
+    [[nodiscard]] std::string key(size_t i) const;
+
+    // Key i packed 8 bits per byte, MSB first, and its number of bits
+    [[nodiscard]] const std::vector<unsigned char>& packedKey(size_t i) const {
+      return packed[i];
+    }
+
+    [[nodiscard]] size_t bits(size_t i) const {
+      return complete ? picked[i] : 0;
+    }
+  };
+
+  // The keys of specs out of a payload without frame, in one pass
+  std::vector<std::string> extractKeys(const char* payload, size_t size, const std::vector<KeySpec>& specs);
+}
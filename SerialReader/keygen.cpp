@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+#include "key_pool.h"
+#include "key_sink.h"
+#include "keygen.h"
+#include "runner.h"
+
+std::timed_mutex& SerialReader::boardMutex() {
+  static std::timed_mutex board;
+  return board;
+}
+
+SerialReader::KeyRequest::KeyRequest() : result(promise.get_future().share()) {}
+
+void SerialReader::KeyRequest::finish(const KeyState _state, std::string _key, std::string _error) {
+  {
+    std::lock_guard lock(mutex);
+    state = _state;
+    key = std::move(_key);
+    error = std::move(_error);
+    changed.notify_all();
+  }
+  promise.set_value(state == KeyState::DONE ? key : std::string());
+}
+
+void SerialReader::KeyRequest::cancel() {
+  std::lock_guard lock(mutex);
+  if (state != KeyState::QUEUED && state != KeyState::RUNNING) return;
+  cancelled = true;
+  if (runner != nullptr) {
+    runner->cancel();
+  }
+}
+
+SerialReader::KeyState SerialReader::KeyRequest::getState() const {
+  std::lock_guard lock(mutex);
+  return state;
+}
+
+SerialReader::KeyProgress SerialReader::KeyRequest::getProgress() const {
+  std::lock_guard lock(mutex);
+  return progress;
+}
+
+std::string SerialReader::KeyRequest::getKey() const {
+  std::lock_guard lock(mutex);
+  return key;
+}
+
+std::string SerialReader::KeyRequest::getError() const {
+  std::lock_guard lock(mutex);
+  return error;
+}
+
+bool SerialReader::KeyRequest::wait(const std::chrono::milliseconds timeout) const {
+  std::unique_lock lock(mutex);
+  return changed.wait_for(lock, timeout, [this] {
+    return state != KeyState::QUEUED && state != KeyState::RUNNING;
+  });
+}
+
+// Requests that wait for the board, in the order they were made; only the first one may take it
+static std::mutex queueMutex;
+static std::condition_variable queueChanged;
+static std::deque<const SerialReader::KeyRequest*> queue;
+
+static void leaveQueue(const SerialReader::KeyRequest* request) {
+  std::lock_guard queued(queueMutex);
+  queue.erase(std::find(queue.begin(), queue.end(), request));
+  queueChanged.notify_all();
+}
+
+std::shared_ptr<SerialReader::KeyRequest> SerialReader::genKeyAsync(const Parser& parser, const std::string& posFile,
+                                                                   const int keySize, ProgressCallback onProgress,
+                                                                   KeyCallback onDone) {
+  auto request = std::make_shared<KeyRequest>();
+  {
+    std::lock_guard queued(queueMutex);
+    queue.push_back(request.get());
+  }
+  std::thread([request, parser = Parser(parser), posFile, keySize, onProgress = std::move(onProgress),
+                onDone = std::move(onDone)]() mutable {
+    if (const auto pool = getKeyPool()) {
+      if (std::string key; pool->take(parser.getParams(), posFile, keySize, key)) {
+        leaveQueue(request.get());
+        request->finish(KeyState::DONE, std::move(key), "");
+        if (onDone) onDone(*request);
+        return;
+      }
+    }
+    // Wait for the requests in front of this one; a request cancelled while waiting leaves the queue at once
+    std::unique_lock lock(boardMutex(), std::defer_lock);
+    bool cancelled = false;
+    while (true) {
+      {
+        std::lock_guard guard(request->mutex);
+        if ((cancelled = request->cancelled)) break;
+      }
+      bool first;
+      {
+        std::unique_lock queued(queueMutex);
+        first = queueChanged.wait_for(queued, std::chrono::milliseconds(100), [&request] {
+          return queue.front() == request.get();
+        });
+      }
+      // The key pool takes the board as well, so even the first request may have to wait for it
+      if (first && lock.try_lock_for(std::chrono::milliseconds(100))) break;
+    }
+    leaveQueue(request.get());
+    if (!cancelled) {
+      std::lock_guard guard(request->mutex);
+      cancelled = request->cancelled;
+      request->state = KeyState::RUNNING;
+    }
+    if (cancelled) {
+      request->finish(KeyState::CANCELLED, "", "cancelled");
+      if (onDone) onDone(*request);
+      return;
+    }
+
+    try {
+      Runner runner(parser);
+      if (!runner.isOpen()) {
+        // uartOpen reports a missing port with -1 rather than an exception; measuring it would only time out
+        lock.unlock();
+        request->finish(KeyState::FAILED, "", "could not open " +
+                        (parser.getReplayFile().empty() ? parser.getSerialPort() : parser.getReplayFile()));
+        if (onDone) onDone(*request);
+        return;
+      }
+      runner.onProgress = [&request, &onProgress](const Phase phase, const size_t bytes, const size_t total) {
+        const KeyProgress progress{phase, bytes, total};
+        {
+          std::lock_guard guard(request->mutex);
+          request->progress = progress;
+        }
+        if (onProgress) onProgress(progress);
+      };
+      {
+        std::lock_guard guard(request->mutex);
+        request->runner = &runner;
+        if (request->cancelled) runner.cancel();
+      }
+      KeySink sink({{posFile, keySize}});
+      const bool measured = run(runner, parser, sink) && sink.isComplete();
+      {
+        std::lock_guard guard(request->mutex);
+        request->runner = nullptr;
+      }
+      runner.release();
+      lock.unlock();
+
+      if (runner.isCancelled()) {
+        request->finish(KeyState::CANCELLED, "", "cancelled");
+      } else if (!measured) {
+        request->finish(KeyState::FAILED, "",
+                        runner.getFailure().empty() ? "no dump received" : runner.getFailure());
+      } else {
+        std::string key = sink.key(0);
+        runner.trace.mark(TraceEvent::EXTRACTED);
+        request->finish(KeyState::DONE, std::move(key), "");
+      }
+    } catch (const std::exception& e) {
+      // Opening the serial port or the GPIO chip failed; the thread must not take the process (or JVM) down
+      if (lock.owns_lock()) lock.unlock();
+      {
+        std::lock_guard guard(request->mutex);
+        request->runner = nullptr;
+      }
+      request->finish(KeyState::FAILED, "", e.what());
+    }
+    if (onDone) onDone(*request);
+  }).detach();
+  return request;
+}
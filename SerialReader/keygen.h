@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "parser.h"
+#include "watchdog.h"
+
+namespace SerialReader {
+  class Runner;
+
+  enum class KeyState { QUEUED, RUNNING, DONE, FAILED, CANCELLED };
+
+  struct KeyProgress {
+    Phase phase = Phase::BOOT;
+    // Bytes of the transfer received so far and the expected total (0 if unknown)
+    size_t bytes = 0;
+    size_t total = 0;
+  };
+
+  class KeyRequest;
+
+  // Held by whoever power-cycles the board and talks to it
+  std::timed_mutex& boardMutex();
+
+  using ProgressCallback = std::function<void(const KeyProgress&)>;
+  using KeyCallback = std::function<void(const KeyRequest&)>;
+
+  /*
+   * Handle of a key generated in the background by genKeyAsync.
+   * Requests share the board, so they are measured one after the other in the order they were made.
+   */
+  class KeyRequest {
+  private:
+    friend std::shared_ptr<KeyRequest> genKeyAsync(const Parser& parser, const std::string& posFile, int keySize,
+                                                   ProgressCallback onProgress, KeyCallback onDone);
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable changed;
+    KeyState state = KeyState::QUEUED;
+    KeyProgress progress;
+    std::string key;
+    std::string error;
+    bool cancelled = false;
+    Runner* runner = nullptr;
+    std::promise<std::string> promise;
+
+    void finish(KeyState _state, std::string _key, std::string _error);
+
+  public:
+    // The key, or an empty string if the request failed or was cancelled
+    const std::shared_future<std::string> result;
+
+    KeyRequest();
+
+    // Stops the measurement (or takes the request out of the queue) and powers off the board, does not wait
+    void cancel();
+
+    [[nodiscard]] KeyState getState() const;
+
+    [[nodiscard]] KeyProgress getProgress() const;
+
+    [[nodiscard]] std::string getKey() const;
+
+    // Why the request failed, empty otherwise
+    [[nodiscard]] std::string getError() const;
+
+    // Waits until the request is done, failed or cancelled, returns false on timeout
+    bool wait(std::chrono::milliseconds timeout) const;
+  };
+
+  /*
+   * Runs gen_key on a background thread and returns immediately.
+   * Both callbacks are invoked on that thread; onDone exactly once, after result is ready. A serial port or GPIO
+   * chip that cannot be opened fails the request with the reason as its error.
+   */
+  std::shared_ptr<KeyRequest> genKeyAsync(const Parser& parser, const std::string& posFile, int keySize,
+                                          ProgressCallback onProgress = nullptr, KeyCallback onDone = nullptr);
+}
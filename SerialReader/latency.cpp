@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "latency.h"
+
+const char* SerialReader::traceEventName(const TraceEvent event) {
+  switch (event) {
+  case TraceEvent::RELAY_OFF:
+    return "relay-off";
+  case TraceEvent::RELAY_ON:
+    return "relay-on";
+  case TraceEvent::SYN:
+    return "syn";
+  case TraceEvent::LOADED:
+    return "loaded";
+  case TraceEvent::PROMPT:
+    return "prompt";
+  case TraceEvent::START:
+    return "start";
+  case TraceEvent::END:
+    return "end";
+  case TraceEvent::FINISHED:
+    return "finished";
+  case TraceEvent::EXTRACTED:
+    return "extracted";
+  }
+  return "unknown";
+}
+
+const char* SerialReader::latencyPhaseName(const LatencyPhase phase) {
+  switch (phase) {
+  case LatencyPhase::POWER_OFF:
+    return "power-off";
+  case LatencyPhase::POWER_UP:
+    return "power-up";
+  case LatencyPhase::BOOT:
+    return "boot";
+  case LatencyPhase::PROMPT:
+    return "prompt";
+  case LatencyPhase::DECAY:
+    return "decay";
+  case LatencyPhase::TRANSFER:
+    return "transfer";
+  case LatencyPhase::FINISH:
+    return "finish";
+  case LatencyPhase::EXTRACT:
+    return "extract";
+  case LatencyPhase::TOTAL:
+    return "total";
+  }
+  return "unknown";
+}
+
+size_t SerialReader::LatencyHistogram::bucketOf(uint64_t value) {
+  value = std::min<uint64_t>(value, (1ULL << LATENCY_MAX_BITS) - 1);
+  if (value < 1ULL << (LATENCY_SUB_BITS + 1)) return value;
+  const int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+  return (static_cast<size_t>(shift) << LATENCY_SUB_BITS) + (value >> shift);
+}
+
+uint64_t SerialReader::LatencyHistogram::highestIn(const size_t bucket) {
+  if (bucket < 1ULL << (LATENCY_SUB_BITS + 1)) return bucket;
+  const size_t shift = (bucket >> LATENCY_SUB_BITS) - 1;
+  const uint64_t sub = bucket - (shift << LATENCY_SUB_BITS);
+  return ((sub + 1) << shift) - 1;
+}
+
+void SerialReader::LatencyHistogram::record(const uint64_t micros) {
+  counts[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(micros, std::memory_order_relaxed);
+  for (uint64_t m = min.load(std::memory_order_relaxed);
+       micros < m && !min.compare_exchange_weak(m, micros, std::memory_order_relaxed);) {}
+  for (uint64_t m = max.load(std::memory_order_relaxed);
+       micros > m && !max.compare_exchange_weak(m, micros, std::memory_order_relaxed);) {}
+  // Last, so that a reader never sees more values than the buckets hold
+  total.fetch_add(1, std::memory_order_release);
+}
+
+void SerialReader::LatencyHistogram::reset() {
+  total = 0;
+  for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+  sum = 0;
+  min = UINT64_MAX;
+  max = 0;
+}
+
+uint64_t SerialReader::LatencyHistogram::percentile(const double share) const {
+  const uint64_t n = total.load(std::memory_order_acquire);
+  if (n == 0) return 0;
+  const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(share, 0.0, 1.0) * n)));
+  const uint64_t highest = max.load(std::memory_order_relaxed);
+  uint64_t seen = 0;
+  for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+    seen += counts[b].load(std::memory_order_relaxed);
+    if (seen >= rank) return std::min(highestIn(b), highest);
+  }
+  return highest;
+}
+
+SerialReader::LatencySummary SerialReader::LatencyHistogram::summary() const {
+  LatencySummary s;
+  s.count = total.load(std::memory_order_acquire);
+  if (s.count == 0) return s;
+  s.min = min;
+  s.max = max;
+  s.mean = static_cast<double>(sum.load()) / static_cast<double>(s.count);
+  s.p50 = percentile(0.5);
+  s.p90 = percentile(0.9);
+  s.p99 = percentile(0.99);
+  s.p999 = percentile(0.999);
+  return s;
+}
+
+void SerialReader::LatencyStats::record(const LatencyPhase phase, const std::chrono::nanoseconds duration) {
+  const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  phases[static_cast<size_t>(phase)].record(micros > 0 ? static_cast<uint64_t>(micros) : 0);
+}
+
+void SerialReader::LatencyStats::setLast(std::vector<std::pair<TraceEvent, std::chrono::microseconds>> events) {
+  std::lock_guard lock(lastMutex);
+  last = std::move(events);
+}
+
+void SerialReader::LatencyStats::reset() {
+  for (auto& p : phases) p.reset();
+  std::lock_guard lock(lastMutex);
+  last.clear();
+}
+
+std::string SerialReader::LatencyStats::report() const {
+  std::ostringstream out;
+  out << "phase\tcount\tmin\tp50\tp90\tp99\tp99.9\tmax\tmean\n";
+  for (size_t i = 0; i < LATENCY_PHASES; i++) {
+    const LatencySummary s = phases[i].summary();
+    out << latencyPhaseName(static_cast<LatencyPhase>(i)) << '\t' << s.count << '\t' << s.min << '\t' << s.p50
+        << '\t' << s.p90 << '\t' << s.p99 << '\t' << s.p999 << '\t' << s.max << '\t'
+        << static_cast<uint64_t>(std::llround(s.mean)) << '\n';
+  }
+  std::lock_guard lock(lastMutex);
+  if (!last.empty()) {
+    out << "\nevent\tus\n";
+    for (const auto& [event, time] : last) out << traceEventName(event) << '\t' << time.count() << '\n';
+  }
+  return out.str();
+}
+
+bool SerialReader::LatencyStats::dump(const std::string& path) const {
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary);
+    out << report();
+    out.flush();
+    if (!out) return false;
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+SerialReader::LatencyStats& SerialReader::latencyStats() {
+  static LatencyStats stats;
+  return stats;
+}
+
+// The phase an event ends, none for the first event of an attempt
+static bool phaseOf(const SerialReader::TraceEvent event, SerialReader::LatencyPhase& phase) {
+  using SerialReader::TraceEvent;
+  using SerialReader::LatencyPhase;
+  switch (event) {
+  case TraceEvent::RELAY_OFF:
+    return false;
+  case TraceEvent::RELAY_ON:
+    phase = LatencyPhase::POWER_OFF;
+    break;
+  case TraceEvent::SYN:
+    phase = LatencyPhase::POWER_UP;
+    break;
+  case TraceEvent::LOADED:
+    phase = LatencyPhase::BOOT;
+    break;
+  case TraceEvent::PROMPT:
+    phase = LatencyPhase::PROMPT;
+    break;
+  case TraceEvent::START:
+    phase = LatencyPhase::DECAY;
+    break;
+  case TraceEvent::END:
+    phase = LatencyPhase::TRANSFER;
+    break;
+  case TraceEvent::FINISHED:
+    phase = LatencyPhase::FINISH;
+    break;
+  case TraceEvent::EXTRACTED:
+    phase = LatencyPhase::EXTRACT;
+    break;
+  }
+  return true;
+}
+
+SerialReader::LatencyTrace::LatencyTrace(LatencyTrace&& other) noexcept
+  : marks(std::move(other.marks)), complete(other.complete) {
+  other.marks.clear();
+  other.complete = false;
+}
+
+SerialReader::LatencyTrace& SerialReader::LatencyTrace::operator=(LatencyTrace&& other) noexcept {
+  if (this != &other) {
+    finish();
+    marks = std::move(other.marks);
+    complete = other.complete;
+    other.marks.clear();
+    other.complete = false;
+  }
+  return *this;
+}
+
+SerialReader::LatencyTrace::~LatencyTrace() {
+  finish();
+}
+
+void SerialReader::LatencyTrace::mark(const TraceEvent event) {
+  // Switching the relay off after a complete measurement starts the next one
+  if (event == TraceEvent::RELAY_OFF && complete) finish();
+  const Clock::time_point now = Clock::now();
+  if (LatencyPhase phase = LatencyPhase::TOTAL; !marks.empty() && phaseOf(event, phase)) {
+    latencyStats().record(phase, now - marks.back().second);
+  }
+  if (event == TraceEvent::END) complete = true;
+  marks.emplace_back(event, now);
+}
+
+void SerialReader::LatencyTrace::finish() {
+  if (marks.empty()) return;
+  // Failed and cancelled measurements keep their phases, but do not count as a total
+  if (complete) latencyStats().record(LatencyPhase::TOTAL, marks.back().second - marks.front().second);
+  std::vector<std::pair<TraceEvent, std::chrono::microseconds>> events;
+  events.reserve(marks.size());
+  for (const auto& [event, time] : marks) {
+    events.emplace_back(event, std::chrono::duration_cast<std::chrono::microseconds>(time - marks.front().second));
+  }
+  latencyStats().setLast(std::move(events));
+  marks.clear();
+  complete = false;
+}
+
+// The handler writes a byte into the pipe, a thread waits on the other end and writes the file
+static int signalPipe[2] = {-1, -1};
+static std::mutex signalMutex;
+static std::string signalPath;
+
+static void onLatencySignal(int) {
+  const int saved = errno;
+  const char c = 0;
+  [[maybe_unused]] const ssize_t n = write(signalPipe[1], &c, 1);
+  errno = saved;
+}
+
+bool SerialReader::dumpLatencyOnSignal(const std::string& path, const int signal) {
+  std::lock_guard lock(signalMutex);
+  signalPath = path;
+  if (signalPipe[0] == -1) {
+    if (pipe2(signalPipe, O_CLOEXEC) != 0) return false;
+    // A burst of signals must not block the handler, the thread writes the file once for all of them anyway
+    fcntl(signalPipe[1], F_SETFL, O_NONBLOCK);
+    std::thread([] {
+      char buf[64];
+      while (true) {
+        const ssize_t n = read(signalPipe[0], buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        std::string target;
+        {
+          std::lock_guard guard(signalMutex);
+          target = signalPath;
+        }
+        latencyStats().dump(target);
+      }
+    }).detach();
+  }
+  struct sigaction action{};
+  action.sa_handler = onLatencySignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  return sigaction(signal, &action, nullptr) == 0;
+}
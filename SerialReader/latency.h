@@ -0,0 +1,147 @@
+#pragma once
+
+// Sub-buckets per power of two, so a recorded duration is off by less than 1/128 of itself
+#define LATENCY_SUB_BITS 7
+// Durations are kept in microseconds up to 2^38 (about 3 days), longer ones count as that
+#define LATENCY_MAX_BITS 38
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+#define LATENCY_PHASES 9
+#define LATENCY_SIGNAL SIGUSR1
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SerialReader {
+  // What the receiver sees of a key generation, in the order it happens
+  enum class TraceEvent { RELAY_OFF, RELAY_ON, SYN, LOADED, PROMPT, START, END, FINISHED, EXTRACTED };
+
+  const char* traceEventName(TraceEvent event);
+
+  /*
+   * What the time up to an event is counted as: RELAY_ON ends POWER_OFF (the relay sleep), the first SYN of the
+   * boot loader ends POWER_UP, "$|" ends BOOT, every "|:" a PROMPT, "&|" the DECAY, "|&" the TRANSFER, "|$" the
+   * FINISH and the extraction of the key EXTRACT. TOTAL is the whole trace, retries included.
+   */
+  enum class LatencyPhase { POWER_OFF, POWER_UP, BOOT, PROMPT, DECAY, TRANSFER, FINISH, EXTRACT, TOTAL };
+
+  const char* latencyPhaseName(LatencyPhase phase);
+
+  // Microseconds
+  struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    double mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+  };
+
+  /*
+   * A histogram of durations in the manner of HdrHistogram: below 2^(LATENCY_SUB_BITS + 1) us every value has its
+   * own bucket, above that every power of two is split into 2^LATENCY_SUB_BITS buckets. Recording is a handful of
+   * relaxed atomic adds, so any thread may record while another reads.
+   */
+  class LatencyHistogram {
+  private:
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> counts{};
+    std::atomic<uint64_t> total = 0;
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint64_t> min = UINT64_MAX;
+    std::atomic<uint64_t> max = 0;
+
+  public:
+    static size_t bucketOf(uint64_t value);
+
+    // Highest value that falls into bucket, what percentiles report
+    static uint64_t highestIn(size_t bucket);
+
+    void record(uint64_t micros);
+
+    void reset();
+
+    [[nodiscard]] uint64_t count() const {
+      return total;
+    }
+
+    // Smallest recorded value that at least share (0 to 1) of all values are not above, 0 if there are none
+    [[nodiscard]] uint64_t percentile(double share) const;
+
+    [[nodiscard]] LatencySummary summary() const;
+  };
+
+  // Latencies of every phase of all measurements of the process, see latencyStats()
+  class LatencyStats {
+  private:
+    std::array<LatencyHistogram, LATENCY_PHASES> phases;
+    mutable std::mutex lastMutex;
+    // Events of the last finished trace and their time since its first one
+    std::vector<std::pair<TraceEvent, std::chrono::microseconds>> last;
+
+  public:
+    void record(LatencyPhase phase, std::chrono::nanoseconds duration);
+
+    [[nodiscard]] const LatencyHistogram& operator[](const LatencyPhase phase) const {
+      return phases[static_cast<size_t>(phase)];
+    }
+
+    void setLast(std::vector<std::pair<TraceEvent, std::chrono::microseconds>> events);
+
+    void reset();
+
+    // A tab-separated table of all phases in microseconds, followed by the events of the last trace
+    [[nodiscard]] std::string report() const;
+
+    // Writes report() to a temporary file and renames it over path; false if that failed
+    bool dump(const std::string& path) const;
+  };
+
+  LatencyStats& latencyStats();
+
+  /*
+   * Timestamps (steady clock) of the events of one key generation or measurement. Every event records the time
+   * since the one before it into its phase of latencyStats(), and finish() records the total. A trace that was
+   * not complete (no "|&" yet) when the relay is switched off again is a retry and continues.
+   */
+  class LatencyTrace {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::pair<TraceEvent, Clock::time_point>> marks;
+    bool complete = false;
+
+  public:
+    LatencyTrace() = default;
+
+    LatencyTrace(LatencyTrace&& other) noexcept;
+
+    LatencyTrace& operator=(LatencyTrace&& other) noexcept;
+
+    ~LatencyTrace();
+
+    void mark(TraceEvent event);
+
+    // Records the total and hands the events to latencyStats(); nothing happens to an empty trace
+    void finish();
+
+    [[nodiscard]] bool isComplete() const {
+      return complete;
+    }
+  };
+
+  /*
+   * Writes latencyStats() to path whenever the process receives signal. The handler only wakes a thread that
+   * writes the file, so the signal may arrive at any time. Installing it again changes the path. Inside a JVM
+   * the signal has to be one the JVM does not use itself (SIGUSR1 is free on HotSpot).
+   */
+  bool dumpLatencyOnSignal(const std::string& path, int signal = LATENCY_SIGNAL);
+}
@@ -1,11 +1,26 @@
+#include <iostream>
+#include "calibration.h"
+#include "latency.h"
 #include "main.h"
 #include "parser.h"
 #include "runner.h"
 
 int main(const int argc, const char** argv) {
   if (const int ret = SerialReader::init(argc, argv); ret == 2) {
-    run(SerialReader::getParser());
-    return 0;
+    const SerialReader::Parser& parser = SerialReader::getParser();
+    if (!parser.getLatency().empty() && !SerialReader::dumpLatencyOnSignal(parser.getLatency())) {
+      std::cerr << "Could not install the handler for SIGUSR1" << std::endl;
+    }
+    int code = 0;
+    if (parser.getCalibrate() > 0) {
+      code = SerialReader::calibrate(SerialReader::getParser());
+    } else {
+      run(SerialReader::getParser());
+    }
+    if (!parser.getLatency().empty() && !SerialReader::latencyStats().dump(parser.getLatency())) {
+      std::cerr << "Could not write " << parser.getLatency() << std::endl;
+    }
+    return code;
   } else {
     return ret;
   }
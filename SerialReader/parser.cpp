@@ -1,6 +1,7 @@
 #include <args.hxx>
 #include <iostream>
 #include <memory>
+#include "calibration.h"
 #include "parser.h"
 
 static std::unique_ptr<SerialReader::Parser> parser;
@@ -22,6 +23,71 @@ int SerialReader::init(const int argc, const char** argv) {
   args::ValueFlag<std::string> outA(argsParser, "out", "File output prefix", {'o', "out"}, "out");
   args::ValueFlagList<std::string> paramsA(argsParser, "params", "The params to send to the RaspPi", {'p', "params"},
                                            std::vector<std::string>(1, "4"));
+  args::ValueFlag maxRetriesA(argsParser, "retries",
+                              "Power-cycle retries after a hang or panic before giving up (0 = never give up)",
+                              {'R', "retries"}, 5);
+  args::Flag noWatchdogA(argsParser, "no-watchdog", "Wait forever instead of power-cycling a hanging board",
+                         {"no-watchdog"});
+  args::ValueFlag<std::string> campaignLogA(argsParser, "log", "File to append failed measurements to",
+                                            {'l', "log"}, "");
+  args::ValueFlag<std::string> captureA(argsParser, "capture", "Record everything received from the serial port",
+                                        {'c', "capture"}, "");
+  args::ValueFlag<std::string> replayA(argsParser, "replay", "Read from a capture instead of the serial port",
+                                       {"replay"}, "");
+  args::Flag realtimeA(argsParser, "realtime", "Replay with the original timing instead of at maximum speed",
+                       {"realtime"});
+  args::Flag lowLatencyA(argsParser, "low-latency",
+                         "Drain the serial port on a dedicated reader thread with ASYNC_LOW_LATENCY",
+                         {"low-latency"});
+  args::ValueFlag readerCpuA(argsParser, "cpu", "Pin the low-latency reader thread to this CPU",
+                             {"reader-cpu"}, -1);
+  args::ValueFlag readerPriorityA(argsParser, "priority",
+                                  "Run the low-latency reader thread with SCHED_FIFO at this priority (needs root)",
+                                  {"reader-priority"}, 0);
+  args::Flag describedA(argsParser, "described",
+                        "Write dumps with a header describing the challenge and a checksum footer",
+                        {"described"});
+  args::Flag archiveA(argsParser, "archive",
+                       "Write dumps as seekable archives, XOR'd against the init value and compressed in chunks",
+                       {"archive"});
+  args::ValueFlag<std::string> referenceA(argsParser, "reference",
+                                          "XOR archived dumps against this dump instead of the init value",
+                                          {"reference"}, "");
+  args::ValueFlag<std::string> catalogA(argsParser, "catalog",
+                                        "Index every dump with its challenge and summary statistics in this file",
+                                        {"catalog"}, "");
+  args::ValueFlag<std::string> boardA(argsParser, "board", "Name of the board in the catalog (default: serial port)",
+                                      {"board"}, "");
+  args::ValueFlag<std::string> sensorA(argsParser, "sensor",
+                                       "File with the temperature (millidegrees Celsius) of the measured board to "
+                                       "record in the catalog, e.g. a sensor next to its DRAM (default: none)",
+                                       {"sensor"}, "");
+  args::ValueFlag<std::string> stabilityA(argsParser, "map",
+                                          "Count per bit in this file how often it differed from the first dump",
+                                          {"stability"}, "");
+  args::ValueFlag<uint64_t> stableBitsA(argsParser, "bits",
+                                        "Stop measuring once this many bits of the stability map are stable",
+                                        {"stable-bits"}, 0);
+  args::ValueFlag<uint32_t> stableThresholdA(argsParser, "mismatches",
+                                             "Mismatches with the first dump a stable bit may have",
+                                             {"stable-threshold"}, 0);
+  args::ValueFlag<std::string> transposedA(argsParser, "store",
+                                           "Also append every dump as a run to this bit-transposed store",
+                                           {"transposed"}, "");
+  args::Flag flipsA(argsParser, "flips", "Also index the weak words of every summary (mode 1) in a .flips file",
+                    {"flips"});
+  args::ValueFlag<std::string> paramsFileA(argsParser, "file",
+                                           "Read the params from this file (one per line, e.g. from --calibrate)",
+                                           {"params-file"}, "");
+  args::ValueFlag<double> calibrateA(argsParser, "density",
+                                     "Find the decay time at which this share of the bits of the params' region "
+                                     "flips, instead of measuring",
+                                     {"calibrate"}, 0);
+  args::ValueFlag<std::string> calibrationA(argsParser, "file", "Where --calibrate writes the chosen params",
+                                            {"calibration"}, CALIBRATION_FILE);
+  args::ValueFlag<std::string> latencyA(argsParser, "file",
+                                        "Write the latency of every phase to this file on SIGUSR1 and at the end",
+                                        {"latency"}, "");
   args::CompletionFlag completion(argsParser, {"complete"});
 
   try {
@@ -38,9 +104,45 @@ int SerialReader::init(const int argc, const char** argv) {
     return 1;
   }
 
-  parser = std::make_unique<Parser>(args::get(serialPortA), args::get(gpioChipA), get(baudA),
-                                    get(usbPortA), get(usbSleepA), get(maxMeasuresA),
-                                    true, args::get(outA), args::get(paramsA));
+  std::vector<std::string> params = args::get(paramsA);
+  if (!args::get(paramsFileA).empty() && !readParams(args::get(paramsFileA), params)) {
+    std::cerr << "Could not read " << args::get(paramsFileA) << std::endl;
+    return 1;
+  }
+
+  parser = std::make_unique<Parser>(ParserOptions{
+    .serialPort = args::get(serialPortA),
+    .gpioChip = args::get(gpioChipA),
+    .baudRate = get(baudA),
+    .usbPort = get(usbPortA),
+    .usbSleep = get(usbSleepA),
+    .maxMeasures = get(maxMeasuresA),
+    .fileOut = true,
+    .outPrefix = args::get(outA),
+    .params = params,
+    .maxRetries = get(maxRetriesA),
+    .watchdog = !noWatchdogA,
+    .campaignLog = args::get(campaignLogA),
+    .captureFile = args::get(captureA),
+    .replayFile = args::get(replayA),
+    .realtime = args::get(realtimeA),
+    .lowLatency = args::get(lowLatencyA),
+    .readerCpu = get(readerCpuA),
+    .readerPriority = get(readerPriorityA),
+    .format = archiveA ? DumpFormat::ARCHIVE : describedA ? DumpFormat::DESCRIBED : DumpFormat::RAW,
+    .reference = args::get(referenceA),
+    .catalog = args::get(catalogA),
+    .board = args::get(boardA).empty() ? args::get(serialPortA) : args::get(boardA),
+    .sensor = args::get(sensorA),
+    .stability = args::get(stabilityA),
+    .stableBits = args::get(stableBitsA),
+    .stableThreshold = args::get(stableThresholdA),
+    .transposed = args::get(transposedA),
+    .flips = args::get(flipsA),
+    .calibrate = args::get(calibrateA),
+    .calibration = args::get(calibrationA),
+    .latency = args::get(latencyA)
+  });
 
   return 2;
 }
@@ -1,67 +1,191 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
+#include "dump_file.h"
 
 namespace SerialReader {
   int init(int argc, const char** argv);
 
+  /*
+   * Everything a measurement is made with, by name, so that callers only set what differs from the defaults, e.g.
+   * Parser({.params = params, .replayFile = capture}). The defaults are those of the command line, except for one
+   * measurement, no output prefix and no board name.
+   */
+  struct ParserOptions {
+    std::string serialPort = "/dev/ttyS0";
+    std::string gpioChip = "gpiochip0";
+    int baudRate = 115200;
+    // GPIO line of the relay that powers the board
+    int usbPort = 2;
+    // Seconds the board stays off between measurements, doubled per failed attempt
+    int usbSleep = 5;
+    int maxMeasures = 1;
+    bool fileOut = true;
+    std::string outPrefix = "";
+    std::vector<std::string> params = {};
+    // Power-cycles after a hang or panic before giving up, 0 retries forever
+    int maxRetries = 5;
+    bool watchdog = true;
+    std::string campaignLog = "";
+    std::string captureFile = "";
+    // Reads a capture instead of the serial port, which holds the retries of the measurements it recorded
+    std::string replayFile = "";
+    bool realtime = false;
+    bool lowLatency = false;
+    int readerCpu = -1;
+    int readerPriority = 0;
+    DumpFormat format = DumpFormat::RAW;
+    std::string reference = "";
+    std::string catalog = "";
+    std::string board = "";
+    std::string sensor = "";
+    std::string stability = "";
+    uint64_t stableBits = 0;
+    uint32_t stableThreshold = 0;
+    std::string transposed = "";
+    bool flips = false;
+    double calibrate = 0;
+    std::string calibration = "";
+    std::string latency = "";
+  };
+
   struct Parser {
-    Parser(std::string _serialPort, std::string _gpioChip, const int _baudRate,
-           const int rpi_power_port, const int _usbSleep, const int _maxMeasures, bool&& _fileOut,
-           std::string _outPrefix, const std::vector<std::string>& _params)
-      : serialPort(std::move(_serialPort)), gpioChip(std::move(_gpioChip)),
-        baudRate(_baudRate), usbPort(rpi_power_port), usbSleep(_usbSleep),
-        maxMeasures(_maxMeasures), fileOut(_fileOut),
-        outPrefix(std::move(_outPrefix)), params(_params) {};
+    explicit Parser(ParserOptions _options) : options(std::move(_options)) {};
+
+    // The same board and settings with another challenge
+    Parser(const Parser& other, const std::vector<std::string>& _params) : options(other.options) {
+      options.params = _params;
+    };
 
     [[nodiscard]] const std::string& getSerialPort() const {
-      return serialPort;
+      return options.serialPort;
     }
 
     [[nodiscard]] const std::string& getGpioChip() const {
-      return gpioChip;
+      return options.gpioChip;
     }
 
     [[nodiscard]] const int& getBaudRate() const {
-      return baudRate;
+      return options.baudRate;
     }
 
     [[nodiscard]] const int& getUSBPort() const {
-      return usbPort;
+      return options.usbPort;
     }
 
     [[nodiscard]] const int& getUSBSleepTime() const {
-      return usbSleep;
+      return options.usbSleep;
     }
 
     [[nodiscard]] const int& getMaxMeasures() const {
-      return maxMeasures;
+      return options.maxMeasures;
     }
 
     [[nodiscard]] const bool& getFileOut() const {
-      return fileOut;
+      return options.fileOut;
     }
 
     [[nodiscard]] const std::string& getOutPrefix() const {
-      return outPrefix;
+      return options.outPrefix;
     }
 
     [[nodiscard]] const std::vector<std::string>& getParams() const {
-      return params;
+      return options.params;
+    }
+
+    [[nodiscard]] const int& getMaxRetries() const {
+      return options.maxRetries;
+    }
+
+    [[nodiscard]] const bool& getWatchdog() const {
+      return options.watchdog;
+    }
+
+    [[nodiscard]] const std::string& getCampaignLog() const {
+      return options.campaignLog;
+    }
+
+    [[nodiscard]] const std::string& getCaptureFile() const {
+      return options.captureFile;
+    }
+
+    [[nodiscard]] const std::string& getReplayFile() const {
+      return options.replayFile;
+    }
+
+    [[nodiscard]] const bool& getRealtime() const {
+      return options.realtime;
+    }
+
+    [[nodiscard]] const bool& getLowLatency() const {
+      return options.lowLatency;
+    }
+
+    [[nodiscard]] const int& getReaderCpu() const {
+      return options.readerCpu;
+    }
+
+    [[nodiscard]] const int& getReaderPriority() const {
+      return options.readerPriority;
+    }
+
+    [[nodiscard]] const DumpFormat& getFormat() const {
+      return options.format;
+    }
+
+    [[nodiscard]] const std::string& getReference() const {
+      return options.reference;
+    }
+
+    [[nodiscard]] const std::string& getCatalog() const {
+      return options.catalog;
+    }
+
+    [[nodiscard]] const std::string& getBoard() const {
+      return options.board;
+    }
+
+    [[nodiscard]] const std::string& getSensor() const {
+      return options.sensor;
+    }
+
+    [[nodiscard]] const std::string& getStability() const {
+      return options.stability;
+    }
+
+    [[nodiscard]] const uint64_t& getStableBits() const {
+      return options.stableBits;
+    }
+
+    [[nodiscard]] const uint32_t& getStableThreshold() const {
+      return options.stableThreshold;
+    }
+
+    [[nodiscard]] const std::string& getTransposed() const {
+      return options.transposed;
+    }
+
+    [[nodiscard]] const bool& getFlips() const {
+      return options.flips;
+    }
+
+    [[nodiscard]] const double& getCalibrate() const {
+      return options.calibrate;
+    }
+
+    [[nodiscard]] const std::string& getCalibration() const {
+      return options.calibration;
+    }
+
+    [[nodiscard]] const std::string& getLatency() const {
+      return options.latency;
     }
 
   private:
-    const std::string serialPort;
-    const std::string gpioChip;
-    const int baudRate;
-    const int usbPort;
-    const int usbSleep;
-    const int maxMeasures;
-    const bool fileOut;
-    const std::string outPrefix;
-    const std::vector<std::string> params;
+    ParserOptions options;
   };
 
   Parser& getParser();
@@ -0,0 +1,550 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "bit_gather.h"
+#include "challenge.h"
+#include "crp.h"
+#include "dump_sink.h"
+#include "key_sink.h"
+#include "keygen.h"
+#include "latency.h"
+#include "puf.h"
+#include "runner.h"
+
+struct puf_session {
+  std::string serialPort;
+  std::string gpioChip;
+  std::string replayFile;
+  int baud = 115200;
+  int relayLine = 2;
+  int powerOff = 5;
+  int maxRetries = 5;
+  bool watchdog = true;
+
+  std::mutex mutex;
+  SerialReader::Runner* runner = nullptr;
+  std::string error;
+  // The last measurement, until a key was extracted from it
+  SerialReader::LatencyTrace trace;
+};
+
+struct puf_crp_store {
+  SerialReader::CrpStore store;
+
+  explicit puf_crp_store(std::string file) : store(std::move(file)) {}
+};
+
+namespace {
+  // Sink that can stop the measurement it is attached to
+  class SessionSink : public SerialReader::DumpSink {
+  public:
+    SerialReader::Runner* runner = nullptr;
+  };
+
+  class CallbackSink : public SessionSink {
+  private:
+    const puf_callbacks& callbacks;
+    uint64_t offset = 0;
+    bool stopped = false;
+
+    void stop(const int ret) {
+      if (ret == 0 || stopped) return;
+      stopped = true;
+      runner->cancel();
+    }
+
+  public:
+    explicit CallbackSink(const puf_callbacks& _callbacks) : callbacks(_callbacks) {}
+
+    void begin(const SerialReader::DumpInfo& info) override {
+      offset = 0;
+      if (callbacks.begin != nullptr) stop(callbacks.begin(callbacks.user, info.frame.c_str(), info.payloadSize));
+    }
+
+    void write(const char* data, const size_t size) override {
+      if (stopped) return;
+      if (callbacks.chunk != nullptr) {
+        stop(callbacks.chunk(callbacks.user, reinterpret_cast<const unsigned char*>(data), size, offset));
+      }
+      offset += size;
+    }
+
+    void end(const bool ok) override {
+      if (callbacks.end != nullptr) callbacks.end(callbacks.user, ok && !stopped);
+    }
+  };
+
+  class KeysSink : public SessionSink {
+  public:
+    SerialReader::KeySink keys;
+
+    explicit KeysSink(const std::vector<SerialReader::KeySpec>& specs) : keys(specs) {}
+
+    void begin(const SerialReader::DumpInfo& info) override {
+      keys.begin(info);
+    }
+
+    void write(const char* data, const size_t size) override {
+      keys.write(data, size);
+    }
+
+    void end(const bool ok) override {
+      keys.end(ok);
+    }
+  };
+
+  class BufferSink : public SessionSink {
+  private:
+    unsigned char* const buffer;
+    const size_t capacity;
+
+  public:
+    size_t size = 0;
+
+    BufferSink(void* _buffer, const size_t _capacity)
+      : buffer(static_cast<unsigned char*>(_buffer)), capacity(_capacity) {}
+
+    void begin(const SerialReader::DumpInfo&) override {
+      size = 0;
+    }
+
+    void write(const char* data, const size_t count) override {
+      if (size < capacity) {
+        std::memcpy(buffer + size, data, count < capacity - size ? count : capacity - size);
+      }
+      size += count;
+    }
+
+    void end(const bool ok) override {
+      if (!ok) size = 0;
+    }
+  };
+}
+
+// Sizes of the structs in ABI version 1, the smallest a caller may pass
+#define PUF_SESSION_CONFIG_V1 (offsetof(puf_session_config, replay_file) + sizeof(const char*))
+#define PUF_CALLBACKS_V1 (offsetof(puf_callbacks, end) + sizeof(void (*)(void*, int)))
+#define PUF_LATENCY_V1 (offsetof(puf_latency, p999_us) + sizeof(uint64_t))
+
+// The fields of a caller's struct this version knows; those the caller's version does not have yet stay zero
+template<typename T>
+static T readStruct(const T* in) {
+  T t{};
+  std::memcpy(&t, in, std::min(in->struct_size, sizeof(T)));
+  return t;
+}
+
+// Hands t to the caller, as much of it as the caller's version of the struct has room for
+template<typename T>
+static void writeStruct(T* out, T t) {
+  t.struct_size = out->struct_size;
+  std::memcpy(out, &t, std::min(out->struct_size, sizeof(T)));
+}
+
+static std::vector<std::string> toParams(const char* const* params, const int params_size) {
+  std::vector<std::string> ret;
+  ret.reserve(params_size > 0 ? params_size : 0);
+  for (int i = 0; i < params_size; i++) {
+    ret.emplace_back(params[i] != nullptr ? params[i] : "");
+  }
+  return ret;
+}
+
+static int fail(puf_session* session, const int status, const std::string& error) {
+  std::lock_guard lock(session->mutex);
+  session->error = error;
+  return status;
+}
+
+static int measure(puf_session* session, const char* const* params, const int params_size, SessionSink& sink) {
+  if (params == nullptr || params_size <= 0) return fail(session, PUF_ERR_ARGUMENT, "no params");
+  SerialReader::Parser parser({
+    .serialPort = session->serialPort, .gpioChip = session->gpioChip, .baudRate = session->baud,
+    .usbPort = session->relayLine, .usbSleep = session->powerOff, .params = toParams(params, params_size),
+    .maxRetries = session->maxRetries, .watchdog = session->watchdog, .replayFile = session->replayFile
+  });
+  std::lock_guard board(SerialReader::boardMutex());
+  std::unique_ptr<SerialReader::Runner> runner;
+  try {
+    runner = std::make_unique<SerialReader::Runner>(parser);
+  } catch (const std::exception& e) {
+    return fail(session, PUF_ERR_OPEN, e.what());
+  }
+  if (!runner->isOpen()) {
+    return fail(session, PUF_ERR_OPEN, "could not open " +
+                (session->replayFile.empty() ? session->serialPort : session->replayFile));
+  }
+  {
+    std::lock_guard lock(session->mutex);
+    session->runner = runner.get();
+    session->error.clear();
+  }
+  sink.runner = runner.get();
+  const bool measured = run(*runner, parser, sink);
+  {
+    std::lock_guard lock(session->mutex);
+    session->runner = nullptr;
+  }
+  runner->release();
+  session->trace = std::move(runner->trace);
+  if (runner->isCancelled()) return fail(session, PUF_ERR_CANCELLED, "cancelled");
+  if (!measured) {
+    return fail(session, PUF_ERR_MEASURE, runner->getFailure().empty() ? "no dump received" : runner->getFailure());
+  }
+  return PUF_OK;
+}
+
+int puf_abi_version(void) {
+  return PUF_ABI_VERSION;
+}
+
+const char* puf_strerror(const int status) {
+  switch (status) {
+  case PUF_OK:
+    return "success";
+  case PUF_ERR_ARGUMENT:
+    return "invalid argument";
+  case PUF_ERR_OPEN:
+    return "could not open the serial port or GPIO chip";
+  case PUF_ERR_MEASURE:
+    return "measurement failed";
+  case PUF_ERR_CANCELLED:
+    return "cancelled";
+  case PUF_ERR_BUFFER:
+    return "buffer too small";
+  case PUF_ERR_POS_FILE:
+    return "could not read the pos file";
+  case PUF_ERR_STORE:
+    return "could not read or write the CRP store";
+  case PUF_ERR_NOT_ENROLLED:
+    return "no response enrolled for this board and challenge";
+  case PUF_ERR_FILE:
+    return "could not write the file";
+  default:
+    return "internal error";
+  }
+}
+
+int puf_session_open(const puf_session_config* config, puf_session** session) {
+  if (config == nullptr || session == nullptr || config->struct_size < PUF_SESSION_CONFIG_V1) {
+    return PUF_ERR_ARGUMENT;
+  }
+  const puf_session_config known = readStruct(config);
+  config = &known;
+  const bool replay = config->replay_file != nullptr && config->replay_file[0] != '\0';
+  if (!replay && (config->serial_port == nullptr || config->gpio_chip == nullptr)) return PUF_ERR_ARGUMENT;
+  try {
+    auto s = std::make_unique<puf_session>();
+    if (replay) {
+      s->replayFile = config->replay_file;
+    } else {
+      s->serialPort = config->serial_port;
+      s->gpioChip = config->gpio_chip;
+    }
+    s->baud = config->baud;
+    s->relayLine = config->relay_line;
+    s->powerOff = config->power_off_seconds;
+    s->maxRetries = config->max_retries;
+    s->watchdog = config->watchdog != 0;
+    *session = s.release();
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+void puf_session_close(puf_session* session) {
+  if (session == nullptr) return;
+  puf_session_cancel(session);
+  // Wait for a measurement on another thread to let go of the session
+  std::lock_guard board(SerialReader::boardMutex());
+  delete session;
+}
+
+void puf_session_cancel(puf_session* session) {
+  if (session == nullptr) return;
+  std::lock_guard lock(session->mutex);
+  if (session->runner != nullptr) session->runner->cancel();
+}
+
+const char* puf_session_error(const puf_session* session) {
+  return session != nullptr ? session->error.c_str() : "";
+}
+
+size_t puf_payload_size(const char* const* params, const int params_size) {
+  if (params == nullptr || params_size <= 0) return 0;
+  try {
+    const auto challenge = SerialReader::Challenge::fromParams(toParams(params, params_size));
+    return challenge.isDump() ? challenge.payloadSize() : 0;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+int puf_measure(puf_session* session, const char* const* params, const int params_size,
+                const puf_callbacks* callbacks) {
+  if (session == nullptr || callbacks == nullptr || callbacks->struct_size < PUF_CALLBACKS_V1) {
+    return PUF_ERR_ARGUMENT;
+  }
+  try {
+    const puf_callbacks known = readStruct(callbacks);
+    CallbackSink sink(known);
+    return measure(session, params, params_size, sink);
+  } catch (const std::exception& e) {
+    return fail(session, PUF_ERR_INTERNAL, e.what());
+  }
+}
+
+int puf_measure_into(puf_session* session, const char* const* params, const int params_size,
+                     void* buffer, const size_t capacity, size_t* written) {
+  if (session == nullptr || (buffer == nullptr && capacity > 0)) return PUF_ERR_ARGUMENT;
+  try {
+    BufferSink sink(buffer, capacity);
+    const int ret = measure(session, params, params_size, sink);
+    if (written != nullptr) *written = sink.size;
+    if (ret == PUF_OK && sink.size > capacity) {
+      return fail(session, PUF_ERR_BUFFER, std::to_string(sink.size) + " bytes of payload do not fit into "
+                                           + std::to_string(capacity));
+    }
+    return ret;
+  } catch (const std::exception& e) {
+    return fail(session, PUF_ERR_INTERNAL, e.what());
+  }
+}
+
+int puf_key_extract(const void* payload, const size_t size, const char* pos_file, const int key_size,
+                    char** key, size_t* key_length) {
+  if (payload == nullptr || pos_file == nullptr || key_size <= 0 || key == nullptr) return PUF_ERR_ARGUMENT;
+  if (!std::ifstream(pos_file)) return PUF_ERR_POS_FILE;
+  try {
+    std::string bits = SerialReader::extractBits(static_cast<const char*>(payload), size, pos_file, key_size);
+    // malloc'd, so that a C caller could even free it itself
+    *key = static_cast<char*>(std::malloc(bits.size() + 1));
+    if (*key == nullptr) return PUF_ERR_INTERNAL;
+    std::memcpy(*key, bits.c_str(), bits.size() + 1);
+    if (key_length != nullptr) *key_length = bits.size();
+    explicit_bzero(bits.data(), bits.size());
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_key_extract_packed(const void* payload, const size_t size, const char* pos_file, const int key_size,
+                           unsigned char* key, const size_t capacity, size_t* bits) {
+  if (payload == nullptr || pos_file == nullptr || key_size <= 0 || key == nullptr) return PUF_ERR_ARGUMENT;
+  if (capacity < (static_cast<size_t>(key_size) + 7) / 8) return PUF_ERR_BUFFER;
+  if (!std::ifstream(pos_file)) return PUF_ERR_POS_FILE;
+  try {
+    const auto positions = SerialReader::KeyPositions::load(pos_file, key_size);
+    const size_t n = SerialReader::gatherBits(static_cast<const unsigned char*>(payload), size, positions, key);
+    if (bits != nullptr) *bits = n;
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_key_generate(puf_session* session, const char* const* params, const int params_size,
+                     const char* pos_file, const int key_size, char** key, size_t* key_length) {
+  if (session == nullptr || key == nullptr) return PUF_ERR_ARGUMENT;
+  const size_t size = puf_payload_size(params, params_size);
+  if (size == 0) return fail(session, PUF_ERR_ARGUMENT, "params do not describe a memory dump");
+  try {
+    std::vector<unsigned char> payload(size);
+    size_t written = 0;
+    int ret = puf_measure_into(session, params, params_size, payload.data(), payload.size(), &written);
+    if (ret == PUF_OK) {
+      ret = puf_key_extract(payload.data(), written, pos_file, key_size, key, key_length);
+      if (ret != PUF_OK) fail(session, ret, puf_strerror(ret));
+      session->trace.mark(SerialReader::TraceEvent::EXTRACTED);
+      session->trace.finish();
+    }
+    explicit_bzero(payload.data(), payload.size());
+    return ret;
+  } catch (const std::exception& e) {
+    return fail(session, PUF_ERR_INTERNAL, e.what());
+  }
+}
+
+int puf_keys_generate(puf_session* session, const char* const* params, const int params_size,
+                      const char* const* pos_files, const int* key_sizes, const int count,
+                      char** keys, size_t* key_lengths) {
+  if (session == nullptr || pos_files == nullptr || key_sizes == nullptr || count <= 0 || keys == nullptr) {
+    return PUF_ERR_ARGUMENT;
+  }
+  if (puf_payload_size(params, params_size) == 0) {
+    return fail(session, PUF_ERR_ARGUMENT, "params do not describe a memory dump");
+  }
+  std::vector<SerialReader::KeySpec> specs;
+  for (int i = 0; i < count; i++) {
+    if (pos_files[i] == nullptr || key_sizes[i] <= 0) return PUF_ERR_ARGUMENT;
+    if (!std::ifstream(pos_files[i])) {
+      return fail(session, PUF_ERR_POS_FILE, std::string("cannot read ") + pos_files[i]);
+    }
+    specs.push_back({pos_files[i], key_sizes[i]});
+  }
+  try {
+    KeysSink sink(specs);
+    const int ret = measure(session, params, params_size, sink);
+    if (ret != PUF_OK) return ret;
+    for (int i = 0; i < count; i++) {
+      std::string bits = sink.keys.key(i);
+      keys[i] = static_cast<char*>(std::malloc(bits.size() + 1));
+      if (keys[i] != nullptr) std::memcpy(keys[i], bits.c_str(), bits.size() + 1);
+      if (key_lengths != nullptr) key_lengths[i] = bits.size();
+      explicit_bzero(bits.data(), bits.size());
+      if (keys[i] == nullptr) {
+        for (int j = 0; j < i; j++) puf_key_free(keys[j]);
+        return fail(session, PUF_ERR_INTERNAL, "out of memory");
+      }
+    }
+    session->trace.mark(SerialReader::TraceEvent::EXTRACTED);
+    session->trace.finish();
+    return PUF_OK;
+  } catch (const std::exception& e) {
+    return fail(session, PUF_ERR_INTERNAL, e.what());
+  }
+}
+
+void puf_key_free(char* key) {
+  if (key == nullptr) return;
+  explicit_bzero(key, std::strlen(key));
+  std::free(key);
+}
+
+int puf_crp_open(const char* path, puf_crp_store** store) {
+  if (path == nullptr || store == nullptr) return PUF_ERR_ARGUMENT;
+  try {
+    auto s = std::make_unique<puf_crp_store>(path);
+    if (!s->store.load()) return PUF_ERR_STORE;
+    *store = s.release();
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+void puf_crp_close(puf_crp_store* store) {
+  delete store;
+}
+
+int puf_crp_enroll(puf_crp_store* store, const char* board, const char* const* params, const int params_size,
+                   const unsigned char* response, const unsigned char* mask, const size_t bits) {
+  if (store == nullptr || board == nullptr || params == nullptr || params_size <= 0 || response == nullptr ||
+      bits == 0 || bits > UINT32_MAX) {
+    return PUF_ERR_ARGUMENT;
+  }
+  try {
+    SerialReader::Crp crp;
+    crp.board = board;
+    crp.challenge = SerialReader::Challenge::fromParams(toParams(params, params_size));
+    crp.bits = static_cast<uint32_t>(bits);
+    crp.response.assign(response, response + (bits + 7) / 8);
+    if (mask != nullptr) crp.mask.assign(mask, mask + (bits + 7) / 8);
+    return store->store.enroll(crp) ? PUF_OK : PUF_ERR_STORE;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_crp_verify(puf_crp_store* store, const char* board, const char* const* params, const int params_size,
+                   const unsigned char* response, const size_t bits, const double threshold,
+                   double* distance, int* accepted) {
+  if (store == nullptr || board == nullptr || params == nullptr || params_size <= 0 || response == nullptr ||
+      bits == 0 || bits > UINT32_MAX) {
+    return PUF_ERR_ARGUMENT;
+  }
+  try {
+    const SerialReader::CrpMatch match = store->store.verify(
+      board, SerialReader::Challenge::fromParams(toParams(params, params_size)), response,
+      static_cast<uint32_t>(bits), threshold);
+    if (distance != nullptr) *distance = match.distance;
+    if (accepted != nullptr) *accepted = match.accepted ? 1 : 0;
+    return match.compared > 0 ? PUF_OK : PUF_ERR_NOT_ENROLLED;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_crp_identify(puf_crp_store* store, const char* const* params, const int params_size,
+                     const unsigned char* response, const size_t bits, const double max_distance,
+                     char* board, const size_t capacity, double* distance) {
+  if (store == nullptr || params == nullptr || params_size <= 0 || response == nullptr || bits == 0 ||
+      bits > UINT32_MAX || board == nullptr) {
+    return PUF_ERR_ARGUMENT;
+  }
+  try {
+    const SerialReader::CrpIdentity identity = store->store.identify(
+      SerialReader::Challenge::fromParams(toParams(params, params_size)), response, static_cast<uint32_t>(bits),
+      max_distance);
+    if (!identity.found) return PUF_ERR_NOT_ENROLLED;
+    if (identity.board.size() >= capacity) return PUF_ERR_BUFFER;
+    std::memcpy(board, identity.board.c_str(), identity.board.size() + 1);
+    if (distance != nullptr) *distance = identity.distance;
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_latency_get(const int phase, puf_latency* latency) {
+  if (phase < 0 || phase >= LATENCY_PHASES || latency == nullptr || latency->struct_size < PUF_LATENCY_V1) {
+    return PUF_ERR_ARGUMENT;
+  }
+  const SerialReader::LatencySummary s =
+    SerialReader::latencyStats()[static_cast<SerialReader::LatencyPhase>(phase)].summary();
+  puf_latency known{};
+  known.count = s.count;
+  known.min_us = s.min;
+  known.max_us = s.max;
+  known.mean_us = s.mean;
+  known.p50_us = s.p50;
+  known.p90_us = s.p90;
+  known.p99_us = s.p99;
+  known.p999_us = s.p999;
+  writeStruct(latency, known);
+  return PUF_OK;
+}
+
+int puf_latency_report(char* buffer, const size_t capacity, size_t* written) {
+  if (buffer == nullptr && capacity > 0) return PUF_ERR_ARGUMENT;
+  try {
+    const std::string report = SerialReader::latencyStats().report();
+    if (written != nullptr) *written = report.size();
+    if (report.size() + 1 > capacity) return PUF_ERR_BUFFER;
+    std::memcpy(buffer, report.c_str(), report.size() + 1);
+    return PUF_OK;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_latency_dump(const char* path) {
+  if (path == nullptr) return PUF_ERR_ARGUMENT;
+  try {
+    return SerialReader::latencyStats().dump(path) ? PUF_OK : PUF_ERR_FILE;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+int puf_latency_dump_on_signal(const char* path, const int signal) {
+  if (path == nullptr || signal <= 0) return PUF_ERR_ARGUMENT;
+  try {
+    return SerialReader::dumpLatencyOnSignal(path, signal) ? PUF_OK : PUF_ERR_INTERNAL;
+  } catch (const std::exception&) {
+    return PUF_ERR_INTERNAL;
+  }
+}
+
+void puf_latency_reset(void) {
+  SerialReader::latencyStats().reset();
+}
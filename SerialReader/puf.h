@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+ * C interface of the SerialReader (libpuf). Every struct passed in starts with its own size, so fields can be
+ * appended in later versions without breaking callers compiled against this one. Strings and buffers returned by
+ * the library have to be released with the matching puf_*_free function.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PUF_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define PUF_API __attribute__((visibility("default")))
+#else
+#define PUF_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  PUF_OK = 0,
+  PUF_ERR_ARGUMENT = -1,
+  PUF_ERR_OPEN = -2,
+  PUF_ERR_MEASURE = -3,
+  PUF_ERR_CANCELLED = -4,
+  PUF_ERR_BUFFER = -5,
+  PUF_ERR_POS_FILE = -6,
+  PUF_ERR_INTERNAL = -7,
+  PUF_ERR_STORE = -8,
+  PUF_ERR_NOT_ENROLLED = -9,
+  PUF_ERR_FILE = -10
+} puf_status;
+
+typedef struct puf_session puf_session;
+
+typedef struct puf_crp_store puf_crp_store;
+
+typedef struct {
+  size_t struct_size;          /* sizeof(puf_session_config) */
+  const char* serial_port;     /* e.g. "/dev/ttyS0" */
+  const char* gpio_chip;       /* e.g. "gpiochip0" */
+  int baud;                    /* e.g. 115200 */
+  int relay_line;              /* GPIO line of the relay powering the sender */
+  int power_off_seconds;       /* how long the sender is kept off before each measurement */
+  int max_retries;             /* power-cycle retries after a hang or panic, 0 = forever */
+  int watchdog;                /* 0 waits forever instead of power-cycling a hanging sender */
+  const char* replay_file;     /* NULL, or a capture recorded with -c to read instead of the serial port */
+} puf_session_config;
+
+/*
+ * Receives the transfer of a measurement while it arrives. A failed attempt ends with end(user, 0) and is
+ * retried, so begin can be called several times per puf_measure. Returning non-zero from begin or chunk
+ * cancels the measurement.
+ */
+typedef struct {
+  size_t struct_size;                                                         /* sizeof(puf_callbacks) */
+  void* user;
+  /* frame is the text in front of the payload, payload_size is 0 if the firmware does not announce it */
+  int (*begin)(void* user, const char* frame, size_t payload_size);
+  /* data is only valid during the call, offset counts payload bytes */
+  int (*chunk)(void* user, const unsigned char* data, size_t size, uint64_t offset);
+  void (*end)(void* user, int ok);
+} puf_callbacks;
+
+/* The PUF_ABI_VERSION the library was built with */
+PUF_API int puf_abi_version(void);
+
+PUF_API const char* puf_strerror(int status);
+
+PUF_API int puf_session_open(const puf_session_config* config, puf_session** session);
+
+/* Cancels a running measurement first */
+PUF_API void puf_session_close(puf_session* session);
+
+/* Aborts the running puf_measure of the session and powers off the sender, callable from any thread */
+PUF_API void puf_session_cancel(puf_session* session);
+
+/* Why the last call on the session failed, valid until the next call on it */
+PUF_API const char* puf_session_error(const puf_session* session);
+
+/* Bytes of payload a dump with these params will have, 0 for modes that do not dump memory */
+PUF_API size_t puf_payload_size(const char* const* params, int params_size);
+
+/* Runs one measurement and streams its transfer into the callbacks, blocks until it is complete */
+PUF_API int puf_measure(puf_session* session, const char* const* params, int params_size,
+                        const puf_callbacks* callbacks);
+
+/*
+ * Runs one measurement and writes the payload (without frame) into buffer.
+ * *written is set to the payload size; PUF_ERR_BUFFER if it did not fit into capacity.
+ */
+PUF_API int puf_measure_into(puf_session* session, const char* const* params, int params_size,
+                             void* buffer, size_t capacity, size_t* written);
+
+/*
+ * Picks the bits listed in pos_file (one bit index per line, ascending) out of a payload, MSB first.
+ * *key is a NUL-terminated string of '0' and '1' to be released with puf_key_free.
+ */
+PUF_API int puf_key_extract(const void* payload, size_t size, const char* pos_file, int key_size,
+                            char** key, size_t* key_length);
+
+/*
+ * Like puf_key_extract, but packs the key 8 bits per byte (MSB first) into a caller-provided buffer of
+ * (key_size + 7) / 8 bytes. *bits is set to the number of bits, fewer than key_size if positions lie beyond the
+ * payload or pos_file has fewer of them.
+ */
+PUF_API int puf_key_extract_packed(const void* payload, size_t size, const char* pos_file, int key_size,
+                                   unsigned char* key, size_t capacity, size_t* bits);
+
+/* puf_measure_into and puf_key_extract in one go, like gen_key */
+PUF_API int puf_key_generate(puf_session* session, const char* const* params, int params_size,
+                             const char* pos_file, int key_size, char** key, size_t* key_length);
+
+/*
+ * One measurement, one key per pos file: keys[i] gets up to key_sizes[i] bits of pos_files[i] and key_lengths[i]
+ * (if not NULL) its length. All keys are picked while the dump streams in, in one pass. Each key is released
+ * with puf_key_free; on failure none is allocated.
+ */
+PUF_API int puf_keys_generate(puf_session* session, const char* const* params, int params_size,
+                              const char* const* pos_files, const int* key_sizes, int count,
+                              char** keys, size_t* key_lengths);
+
+/* Zeroizes and frees a key */
+PUF_API void puf_key_free(char* key);
+
+/*
+ * Opens a store of enrolled challenge-response pairs (see SerialReader/crp.h); the file is created by the first
+ * enrollment. Safe to use from several threads.
+ */
+PUF_API int puf_crp_open(const char* path, puf_crp_store** store);
+
+PUF_API void puf_crp_close(puf_crp_store* store);
+
+/*
+ * Enrolls a response of board to params, packed 8 bits per byte (MSB first) like puf_key_extract_packed.
+ * mask has the same size, its set bits are reliable; NULL counts every bit.
+ */
+PUF_API int puf_crp_enroll(puf_crp_store* store, const char* board, const char* const* params, int params_size,
+                           const unsigned char* response, const unsigned char* mask, size_t bits);
+
+/*
+ * Compares a fresh response with every enrolled one of board and params that has as many bits. *distance is the
+ * smallest masked fractional Hamming distance, *accepted whether it is at most threshold.
+ * PUF_ERR_NOT_ENROLLED if there is nothing to compare with.
+ */
+PUF_API int puf_crp_verify(puf_crp_store* store, const char* board, const char* const* params, int params_size,
+                           const unsigned char* response, size_t bits, double threshold,
+                           double* distance, int* accepted);
+
+/*
+ * Finds the board whose enrolled response to params is closest to a fresh one, if it is at most max_distance
+ * (fractional) away. The board name is copied NUL-terminated into board, which should hold 64 bytes.
+ * PUF_ERR_NOT_ENROLLED if no board is close enough.
+ */
+PUF_API int puf_crp_identify(puf_crp_store* store, const char* const* params, int params_size,
+                             const unsigned char* response, size_t bits, double max_distance,
+                             char* board, size_t capacity, double* distance);
+
+/* Phases of a measurement in the latency statistics, see SerialReader/latency.h */
+typedef enum {
+  PUF_PHASE_POWER_OFF = 0,     /* relay sleep */
+  PUF_PHASE_POWER_UP = 1,      /* relay on until the first SYN */
+  PUF_PHASE_BOOT = 2,          /* first SYN until "$|" */
+  PUF_PHASE_PROMPT = 3,        /* up to each "|:" */
+  PUF_PHASE_DECAY = 4,         /* last "|:" until "&|" */
+  PUF_PHASE_TRANSFER = 5,      /* "&|" until "|&" */
+  PUF_PHASE_FINISH = 6,        /* "|&" until "|$" */
+  PUF_PHASE_EXTRACT = 7,       /* key extraction */
+  PUF_PHASE_TOTAL = 8          /* relay off until the key, retries included */
+} puf_phase;
+
+typedef struct {
+  size_t struct_size;          /* sizeof(puf_latency) */
+  uint64_t count;
+  uint64_t min_us;
+  uint64_t max_us;
+  double mean_us;
+  uint64_t p50_us;
+  uint64_t p90_us;
+  uint64_t p99_us;
+  uint64_t p999_us;
+} puf_latency;
+
+/* Latencies of one phase over all measurements of the process so far */
+PUF_API int puf_latency_get(int phase, puf_latency* latency);
+
+/*
+ * Writes the latencies of all phases and the events of the last measurement as a NUL-terminated, tab-separated
+ * table into buffer. *written is set to its length; PUF_ERR_BUFFER if it did not fit into capacity.
+ */
+PUF_API int puf_latency_report(char* buffer, size_t capacity, size_t* written);
+
+PUF_API int puf_latency_dump(const char* path);
+
+/* Writes the report to path whenever the process receives signal (e.g. SIGUSR1) */
+PUF_API int puf_latency_dump_on_signal(const char* path, int signal);
+
+PUF_API void puf_latency_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "bit_kernels.h"
+#include "randomness.h"
+
+const char* const SerialReader::randomnessTests[RANDOMNESS_TESTS] = {
+  "monobit", "runs", "block frequency", "approximate entropy", "serial 1", "serial 2"
+};
+
+void SerialReader::BitSequence::push(uint64_t value, const uint32_t count) {
+  if (count == 0) return;
+  if (count < 64) value &= (1ULL << count) - 1;
+  const uint32_t used = bits % 64;
+  if (used == 0) words.push_back(0);
+  if (used + count <= 64) {
+    words.back() |= value << (64 - used - count);
+  } else {
+    words.back() |= value >> (used + count - 64);
+    words.push_back(value << (128 - used - count));
+  }
+  bits += count;
+}
+
+void SerialReader::BitSequence::append(const unsigned char* packed, const size_t count) {
+  size_t i = 0;
+  for (; i + 64 <= count; i += 64) {
+    uint64_t v;
+    std::memcpy(&v, packed + i / 8, 8);
+    push(__builtin_bswap64(v), 64);
+  }
+  for (; i + 8 <= count; i += 8) push(packed[i / 8], 8);
+  if (i < count) push(packed[i / 8] >> (8 - (count - i)), static_cast<uint32_t>(count - i));
+}
+
+void SerialReader::BitSequence::append(const std::string& key) {
+  uint64_t value = 0;
+  uint32_t count = 0;
+  for (const char c : key) {
+    if (c != '0' && c != '1') continue;
+    value = value << 1 | (c == '1');
+    if (++count == 64) {
+      push(value, 64);
+      value = 0;
+      count = 0;
+    }
+  }
+  push(value, count);
+}
+
+void SerialReader::BitSequence::append(const BitSequence& other) {
+  for (size_t i = 0; i < other.bits; i += 64) {
+    const auto n = static_cast<uint32_t>(std::min<size_t>(64, other.bits - i));
+    push(other.window(i) >> (64 - n), n);
+  }
+}
+
+uint64_t SerialReader::BitSequence::window(const size_t from) const {
+  const size_t w = from / 64;
+  const uint32_t s = from % 64;
+  if (w >= words.size()) return 0;
+  uint64_t ret = words[w] << s;
+  if (s != 0 && w + 1 < words.size()) ret |= words[w + 1] >> (64 - s);
+  return ret;
+}
+
+SerialReader::BitSequence SerialReader::BitSequence::slice(const size_t from, const size_t count) const {
+  BitSequence ret;
+  const size_t end = std::min(bits, from + count);
+  for (size_t i = from; i < end; i += 64) {
+    const auto n = static_cast<uint32_t>(std::min<size_t>(64, end - i));
+    ret.push(window(i) >> (64 - n), n);
+  }
+  return ret;
+}
+
+uint64_t SerialReader::BitSequence::ones(const size_t from, const size_t count) const {
+  uint64_t ret = 0;
+  const size_t end = std::min(bits, from + count);
+  for (size_t i = from; i < end; i += 64) {
+    const auto n = static_cast<uint32_t>(std::min<size_t>(64, end - i));
+    ret += __builtin_popcountll(window(i) >> (64 - n));
+  }
+  return ret;
+}
+
+static double igamcSeries(const double a, const double x) {
+  double ap = a;
+  double del = 1 / a;
+  double sum = del;
+  for (int n = 0; n < 10000; n++) {
+    ap += 1;
+    del *= x / ap;
+    sum += del;
+    if (std::fabs(del) < std::fabs(sum) * 1e-15) break;
+  }
+  return 1 - sum * std::exp(-x + a * std::log(x) - std::lgamma(a));
+}
+
+// Lentz's continued fraction, which converges quickly for x > a + 1
+static double igamcFraction(const double a, const double x) {
+  constexpr double tiny = 1e-300;
+  double b = x + 1 - a;
+  double c = 1 / tiny;
+  double d = 1 / b;
+  double h = d;
+  for (int i = 1; i < 10000; i++) {
+    const double an = -i * (i - a);
+    b += 2;
+    d = an * d + b;
+    if (std::fabs(d) < tiny) d = tiny;
+    c = b + an / c;
+    if (std::fabs(c) < tiny) c = tiny;
+    d = 1 / d;
+    const double del = d * c;
+    h *= del;
+    if (std::fabs(del - 1) < 1e-15) break;
+  }
+  return std::exp(-x + a * std::log(x) - std::lgamma(a)) * h;
+}
+
+double SerialReader::igamc(const double a, const double x) {
+  if (x <= 0 || a <= 0) return 1;
+  return std::clamp(x < a + 1 ? igamcSeries(a, x) : igamcFraction(a, x), 0.0, 1.0);
+}
+
+// Bit i and bit i + 1 differ, for i from 0 to n - 2
+static uint64_t transitions(const SerialReader::BitSequence& s) {
+  uint64_t ret = 0;
+  const size_t pairs = s.size() - 1;
+  for (size_t i = 0; i < pairs; i += 63) {
+    const uint64_t x = s.window(i);
+    const auto n = static_cast<uint32_t>(std::min<size_t>(63, pairs - i));
+    ret += __builtin_popcountll((x ^ x << 1) >> (64 - n));
+  }
+  return ret;
+}
+
+// Occurrences of every m bit pattern at every position, wrapping around at the end
+static std::vector<uint32_t> patterns(const SerialReader::BitSequence& s, const uint32_t m) {
+  std::vector<uint32_t> ret(1ULL << m);
+  const size_t n = s.size();
+  const size_t straight = n >= m ? n - m + 1 : 0;
+  for (size_t i = 0; i < straight; i++) ret[s.window(i) >> (64 - m)]++;
+  for (size_t i = straight; i < n; i++) {
+    const auto tail = static_cast<uint32_t>(n - i);
+    ret[(s.window(i) >> (64 - tail)) << (m - tail) | s.window(0) >> (64 - (m - tail))]++;
+  }
+  return ret;
+}
+
+// Patterns of one bit less, since every m - 1 bit pattern starts exactly the m bit patterns that extend it
+static std::vector<uint32_t> fold(const std::vector<uint32_t>& counts) {
+  std::vector<uint32_t> ret(counts.size() / 2);
+  for (size_t p = 0; p < ret.size(); p++) ret[p] = counts[2 * p] + counts[2 * p + 1];
+  return ret;
+}
+
+static double psi2(const std::vector<uint32_t>& counts, const double n) {
+  if (counts.size() < 2) return 0;
+  double sum = 0;
+  for (const uint32_t c : counts) sum += static_cast<double>(c) * c;
+  return static_cast<double>(counts.size()) / n * sum - n;
+}
+
+static double phi(const std::vector<uint32_t>& counts, const double n) {
+  if (counts.size() < 2) return 0;
+  double sum = 0;
+  for (const uint32_t c : counts) {
+    if (c != 0) sum += c / n * std::log(c / n);
+  }
+  return sum;
+}
+
+SerialReader::RandomnessResult SerialReader::testSequence(const BitSequence& sequence,
+                                                          const RandomnessParams& params) {
+  RandomnessResult ret;
+  const size_t bits = sequence.size();
+  if (bits < 2) return ret;
+  const auto n = static_cast<double>(bits);
+  const uint64_t ones = sequence.ones(0, bits);
+
+  ret.p[0] = std::erfc(std::fabs(2 * static_cast<double>(ones) - n) / std::sqrt(2 * n));
+
+  const double pi = static_cast<double>(ones) / n;
+  if (std::fabs(pi - 0.5) < 2 / std::sqrt(n)) {
+    const auto v = static_cast<double>(transitions(sequence) + 1);
+    ret.p[1] = std::erfc(std::fabs(v - 2 * n * pi * (1 - pi)) / (2 * std::sqrt(2 * n) * pi * (1 - pi)));
+  }
+
+  const size_t block = std::clamp<size_t>(params.block, 1, bits);
+  const size_t blocks = bits / block;
+  double chi = 0;
+  for (size_t b = 0; b < blocks; b++) {
+    const double share = static_cast<double>(sequence.ones(b * block, block)) / static_cast<double>(block) - 0.5;
+    chi += share * share;
+  }
+  ret.p[2] = igamc(static_cast<double>(blocks) / 2, 2 * static_cast<double>(block) * chi);
+
+  // The pattern lengths SP 800-22 recommends at most for this many bits
+  const auto log2n = static_cast<int>(std::log2(n));
+  const auto entropy = static_cast<uint32_t>(std::clamp<int>(std::min<int>(params.entropy, log2n - 6), 1, 15));
+  const auto serial = static_cast<uint32_t>(std::clamp<int>(std::min<int>(params.serial, log2n - 3), 3, 16));
+  std::vector<std::vector<uint32_t>> counts(std::max(entropy + 1, serial) + 1);
+  counts.back() = patterns(sequence, static_cast<uint32_t>(counts.size() - 1));
+  for (size_t m = counts.size() - 1; m > 0; m--) counts[m - 1] = fold(counts[m]);
+
+  const double apen = phi(counts[entropy], n) - phi(counts[entropy + 1], n);
+  ret.p[3] = igamc(std::ldexp(1, static_cast<int>(entropy) - 1), n * (std::log(2) - apen));
+
+  const double psi = psi2(counts[serial], n);
+  const double psi1 = psi2(counts[serial - 1], n);
+  const double psi2n = psi2(counts[serial - 2], n);
+  ret.p[4] = igamc(std::ldexp(1, static_cast<int>(serial) - 2), (psi - psi1) / 2);
+  ret.p[5] = igamc(std::ldexp(1, static_cast<int>(serial) - 3), (psi - 2 * psi1 + psi2n) / 2);
+  return ret;
+}
+
+double SerialReader::RandomnessSummary::minPassRate() const {
+  if (sequences == 0) return 1;
+  constexpr double p = 1 - RANDOMNESS_ALPHA;
+  return p - 3 * std::sqrt(p * RANDOMNESS_ALPHA / static_cast<double>(sequences));
+}
+
+bool SerialReader::RandomnessSummary::passes(const size_t test) const {
+  if (sequences == 0) return false;
+  // Below 55 sequences the uniformity of the p-values says little (SP 800-22 section 4.2.2)
+  return static_cast<double>(passed[test]) / static_cast<double>(sequences) >= minPassRate() &&
+         (sequences < 55 || uniformity[test] >= 0.0001);
+}
+
+static unsigned threadCount(const unsigned threads, const size_t work) {
+  const unsigned n = threads != 0 ? threads : std::max(1U, std::thread::hardware_concurrency());
+  return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(n, work)));
+}
+
+SerialReader::RandomnessSummary SerialReader::testSequences(const std::vector<BitSequence>& sequences,
+                                                            const RandomnessParams& params, const unsigned threads) {
+  std::vector<RandomnessResult> results(sequences.size());
+  std::atomic<size_t> next = 0;
+  std::vector<std::thread> workers;
+  for (unsigned t = threadCount(threads, sequences.size()); t > 0; t--) {
+    workers.emplace_back([&] {
+      for (size_t i = next++; i < sequences.size(); i = next++) results[i] = testSequence(sequences[i], params);
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  RandomnessSummary ret;
+  ret.sequences = sequences.size();
+  for (size_t test = 0; test < RANDOMNESS_TESTS; test++) {
+    size_t bins[10] = {};
+    for (const auto& result : results) {
+      if (result.p[test] >= RANDOMNESS_ALPHA) ret.passed[test]++;
+      bins[std::min(9, static_cast<int>(result.p[test] * 10))]++;
+    }
+    const double expected = static_cast<double>(results.size()) / 10;
+    double chi = 0;
+    for (const size_t bin : bins) chi += (bin - expected) * (bin - expected) / expected;
+    ret.uniformity[test] = results.empty() ? 0 : igamc(4.5, chi / 2);
+  }
+  return ret;
+}
+
+SerialReader::UniquenessSummary SerialReader::uniqueness(const std::vector<BitSequence>& keys,
+                                                         const unsigned threads) {
+  UniquenessSummary ret;
+  if (keys.empty() || keys[0].size() == 0) return ret;
+  const size_t bits = keys[0].size();
+  const size_t words = (bits + 63) / 64;
+  std::vector<uint64_t> packed;
+  for (const auto& key : keys) {
+    if (key.size() < bits) continue;
+    const BitSequence cut = key.size() == bits ? key : key.slice(0, bits);
+    packed.insert(packed.end(), cut.getWords().begin(), cut.getWords().end());
+  }
+  const size_t count = packed.size() / words;
+
+  std::vector<uint32_t> aliasing(bits);
+  for (size_t k = 0; k < count; k++) {
+    for (size_t i = 0; i < bits; i++) aliasing[i] += packed[k * words + i / 64] >> (63 - i % 64) & 1;
+  }
+  for (const uint32_t ones : aliasing) {
+    const double share = static_cast<double>(ones) / static_cast<double>(count);
+    ret.minAliasing = std::min(ret.minAliasing, share);
+    ret.maxAliasing = std::max(ret.maxAliasing, share);
+  }
+  if (count < 2) return ret;
+
+  const BitKernels& kernels = bitKernels();
+  std::mutex mutex;
+  double sum = 0;
+  double squares = 0;
+  uint64_t min = bits;
+  uint64_t max = 0;
+  std::atomic<size_t> next = 0;
+  std::vector<std::thread> workers;
+  for (unsigned t = threadCount(threads, count - 1); t > 0; t--) {
+    workers.emplace_back([&] {
+      double localSum = 0;
+      double localSquares = 0;
+      uint64_t localMin = bits;
+      uint64_t localMax = 0;
+      for (size_t i = next++; i + 1 < count; i = next++) {
+        const uint64_t* a = packed.data() + i * words;
+        for (size_t j = i + 1; j < count; j++) {
+          const uint64_t* b = packed.data() + j * words;
+          const uint64_t d = kernels.distance(a, b, words);
+          localSum += static_cast<double>(d);
+          localSquares += static_cast<double>(d) * static_cast<double>(d);
+          localMin = std::min(localMin, d);
+          localMax = std::max(localMax, d);
+        }
+      }
+      std::lock_guard lock(mutex);
+      sum += localSum;
+      squares += localSquares;
+      min = std::min(min, localMin);
+      max = std::max(max, localMax);
+    });
+  }
+  for (auto& worker : workers) worker.join();
+
+  ret.pairs = static_cast<uint64_t>(count) * (count - 1) / 2;
+  const auto pairs = static_cast<double>(ret.pairs);
+  const auto n = static_cast<double>(bits);
+  ret.mean = sum / pairs / n;
+  ret.deviation = std::sqrt(std::max(0.0, squares / pairs - sum / pairs * (sum / pairs))) / n;
+  ret.min = static_cast<double>(min) / n;
+  ret.max = static_cast<double>(max) / n;
+  return ret;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// Significance level of every test
+#define RANDOMNESS_ALPHA 0.01
+// Bits per block of the block frequency test
+#define RANDOMNESS_BLOCK 128
+// Pattern lengths of the serial and approximate entropy tests, lowered for short sequences
+#define RANDOMNESS_SERIAL 8
+#define RANDOMNESS_ENTROPY 6
+#define RANDOMNESS_TESTS 6
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SerialReader {
+  // Bits in order, the first one in the most significant bit of the first word; bits beyond the last are cleared
+  class BitSequence {
+  private:
+    std::vector<uint64_t> words;
+    size_t bits = 0;
+
+    // Appends the lowest count (up to 64) bits of value, most significant first
+    void push(uint64_t value, uint32_t count);
+
+  public:
+    // Appends bits packed MSB first, as gatherBits writes them
+    void append(const unsigned char* packed, size_t count);
+
+    // Appends a key as gen_key returns it, one '0' or '1' per bit
+    void append(const std::string& key);
+
+    void append(const BitSequence& other);
+
+    [[nodiscard]] BitSequence slice(size_t from, size_t count) const;
+
+    [[nodiscard]] size_t size() const {
+      return bits;
+    }
+
+    [[nodiscard]] const std::vector<uint64_t>& getWords() const {
+      return words;
+    }
+
+    // The 64 bits starting at from, the first one most significant; bits beyond the end are 0
+    [[nodiscard]] uint64_t window(size_t from) const;
+
+    // Ones among count bits starting at from
+    [[nodiscard]] uint64_t ones(size_t from, size_t count) const;
+  };
+
+  // p-values of one sequence: monobit, runs, block frequency, approximate entropy and serial (two)
+  struct RandomnessResult {
+    double p[RANDOMNESS_TESTS] = {};
+  };
+
+  extern const char* const randomnessTests[RANDOMNESS_TESTS];
+
+  struct RandomnessParams {
+    uint32_t block = RANDOMNESS_BLOCK;
+    uint32_t serial = RANDOMNESS_SERIAL;
+    uint32_t entropy = RANDOMNESS_ENTROPY;
+  };
+
+  /*
+   * The tests of NIST SP 800-22 that apply to keys of a few hundred bits up to millions of bits. Counts come from
+   * popcounts over words, patterns of the serial and approximate entropy tests are counted once at the longest
+   * length both need and folded down to the shorter ones.
+   */
+  RandomnessResult testSequence(const BitSequence& sequence, const RandomnessParams& params = {});
+
+  struct RandomnessSummary {
+    size_t sequences = 0;
+    // Sequences with p >= RANDOMNESS_ALPHA, per test
+    size_t passed[RANDOMNESS_TESTS] = {};
+    // Whether the p-values of a test are uniform (chi-square over 10 bins, as SP 800-22 section 4.2.2)
+    double uniformity[RANDOMNESS_TESTS] = {};
+
+    // Lowest share of passing sequences that is still within three standard deviations of 1 - RANDOMNESS_ALPHA
+    [[nodiscard]] double minPassRate() const;
+
+    [[nodiscard]] bool passes(size_t test) const;
+  };
+
+  // Tests every sequence on threads threads (0 for one per core)
+  RandomnessSummary testSequences(const std::vector<BitSequence>& sequences, const RandomnessParams& params = {},
+                                  unsigned threads = 0);
+
+  struct UniquenessSummary {
+    uint64_t pairs = 0;
+    // Fractional Hamming distance between the keys of different boards, ideally 0.5 on average
+    double mean = 0;
+    double deviation = 0;
+    double min = 1;
+    double max = 0;
+    // Share of keys in which a bit position is 1, ideally 0.5 for every position
+    double minAliasing = 1;
+    double maxAliasing = 0;
+  };
+
+  // Compares every pair of keys (of the length of the first one, longer ones are cut, shorter ones skipped)
+  UniquenessSummary uniqueness(const std::vector<BitSequence>& keys, unsigned threads = 0);
+
+  // Regularized upper incomplete gamma function Q(a, x), which the tests derive their p-values from
+  double igamc(double a, double x);
+}
@@ -0,0 +1,119 @@
+#include <args.hxx>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include "bit_gather.h"
+#include "dump_file.h"
+#include "randomness.h"
+
+using namespace SerialReader;
+
+// Keys as gen_key returns them, one line of '0' and '1' per key
+static bool readKeys(const std::string& path, std::vector<BitSequence>& keys) {
+  std::ifstream in(path);
+  if (!in) return false;
+  for (std::string line; std::getline(in, line);) {
+    BitSequence key;
+    key.append(line);
+    if (key.size() > 0) keys.push_back(std::move(key));
+  }
+  return true;
+}
+
+// Runs the SP 800-22 tests on extracted keys and compares the keys of different boards
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Tests keys for randomness (monobit, runs, block frequency, approximate entropy, serial) and uniqueness.",
+    "Keys are read from text files with one key of '0' and '1' per line, or extracted from dumps with --pos. "
+    "Every key is tested on its own unless -n cuts all of them together into sequences of that many bits. "
+    "Exits with 1 if a test failed.");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::PositionalList<std::string> filesA(argsParser, "files", "Key files, or dumps with --pos");
+  args::ValueFlag<std::string> posA(argsParser, "pos", "Extract a key from every dump with this pos file",
+                                    {"pos"}, "");
+  args::ValueFlag<int> keySizeA(argsParser, "bits", "Number of positions to read from the pos file",
+                                {'k', "key-size"}, 1024);
+  args::ValueFlag<size_t> lengthA(argsParser, "bits", "Test sequences of this many bits instead of single keys",
+                                  {'n', "length"}, 0);
+  args::ValueFlag<uint32_t> blockA(argsParser, "bits", "Block size of the block frequency test", {"block"},
+                                   RANDOMNESS_BLOCK);
+  args::ValueFlag<uint32_t> serialA(argsParser, "bits", "Pattern length of the serial test", {"serial"},
+                                    RANDOMNESS_SERIAL);
+  args::ValueFlag<uint32_t> entropyA(argsParser, "bits", "Pattern length of the approximate entropy test",
+                                     {"entropy"}, RANDOMNESS_ENTROPY);
+  args::ValueFlag<unsigned> threadsA(argsParser, "threads", "Threads to test on, 0 for one per core",
+                                     {'j', "threads"}, 0);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  std::vector<BitSequence> keys;
+  std::optional<KeyPositions> positions;
+  if (!args::get(posA).empty()) positions = KeyPositions::load(args::get(posA), args::get(keySizeA));
+  for (const auto& file : args::get(filesA)) {
+    if (!positions) {
+      if (!readKeys(file, keys)) std::cerr << "Could not read " << file << std::endl;
+      continue;
+    }
+    const DumpReader dump(file);
+    if (!dump.isOpen()) {
+      std::cerr << "Could not read " << file << std::endl;
+      continue;
+    }
+    std::vector<unsigned char> packed((positions->size() + 7) / 8);
+    const size_t bits = gatherBits(dump.payload, dump.size, *positions, packed.data());
+    if (bits > 0) keys.emplace_back().append(packed.data(), bits);
+    explicit_bzero(packed.data(), packed.size());
+  }
+  if (keys.empty()) {
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  std::vector<BitSequence> sequences;
+  if (const size_t length = args::get(lengthA); length > 0) {
+    BitSequence all;
+    for (const auto& key : keys) all.append(key);
+    for (size_t from = 0; from + length <= all.size(); from += length) sequences.push_back(all.slice(from, length));
+    if (sequences.empty()) sequences.push_back(std::move(all));
+  } else {
+    sequences = keys;
+  }
+
+  const RandomnessParams params{args::get(blockA), args::get(serialA), args::get(entropyA)};
+  const auto start = std::chrono::steady_clock::now();
+  const RandomnessSummary summary = testSequences(sequences, params, args::get(threadsA));
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  size_t total = 0;
+  for (const auto& sequence : sequences) total += sequence.size();
+  std::cout << summary.sequences << " sequences, " << total << " bits, " << ms << " ms" << std::endl;
+  std::cout << "Pass rate needed: " << summary.minPassRate() << std::endl;
+  int ret = 0;
+  for (size_t test = 0; test < RANDOMNESS_TESTS; test++) {
+    std::printf("%-20s %8zu/%-8zu uniformity %.6f  %s\n", randomnessTests[test], summary.passed[test],
+                summary.sequences, summary.uniformity[test], summary.passes(test) ? "pass" : "FAIL");
+    if (!summary.passes(test)) ret = 1;
+  }
+
+  if (keys.size() > 1) {
+    const UniquenessSummary unique = uniqueness(keys, args::get(threadsA));
+    std::printf("Uniqueness: %llu pairs, distance %.4f (deviation %.4f, %.4f to %.4f), ones per bit %.4f to %.4f\n",
+                static_cast<unsigned long long>(unique.pairs), unique.mean, unique.deviation, unique.min, unique.max,
+                unique.minAliasing, unique.maxAliasing);
+  }
+  return ret;
+}
@@ -1,3 +1,4 @@
+#include <cstring>
 #include "receiver.h"
 #include "runnerc.h"
 
@@ -5,3 +6,9 @@ char* get_key(const char* _serialPort, const char* _gpioChip, const int baud, co
               const char** _params, const int params_size, const char* _pos_file, const int key_size) {
   return gen_key(_serialPort, _gpioChip, baud, rpi_power_port, sleep, _params, params_size, _pos_file, key_size);
 }
+
+void free_key(char* key) {
+  if (key == nullptr) return;
+  explicit_bzero(key, std::strlen(key));
+  delete[] key;
+}
@@ -6,7 +6,10 @@
 #define EXTERNC
 #endif
 
-char* get_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_power_port, int sleep,
-              const char** _params, int params_size, const char* _pos_file, int key_size);
+EXTERNC char* get_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_power_port, int sleep,
+                      const char** _params, int params_size, const char* _pos_file, int key_size);
+
+// Releases a key returned by get_key, see puf.h for the versioned interface
+EXTERNC void free_key(char* key);
 
 #undef EXTERNC
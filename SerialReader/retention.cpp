@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bytes.h"
+#include "dump_file.h"
+#include "dump_view.h"
+#include "retention.h"
+
+SerialReader::RetentionBuilder::RetentionBuilder(const Challenge& _challenge, const double _reliability)
+  : challenge(_challenge), reliability(_reliability) {
+  challenge.decay = 0;
+}
+
+void SerialReader::RetentionBuilder::add(const std::string& path, const int decay) {
+  dumps[decay].push_back(path);
+}
+
+// Splits the payload into rows, mirroring which words puf_read_all skips
+static std::vector<SerialReader::RetentionRow> splitRows(const SerialReader::Challenge& challenge,
+                                                         const uint64_t size) {
+  std::vector<SerialReader::RetentionRow> rows;
+  const SerialReader::DumpView layout(nullptr, size, challenge);
+  for (const SerialReader::DumpRow& r : layout.rows()) {
+    SerialReader::RetentionRow row;
+    row.bank = r.bank;
+    row.row = r.row;
+    row.first = r.first * 32;
+    row.bits = r.words * 32;
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+// Packs count levels (a multiple of 8) into RETENTION_LEVEL_BITS bits each, MSB first, RETENTION_NEVER as 63
+static void packLevels(const uint8_t* levels, const uint64_t count, unsigned char* out) {
+  for (uint64_t i = 0; i < count; i += 8) {
+    uint64_t group = 0;
+    for (int k = 0; k < 8; k++) group = group << 6 | std::min<uint8_t>(levels[i + k], RETENTION_LEVELS);
+    for (int k = 5; k >= 0; k--) *out++ = static_cast<unsigned char>(group >> 8 * k);
+  }
+}
+
+bool SerialReader::RetentionBuilder::write(const std::string& path) {
+  const uint64_t size = challenge.payloadSize();
+  if (!challenge.isDump() || size == 0) {
+    error = "the challenge does not read memory";
+    return false;
+  }
+  if (dumps.empty() || dumps.size() > RETENTION_LEVELS) {
+    error = "there have to be 1 to " + std::to_string(RETENTION_LEVELS) + " decay times";
+    return false;
+  }
+
+  // All dumps stay mapped, building walks them chunk by chunk
+  std::vector<std::vector<std::unique_ptr<DumpReader>>> levels;
+  uint32_t runs = 0;
+  for (const auto& [decay, paths] : dumps) {
+    auto& readers = levels.emplace_back();
+    for (const auto& file : paths) {
+      auto reader = std::make_unique<DumpReader>(file);
+      if (!reader->isOpen() || reader->size != size) {
+        error = file + " is not a dump of " + std::to_string(size) + " bytes";
+        return false;
+      }
+      readers.push_back(std::move(reader));
+      runs++;
+    }
+  }
+
+  std::vector<RetentionRow> rows = splitRows(challenge, size);
+  unsigned char header[RETENTION_HEADER_SIZE]{};
+  std::memcpy(header, RETENTION_MAGIC, sizeof(RETENTION_MAGIC));
+  putU32(header + 8, RETENTION_VERSION);
+  putU32(header + 12, RETENTION_HEADER_SIZE);
+  putU64(header + 16, size);
+  putU32(header + 24, static_cast<uint32_t>(levels.size()));
+  putU32(header + 28, static_cast<uint32_t>(rows.size()));
+  putChallenge(header + 32, challenge);
+  putU32(header + 68, static_cast<uint32_t>(std::lround(reliability * 1e6)));
+  putU32(header + 72, runs);
+  unsigned char* decay = header + 128;
+  for (const auto& [time, _] : dumps) {
+    putU32(decay, static_cast<uint32_t>(time));
+    decay += 4;
+  }
+
+  // The rows are only known once every cell is, they are written over these zeros at the end
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+  const std::vector<char> empty(rows.size() * RETENTION_ROW_SIZE);
+  out.write(empty.data(), static_cast<std::streamsize>(empty.size()));
+
+  unsigned char pattern[4];
+  for (int i = 0; i < 4; i++) pattern[i] = static_cast<unsigned char>(challenge.init >> 8 * (3 - i));
+  // Only one chunk of cells is held at a time, packed as it is written
+  std::vector<uint8_t> cells(RETENTION_CHUNK * 8);
+  std::vector<unsigned char> packed(RETENTION_CHUNK * RETENTION_LEVEL_BITS);
+  std::vector<uint16_t> counts(RETENTION_CHUNK * 8);
+  size_t nextRow = 0;
+  for (uint64_t chunk = 0; chunk < size && out; chunk += RETENTION_CHUNK) {
+    const uint64_t n = std::min<uint64_t>(RETENTION_CHUNK, size - chunk);
+    std::fill_n(cells.begin(), n * 8, RETENTION_NEVER);
+    for (size_t l = 0; l < levels.size(); l++) {
+      std::fill_n(counts.begin(), n * 8, 0);
+      for (const auto& reader : levels[l]) {
+        const unsigned char* p = reader->payload + chunk;
+        for (uint64_t i = 0; i < n; i++) {
+          unsigned int flips = p[i] ^ pattern[(chunk + i) % 4];
+          while (flips != 0) {
+            const int bit = __builtin_clz(flips) - 24;
+            counts[i * 8 + bit]++;
+            flips &= ~(0x80U >> bit);
+          }
+        }
+      }
+      const auto needed = std::max<uint32_t>(
+        1, static_cast<uint32_t>(std::ceil(reliability * static_cast<double>(levels[l].size()) - 1e-9)));
+      for (uint64_t i = 0; i < n * 8; i++) {
+        if (cells[i] == RETENTION_NEVER && counts[i] >= needed) cells[i] = static_cast<uint8_t>(l);
+      }
+    }
+
+    // Rows are in payload order, a row can continue in the next chunk
+    const uint64_t first = chunk * 8;
+    const uint64_t last = first + n * 8;
+    for (size_t r = nextRow; r < rows.size() && rows[r].first < last; r++) {
+      RetentionRow& row = rows[r];
+      const uint64_t to = std::min<uint64_t>(row.first + row.bits, last);
+      for (uint64_t bit = std::max(row.first, first); bit < to; bit++) {
+        const uint8_t l = cells[bit - first];
+        row.minLevel = std::min(row.minLevel, l);
+        row.maxLevel = std::max(row.maxLevel, l);
+        row.levels |= 1ULL << std::min<int>(l, RETENTION_LEVELS);
+      }
+      if (row.first + row.bits <= last) nextRow = r + 1;
+    }
+
+    packLevels(cells.data(), n * 8, packed.data());
+    out.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(n * RETENTION_LEVEL_BITS));
+  }
+
+  out.seekp(RETENTION_HEADER_SIZE);
+  for (const auto& row : rows) {
+    unsigned char entry[RETENTION_ROW_SIZE]{};
+    putU32(entry, row.bank);
+    putU32(entry + 4, row.row);
+    putU64(entry + 8, row.first);
+    putU32(entry + 16, row.bits);
+    entry[20] = row.minLevel;
+    entry[21] = row.maxLevel;
+    putU64(entry + 24, row.levels);
+    out.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+  }
+  out.flush();
+  if (!out) {
+    error = "could not write " + path;
+    return false;
+  }
+  return true;
+}
+
+SerialReader::RetentionMap::RetentionMap(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size >= RETENTION_HEADER_SIZE) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m != MAP_FAILED) {
+      map = static_cast<const unsigned char*>(m);
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+  if (map == nullptr) return;
+  size = getU64(map + 16);
+  const uint32_t levels = getU32(map + 24);
+  rowCount = getU32(map + 28);
+  if (std::memcmp(map, RETENTION_MAGIC, sizeof(RETENTION_MAGIC)) != 0 || levels > RETENTION_LEVELS ||
+      getU32(map + 8) != RETENTION_VERSION ||
+      mapSize != RETENTION_HEADER_SIZE + static_cast<uint64_t>(rowCount) * RETENTION_ROW_SIZE +
+                 size * RETENTION_LEVEL_BITS) {
+    munmap(const_cast<unsigned char*>(map), mapSize);
+    map = nullptr;
+    return;
+  }
+  challenge = getChallenge(map + 32);
+  reliability = getU32(map + 68) / 1e6;
+  runs = getU32(map + 72);
+  for (uint32_t l = 0; l < levels; l++) decays.push_back(static_cast<int>(getU32(map + 128 + 4 * l)));
+  rows = map + RETENTION_HEADER_SIZE;
+  cells = rows + static_cast<size_t>(rowCount) * RETENTION_ROW_SIZE;
+}
+
+SerialReader::RetentionMap::~RetentionMap() {
+  if (map != nullptr) munmap(const_cast<unsigned char*>(map), mapSize);
+}
+
+SerialReader::RetentionRow SerialReader::RetentionMap::row(const uint32_t index) const {
+  const unsigned char* entry = rows + static_cast<size_t>(index) * RETENTION_ROW_SIZE;
+  RetentionRow ret;
+  ret.bank = getU32(entry);
+  ret.row = getU32(entry + 4);
+  ret.first = getU64(entry + 8);
+  ret.bits = getU32(entry + 16);
+  ret.minLevel = entry[20];
+  ret.maxLevel = entry[21];
+  ret.levels = getU64(entry + 24);
+  return ret;
+}
+
+uint8_t SerialReader::RetentionMap::level(const uint64_t bit) const {
+  // A cell starts at bit 0, 2, 4 or 6 of a byte, so it spans at most two
+  const uint64_t offset = bit * RETENTION_LEVEL_BITS;
+  const unsigned char* p = cells + offset / 8;
+  const unsigned shift = offset % 8;
+  const unsigned v = shift <= 2 ? p[0] >> (2 - shift) : (p[0] << 8 | p[1]) >> (10 - shift);
+  const auto l = static_cast<uint8_t>(v & 0x3F);
+  return l == RETENTION_LEVELS ? RETENTION_NEVER : l;
+}
+
+int SerialReader::RetentionMap::retention(const uint64_t bit) const {
+  const uint8_t l = level(bit);
+  return l < decays.size() ? decays[l] : -1;
+}
+
+uint64_t SerialReader::RetentionMap::levelMask(const int minDecay, const int maxDecay) const {
+  uint64_t mask = 0;
+  for (size_t l = 0; l < decays.size(); l++) {
+    if (decays[l] >= minDecay && decays[l] <= maxDecay) mask |= 1ULL << l;
+  }
+  return mask;
+}
+
+std::vector<uint64_t> SerialReader::RetentionMap::select(const RetentionQuery& query) const {
+  std::vector<uint64_t> ret;
+  const uint64_t mask = levelMask(query.minDecay, query.maxDecay);
+  if (mask == 0) return ret;
+  for (uint32_t i = 0; i < rowCount; i++) {
+    const RetentionRow r = row(i);
+    if ((query.bank && r.bank != *query.bank) || r.row < query.firstRow || r.row > query.lastRow ||
+        (r.levels & mask) == 0) {
+      continue;
+    }
+    for (uint64_t bit = r.first; bit < r.first + r.bits; bit++) {
+      const uint8_t l = level(bit);
+      if (l < RETENTION_LEVELS && mask >> l & 1) ret.push_back(bit);
+    }
+  }
+  return ret;
+}
+
+std::vector<uint64_t> SerialReader::RetentionMap::histogram() const {
+  std::vector<uint64_t> ret(decays.size() + 1);
+  for (uint64_t bit = 0; bit < size * 8; bit++) {
+    const uint8_t l = level(bit);
+    ret[l < decays.size() ? l : decays.size()]++;
+  }
+  return ret;
+}
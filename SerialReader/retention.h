@@ -0,0 +1,131 @@
+#pragma once
+
+#define RETENTION_MAGIC "PUFRETN"
+#define RETENTION_VERSION 2
+#define RETENTION_HEADER_SIZE 512
+// Levels fit a 64 bit mask per row, the last bit of which stands for RETENTION_NEVER
+#define RETENTION_LEVELS 63
+// Level of the cells that did not flip reliably at any of the decay times
+#define RETENTION_NEVER 255
+// Bits per cell in the file, enough for every level and RETENTION_NEVER (stored as RETENTION_LEVELS)
+#define RETENTION_LEVEL_BITS 6
+#define RETENTION_ROW_SIZE 32
+// Payload bytes processed at a time while building, bounds the flip counters and the cells held in memory
+#define RETENTION_CHUNK 65536
+#define RETENTION_EXTENSION ".pufr"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "challenge.h"
+
+namespace SerialReader {
+  // A contiguous stretch of payload bits that lies in one DRAM row of one bank
+  struct RetentionRow {
+    uint32_t bank = 0;
+    uint32_t row = 0;
+    // Payload bit index of the first cell, MSB first like in pos files
+    uint64_t first = 0;
+    uint32_t bits = 0;
+    uint8_t minLevel = RETENTION_NEVER;
+    uint8_t maxLevel = 0;
+    // Bit l is set if a cell of the row has level l, bit 63 if one has RETENTION_NEVER
+    uint64_t levels = 0;
+  };
+
+  /*
+   * Collects the dumps of a decay sweep (one challenge, several decay times) and quantizes them into a retention
+   * map: every cell gets the level of the shortest decay time at which it differed from the init value in at least
+   * reliability of the runs.
+   */
+  class RetentionBuilder {
+  private:
+    Challenge challenge;
+    double reliability;
+    // Dump paths by decay time
+    std::map<int, std::vector<std::string>> dumps;
+    std::string error;
+
+  public:
+    RetentionBuilder(const Challenge& _challenge, double _reliability);
+
+    void add(const std::string& path, int decay);
+
+    // Reads the dumps and writes the map, false on error
+    bool write(const std::string& path);
+
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+  };
+
+  // Selects cells, rows are inclusive and so are the decay times (in seconds)
+  struct RetentionQuery {
+    std::optional<uint32_t> bank;
+    uint32_t firstRow = 0;
+    uint32_t lastRow = std::numeric_limits<uint32_t>::max();
+    int minDecay = 0;
+    int maxDecay = std::numeric_limits<int>::max();
+  };
+
+  /*
+   * Read-only mapping of a retention map. The rows of the index let a query skip the rows of other banks and
+   * the rows that have no cell in the asked-for levels.
+   *
+   * Layout (little endian):
+   *   header (RETENTION_HEADER_SIZE bytes): "PUFRETN\0", u32 version, u32 header size, u64 payload size,
+   *     u32 levels, u32 rows, challenge (CHALLENGE_SIZE bytes, the decay is 0), u32 reliability in millionths,
+   *     u32 runs, 24 bytes reserved, then at offset 128 the decay time of every level, ascending
+   *   rows (RETENTION_ROW_SIZE bytes each): u32 bank, u32 row, u64 first bit, u32 bits, u8 min level,
+   *     u8 max level, u16 reserved, u64 level mask
+   *   cells: the level of every payload bit in RETENTION_LEVEL_BITS bits, MSB first, so 8 cells take 6 bytes
+   */
+  class RetentionMap {
+  private:
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    const unsigned char* rows = nullptr;
+    const unsigned char* cells = nullptr;
+
+    // Mask of the levels with a decay time in [minDecay, maxDecay]
+    [[nodiscard]] uint64_t levelMask(int minDecay, int maxDecay) const;
+
+  public:
+    Challenge challenge;
+    uint64_t size = 0;
+    double reliability = 0;
+    uint32_t runs = 0;
+    std::vector<int> decays;
+    uint32_t rowCount = 0;
+
+    explicit RetentionMap(const std::string& path);
+
+    ~RetentionMap();
+
+    RetentionMap(const RetentionMap&) = delete;
+
+    RetentionMap& operator=(const RetentionMap&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return map != nullptr;
+    }
+
+    [[nodiscard]] RetentionRow row(uint32_t index) const;
+
+    // RETENTION_NEVER for the cells that never flipped reliably
+    [[nodiscard]] uint8_t level(uint64_t bit) const;
+
+    // Decay time of the level of a cell, -1 for RETENTION_NEVER
+    [[nodiscard]] int retention(uint64_t bit) const;
+
+    // Payload bit indices of the matching cells, ascending
+    [[nodiscard]] std::vector<uint64_t> select(const RetentionQuery& query) const;
+
+    // Number of cells per level, the last entry counts RETENTION_NEVER
+    [[nodiscard]] std::vector<uint64_t> histogram() const;
+  };
+}
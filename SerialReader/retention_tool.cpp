@@ -0,0 +1,170 @@
+#include <args.hxx>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "catalog.h"
+#include "dump_file.h"
+#include "dump_view.h"
+#include "retention.h"
+
+using namespace SerialReader;
+
+// Builds a retention map from a decay sweep and selects cells by where they are and how long they hold their value
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Quantizes a decay sweep into the shortest decay time at which every cell reliably flips.",
+    "Commands: build MAP DUMP... (the decay time comes from described dumps, else from the catalog, else from -p), "
+    "info MAP (cells per decay time), query MAP (cells by bank, rows and decay time), cell MAP INDEX");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "build, info, query or cell");
+  args::Positional<std::string> mapA(argsParser, "map", "Retention map");
+  args::PositionalList<std::string> filesA(argsParser, "args", "Dumps of the sweep or a bit index");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params", "build: params the raw dumps were measured with",
+                                           {'p', "params"});
+  args::ValueFlag<std::string> catalogA(argsParser, "catalog", "build: catalog that knows the raw dumps",
+                                        {'c', "catalog"}, "");
+  args::ValueFlag<double> reliabilityA(argsParser, "reliability",
+                                       "build: share of the runs of a decay time in which a cell has to flip",
+                                       {'r', "reliability"}, 1.0);
+  args::ValueFlag<uint32_t> bankA(argsParser, "bank", "query: bank", {"bank"});
+  args::ValueFlag<uint32_t> firstRowA(argsParser, "row", "query: first row", {"first-row"}, 0);
+  args::ValueFlag<uint32_t> lastRowA(argsParser, "row", "query: last row", {"last-row"},
+                                     std::numeric_limits<uint32_t>::max());
+  args::ValueFlag<int> minA(argsParser, "seconds", "query: shortest retention", {"min"}, 0);
+  args::ValueFlag<int> maxA(argsParser, "seconds", "query: longest retention", {"max"},
+                            std::numeric_limits<int>::max());
+  args::ValueFlag<std::string> posA(argsParser, "pos", "query: write the cells as a pos file instead",
+                                    {'o', "pos"}, "");
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  const std::string& file = args::get(mapA);
+  const std::vector<std::string>& files = args::get(filesA);
+
+  if (command == "build") {
+    std::optional<Catalog> catalog;
+    if (!args::get(catalogA).empty()) {
+      catalog.emplace(args::get(catalogA));
+      if (!catalog->load()) {
+        std::cerr << "Could not read " << args::get(catalogA) << std::endl;
+        return 1;
+      }
+    }
+    const Challenge given = Challenge::fromParams(args::get(paramsA));
+    std::optional<RetentionBuilder> builder;
+    Challenge challenge;
+    for (const auto& dump : files) {
+      Challenge c;
+      if (const DumpReader reader(dump); reader.described) {
+        c = reader.info.challenge;
+      } else if (const CatalogEntry* entry = catalog ? catalog->find(dump) : nullptr) {
+        c = entry->challenge;
+      } else if (!args::get(paramsA).empty()) {
+        c = given;
+      } else {
+        std::cerr << "The decay time of " << dump << " is unknown, catalog it with its params first" << std::endl;
+        return 1;
+      }
+      if (!builder) {
+        challenge = c;
+        builder.emplace(challenge, args::get(reliabilityA));
+      } else if (c.start != challenge.start || c.end != challenge.end || c.init != challenge.init ||
+                 c.addMode != challenge.addMode) {
+        std::cerr << dump << " was measured with another challenge" << std::endl;
+        return 1;
+      }
+      builder->add(dump, c.decay);
+    }
+    if (!builder) {
+      std::cerr << argsParser;
+      return 1;
+    }
+    if (!builder->write(file)) {
+      std::cerr << builder->getError() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  const RetentionMap map(file);
+  if (!map.isOpen()) {
+    std::cerr << "Could not read " << file << std::endl;
+    return 1;
+  }
+  // Only the layout, to locate cells
+  const DumpView layout(nullptr, map.size, map.challenge);
+
+  if (command == "info") {
+    const std::vector<uint64_t> counts = map.histogram();
+    std::cout << "runs " << map.runs << std::endl
+      << "reliability " << map.reliability << std::endl
+      << "rows " << map.rowCount << std::endl
+      << "decay\tcells" << std::endl;
+    for (size_t l = 0; l < map.decays.size(); l++) std::cout << map.decays[l] << '\t' << counts[l] << std::endl;
+    std::cout << "never\t" << counts.back() << std::endl;
+    return 0;
+  }
+
+  if (command == "query") {
+    RetentionQuery query;
+    if (bankA) query.bank = args::get(bankA);
+    query.firstRow = args::get(firstRowA);
+    query.lastRow = args::get(lastRowA);
+    query.minDecay = args::get(minA);
+    query.maxDecay = args::get(maxA);
+    const std::vector<uint64_t> bits = map.select(query);
+    if (!args::get(posA).empty()) {
+      std::ofstream out(args::get(posA));
+      for (const uint64_t bit : bits) out << bit << '\n';
+      return out ? 0 : 1;
+    }
+    std::cout << "bit\tbank\trow\tcol\tdecay\n";
+    for (const uint64_t bit : bits) {
+      const Cell cell = layout.cell(bit / 32);
+      std::cout << bit << '\t' << cell.bank << '\t' << cell.row << '\t' << cell.col << '\t' << map.retention(bit)
+        << '\n';
+    }
+    return 0;
+  }
+
+  if (command == "cell" && files.size() == 1) {
+    uint64_t bit;
+    try {
+      bit = std::stoull(files[0]);
+    } catch (const std::exception& _) {
+      std::cerr << files[0] << " is no bit index" << std::endl;
+      std::cerr << argsParser;
+      return 1;
+    }
+    if (bit >= map.size * 8) {
+      std::cerr << "There are only " << map.size * 8 << " cells" << std::endl;
+      return 1;
+    }
+    const Cell cell = layout.cell(bit / 32);
+    std::cout << "bank " << cell.bank << ", row " << cell.row << ", col " << cell.col << ", bit " << 31 - bit % 32
+      << ", retention ";
+    if (map.retention(bit) < 0) {
+      std::cout << "beyond " << map.decays.back() << " s" << std::endl;
+    } else {
+      std::cout << map.retention(bit) << " s" << std::endl;
+    }
+    return 0;
+  }
+
+  std::cerr << argsParser;
+  return 1;
+}
@@ -1,29 +1,169 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <poll.h>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <unistd.h>
+#include "archive.h"
+#include "bit_gather.h"
+#include "catalog.h"
+#include "challenge.h"
+#include "dump_file.h"
+#include "flips.h"
 #include "gpio_utils.h"
+#include "key_pool.h"
+#include "key_sink.h"
+#include "keygen.h"
 #include "logger.h"
 #include "parser.h"
 #include "runner.h"
+#include "stability.h"
+#include "survey.h"
+#include "transposed.h"
+#include "watchdog.h"
 
 void SerialReader::run(Parser& parser) {
-  Runner runner(parser.getSerialPort().c_str(), parser.getGpioChip().c_str(),
-                parser.getUSBPort(), parser.getBaudRate());
+  Runner runner(parser);
   bool running = true;
   int count = 0;
+  int failures = 0;
+  std::unique_ptr<Catalog> catalog;
+  if (!parser.getCatalog().empty()) {
+    catalog = std::make_unique<Catalog>(parser.getCatalog());
+  }
+  std::unique_ptr<StabilityMap> stability;
+  if (!parser.getStability().empty()) {
+    stability = std::make_unique<StabilityMap>(parser.getStability(), Challenge::fromParams(parser.getParams()),
+                                               parser.getStableThreshold());
+    if (!stability->isOpen()) {
+      std::cerr << "Not counting stable bits, " << stability->getError() << std::endl;
+      stability.reset();
+    }
+  }
+  std::unique_ptr<TransposedWriter> transposed;
+  if (!parser.getTransposed().empty()) {
+    transposed = std::make_unique<TransposedWriter>(parser.getTransposed(), Challenge::fromParams(parser.getParams()));
+    if (!transposed->isOpen()) {
+      std::cerr << "Not transposing dumps, " << transposed->getError() << std::endl;
+      transposed.reset();
+    }
+  }
   while (running) {
-    std::ofstream pufOutput(parser.getOutPrefix() + std::to_string(count) + ".bin");
+    const bool archive = parser.getFormat() == DumpFormat::ARCHIVE;
+    const std::string name = parser.getOutPrefix() + std::to_string(count) + (archive ? ARCHIVE_EXTENSION : ".bin");
+    // The file is only created once the transfer starts
+    std::unique_ptr<DumpSink> pufOutput;
+    if (archive) {
+      pufOutput = std::make_unique<ArchiveWriter>(name, parser.getReference());
+    } else {
+      pufOutput = std::make_unique<DumpWriter>(name, parser.getFormat());
+    }
+    DumpSink* output = pufOutput.get();
+    std::unique_ptr<DumpSink> counted;
+    if (stability) {
+      counted = std::make_unique<StabilitySink>(*output, *stability);
+      output = counted.get();
+    }
+    std::unique_ptr<DumpSink> runs;
+    if (transposed) {
+      runs = std::make_unique<TransposedSink>(*output, *transposed);
+      output = runs.get();
+    }
+    std::unique_ptr<DumpSink> indexed;
+    if (parser.getFlips()) {
+      indexed = std::make_unique<FlipSink>(*output, name + FLIP_EXTENSION);
+      output = indexed.get();
+    }
+    std::unique_ptr<DumpSink> surveyed;
+    if (Challenge::fromParams(parser.getParams()).isSurvey()) {
+      surveyed = std::make_unique<SurveySink>(*output, name + SURVEY_EXTENSION);
+      output = surveyed.get();
+    }
+    std::unique_ptr<DumpSink> cataloged;
+    if (catalog) {
+      cataloged = std::make_unique<CatalogSink>(*output, *catalog, name, parser.getBoard(), parser.getSensor());
+      output = cataloged.get();
+    }
+    const uint32_t measured = stability ? stability->measurements() : 0;
     runner.reset(parser);
-    running = runner.loop(parser, pufOutput, count);
+    running = runner.loop(parser, *output, count);
+    if (!runner.getFailure().empty()) {
+      running = runner.recover(parser, ++failures, name);
+    } else {
+      failures = 0;
+    }
+    if (stability && stability->measurements() != measured) {
+      std::cout << std::endl << stability->stable() << " stable bits after " << stability->measurements()
+                << " measurements" << std::endl;
+      if (parser.getStableBits() > 0 && stability->converged(parser.getStableBits())) {
+        std::cout << "Stable bits converged" << std::endl;
+        running = false;
+      }
+    }
   }
   runner.release();
+  if (stability && !stability->writePositions(parser.getStability() + ".pos")) {
+    std::cerr << "Could not write " << parser.getStability() << ".pos" << std::endl;
+  }
 }
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "hicpp-signed-bitwise"
 
+std::string SerialReader::extractKey(const std::string& out_str, const std::string& pos_file, const int key_size) {
+  return extractKey(out_str.data(), out_str.size(), pos_file, key_size);
+}
+
+std::string SerialReader::extractKey(const char* out, const size_t size, const std::string& pos_file,
+                                     const int key_size) {
+  const auto* comma = static_cast<const char*>(std::memchr(out, ',', size));
+  if (comma == nullptr) return {};
+  return extractBits(comma + 1, out + size - comma - 1, pos_file, key_size);
+}
+
+std::string SerialReader::extractBits(const char* payload, const size_t size, const std::string& _pos_file,
+                                      const int key_size) {
+  const KeyPositions positions = KeyPositions::load(_pos_file, key_size);
+  std::vector<unsigned char> packed((positions.size() + 7) / 8);
+  const size_t bits = gatherBits(reinterpret_cast<const unsigned char*>(payload), size, positions, packed.data());
+  std::string result(bits, '0');
+  for (size_t i = 0; i < bits; i++) {
+    result[i] = static_cast<char>('0' + (packed[i / 8] >> (7 - i % 8) & 1));
+  }
+  explicit_bzero(packed.data(), packed.size());
+  return result;
+}
+
+static char* copy_key(const std::string& key, const int key_size) {
+  auto result = new char[(key_size > 0 ? key_size : 0) + 1]();
+  key.copy(result, key.size());
+  return result;
+}
+
+// Measures once and picks all keys while the dump streams in, so nothing but the keys is kept in memory
+static std::unique_ptr<char*[]> measure_keys(SerialReader::Parser& parser, const char* const* pos_files,
+                                             const int* key_sizes, const int count) {
+  std::vector<SerialReader::KeySpec> specs;
+  for (int i = 0; i < count; i++) specs.push_back({pos_files[i], key_sizes[i]});
+  SerialReader::KeySink sink(specs);
+  SerialReader::Runner runner(parser);
+  run(runner, parser, sink);
+  runner.release();
+  auto keys = std::make_unique<char*[]>(count > 0 ? count : 1);
+  for (int i = 0; i < count; i++) {
+    std::string key = sink.key(i);
+    keys[i] = copy_key(key, key_sizes[i]);
+    explicit_bzero(key.data(), key.size());
+  }
+  runner.trace.mark(SerialReader::TraceEvent::EXTRACTED);
+  return keys;
+}
+
 char* gen_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_power_port, int sleep,
               const char** _params, int params_size, const char* _pos_file, int key_size) {
   std::string serialPort(_serialPort);
@@ -33,61 +173,138 @@ char* gen_key(const char* _serialPort, const char* _gpioChip, int baud, int rpi_
   params.reserve(params_size);
   for (int i = 0; i < params_size; i++)
     params.emplace_back(_params[i]);
-  auto parser = SerialReader::Parser(serialPort, gpioChip, baud, rpi_power_port,
-                                     sleep, 1, true, outName, params);
-  std::ostringstream out;
-  run(parser, out);
-  std::string out_str = out.str();
-  const char* in = out_str.c_str();
-  std::ifstream pos_file(_pos_file);
-  auto result = new char[key_size];
-  int nextBit;
-  pos_file >> nextBit;
-  int count = 0;
-  int index = 0;
-  bool commaFound = false;
-  bool nextLine = true;
-  while (nextLine) {
-    if (commaFound) {
-      for (int shift = 7; shift >= 0 && nextLine; shift--) {
-        if (count == nextBit) {
-          result[index++] = static_cast<char>((*in >> shift & 1) + '0');
-          if (!(pos_file >> nextBit)) {
-            nextLine = false;
-          }
-        }
-        count++;
-      }
-    } else {
-      if (*in == ',') {
-        commaFound = true;
-      }
+  if (const auto pool = SerialReader::getKeyPool()) {
+    if (std::string key; pool->take(params, _pos_file, key_size, key)) {
+      return copy_key(key, key_size);
     }
-    in++;
   }
-  return result;
+  auto parser = SerialReader::Parser({
+    .serialPort = serialPort, .gpioChip = gpioChip, .baudRate = baud, .usbPort = rpi_power_port, .usbSleep = sleep,
+    .outPrefix = outName, .params = params
+  });
+  std::lock_guard board(SerialReader::boardMutex());
+  return measure_keys(parser, &_pos_file, &key_size, 1)[0];
+}
+
+char* replay_key(const char* _captureFile, int realtime,
+                 const char** _params, int params_size, const char* _pos_file, int key_size) {
+  std::vector<std::string> params;
+  params.reserve(params_size);
+  for (int i = 0; i < params_size; i++)
+    params.emplace_back(_params[i]);
+  // The capture holds the retries of the measurement it recorded, and replaying ends with it
+  auto parser = SerialReader::Parser({
+    .params = params, .maxRetries = 0, .watchdog = false, .replayFile = _captureFile, .realtime = realtime != 0
+  });
+  return measure_keys(parser, &_pos_file, &key_size, 1)[0];
+}
+
+char** gen_keys(const char* _serialPort, const char* _gpioChip, int baud, int rpi_power_port, int sleep,
+                const char** _params, int params_size, const char** pos_files, const int* key_sizes, int count) {
+  std::vector<std::string> params;
+  params.reserve(params_size);
+  for (int i = 0; i < params_size; i++)
+    params.emplace_back(_params[i]);
+  auto parser = SerialReader::Parser({
+    .serialPort = _serialPort, .gpioChip = _gpioChip, .baudRate = baud, .usbPort = rpi_power_port, .usbSleep = sleep,
+    .params = params
+  });
+  std::lock_guard board(SerialReader::boardMutex());
+  return measure_keys(parser, pos_files, key_sizes, count).release();
+}
+
+char** replay_keys(const char* _captureFile, int realtime, const char** _params, int params_size,
+                   const char** pos_files, const int* key_sizes, int count) {
+  std::vector<std::string> params;
+  params.reserve(params_size);
+  for (int i = 0; i < params_size; i++)
+    params.emplace_back(_params[i]);
+  // The capture holds the retries of the measurement it recorded, and replaying ends with it
+  auto parser = SerialReader::Parser({
+    .params = params, .maxRetries = 0, .watchdog = false, .replayFile = _captureFile, .realtime = realtime != 0
+  });
+  return measure_keys(parser, pos_files, key_sizes, count).release();
+}
+
+void free_keys(char** keys, const int count) {
+  if (keys == nullptr) return;
+  for (int i = 0; i < count; i++) {
+    if (keys[i] == nullptr) continue;
+    explicit_bzero(keys[i], std::strlen(keys[i]));
+    delete[] keys[i];
+  }
+  delete[] keys;
 }
 
 #pragma clang diagnostic pop
 
 void SerialReader::run(Parser& parser, std::ostream& output) {
-  Runner runner(parser.getSerialPort().c_str(), parser.getGpioChip().c_str(),
-                parser.getUSBPort(), parser.getBaudRate());
+  Runner runner(parser);
+  run(runner, parser, output);
+  runner.release();
+}
+
+bool SerialReader::run(Runner& runner, Parser& parser, std::ostream& output) {
+  StreamSink sink(output);
+  return run(runner, parser, sink);
+}
+
+bool SerialReader::run(Runner& runner, Parser& parser, DumpSink& output) {
   bool running = true;
   int count = 0;
-  while (running && count == 0) {
+  int failures = 0;
+  while (running && count == 0 && !runner.isCancelled()) {
     runner.reset(parser);
     running = runner.loop(parser, output, count);
+    if (!runner.getFailure().empty()) {
+      running = runner.recover(parser, ++failures, "key");
+    } else {
+      failures = 0;
+    }
   }
-  runner.release();
+  return count > 0;
+}
+
+SerialReader::Runner::Runner(const Parser& parser)
+  : gpioChip(parser.getReplayFile().empty() ? gpiod::chip(parser.getGpioChip()) : gpiod::chip()),
+    gpioRelayLine(parser.getReplayFile().empty() ? gpioChip.get_line(parser.getUSBPort()) : gpiod::line()),
+    fd(parser.getReplayFile().empty() ? uartOpen(parser.getSerialPort().c_str(), parser.getBaudRate()) : -1) {
+  try {
+    setUp(parser);
+  } catch (...) {
+    // The destructor does not run for a constructor that throws
+    reader.reset();
+    if (fd >= 0) close(fd);
+    throw;
+  }
+}
+
+SerialReader::Runner::~Runner() {
+  reader.reset();
+  capture.reset();
+  if (fd >= 0) close(fd);
 }
 
-SerialReader::Runner::Runner(const char* port, const char* chipName,
-                             const int usb, const int baud)
-  : fd(uartOpen(port, baud)),
-    gpioChip(gpiod::chip(chipName)),
-    gpioRelayLine(gpioChip.get_line(usb)) {
-  gpioRelayLine.request({"SerialReader", gpiod::line_request::DIRECTION_OUTPUT, 0});
+void SerialReader::Runner::setUp(const Parser& parser) {
+  if (!parser.getReplayFile().empty()) {
+    replay = std::make_unique<CaptureReader>(parser.getReplayFile(), parser.getRealtime());
+    if (!replay->isOpen()) {
+      std::cerr << "Could not open capture " << parser.getReplayFile() << std::endl;
+    }
+  } else {
+    gpioRelayLine.request({"SerialReader", gpiod::line_request::DIRECTION_OUTPUT, 0});
+    if (parser.getLowLatency()) {
+      if (!serialLowLatency(fd)) {
+        std::cerr << "The serial driver does not support ASYNC_LOW_LATENCY" << std::endl;
+      }
+      reader = std::make_unique<UartReader>(fd, parser.getBaudRate(), parser.getReaderCpu(),
+                                            parser.getReaderPriority());
+    }
+  }
+  if (!parser.getCaptureFile().empty()) {
+    capture = std::make_unique<CaptureWriter>(parser.getCaptureFile(),
+                                              replay ? replay->getBaudRate() : parser.getBaudRate());
+  }
 #ifdef LOG
     auto t = std::time(nullptr);
     auto tm = *std::localtime(&t);
@@ -100,23 +317,130 @@ SerialReader::Runner::Runner(const char* port, const char* chipName,
 }
 
 void SerialReader::Runner::reset(const Parser& parser) {
+  if (replay) return;
   log_data("Cutting off USB Power...", log);
   gpioRelayLine.set_value(1);
-  std::this_thread::sleep_for(std::chrono::seconds(parser.getUSBSleepTime()));
+  trace.mark(TraceEvent::RELAY_OFF);
+  if (!pause(parser.getUSBSleepTime())) return;
   log_data("Turning on USB Power...", log);
   gpioRelayLine.set_value(0);
+  trace.mark(TraceEvent::RELAY_ON);
+}
+
+bool SerialReader::Runner::recover(const Parser& parser, const int attempt, const std::string& measurement) {
+  if (cancelled) return false;
+  const bool retry = parser.getMaxRetries() <= 0 || attempt <= parser.getMaxRetries();
+  const int exponent = attempt - 1 < 10 ? attempt - 1 : 10;
+  const int backoff = std::min(parser.getUSBSleepTime() << exponent, MAX_BACKOFF);
+  if (!parser.getCampaignLog().empty() && !campaignLog.is_open()) {
+    campaignLog.open(parser.getCampaignLog(), std::ios::app);
+  }
+  const auto t = std::time(nullptr);
+  const auto tm = *std::localtime(&t);
+  campaignLog << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << '\t' << measurement << '\t' << failure
+    << "\tattempt " << attempt << '\t' << (retry ? "retrying after " + std::to_string(backoff) + " s" : "giving up")
+    << std::endl;
+  if (!retry) {
+    log_data("Giving up after " + std::to_string(attempt) + " failed attempts: " + failure, log);
+    return false;
+  }
+  log_data("Measurement failed (" + failure + "), power-cycling in " + std::to_string(backoff) + " s...", log);
+  if (replay) return true;
+  gpioRelayLine.set_value(1);
+  return pause(backoff);
+}
+
+bool SerialReader::Runner::pause(const int seconds) {
+  std::unique_lock lock(wakeMutex);
+  return !wake.wait_for(lock, std::chrono::seconds(seconds), [this] { return cancelled.load(); });
+}
+
+void SerialReader::Runner::cancel() {
+  std::lock_guard lock(wakeMutex);
+  cancelled = true;
+  wake.notify_all();
+}
+
+ssize_t SerialReader::Runner::receive(char* buf, const size_t size) {
+  if (!replay && !reader) {
+    // Wake up regularly instead of blocking for VTIME, so a cancellation is noticed quickly
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) == 0) return 0;
+  }
+  const ssize_t n = replay ? replay->read(buf, size) : reader ? reader->read(buf, size) : read(fd, buf, size);
+  if (capture && n > 0) {
+    capture->record(buf, n);
+  }
+  return n;
+}
+
+void SerialReader::Runner::send(const std::string& str) const {
+  serialPuts(fd, str.c_str());
+  serialFlush(fd);
 }
 
-bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count) {
+bool SerialReader::Runner::loop(Parser& parser, DumpSink& output, int& count) {
   bool running = true;
   //log_data("Starting measurement...", log);
   char lastChar = ' ', in = ' ';
-  size_t numBytes = 0, i = 0;
+  ssize_t numBytes = 0, i = 0;
   char readBuf[BUFFER_SIZE];
   bool writePuf = false;
   volatile bool interrupt = false;
-  int charCount = 0;
+  size_t charCount = 0;
   std::thread* input = nullptr;
+  const Challenge challenge = Challenge::fromParams(parser.getParams());
+  // Replays carry no real timing, and a capture may legitimately end in the middle of a phase
+  const bool guarded = parser.getWatchdog() && challenge.hasTransfer() && !replay;
+  Watchdog watchdog(challenge, parser.getBaudRate());
+  int prompts = 0;
+  long long overruns = -1;
+  DumpInfo info;
+  info.challenge = challenge;
+  info.payloadSize = challenge.isDump() ? challenge.payloadSize() : 0;
+  bool inFrame = false;
+  bool begun = false;
+  bool synced = false;
+  size_t remaining = 0;
+  std::string line;
+  expectInput = 0;
+  failure.clear();
+  const auto report = [&](const size_t bytes) {
+    if (onProgress) onProgress(watchdog.phase(), bytes, info.payloadSize);
+  };
+  const auto enter = [&](const Phase phase) {
+    watchdog.enter(phase);
+    report(0);
+  };
+  const auto fail = [&](const std::string& reason) {
+    failure = reason;
+    log_data("Aborting measurement: " + failure, log);
+    interrupt = true;
+    writePuf = false;
+    if (input != nullptr) {
+      input->join();
+      delete input;
+      input = nullptr;
+    }
+    if (begun) {
+      output.end(false);
+      begun = false;
+    }
+  };
+  // Bytes dropped by the UART or the tty layer would silently shift the rest of the dump
+  const auto lostBytes = [&] {
+    return overruns >= 0 && serialOverruns(fd) > overruns;
+  };
+  const auto progress = [&](const size_t written) {
+    if ((charCount + written) / FLUSH_INTERVAL != charCount / FLUSH_INTERVAL) {
+      std::cout << '\r' << charCount + written << " bytes written." << std::flush;
+      report(charCount + written);
+      if (lostBytes()) {
+        fail("bytes lost to UART overruns");
+      }
+    }
+    charCount += written;
+  };
 #ifdef USER_INPUT
     std::thread inputUser([this, &interrupt] {
         while (!interrupt) {
@@ -132,14 +456,75 @@ bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count
         }
     });
 #endif
+  report(0);
   while (!interrupt) {
+    if (cancelled) {
+      fail("cancelled");
+      continue;
+    }
     if (i >= numBytes) {
       i = 0;
-      numBytes = read(fd, &readBuf, BUFFER_SIZE);
+      numBytes = receive(readBuf, BUFFER_SIZE);
+      if (numBytes <= 0 && replay && replay->eof()) {
+        // Nothing more will ever arrive, finish like after "|$"
+        interrupt = true;
+        running = false;
+        if (input != nullptr) {
+          input->join();
+          delete input;
+          input = nullptr;
+        }
+        if (begun) {
+          output.end(false);
+        }
+        continue;
+      }
+      if (numBytes > 0) {
+        watchdog.feed();
+      }
+      if (numBytes < 0 && errno != EINTR && errno != EAGAIN) {
+        fail(std::string("read failed: ") + std::strerror(errno));
+      } else if (guarded && watchdog.expired()) {
+        if (watchdog.phase() == Phase::FINISH && !challenge.isDump()) {
+          // Summaries end with "|&" and never print "|$", the measurement is complete already
+          interrupt = true;
+        } else {
+          fail(std::string("timeout in ") + phaseName(watchdog.phase()) + " phase");
+        }
+      }
       if (numBytes <= 0) continue;
     }
+
+    if (remaining > 0) {
+      // The size of a dump is known, so its payload is copied in bulk and never scanned for markers
+      const size_t n = std::min(remaining, static_cast<size_t>(numBytes - i));
+      output.write(readBuf + i, n);
+      i += static_cast<ssize_t>(n);
+      remaining -= n;
+      progress(n);
+      continue;
+    }
+
     in = readBuf[i];
     ++i;
+    // The boot loader greets with SYN, the first one tells how long the board took to power up
+    if (in == 0x16 && !synced) {
+      synced = true;
+      trace.mark(TraceEvent::SYN);
+    }
+
+    if (inFrame) {
+      info.frame += in;
+      if (in == ',' || info.frame.size() >= 32) {
+        inFrame = false;
+        output.begin(info);
+        begun = true;
+        remaining = info.payloadSize;
+        progress(info.frame.size());
+        lastChar = ' ';
+      }
+      continue;
+    }
 
     if (!writePuf) {
       if ((in < 32 || in > 126) && in != 10 && in != 13) {
@@ -147,45 +532,73 @@ bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count
       } else {
         log_live(in, log);
       }
+      if (in == '\n') {
+        if (line.rfind(FIRMWARE_BUILD, 0) == 0) {
+          firmware = line.substr(sizeof(FIRMWARE_BUILD) - 1);
+        }
+        line.clear();
+      } else if (in != '\r' && line.size() < 128) {
+        line += in;
+      }
     }
     if (START_1 == lastChar && START_2 == in) {
       writePuf = true;
+      trace.mark(TraceEvent::START);
+      enter(Phase::TRANSFER);
+      overruns = replay ? -1 : serialOverruns(fd);
       if (input != nullptr) {
         input->join();
         delete input;
         input = nullptr;
       }
+      info.frame.clear();
+      info.firmware = firmware;
+      info.startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+      charCount = 0;
+      if (info.payloadSize > 0) {
+        inFrame = true;
+        continue;
+      }
+      output.begin(info);
+      begun = true;
+    } else if (END_1 == lastChar && END_2 == in && lostBytes()) {
+      fail("bytes lost to UART overruns");
     } else if (END_1 == lastChar && END_2 == in) {
       ++count;
       writePuf = false;
+      trace.mark(TraceEvent::END);
+      enter(Phase::FINISH);
       log_data(std::to_string(charCount) + " bytes in total written.", log);
-      output.flush();
-      if (auto* o = dynamic_cast<std::ofstream*>(&output)) {
-        o->close();
+      if (begun) {
+        output.end(true);
+        begun = false;
       }
       if (parser.getMaxMeasures() > 0 && count >= parser.getMaxMeasures()) {
         running = false;
       }
     } else if (LOADED_1 == lastChar && LOADED_2 == in) {
+      trace.mark(TraceEvent::LOADED);
+      enter(Phase::PROMPT);
       input = new std::thread([this, &parser, &interrupt] {
         for (auto& param : parser.getParams()) {
-          while (!expectInput) {
+          while (expectInput == 0) {
             if (interrupt) return; // Shortcut thread
           }
-          expectInput = false;
+          --expectInput;
+          if (replay) continue; // Nobody listens to the answers of a replay
           std::this_thread::sleep_for(std::chrono::milliseconds(50));
-          std::string toSend = param;
-          serialPuts(fd, toSend.c_str());
-          serialFlush(fd);
+          send(param);
           std::this_thread::sleep_for(std::chrono::milliseconds(50));
-          toSend = "\r";
-          serialPuts(fd, toSend.c_str());
-          serialFlush(fd);
+          send("\r");
         }
       });
     } else if (ASK_INPUT_1 == lastChar && ASK_INPUT_2 == in) {
-      expectInput = true;
+      ++expectInput;
+      trace.mark(TraceEvent::PROMPT);
+      enter(++prompts >= challenge.prompts() ? Phase::DECAY : Phase::PROMPT);
     } else if (FINISHED_1 == lastChar && FINISHED_2 == in) {
+      trace.mark(TraceEvent::FINISHED);
       interrupt = true;
       if (input != nullptr) {
         input->join();
@@ -193,27 +606,16 @@ bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count
         input = nullptr;
       }
     } else if (PANIC_1 == lastChar && PANIC_2 == in) {
-      interrupt = true;
-      if (input != nullptr) {
-        input->join();
-        delete input;
-        input = nullptr;
-      }
-      output.flush();
-      if (auto* o = dynamic_cast<std::ofstream*>(&output)) {
-        o->close();
-      }
+      fail("firmware panic");
     }
-    if (writePuf && charCount > 1) {
-      output << lastChar;
+    // Summaries are scanned byte by byte, one behind so that the "|" of "|&" is never written
+    const bool summary = writePuf && begun && info.payloadSize == 0;
+    if (summary && charCount > 1) {
+      output.write(&lastChar, 1);
     }
     lastChar = in;
-    if (writePuf) {
-      ++charCount;
-      if (charCount % FLUSH_INTERVAL == 0) {
-        std::cout << '\r' << charCount << " bytes written." << std::flush;
-        output.flush();
-      }
+    if (summary) {
+      progress(1);
     }
   }
   std::cout << std::endl;
@@ -224,5 +626,10 @@ bool SerialReader::Runner::loop(Parser& parser, std::ostream& output, int& count
 }
 
 void SerialReader::Runner::release() const {
+  if (replay) return;
+  if (cancelled) {
+    // Do not leave a cancelled measurement running on the board
+    gpioRelayLine.set_value(1);
+  }
   gpioRelayLine.release();
 }
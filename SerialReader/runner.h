@@ -2,22 +2,75 @@
 
 #define FLUSH_INTERVAL 10000
 #define BUFFER_SIZE 1024
+#define FIRMWARE_BUILD "BUILD DATE: "
 
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <gpiod.hpp>
+#include "capture.h"
+#include "dump_sink.h"
+#include "latency.h"
+#include "parser.h"
+#include "uart_reader.h"
+#include "watchdog.h"
 
 namespace SerialReader {
   void run(Parser& parser);
 
   void run(Parser& parser, std::ostream& output);
 
+  // Picks the bits listed in pos_file out of a dump, MSB first, starting after the first ','
+  std::string extractKey(const std::string& out_str, const std::string& pos_file, int key_size);
+
+  std::string extractKey(const char* out, size_t size, const std::string& pos_file, int key_size);
+
+  // Same for a payload without the frame in front of it
+  std::string extractBits(const char* payload, size_t size, const std::string& pos_file, int key_size);
+
+  class Runner;
+
+  // Measures until one dump was written to output, returns false if it gave up or was cancelled
+  bool run(Runner& runner, Parser& parser, std::ostream& output);
+
+  bool run(Runner& runner, Parser& parser, DumpSink& output);
+
   class Runner {
   private:
-    const int fd;
     const gpiod::chip gpioChip;
     const gpiod::line gpioRelayLine;
+    // Opened after the GPIO chip, which throws if it cannot be opened; closed by the destructor
+    const int fd;
 
     std::ofstream log;
+    std::ofstream campaignLog;
+
+    std::string failure;
+    // What follows FIRMWARE_BUILD in the boot messages of the board
+    std::string firmware;
+
+    std::unique_ptr<CaptureWriter> capture;
+    std::unique_ptr<CaptureReader> replay;
+    std::unique_ptr<UartReader> reader;
+
+    std::atomic<bool> cancelled = false;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    // The part of the constructor after the serial port was opened
+    void setUp(const Parser& parser);
+
+    // Sleeps unless cancelled, returns false if it was
+    bool pause(int seconds);
+
+    // read() on the serial port, or on the capture when replaying
+    ssize_t receive(char* buf, size_t size);
+
+    void send(const std::string& str) const;
 
     const char LOADED_1 = '$';
     const char LOADED_2 = '|';
@@ -33,14 +86,52 @@ namespace SerialReader {
     const char PANIC_2 = '&';
 
   public:
-    Runner(const char* port, const char* chipName, int usb, int baud);
+    explicit Runner(const Parser& parser);
+
+    // Stops the reader thread before it closes the serial port
+    ~Runner();
+
+    Runner(const Runner&) = delete;
+
+    Runner& operator=(const Runner&) = delete;
+
+    [[nodiscard]] bool isReplaying() const {
+      return replay != nullptr;
+    }
+
+    // Whether the serial port (or the capture to replay) could be opened
+    [[nodiscard]] bool isOpen() const {
+      return replay ? replay->isOpen() : fd >= 0;
+    }
 
     void reset(const Parser& parser);
 
-    bool loop(Parser& parser, std::ostream& output, int& count);
+    bool loop(Parser& parser, DumpSink& output, int& count);
+
+    // Why the last loop() was aborted, empty if it was not
+    [[nodiscard]] const std::string& getFailure() const {
+      return failure;
+    }
+
+    // Keeps the board powered off for an exponential backoff, returns whether to retry at all
+    bool recover(const Parser& parser, int attempt, const std::string& measurement);
 
     void release() const;
 
-    volatile bool expectInput = false;
+    // Aborts the running loop and any backoff, safe to call from any thread; release() then powers off the board
+    void cancel();
+
+    [[nodiscard]] bool isCancelled() const {
+      return cancelled;
+    }
+
+    // Called on every phase change and every FLUSH_INTERVAL bytes with the bytes so far and the expected total
+    std::function<void(Phase, size_t, size_t)> onProgress;
+
+    // Events of the measurement so far; whoever extracts a key from it marks TraceEvent::EXTRACTED
+    LatencyTrace trace;
+
+    // Prompts the input thread has not answered yet, replays can deliver several at once
+    std::atomic<int> expectInput = 0;
   };
 }
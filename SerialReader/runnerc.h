@@ -2,3 +2,21 @@
 
 char* gen_key(const char* serial_port, const char* gpio_chip, int baud, int rpi_power_port, int sleep,
               const char** params, int params_size, const char* pos_file, int key_size);
+
+// Same as gen_key, but the firmware output is read from a capture recorded with -c
+char* replay_key(const char* capture_file, int realtime,
+                 const char** params, int params_size, const char* pos_file, int key_size);
+
+/*
+ * One measurement, one key per pos file: keys[i] has up to key_sizes[i] bits of pos_files[i]. The bits are picked
+ * while the dump streams in, in a single pass for all keys. The keys are empty if the measurement failed; the
+ * array is released with free_keys.
+ */
+char** gen_keys(const char* serial_port, const char* gpio_chip, int baud, int rpi_power_port, int sleep,
+                const char** params, int params_size, const char** pos_files, const int* key_sizes, int count);
+
+char** replay_keys(const char* capture_file, int realtime, const char** params, int params_size,
+                   const char** pos_files, const int* key_sizes, int count);
+
+// Zeroizes and releases the count keys returned by gen_keys or replay_keys
+void free_keys(char** keys, int count);
@@ -21,6 +21,12 @@ pushd $1
 #sleep 1h
 echo "Starting with measurements"
 
+#Hangs and retries of all measurements are appended here
+CAMPAIGNLOG=$(pwd)/campaign.log
+
+#Every dump is indexed here with its challenge, temperature and statistics, see puf-catalog
+CATALOG=$(pwd)/catalog.tsv
+
 #Filenames of created .bin
 FILEPREFIX=run_
 echo "Generated .bin will have the scheme run_TIME_ATTEMPT.bin"
@@ -37,7 +43,7 @@ function measure {
   #run cmd for PUF
   echo "Collecting $RUNS file(s) for $2 sec decay time"
   ########
-  ~/SerialReader -p 0 -p 0 -p 0 -p $3 -p $4 -p $5 -p 1 -p 1 -p $2 -o $NAME -m $RUNS
+  ~/SerialReader -p 0 -p 0 -p 0 -p $3 -p $4 -p $5 -p 1 -p 1 -p $2 -o $NAME -m $RUNS -l $CAMPAIGNLOG --catalog $CATALOG
   ########
   echo "Run for $2 seconds decay time completed."
   popd
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "dump_view.h"
+#include "spatial.h"
+
+SerialReader::NeighbourCounts& SerialReader::NeighbourCounts::operator+=(const NeighbourCounts& other) {
+  pairs += other.pairs;
+  first += other.first;
+  second += other.second;
+  both += other.both;
+  return *this;
+}
+
+double SerialReader::NeighbourCounts::correlation() const {
+  const auto n = static_cast<double>(pairs);
+  const auto x = static_cast<double>(first);
+  const auto y = static_cast<double>(second);
+  const double denominator = std::sqrt(x * (n - x) * y * (n - y));
+  return denominator > 0 ? (n * static_cast<double>(both) - x * y) / denominator : 0;
+}
+
+SerialReader::SpatialMap& SerialReader::SpatialMap::operator+=(const SpatialMap& other) {
+  for (size_t i = 0; i < rowBits.size(); i++) {
+    rowBits[i] += other.rowBits[i];
+    rowFlips[i] += other.rowFlips[i];
+  }
+  for (size_t i = 0; i < colBits.size(); i++) {
+    colBits[i] += other.colBits[i];
+    colFlips[i] += other.colFlips[i];
+  }
+  for (size_t i = 0; i < laneFlips.size(); i++) laneFlips[i] += other.laneFlips[i];
+  vertical += other.vertical;
+  horizontal += other.horizontal;
+  return *this;
+}
+
+uint64_t SerialReader::SpatialMap::bits() const {
+  uint64_t n = 0;
+  for (const uint64_t b : rowBits) n += b;
+  return n;
+}
+
+uint64_t SerialReader::SpatialMap::flips() const {
+  uint64_t n = 0;
+  for (const uint64_t f : rowFlips) n += f;
+  return n;
+}
+
+uint64_t SerialReader::SpatialMap::bankBits(const uint32_t bank) const {
+  uint64_t n = 0;
+  for (uint32_t r = 0; r < SPATIAL_ROWS; r++) n += rowBits[bank * SPATIAL_ROWS + r];
+  return n;
+}
+
+uint64_t SerialReader::SpatialMap::bankFlips(const uint32_t bank) const {
+  uint64_t n = 0;
+  for (uint32_t r = 0; r < SPATIAL_ROWS; r++) n += rowFlips[bank * SPATIAL_ROWS + r];
+  return n;
+}
+
+// Correlation of the densities of the entries lag apart within each of the banks runs of length entries
+static double profileCorrelation(const std::vector<uint64_t>& bits, const std::vector<uint64_t>& flips,
+                                 const uint32_t length, const uint32_t lag) {
+  double n = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+  for (uint32_t bank = 0; bank < SPATIAL_BANKS; bank++) {
+    const size_t base = static_cast<size_t>(bank) * length;
+    for (uint32_t i = 0; i + lag < length; i++) {
+      const size_t a = base + i;
+      const size_t b = a + lag;
+      if (bits[a] == 0 || bits[b] == 0) continue;
+      const double x = static_cast<double>(flips[a]) / static_cast<double>(bits[a]);
+      const double y = static_cast<double>(flips[b]) / static_cast<double>(bits[b]);
+      n++;
+      sx += x;
+      sy += y;
+      sxx += x * x;
+      syy += y * y;
+      sxy += x * y;
+    }
+  }
+  if (n < 3) return 0;
+  const double denominator = std::sqrt((n * sxx - sx * sx) * (n * syy - sy * sy));
+  return denominator > 0 ? (n * sxy - sx * sy) / denominator : 0;
+}
+
+double SerialReader::SpatialMap::rowCorrelation(const uint32_t lag) const {
+  return profileCorrelation(rowBits, rowFlips, SPATIAL_ROWS, lag);
+}
+
+double SerialReader::SpatialMap::colCorrelation(const uint32_t lag) const {
+  return profileCorrelation(colBits, colFlips, SPATIAL_COLS, lag);
+}
+
+std::pair<double, double> SerialReader::SpatialMap::edgeDensity(const uint32_t subarrayRows) const {
+  uint64_t edgeBits = 0, edgeFlips = 0, innerBits = 0, innerFlips = 0;
+  for (size_t i = 0; i < rowBits.size(); i++) {
+    const uint32_t r = i % SPATIAL_ROWS % subarrayRows;
+    if (r == 0 || r == subarrayRows - 1) {
+      edgeBits += rowBits[i];
+      edgeFlips += rowFlips[i];
+    } else {
+      innerBits += rowBits[i];
+      innerFlips += rowFlips[i];
+    }
+  }
+  return {edgeBits > 0 ? static_cast<double>(edgeFlips) / static_cast<double>(edgeBits) : 0,
+          innerBits > 0 ? static_cast<double>(innerFlips) / static_cast<double>(innerBits) : 0};
+}
+
+SerialReader::SpatialAnalysis::SpatialAnalysis(const unsigned _threads) : threads(_threads) {
+  maps[1].addMode = 1;
+}
+
+// The word of each column that a mapping saw last, to pair it with the same column of the next row
+struct LastRows {
+  std::vector<uint32_t> row = std::vector<uint32_t>(SPATIAL_BANKS * SPATIAL_COLS, UINT32_MAX);
+  std::vector<uint32_t> mask = std::vector<uint32_t>(SPATIAL_BANKS * SPATIAL_COLS);
+};
+
+// Counts the words [begin, end) of view into maps, row by row so that bank and row are looked up once per row
+static void countWords(const SerialReader::DumpView& view, const uint32_t init, const uint64_t begin,
+                       const uint64_t end, std::array<SerialReader::SpatialMap, 2>& maps) {
+  std::array<LastRows, 2> last;
+  std::array<uint64_t, 32> lanes{};
+  uint32_t masks[SPATIAL_COLS];
+  uint8_t counts[SPATIAL_COLS];
+  for (uint64_t index = begin; index < end;) {
+    const SerialReader::DumpRow r = view.row(index);
+    const auto words = static_cast<uint32_t>(std::min<uint64_t>(r.words, end - index));
+    for (uint32_t w = 0; w < words; w++) {
+      uint32_t mask = view.word(index + w) ^ init;
+      masks[w] = mask;
+      counts[w] = static_cast<uint8_t>(__builtin_popcount(mask));
+      // Flips are sparse, so visiting the set bits is cheaper than testing all 32
+      for (; mask != 0; mask &= mask - 1) lanes[31 - __builtin_ctz(mask)]++;
+    }
+    const uint32_t address = view.address(index);
+    for (int m = 0; m < 2; m++) {
+      SerialReader::SpatialMap& map = maps[m];
+      const SerialReader::Cell c = SerialReader::cellOf(address, m);
+      const size_t colBase = static_cast<size_t>(c.bank) * SPATIAL_COLS + c.col;
+      uint64_t flips = 0;
+      for (uint32_t w = 0; w < words; w++) {
+        const size_t slot = colBase + w;
+        flips += counts[w];
+        map.colBits[slot] += 32;
+        map.colFlips[slot] += counts[w];
+        if (w > 0) {
+          map.horizontal.pairs += 32;
+          map.horizontal.first += counts[w - 1];
+          map.horizontal.second += counts[w];
+          map.horizontal.both += __builtin_popcount(masks[w - 1] & masks[w]);
+        }
+        if (last[m].row[slot] != UINT32_MAX && last[m].row[slot] + 1 == c.row) {
+          map.vertical.pairs += 32;
+          map.vertical.first += __builtin_popcount(last[m].mask[slot]);
+          map.vertical.second += counts[w];
+          map.vertical.both += __builtin_popcount(last[m].mask[slot] & masks[w]);
+        }
+        last[m].row[slot] = c.row;
+        last[m].mask[slot] = masks[w];
+      }
+      const size_t rowSlot = static_cast<size_t>(c.bank) * SPATIAL_ROWS + c.row;
+      map.rowBits[rowSlot] += 32ULL * words;
+      map.rowFlips[rowSlot] += flips;
+    }
+    index += words;
+  }
+  for (auto& map : maps) {
+    for (size_t i = 0; i < lanes.size(); i++) map.laneFlips[i] += lanes[i];
+  }
+}
+
+void SerialReader::SpatialAnalysis::add(const DumpView& view, const uint32_t init) {
+  const uint64_t words = view.words();
+  const unsigned n = threads != 0 ? threads : std::max(1U, std::thread::hardware_concurrency());
+  // At least a few rows per thread, cut at row boundaries as long as the dump starts at one
+  const auto parts = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(n, words / (8 * SPATIAL_COLS))));
+  std::vector<std::array<SpatialMap, 2>> partial(parts - 1);
+  std::vector<std::thread> workers;
+  const auto cut = [&](const unsigned part) {
+    return part == parts ? words : words * part / parts / SPATIAL_COLS * SPATIAL_COLS;
+  };
+  for (unsigned part = 1; part < parts; part++) {
+    partial[part - 1][1].addMode = 1;
+    workers.emplace_back([&, part] { countWords(view, init, cut(part), cut(part + 1), partial[part - 1]); });
+  }
+  countWords(view, init, 0, cut(1), maps);
+  for (auto& worker : workers) worker.join();
+  for (const auto& p : partial) {
+    maps[0] += p[0];
+    maps[1] += p[1];
+  }
+  dumps++;
+}
+
+SerialReader::SpatialAnalysis& SerialReader::SpatialAnalysis::operator+=(const SpatialAnalysis& other) {
+  maps[0] += other.maps[0];
+  maps[1] += other.maps[1];
+  dumps += other.dumps;
+  return *this;
+}
+
+static double density(const uint64_t flips, const uint64_t bits) {
+  return bits > 0 ? static_cast<double>(flips) / static_cast<double>(bits) : 0;
+}
+
+static const char* mapName(const int addMode) {
+  return addMode == 0 ? "brc" : "rbc";
+}
+
+void SerialReader::SpatialAnalysis::report(std::ostream& out) const {
+  out << "dumps " << dumps << std::endl;
+  const SpatialMap& any = maps[0];
+  out << "bits " << any.bits() << std::endl
+    << "flips " << any.flips() << std::endl
+    << "density " << density(any.flips(), any.bits()) << std::endl;
+  for (const SpatialMap& map : maps) {
+    const auto [edge, inner] = map.edgeDensity();
+    out << std::endl << "map " << mapName(map.addMode) << std::endl
+      << "vertical " << map.vertical.correlation() << std::endl
+      << "horizontal " << map.horizontal.correlation() << std::endl
+      << "subarray edge " << edge << " inner " << inner << std::endl
+      << "bank\tbits\tflips\tdensity" << std::endl;
+    for (uint32_t bank = 0; bank < SPATIAL_BANKS; bank++) {
+      const uint64_t bits = map.bankBits(bank);
+      if (bits == 0) continue;
+      const uint64_t flips = map.bankFlips(bank);
+      out << bank << '\t' << bits << '\t' << flips << '\t' << density(flips, bits) << std::endl;
+    }
+    out << "lag\trows\tcols" << std::endl;
+    for (uint32_t lag = 1; lag <= SPATIAL_LAGS; lag++) {
+      out << lag << '\t' << map.rowCorrelation(lag) << '\t' << map.colCorrelation(lag) << std::endl;
+    }
+  }
+  // The same in both mappings, the bits of a word do not depend on where it lies
+  out << std::endl << "bit\tflips" << std::endl;
+  for (size_t i = 0; i < any.laneFlips.size(); i++) out << i << '\t' << any.laneFlips[i] << std::endl;
+}
+
+void SerialReader::SpatialAnalysis::writeRows(std::ostream& out) const {
+  out << "map\tbank\trow\tbits\tflips\tdensity\n";
+  for (const SpatialMap& map : maps) {
+    for (size_t i = 0; i < map.rowBits.size(); i++) {
+      if (map.rowBits[i] == 0) continue;
+      out << mapName(map.addMode) << '\t' << i / SPATIAL_ROWS << '\t' << i % SPATIAL_ROWS << '\t' << map.rowBits[i]
+          << '\t' << map.rowFlips[i] << '\t' << density(map.rowFlips[i], map.rowBits[i]) << '\n';
+    }
+  }
+}
+
+void SerialReader::SpatialAnalysis::writeCols(std::ostream& out) const {
+  out << "map\tbank\tcol\tbits\tflips\tdensity\n";
+  for (const SpatialMap& map : maps) {
+    for (size_t i = 0; i < map.colBits.size(); i++) {
+      if (map.colBits[i] == 0) continue;
+      out << mapName(map.addMode) << '\t' << i / SPATIAL_COLS << '\t' << i % SPATIAL_COLS << '\t' << map.colBits[i]
+          << '\t' << map.colFlips[i] << '\t' << density(map.colFlips[i], map.colBits[i]) << '\n';
+    }
+  }
+}
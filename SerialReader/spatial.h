@@ -0,0 +1,110 @@
+#pragma once
+
+#define SPATIAL_BANKS 8
+#define SPATIAL_ROWS 16384
+#define SPATIAL_COLS 1024
+// Distances in rows (or columns) up to which the flip profiles are correlated
+#define SPATIAL_LAGS 8
+// Rows per subarray that the edge rows are counted for, 512 on the LPDDR2 of the Pi
+#define SPATIAL_SUBARRAY_ROWS 512
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace SerialReader {
+  class DumpView;
+
+  // Flips of pairs of neighbouring cells: both cells hold the same bit of two words next to each other
+  struct NeighbourCounts {
+    // Bits compared, 32 per pair of words
+    uint64_t pairs = 0;
+    // Flipped bits of the first (upper or left) and of the second word
+    uint64_t first = 0;
+    uint64_t second = 0;
+    uint64_t both = 0;
+
+    NeighbourCounts& operator+=(const NeighbourCounts& other);
+
+    // Phi coefficient of the flips of the two cells, 0 if either never or always flips
+    [[nodiscard]] double correlation() const;
+  };
+
+  /*
+   * Flip counts of one or more dumps by bank, row and column as one address mapping sees them. Rows and columns
+   * are counted per bank, so a row is the same DRAM row in every dump; bits counts the cells that were dumped,
+   * which differs between rows and columns if a dump does not cover whole rows.
+   */
+  struct SpatialMap {
+    int addMode = 0;
+    std::vector<uint64_t> rowBits = std::vector<uint64_t>(SPATIAL_BANKS * SPATIAL_ROWS);
+    std::vector<uint64_t> rowFlips = std::vector<uint64_t>(SPATIAL_BANKS * SPATIAL_ROWS);
+    std::vector<uint64_t> colBits = std::vector<uint64_t>(SPATIAL_BANKS * SPATIAL_COLS);
+    std::vector<uint64_t> colFlips = std::vector<uint64_t>(SPATIAL_BANKS * SPATIAL_COLS);
+    // Flips per bit of the word, bit 31 first as in pos files
+    std::array<uint64_t, 32> laneFlips{};
+    // The same column in adjacent rows of a bank, and adjacent columns in one row
+    NeighbourCounts vertical;
+    NeighbourCounts horizontal;
+
+    SpatialMap& operator+=(const SpatialMap& other);
+
+    [[nodiscard]] uint64_t bits() const;
+
+    [[nodiscard]] uint64_t flips() const;
+
+    [[nodiscard]] uint64_t bankBits(uint32_t bank) const;
+
+    [[nodiscard]] uint64_t bankFlips(uint32_t bank) const;
+
+    /*
+     * Pearson correlation of the flip densities of rows (of columns) lag apart in the same bank, over the pairs
+     * of which both were dumped; 0 if there are fewer than 3 such pairs or a profile is flat.
+     */
+    [[nodiscard]] double rowCorrelation(uint32_t lag) const;
+
+    [[nodiscard]] double colCorrelation(uint32_t lag) const;
+
+    // Flip density of the first and last row of every subarray of subarrayRows rows, and of all other rows
+    [[nodiscard]] std::pair<double, double> edgeDensity(uint32_t subarrayRows = SPATIAL_SUBARRAY_ROWS) const;
+  };
+
+  /*
+   * Counts the cells of dumps that differ from the init value under BRC and RBC at once, in a single pass over
+   * each payload. A dump is cut into as many parts as there are threads, every thread counts its part into maps
+   * of its own and the maps are added up afterwards, so the counts do not depend on the number of threads; only
+   * the neighbour pairs across a cut are missed, one row per bank and one pair of columns.
+   */
+  class SpatialAnalysis {
+  private:
+    unsigned threads;
+    uint64_t dumps = 0;
+
+  public:
+    // Index 0 is BRC, 1 is RBC
+    std::array<SpatialMap, 2> maps;
+
+    // 0 threads use every CPU
+    explicit SpatialAnalysis(unsigned _threads = 0);
+
+    // The payload of view, whose cells hold init before the decay
+    void add(const DumpView& view, uint32_t init);
+
+    SpatialAnalysis& operator+=(const SpatialAnalysis& other);
+
+    [[nodiscard]] uint64_t getDumps() const {
+      return dumps;
+    }
+
+    // Flips per bank, the neighbour correlations and the profile correlations of both mappings
+    void report(std::ostream& out) const;
+
+    // Tab-separated flip counts per bank and row (per bank and column) of both mappings, for heatmaps
+    void writeRows(std::ostream& out) const;
+
+    void writeCols(std::ostream& out) const;
+  };
+}
@@ -0,0 +1,79 @@
+#include <args.hxx>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "dump_file.h"
+#include "dump_view.h"
+#include "spatial.h"
+
+using namespace SerialReader;
+
+static bool writeTable(const std::string& path, const SpatialAnalysis& analysis, const bool rows) {
+  std::ofstream out(path);
+  rows ? analysis.writeRows(out) : analysis.writeCols(out);
+  out.flush();
+  if (!out) {
+    std::cerr << "Could not write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Counts where the bits of dumps flipped, by bank, row and column under both address mappings
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Counts the flipped bits of dumps by bank, row and column under BRC and RBC, in one pass per dump, and "
+    "correlates the flips of neighbouring rows and columns.",
+    "Commands: report DUMP... (flips per bank, neighbour and profile correlations of all dumps together)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "report");
+  args::PositionalList<std::string> filesA(argsParser, "dumps", "Dumps of one board");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params",
+                                           "params the raw dumps were measured with (init value and address mode)",
+                                           {'p', "params"});
+  args::ValueFlag<unsigned> threadsA(argsParser, "threads", "Threads per dump, 0 for every CPU", {'t', "threads"},
+                                     0);
+  args::ValueFlag<std::string> rowsA(argsParser, "file", "Write the flips per bank and row as TSV", {"rows"}, "");
+  args::ValueFlag<std::string> colsA(argsParser, "file", "Write the flips per bank and column as TSV", {"cols"},
+                                     "");
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::vector<std::string>& files = args::get(filesA);
+  if (args::get(commandA) != "report" || files.empty()) {
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const bool given = !args::get(paramsA).empty();
+  const Challenge params = Challenge::fromParams(args::get(paramsA));
+  SpatialAnalysis analysis(args::get(threadsA));
+  for (const auto& file : files) {
+    const DumpReader reader(file);
+    if (!reader.isOpen()) {
+      std::cerr << "Could not read " << file << std::endl;
+      return 1;
+    }
+    if (!reader.described && !given) {
+      std::cerr << "The init value of " << file << " is unknown, give its params with -p" << std::endl;
+      return 1;
+    }
+    const DumpView view(reader, params.addMode);
+    analysis.add(view, reader.described ? reader.info.challenge.init : params.init);
+  }
+
+  analysis.report(std::cout);
+  if (!args::get(rowsA).empty() && !writeTable(args::get(rowsA), analysis, true)) return 1;
+  if (!args::get(colsA).empty() && !writeTable(args::get(colsA), analysis, false)) return 1;
+  return 0;
+}
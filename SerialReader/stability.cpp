@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bit_kernels.h"
+#include "bytes.h"
+#include "stability.h"
+
+SerialReader::StabilityMap::StabilityMap(const std::string& path, const Challenge& challenge,
+                                         const uint32_t _threshold) {
+  size = challenge.payloadSize();
+  if (!challenge.isDump() || size == 0) {
+    error = "the challenge does not read memory";
+    return;
+  }
+  stride = (size + 7) / 8 * 8;
+  threshold = _threshold;
+  while (planes < 32 && (1ULL << planes) - 1 < static_cast<uint64_t>(threshold) + 1) planes++;
+  unsigned char header[STABILITY_HEADER_SIZE]{};
+  std::memcpy(header, STABILITY_MAGIC, sizeof(STABILITY_MAGIC));
+  putU32(header + 8, STABILITY_VERSION);
+  putU32(header + 12, STABILITY_HEADER_SIZE);
+  putU64(header + 16, size);
+  putU64(header + 24, stride);
+  putU32(header + 32, planes);
+  putU32(header + 36, threshold);
+  putChallenge(header + 56, challenge);
+
+  const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    error = "could not open " + path + ": " + std::strerror(errno);
+    return;
+  }
+  const size_t total = STABILITY_HEADER_SIZE + (2 + planes) * stride;
+  struct stat st{};
+  const bool created = fstat(fd, &st) == 0 && st.st_size == 0;
+  if (created && ftruncate(fd, static_cast<off_t>(total)) != 0) {
+    error = "could not allocate " + path;
+    close(fd);
+    return;
+  }
+  if (!created && static_cast<size_t>(st.st_size) != total) {
+    error = path + " belongs to another challenge or threshold";
+    close(fd);
+    return;
+  }
+  void* m = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) {
+    error = "could not map " + path;
+    return;
+  }
+  map = static_cast<unsigned char*>(m);
+  mapSize = total;
+  if (created) {
+    std::memcpy(map, header, sizeof(header));
+  } else if (std::memcmp(map, header, 40) != 0 || std::memcmp(map + 56, header + 56, CHALLENGE_SIZE) != 0) {
+    error = path + " belongs to another challenge or threshold";
+    munmap(map, mapSize);
+    map = nullptr;
+  }
+}
+
+SerialReader::StabilityMap::~StabilityMap() {
+  if (map != nullptr) munmap(map, mapSize);
+}
+
+unsigned char* SerialReader::StabilityMap::plane(const uint32_t index) const {
+  return map + STABILITY_HEADER_SIZE + index * stride;
+}
+
+uint32_t SerialReader::StabilityMap::measurements() const {
+  return map != nullptr ? getU32(map + 40) : 0;
+}
+
+uint64_t SerialReader::StabilityMap::stable() const {
+  return map != nullptr ? getU64(map + 48) : 0;
+}
+
+bool SerialReader::StabilityMap::converged(const uint64_t target) const {
+  return measurements() > 1 && stable() >= target && getU32(map + 44) >= STABILITY_SETTLE;
+}
+
+bool SerialReader::StabilityMap::isStable(const uint64_t bit) const {
+  if (map == nullptr || bit >= size * 8) return false;
+  uint32_t counter = 0;
+  for (uint32_t k = 0; k < planes; k++) {
+    counter |= (plane(2 + k)[bit / 8] >> (7 - bit % 8) & 1) << k;
+  }
+  return counter <= threshold;
+}
+
+bool SerialReader::StabilityMap::writePositions(const std::string& path) const {
+  if (map == nullptr) return false;
+  std::ofstream out(path);
+  const BitKernels& kernels = bitKernels();
+  std::vector<const uint64_t*> counters(planes);
+  uint64_t mask[STABILITY_BLOCK];
+  for (uint64_t offset = 0; offset < size; offset += STABILITY_BLOCK * 8) {
+    const size_t words = std::min<uint64_t>(STABILITY_BLOCK, (stride - offset) / 8);
+    for (uint32_t k = 0; k < planes; k++) counters[k] = reinterpret_cast<const uint64_t*>(plane(2 + k) + offset);
+    kernels.atMost(counters.data(), planes, threshold, mask, words);
+    for (uint64_t byte = offset; byte < offset + words * 8 && byte < size; byte++) {
+      // Little endian words, so byte i of a word is payload byte 8 * word + i; pos files count MSB first
+      const unsigned bits = mask[(byte - offset) / 8] >> 8 * (byte % 8) & 0xFF;
+      for (int shift = 7; shift >= 0; shift--) {
+        if (bits >> shift & 1) out << byte * 8 + 7 - shift << '\n';
+      }
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+void SerialReader::StabilityMap::update(const uint64_t offset, const unsigned char* data, size_t count) {
+  if (map == nullptr || offset >= size) return;
+  if (count > size - offset) count = size - offset;
+  if (measurements() == 0) {
+    std::memcpy(plane(0) + offset, data, count);
+    return;
+  }
+  const unsigned char* reference = plane(0) + offset;
+  unsigned char* pending = plane(1) + offset;
+  const size_t words = count / 8;
+  bitKernels().bitXor(reinterpret_cast<uint64_t*>(pending), reinterpret_cast<const uint64_t*>(data),
+                      reinterpret_cast<const uint64_t*>(reference), words);
+  for (size_t i = words * 8; i < count; i++) pending[i] = data[i] ^ reference[i];
+}
+
+uint64_t SerialReader::StabilityMap::fold() {
+  const BitKernels& kernels = bitKernels();
+  std::vector<uint64_t*> counters(planes);
+  uint64_t mask[STABILITY_BLOCK];
+  uint64_t ret = 0;
+  for (uint64_t offset = 0; offset < stride; offset += STABILITY_BLOCK * 8) {
+    const size_t words = std::min<uint64_t>(STABILITY_BLOCK, (stride - offset) / 8);
+    auto* carry = reinterpret_cast<uint64_t*>(plane(1) + offset);
+    for (uint32_t k = 0; k < planes; k++) counters[k] = reinterpret_cast<uint64_t*>(plane(2 + k) + offset);
+    // Blocks without a difference are not written, so that their pages stay clean
+    if (kernels.popcount(carry, words) != 0) {
+      kernels.increment(counters.data(), planes, carry, words);
+      std::memset(carry, 0, words * 8);
+    }
+    kernels.atMost(counters.data(), planes, threshold, mask, words);
+    ret += kernels.popcount(mask, words);
+  }
+  // The padding up to the stride never differs
+  return ret - (stride - size) * 8;
+}
+
+void SerialReader::StabilityMap::commit(const bool ok) {
+  if (map == nullptr) return;
+  const uint32_t n = measurements();
+  if (!ok) {
+    // Leave the counters alone and start the next transfer with a clean pending plane
+    if (n > 0) std::memset(plane(1), 0, stride);
+    return;
+  }
+  const uint64_t previous = stable();
+  const uint64_t now = n == 0 ? size * 8 : fold();
+  putU32(map + 40, n + 1);
+  putU32(map + 44, n > 0 && now == previous ? getU32(map + 44) + 1 : 0);
+  putU64(map + 48, now);
+  msync(map, mapSize, MS_ASYNC);
+}
+
+void SerialReader::StabilitySink::begin(const DumpInfo& info) {
+  offset = 0;
+  dump = info.payloadSize > 0 && info.payloadSize == stability.getSize();
+  inner.begin(info);
+}
+
+void SerialReader::StabilitySink::write(const char* data, const size_t count) {
+  if (dump) stability.update(offset, reinterpret_cast<const unsigned char*>(data), count);
+  offset += count;
+  inner.write(data, count);
+}
+
+void SerialReader::StabilitySink::end(const bool ok) {
+  inner.end(ok);
+  if (dump) stability.commit(ok && offset == stability.getSize());
+  dump = false;
+}
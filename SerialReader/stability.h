@@ -0,0 +1,110 @@
+#pragma once
+
+#define STABILITY_MAGIC "PUFSTAB"
+#define STABILITY_VERSION 1
+#define STABILITY_HEADER_SIZE 512
+// Measurements in a row the number of stable bits has to hold before enrollment counts as converged
+#define STABILITY_SETTLE 3
+// Words the counters are folded in at a time, small enough for the stack and L1
+#define STABILITY_BLOCK 512
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "challenge.h"
+#include "dump_sink.h"
+
+namespace SerialReader {
+  /*
+   * Per-bit stability of the responses to one challenge, kept in a memory mapped file and updated while dumps
+   * stream in. Every bit is compared with its value in the first dump and has a saturating counter of how often it
+   * differed since; a bit is stable while its counter is at most the threshold.
+   *
+   * The counters are bit-sliced: plane k holds bit k of the counters of all payload bits, in payload layout, so one
+   * 64 bit word of every plane updates 64 counters at once. The mismatches of a transfer are collected in a pending
+   * plane and only added to the counters when it completed, so an aborted transfer leaves the map untouched.
+   *
+   * Header (STABILITY_HEADER_SIZE bytes, little endian):
+   *   "PUFSTAB\0", u32 version, u32 header size, u64 payload size, u64 plane stride, u32 counter planes,
+   *   u32 threshold, u32 measurements, u32 measurements the stable count did not change, u64 stable bits,
+   *   u32 mode, address mode, function location, start, end, init value, function, interval, decay
+   * followed by the reference plane (first dump), the pending plane and the counter planes, least significant first.
+   * The whole region is mapped, like puf_read_all reads it.
+   */
+  class StabilityMap {
+  private:
+    unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    uint64_t size = 0;
+    uint64_t stride = 0;
+    uint32_t planes = 0;
+    uint32_t threshold = 0;
+    std::string error;
+
+    [[nodiscard]] unsigned char* plane(uint32_t index) const;
+
+    // Adds the pending plane to the counters and counts the stable bits
+    uint64_t fold();
+
+  public:
+    // Opens the map of challenge, or creates it; threshold is the number of mismatches a stable bit may have
+    StabilityMap(const std::string& path, const Challenge& challenge, uint32_t _threshold = 0);
+
+    ~StabilityMap();
+
+    StabilityMap(const StabilityMap&) = delete;
+
+    StabilityMap& operator=(const StabilityMap&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return map != nullptr;
+    }
+
+    // Why the map could not be opened, e.g. because the file belongs to another challenge
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+
+    [[nodiscard]] uint64_t getSize() const {
+      return size;
+    }
+
+    [[nodiscard]] uint32_t measurements() const;
+
+    // Number of bits that are stable after the last completed measurement
+    [[nodiscard]] uint64_t stable() const;
+
+    // Whether at least target bits are stable and that number held for STABILITY_SETTLE measurements
+    [[nodiscard]] bool converged(uint64_t target) const;
+
+    // Whether the counter of a payload bit (MSB first, like in pos files) is at most the threshold
+    [[nodiscard]] bool isStable(uint64_t bit) const;
+
+    // Writes the indices of the stable bits one per line, i.e. a pos file for extractKey; false on error
+    bool writePositions(const std::string& path) const;
+
+    // Streaming update, offset is the position of data in the payload
+    void update(uint64_t offset, const unsigned char* data, size_t count);
+
+    // Ends a measurement; its mismatches only count if it was complete
+    void commit(bool ok);
+  };
+
+  // Passes the transfer on and updates a stability map with it
+  class StabilitySink : public DumpSink {
+  private:
+    DumpSink& inner;
+    StabilityMap& stability;
+    uint64_t offset = 0;
+    bool dump = false;
+
+  public:
+    StabilitySink(DumpSink& _inner, StabilityMap& _stability) : inner(_inner), stability(_stability) {}
+
+    void begin(const DumpInfo& info) override;
+
+    void write(const char* data, size_t count) override;
+
+    void end(bool ok) override;
+  };
+}
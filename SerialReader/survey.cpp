@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "survey.h"
+
+void SerialReader::SurveyMap::sort() {
+  std::sort(rows.begin(), rows.end(), [](const SurveyRow& a, const SurveyRow& b) {
+    return a.address < b.address;
+  });
+  rows.erase(std::unique(rows.begin(), rows.end(), [](const SurveyRow& a, const SurveyRow& b) {
+    return a.address == b.address;
+  }), rows.end());
+}
+
+// Halfway between the end of one row and the start of the next, rounded down to a row
+static uint32_t between(const uint32_t a, const uint32_t b) {
+  const uint64_t mid = (static_cast<uint64_t>(a) + SURVEY_ROW + b) / 2;
+  return static_cast<uint32_t>(mid & ~static_cast<uint64_t>(SURVEY_ROW - 1));
+}
+
+uint32_t SerialReader::SurveyMap::from(const size_t i) const {
+  return i == 0 ? rows[0].address : between(rows[i - 1].address, rows[i].address);
+}
+
+uint32_t SerialReader::SurveyMap::to(const size_t i) const {
+  if (i + 1 < rows.size()) return between(rows[i].address, rows[i + 1].address);
+  // The evenly spaced rows end one step before the end of the region, the last one stands for the rest of it
+  const uint32_t end = challenge.end & ~static_cast<uint32_t>(SURVEY_ROW - 1);
+  return std::max(rows[i].address + SURVEY_ROW, end);
+}
+
+double SerialReader::SurveyMap::density(const uint32_t start, const uint32_t end) const {
+  double weighted = 0;
+  uint64_t covered = 0;
+  for (size_t i = 0; i < rows.size(); i++) {
+    const uint32_t lo = std::max(start, from(i)), hi = std::min(end, to(i));
+    if (lo >= hi) continue;
+    weighted += rows[i].density() * (hi - lo);
+    covered += hi - lo;
+  }
+  return covered > 0 ? weighted / static_cast<double>(covered) : 0;
+}
+
+std::vector<SerialReader::SurveyRegion> SerialReader::SurveyMap::regions(const uint32_t size,
+                                                                         const size_t count) const {
+  std::vector<SurveyRegion> result;
+  if (rows.empty() || count == 0) return result;
+  const uint32_t first = from(0), last = to(rows.size() - 1);
+  const uint32_t length = std::min((std::max<uint32_t>(size, 1) + SURVEY_ROW - 1) & ~(SURVEY_ROW - 1), last - first);
+  // One candidate centred on every row; refined rows are where the density changes, so they place them well
+  std::vector<SurveyRegion> candidates;
+  for (const auto& row : rows) {
+    const int64_t centre = static_cast<int64_t>(row.address) + SURVEY_ROW / 2 - length / 2;
+    const auto start = static_cast<uint32_t>(std::clamp<int64_t>(centre, first, last - length)) &
+                       ~static_cast<uint32_t>(SURVEY_ROW - 1);
+    candidates.push_back({std::max(start, first), std::max(start, first) + length, 0});
+  }
+  for (auto& c : candidates) c.density = density(c.start, c.end);
+  std::stable_sort(candidates.begin(), candidates.end(), [](const SurveyRegion& a, const SurveyRegion& b) {
+    return a.density > b.density;
+  });
+  for (const auto& c : candidates) {
+    const bool overlaps = std::any_of(result.begin(), result.end(), [&c](const SurveyRegion& r) {
+      return c.start < r.end && r.start < c.end;
+    });
+    if (overlaps) continue;
+    result.push_back(c);
+    if (result.size() == count) break;
+  }
+  return result;
+}
+
+bool SerialReader::SurveyMap::write(const std::string& path) const {
+  std::ofstream out(path);
+  out << std::hex << std::uppercase << "# start " << challenge.start << " end " << challenge.end << " init "
+      << challenge.init << std::dec << " addMode " << challenge.addMode << " decay " << challenge.decay << '\n';
+  out << "address\tbank\trow\tlevel\tflips\tdensity\n";
+  for (const auto& row : rows) {
+    const Cell cell = cellOf(row.address, challenge.addMode);
+    out << std::hex << std::uppercase << row.address << std::dec << '\t' << cell.bank << '\t' << cell.row << '\t'
+        << row.level << '\t' << row.flips << '\t' << row.density() << '\n';
+  }
+  out.flush();
+  return static_cast<bool>(out);
+}
+
+bool SerialReader::SurveyMap::read(const std::string& path, SurveyMap& map) {
+  std::ifstream in(path);
+  std::string line;
+  if (!in || !std::getline(in, line) || line.rfind("# start ", 0) != 0) return false;
+  map = SurveyMap();
+  std::istringstream header(line.substr(2));
+  for (std::string key; header >> key;) {
+    if (key == "start") header >> std::hex >> map.challenge.start;
+    if (key == "end") header >> std::hex >> map.challenge.end;
+    if (key == "init") header >> std::hex >> map.challenge.init;
+    if (key == "addMode") header >> std::dec >> map.challenge.addMode;
+    if (key == "decay") header >> std::dec >> map.challenge.decay;
+  }
+  map.challenge.mode = 5;
+  std::getline(in, line);
+  for (; std::getline(in, line);) {
+    std::istringstream fields(line);
+    SurveyRow row;
+    uint32_t bank, r;
+    if (fields >> std::hex >> row.address >> std::dec >> bank >> r >> row.level >> row.flips) map.rows.push_back(row);
+  }
+  map.sort();
+  return !in.bad();
+}
+
+SerialReader::SurveyParser::SurveyParser(SurveyMap& map) : TokenParser([&map](const std::string& token) {
+  const size_t at = token.find('@');
+  const size_t eq = token.find('=');
+  SurveyRow row;
+  // "%d@%08X=%d"
+  if (at == std::string::npos || eq == std::string::npos || eq != at + 9 ||
+      !parseNumber(token, 0, at, 10, row.level) || !parseNumber(token, at + 1, eq, 16, row.address) ||
+      !parseNumber(token, eq + 1, token.size(), 10, row.flips) || row.flips > SURVEY_ROW * 8 ||
+      row.address % SURVEY_ROW != 0) {
+    return false;
+  }
+  map.rows.push_back(row);
+  return true;
+}) {}
+
+void SerialReader::SurveySink::begin(const DumpInfo& info) {
+  survey = info.payloadSize == 0 && info.challenge.isSurvey();
+  map = SurveyMap();
+  map.challenge = info.challenge;
+  parser.reset();
+  inner.begin(info);
+}
+
+void SerialReader::SurveySink::write(const char* data, const size_t count) {
+  if (survey) parser.feed(data, count);
+  inner.write(data, count);
+}
+
+void SerialReader::SurveySink::end(const bool ok) {
+  inner.end(ok);
+  if (survey && ok) {
+    parser.finish();
+    map.sort();
+    if (!map.write(path)) std::cerr << "Could not write " << path << std::endl;
+  }
+  survey = false;
+}
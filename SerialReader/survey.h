@@ -0,0 +1,93 @@
+#pragma once
+
+// Bytes per sampled row and the most rows puf_read_survey reads, as in GetPuf.c
+#define SURVEY_ROW 0x1000
+#define SURVEY_MAX_ROWS 1024
+// Longest text the firmware prints per row: "%d@%08X=%d,"
+#define SURVEY_TOKEN_SIZE 20
+#define SURVEY_EXTENSION ".survey"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "challenge.h"
+#include "dump_sink.h"
+#include "token_parser.h"
+
+namespace SerialReader {
+  // One row the survey read
+  struct SurveyRow {
+    uint32_t address = 0;
+    // Bits of the row that differed from the init value
+    uint32_t flips = 0;
+    // 0 for the evenly spaced rows, n for the rows added in the n-th refinement
+    uint32_t level = 0;
+
+    [[nodiscard]] double density() const {
+      return flips / (SURVEY_ROW * 8.0);
+    }
+  };
+
+  // A stretch of addresses and its estimated share of flipped bits
+  struct SurveyRegion {
+    uint32_t start = 0;
+    uint32_t end = 0;
+    double density = 0;
+  };
+
+  /*
+   * Flip density of a region as a survey (mode 5) sampled it. Each row stands for the addresses up to halfway to
+   * its neighbours, so densities of stretches are averages weighted by how much of a stretch each row covers.
+   *
+   * Written as text: "# start S end E init I addMode A decay D" (hex addresses), a header line and then per row
+   * "address\tbank\trow\tlevel\tflips\tdensity" sorted by address.
+   */
+  struct SurveyMap {
+    Challenge challenge;
+    std::vector<SurveyRow> rows;
+
+    // Sorts by address and drops rows read twice
+    void sort();
+
+    // First and one past the last address row i stands for
+    [[nodiscard]] uint32_t from(size_t i) const;
+
+    [[nodiscard]] uint32_t to(size_t i) const;
+
+    [[nodiscard]] double density(uint32_t start, uint32_t end) const;
+
+    // The count densest regions of size bytes (whole rows) that do not overlap, densest first
+    [[nodiscard]] std::vector<SurveyRegion> regions(uint32_t size, size_t count) const;
+
+    bool write(const std::string& path) const;
+
+    // False if the file could not be read or is no survey map
+    static bool read(const std::string& path, SurveyMap& map);
+  };
+
+  // Parses the text puf_read_survey prints between "&|" and "|&", "%d@%08X=%d" per row separated by ","
+  class SurveyParser : public TokenParser {
+  public:
+    explicit SurveyParser(SurveyMap& map);
+  };
+
+  // Passes the transfer on and writes a survey (mode 5) as a map once it completed
+  class SurveySink : public DumpSink {
+  private:
+    DumpSink& inner;
+    const std::string path;
+    SurveyMap map;
+    SurveyParser parser{map};
+    bool survey = false;
+
+  public:
+    SurveySink(DumpSink& _inner, std::string _path) : inner(_inner), path(std::move(_path)) {}
+
+    void begin(const DumpInfo& info) override;
+
+    void write(const char* data, size_t count) override;
+
+    void end(bool ok) override;
+  };
+}
@@ -0,0 +1,101 @@
+#include <args.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "dump_file.h"
+#include "survey.h"
+
+using namespace SerialReader;
+
+// The address as the kernel reads start and end params: hex digits from the top, so all eight of them
+static std::string param(const uint32_t address) {
+  char text[9];
+  std::snprintf(text, sizeof(text), "%08X", address);
+  return text;
+}
+
+// Turns surveys (mode 5) into flip density maps and picks the regions worth dumping or summarising
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Builds flip density maps from surveys (mode 5) and picks the densest regions of them.",
+    "Commands: build MAP SURVEY (a transfer as SerialReader wrote it), info MAP, regions MAP (the densest regions "
+    "that do not overlap, with the params to measure them)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "build, info or regions");
+  args::Positional<std::string> mapA(argsParser, "map", "Survey map");
+  args::Positional<std::string> surveyA(argsParser, "survey", "build: the survey transfer");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params", "build: params a raw survey was measured with",
+                                           {'p', "params"});
+  args::ValueFlag<size_t> countA(argsParser, "count", "regions: number of regions", {'n', "count"}, 4);
+  args::ValueFlag<uint32_t> sizeA(argsParser, "KiB", "regions: size of each region", {"size"}, 1024);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  const std::string& path = args::get(mapA);
+
+  if (command == "build" && surveyA) {
+    const DumpReader dump(args::get(surveyA));
+    if (!dump.isOpen()) {
+      std::cerr << "Could not read " << args::get(surveyA) << std::endl;
+      return 1;
+    }
+    SurveyMap map;
+    map.challenge = dump.described || args::get(paramsA).empty() ? dump.info.challenge
+                                                                  : Challenge::fromParams(args::get(paramsA));
+    SurveyParser survey(map);
+    // A raw survey starts with a row that DumpReader took for the frame of a dump
+    if (!dump.described) survey.feed(dump.info.frame.data(), dump.info.frame.size());
+    survey.feed(reinterpret_cast<const char*>(dump.payload), dump.size);
+    survey.finish();
+    map.sort();
+    if (!map.write(path)) {
+      std::cerr << "Could not write " << path << std::endl;
+      return 1;
+    }
+    std::cout << map.rows.size() << " rows";
+    if (survey.getMalformed() > 0) std::cout << ", skipped " << survey.getMalformed() << " malformed";
+    std::cout << std::endl;
+    return 0;
+  }
+
+  SurveyMap map;
+  if (!SurveyMap::read(path, map) || map.rows.empty()) {
+    std::cerr << "Could not read " << path << std::endl;
+    return 1;
+  }
+  if (command == "info") {
+    std::map<uint32_t, size_t> levels;
+    for (const auto& row : map.rows) levels[row.level]++;
+    const auto [lo, hi] = std::minmax_element(map.rows.begin(), map.rows.end(),
+                                              [](const SurveyRow& a, const SurveyRow& b) {
+                                                return a.flips < b.flips;
+                                              });
+    const uint32_t first = map.from(0), last = map.to(map.rows.size() - 1);
+    std::cout << map.rows.size() << " rows between " << param(first) << " and " << param(last) << std::endl;
+    for (const auto& [level, rows] : levels) std::cout << "level " << level << ": " << rows << " rows" << std::endl;
+    std::cout << "density " << lo->density() << " to " << hi->density() << ", " << map.density(first, last)
+      << " on average" << std::endl;
+    return 0;
+  }
+  if (command == "regions") {
+    for (const auto& region : map.regions(args::get(sizeA) * 1024, args::get(countA))) {
+      std::cout << region.density << "\t-p " << param(region.start) << " -p " << param(region.end) << std::endl;
+    }
+    return 0;
+  }
+  std::cerr << argsParser;
+  return 1;
+}
@@ -0,0 +1,43 @@
+#include "token_parser.h"
+
+bool SerialReader::parseNumber(const std::string& s, const size_t from, const size_t to, const int base,
+                               uint32_t& value) {
+  if (from >= to) return false;
+  value = 0;
+  for (size_t i = from; i < to; i++) {
+    const char c = s[i];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (base == 16 && c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else if (base == 16 && c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else {
+      return false;
+    }
+    value = value * base + digit;
+  }
+  return true;
+}
+
+void SerialReader::TokenParser::parse() {
+  if (token.empty()) return;
+  if (!onToken(token)) malformed++;
+  token.clear();
+}
+
+void SerialReader::TokenParser::feed(const char* data, const size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const char c = data[i];
+    if (c == ',') {
+      parse();
+    } else if (c > ' ' && token.size() < TOKEN_MAX_SIZE) {
+      token += c;
+    }
+  }
+}
+
+void SerialReader::TokenParser::finish() {
+  parse();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Longer tokens are cut, no token of the firmware comes close
+#define TOKEN_MAX_SIZE 32
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace SerialReader {
+  // Value of the hex or decimal field [from, to) of s, false if it is empty or has other characters
+  bool parseNumber(const std::string& s, size_t from, size_t to, int base, uint32_t& value);
+
+  /*
+   * Splits the text the firmware prints between "&|" and "|&" into ","-separated tokens and hands every token,
+   * without whitespace, to a callback that returns false if the token is malformed. Text can be fed in pieces of
+   * any size.
+   */
+  class TokenParser {
+  private:
+    std::function<bool(const std::string&)> onToken;
+    std::string token;
+    size_t malformed = 0;
+
+    void parse();
+
+  public:
+    explicit TokenParser(std::function<bool(const std::string&)> _onToken) : onToken(std::move(_onToken)) {}
+
+    void feed(const char* data, size_t count);
+
+    // Parses what is left after the last ","
+    void finish();
+
+    // Drops a partial token and the malformed count, for the next transfer
+    void reset() {
+      token.clear();
+      malformed = 0;
+    }
+
+    [[nodiscard]] size_t getMalformed() const {
+      return malformed;
+    }
+  };
+}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bit_kernels.h"
+#include "bytes.h"
+#include "transposed.h"
+
+SerialReader::TransposedWriter::TransposedWriter(std::string _path, const Challenge& challenge)
+  : path(std::move(_path)) {
+  size = challenge.payloadSize();
+  if (!challenge.isDump() || size == 0) {
+    error = "the challenge does not read memory";
+    return;
+  }
+  unsigned char header[TRANSPOSED_HEADER_SIZE]{};
+  std::memcpy(header, TRANSPOSED_MAGIC, sizeof(TRANSPOSED_MAGIC));
+  putU32(header + 8, TRANSPOSED_VERSION);
+  putU32(header + 12, TRANSPOSED_HEADER_SIZE);
+  putU64(header + 16, size);
+  putChallenge(header + 32, challenge);
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    error = "could not open " + path + ": " + std::strerror(errno);
+    return;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size == 0) {
+    if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+      error = "could not write " + path;
+      close(fd);
+      fd = -1;
+    }
+    return;
+  }
+  unsigned char existing[TRANSPOSED_HEADER_SIZE];
+  if (pread(fd, existing, sizeof(existing), 0) != sizeof(existing) || std::memcmp(existing, header, 24) != 0 ||
+      std::memcmp(existing + 32, header + 32, CHALLENGE_SIZE) != 0) {
+    error = path + " belongs to another challenge";
+    close(fd);
+    fd = -1;
+    return;
+  }
+  runs = getU32(existing + 24);
+}
+
+SerialReader::TransposedWriter::~TransposedWriter() {
+  if (map != nullptr) munmap(map, mapSize);
+  if (fd != -1) close(fd);
+}
+
+bool SerialReader::TransposedWriter::mapGroup(const uint32_t index) {
+  if (group == index) return true;
+  if (map != nullptr) munmap(map, mapSize);
+  map = nullptr;
+  words = nullptr;
+  group = -1;
+  const uint64_t groupSize = size * 8 * sizeof(uint64_t);
+  const uint64_t offset = TRANSPOSED_HEADER_SIZE + index * groupSize;
+  // Groups that were never written are holes of zeros
+  struct stat st{};
+  if (fstat(fd, &st) != 0) return false;
+  if (static_cast<uint64_t>(st.st_size) < offset + groupSize &&
+      ftruncate(fd, static_cast<off_t>(offset + groupSize)) != 0) {
+    return false;
+  }
+  const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const uint64_t aligned = offset / page * page;
+  mapSize = groupSize + (offset - aligned);
+  void* m = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(aligned));
+  if (m == MAP_FAILED) return false;
+  map = static_cast<unsigned char*>(m);
+  words = reinterpret_cast<uint64_t*>(map + (offset - aligned));
+  group = index;
+  return true;
+}
+
+bool SerialReader::TransposedWriter::begin() {
+  received = 0;
+  if (fd == -1) return false;
+  if (!mapGroup(runs / TRANSPOSED_RUNS)) {
+    error = "could not allocate a run group in " + path;
+    return false;
+  }
+  // The slot may hold bits of a run that never committed, e.g. because the process died during its transfer
+  const uint64_t keep = ~(1ULL << runs % TRANSPOSED_RUNS);
+  for (uint64_t i = 0; i < size * 8; i++) words[i] &= keep;
+  return true;
+}
+
+void SerialReader::TransposedWriter::update(const unsigned char* data, size_t count) {
+  if (words == nullptr || received >= size) return;
+  if (count > size - received) count = size - received;
+  bitKernels().spread(data, count, words + received * 8, 1ULL << runs % TRANSPOSED_RUNS);
+  received += count;
+}
+
+bool SerialReader::TransposedWriter::commit(const bool ok) {
+  if (words == nullptr) return false;
+  if (!ok || received != size) {
+    // The next run reuses the slot, begin() clears it
+    received = 0;
+    return false;
+  }
+  received = 0;
+  unsigned char count[4];
+  putU32(count, runs + 1);
+  if (pwrite(fd, count, sizeof(count), 24) != sizeof(count)) return false;
+  runs++;
+  return true;
+}
+
+void SerialReader::TransposedSink::begin(const DumpInfo& info) {
+  dump = info.payloadSize > 0 && info.payloadSize == writer.getSize() && writer.begin();
+  inner.begin(info);
+}
+
+void SerialReader::TransposedSink::write(const char* data, const size_t count) {
+  if (dump) writer.update(reinterpret_cast<const unsigned char*>(data), count);
+  inner.write(data, count);
+}
+
+void SerialReader::TransposedSink::end(const bool ok) {
+  inner.end(ok);
+  if (dump) writer.commit(ok);
+  dump = false;
+}
+
+SerialReader::TransposedReader::TransposedReader(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return;
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && st.st_size >= TRANSPOSED_HEADER_SIZE) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m != MAP_FAILED) {
+      map = static_cast<const unsigned char*>(m);
+      mapSize = st.st_size;
+    }
+  }
+  close(fd);
+  if (map == nullptr) return;
+  size = getU64(map + 16);
+  runs = getU32(map + 24);
+  bits = size * 8;
+  groupCount = (runs + TRANSPOSED_RUNS - 1) / TRANSPOSED_RUNS;
+  lastMask = runs % TRANSPOSED_RUNS == 0 ? ~0ULL : (1ULL << runs % TRANSPOSED_RUNS) - 1;
+  if (std::memcmp(map, TRANSPOSED_MAGIC, sizeof(TRANSPOSED_MAGIC)) != 0 ||
+      mapSize < TRANSPOSED_HEADER_SIZE + groupCount * bits * sizeof(uint64_t)) {
+    munmap(const_cast<unsigned char*>(map), mapSize);
+    map = nullptr;
+    return;
+  }
+  challenge = getChallenge(map + 32);
+  groups = reinterpret_cast<const uint64_t*>(map + TRANSPOSED_HEADER_SIZE);
+}
+
+SerialReader::TransposedReader::~TransposedReader() {
+  if (map != nullptr) munmap(const_cast<unsigned char*>(map), mapSize);
+}
+
+uint64_t SerialReader::TransposedReader::word(const uint64_t bit, const uint32_t group) const {
+  const uint64_t w = groups[group * bits + bit];
+  return group + 1 == groupCount ? w & lastMask : w;
+}
+
+uint32_t SerialReader::TransposedReader::ones(const uint64_t bit) const {
+  uint32_t ret = 0;
+  for (uint32_t g = 0; g < groupCount; g++) ret += __builtin_popcountll(word(bit, g));
+  return ret;
+}
+
+int SerialReader::TransposedReader::majority(const uint64_t bit) const {
+  return 2 * ones(bit) >= runs ? 1 : 0;
+}
+
+bool SerialReader::TransposedReader::isStable(const uint64_t bit, const uint32_t threshold) const {
+  const uint32_t n = ones(bit);
+  return std::min(n, runs - n) <= threshold;
+}
+
+double SerialReader::TransposedReader::flipProbability(const uint64_t bit) const {
+  if (runs == 0) return 0;
+  const bool init = challenge.init >> (31 - bit % 32) & 1;
+  const uint32_t n = ones(bit);
+  return static_cast<double>(init ? runs - n : n) / runs;
+}
+
+SerialReader::TransposedStats SerialReader::TransposedReader::stats(const uint32_t threshold) const {
+  TransposedStats ret;
+  if (runs == 0) return ret;
+  uint64_t errors = 0;
+  uint64_t flips = 0;
+  for (uint64_t bit = 0; bit < bits; bit++) {
+    const uint32_t n = ones(bit);
+    const uint32_t minority = std::min(n, runs - n);
+    if (minority <= threshold) ret.stable++;
+    errors += minority;
+    flips += challenge.init >> (31 - bit % 32) & 1 ? runs - n : n;
+  }
+  const auto total = static_cast<double>(bits) * runs;
+  ret.bitErrorRate = static_cast<double>(errors) / total;
+  ret.flipRate = static_cast<double>(flips) / total;
+  return ret;
+}
+
+bool SerialReader::TransposedReader::writePositions(const std::string& path, const uint32_t threshold) const {
+  std::ofstream out(path);
+  for (uint64_t bit = 0; bit < bits; bit++) {
+    if (isStable(bit, threshold)) out << bit << '\n';
+  }
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#define TRANSPOSED_MAGIC "PUFTRAN"
+#define TRANSPOSED_VERSION 1
+// A page, so that every run group can be mapped on its own
+#define TRANSPOSED_HEADER_SIZE 4096
+#define TRANSPOSED_RUNS 64
+#define TRANSPOSED_EXTENSION ".puft"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "challenge.h"
+#include "dump_sink.h"
+
+namespace SerialReader {
+  /*
+   * Run-major store of many dumps of one challenge: for every payload bit (MSB first, like in pos files) one 64 bit
+   * word holds its value in up to TRANSPOSED_RUNS runs, bit r being run r. Run groups of 64 follow each other, so
+   * how a bit behaved across runs is one load (per group) and a popcount.
+   *
+   * Header (TRANSPOSED_HEADER_SIZE bytes, little endian):
+   *   "PUFTRAN\0", u32 version, u32 header size, u64 payload size, u32 runs, u32 reserved,
+   *   u32 mode, address mode, function location, start, end, init value, function, interval, decay
+   * followed by the run groups of payload size * 8 words each.
+   */
+  class TransposedWriter {
+  private:
+    const std::string path;
+    int fd = -1;
+    uint64_t size = 0;
+    uint32_t runs = 0;
+    // Mapping of the run group that is written to
+    unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    uint64_t* words = nullptr;
+    int64_t group = -1;
+    uint64_t received = 0;
+    std::string error;
+
+    bool mapGroup(uint32_t index);
+
+  public:
+    // Opens the store of challenge, or creates it
+    TransposedWriter(std::string _path, const Challenge& challenge);
+
+    ~TransposedWriter();
+
+    TransposedWriter(const TransposedWriter&) = delete;
+
+    TransposedWriter& operator=(const TransposedWriter&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return fd != -1;
+    }
+
+    [[nodiscard]] const std::string& getError() const {
+      return error;
+    }
+
+    [[nodiscard]] uint64_t getSize() const {
+      return size;
+    }
+
+    [[nodiscard]] uint32_t getRuns() const {
+      return runs;
+    }
+
+    // Starts the next run and clears its slot, false if its group could not be allocated
+    bool begin();
+
+    // Streaming update, the bytes continue the payload of the current run
+    void update(const unsigned char* data, size_t count);
+
+    // Ends the run; an incomplete one is not counted and its slot is reused
+    bool commit(bool ok);
+  };
+
+  // Passes the transfer on and appends it as a run
+  class TransposedSink : public DumpSink {
+  private:
+    DumpSink& inner;
+    TransposedWriter& writer;
+    bool dump = false;
+
+  public:
+    TransposedSink(DumpSink& _inner, TransposedWriter& _writer) : inner(_inner), writer(_writer) {}
+
+    void begin(const DumpInfo& info) override;
+
+    void write(const char* data, size_t count) override;
+
+    void end(bool ok) override;
+  };
+
+  // Aggregates over all bits of a store
+  struct TransposedStats {
+    // Bits that differ from their majority in at most threshold runs
+    uint64_t stable = 0;
+    // Share of all bits of all runs that differ from the majority of their bit
+    double bitErrorRate = 0;
+    // Share of all bits of all runs that differ from the init value, i.e. decayed
+    double flipRate = 0;
+  };
+
+  // Read-only mapping of a whole store
+  class TransposedReader {
+  private:
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    const uint64_t* groups = nullptr;
+    uint64_t bits = 0;
+    // Runs of the last group
+    uint64_t lastMask = 0;
+    uint32_t groupCount = 0;
+
+  public:
+    Challenge challenge;
+    uint64_t size = 0;
+    uint32_t runs = 0;
+
+    explicit TransposedReader(const std::string& path);
+
+    ~TransposedReader();
+
+    TransposedReader(const TransposedReader&) = delete;
+
+    TransposedReader& operator=(const TransposedReader&) = delete;
+
+    [[nodiscard]] bool isOpen() const {
+      return map != nullptr;
+    }
+
+    [[nodiscard]] uint32_t getGroups() const {
+      return groupCount;
+    }
+
+    // Values of a bit in runs group * 64 to group * 64 + 63, bit r being run r of the group
+    [[nodiscard]] uint64_t word(uint64_t bit, uint32_t group) const;
+
+    // In how many runs a bit was 1
+    [[nodiscard]] uint32_t ones(uint64_t bit) const;
+
+    // The value of a bit in most runs, ties go to 1
+    [[nodiscard]] int majority(uint64_t bit) const;
+
+    // Whether a bit differed from its majority in at most threshold runs
+    [[nodiscard]] bool isStable(uint64_t bit, uint32_t threshold = 0) const;
+
+    // Share of the runs in which a bit differed from the init value
+    [[nodiscard]] double flipProbability(uint64_t bit) const;
+
+    [[nodiscard]] TransposedStats stats(uint32_t threshold = 0) const;
+
+    // Writes the indices of the stable bits one per line, i.e. a pos file for extractKey; false on error
+    bool writePositions(const std::string& path, uint32_t threshold = 0) const;
+  };
+}
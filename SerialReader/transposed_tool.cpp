@@ -0,0 +1,121 @@
+#include <args.hxx>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "dump_file.h"
+#include "transposed.h"
+
+using namespace SerialReader;
+
+// Converts dumps into a bit-transposed store and answers cross-run questions from it
+int main(const int argc, const char** argv) {
+  args::ArgumentParser argsParser(
+    "Stores many dumps of one challenge bit-transposed, with up to 64 runs of a bit in one word.",
+    "Commands: append STORE DUMP... (-p gives the params of raw dumps), info STORE (stable bits, bit error rate, "
+    "flip rate), stable STORE POS (writes the stable bits as a pos file), bit STORE INDEX (the bit in every run)");
+  args::HelpFlag help(argsParser, "help", "Display this help menu", {'h', "help"});
+  args::Positional<std::string> commandA(argsParser, "command", "append, info, stable or bit");
+  args::Positional<std::string> storeA(argsParser, "store", "Transposed store");
+  args::PositionalList<std::string> filesA(argsParser, "args", "Dumps to append, pos file or bit index");
+  args::ValueFlagList<std::string> paramsA(argsParser, "params", "Params the raw dumps were measured with",
+                                           {'p', "params"});
+  args::ValueFlag<uint32_t> thresholdA(argsParser, "threshold", "Runs a stable bit may differ from its majority",
+                                       {'t', "threshold"}, 0);
+
+  try {
+    argsParser.ParseCLI(argc, argv);
+  } catch (const args::Help& _) {
+    std::cout << argsParser;
+    return 0;
+  } catch (const args::ParseError& e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << argsParser;
+    return 1;
+  }
+
+  const std::string& command = args::get(commandA);
+  const std::string& store = args::get(storeA);
+  const std::vector<std::string>& files = args::get(filesA);
+
+  if (command == "append") {
+    std::unique_ptr<TransposedWriter> writer;
+    Challenge challenge;
+    for (const auto& file : files) {
+      const DumpReader dump(file);
+      if (!dump.isOpen()) {
+        std::cerr << "Could not read " << file << std::endl;
+        return 1;
+      }
+      if (!writer) {
+        // Raw dumps only know their region, the store needs the init value as well
+        challenge = dump.info.challenge;
+        if (const TransposedReader existing(store); existing.isOpen()) {
+          challenge = existing.challenge;
+        } else if (!dump.described && !args::get(paramsA).empty()) {
+          challenge = Challenge::fromParams(args::get(paramsA));
+        }
+        writer = std::make_unique<TransposedWriter>(store, challenge);
+        if (!writer->isOpen()) {
+          std::cerr << writer->getError() << std::endl;
+          return 1;
+        }
+      }
+      const Challenge& c = dump.info.challenge;
+      const bool other = dump.described && (c.start != challenge.start || c.end != challenge.end ||
+                                             c.init != challenge.init || c.decay != challenge.decay);
+      if (other || dump.size != writer->getSize() || !writer->begin()) {
+        std::cerr << "Skipping " << file << ", it does not fit into " << store << std::endl;
+        continue;
+      }
+      writer->update(dump.payload, dump.size);
+      writer->commit(true);
+    }
+    return 0;
+  }
+
+  const TransposedReader reader(store);
+  if (!reader.isOpen()) {
+    std::cerr << "Could not read " << store << std::endl;
+    return 1;
+  }
+
+  if (command == "info") {
+    const TransposedStats stats = reader.stats(args::get(thresholdA));
+    std::cout << "runs " << reader.runs << std::endl
+      << "bits " << reader.size * 8 << std::endl
+      << "stable " << stats.stable << std::endl
+      << "bit error rate " << stats.bitErrorRate << std::endl
+      << "flip rate " << stats.flipRate << std::endl;
+    return 0;
+  }
+
+  if (command == "stable" && files.size() == 1) {
+    return reader.writePositions(files[0], args::get(thresholdA)) ? 0 : 1;
+  }
+
+  if (command == "bit" && files.size() == 1) {
+    uint64_t bit;
+    try {
+      bit = std::stoull(files[0]);
+    } catch (const std::exception& _) {
+      std::cerr << files[0] << " is no bit index" << std::endl;
+      std::cerr << argsParser;
+      return 1;
+    }
+    if (bit >= reader.size * 8) {
+      std::cerr << "There are only " << reader.size * 8 << " bits" << std::endl;
+      return 1;
+    }
+    for (uint32_t run = 0; run < reader.runs; run++) {
+      std::cout << (reader.word(bit, run / TRANSPOSED_RUNS) >> run % TRANSPOSED_RUNS & 1);
+    }
+    std::cout << std::endl << "ones " << reader.ones(bit) << ", majority " << reader.majority(bit)
+      << ", flip probability " << reader.flipProbability(bit) << std::endl;
+    return 0;
+  }
+
+  std::cerr << argsParser;
+  return 1;
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "uart_reader.h"
+
+// Enough for 10 ms of data at the given baud rate (8N1), so the reader wakes up about 100 times a second
+static size_t chunkFor(const int baud) {
+  const size_t bytes = static_cast<size_t>(baud > 0 ? baud : 115200) / 10 / 100;
+  size_t chunk = 64;
+  while (chunk < bytes && chunk < 65536) chunk <<= 1;
+  return chunk;
+}
+
+SerialReader::UartReader::UartReader(const int _fd, const int baud, const int cpu, const int priority)
+  : fd(_fd), chunkSize(chunkFor(baud)), ring(new char[READER_RING_SIZE]) {
+  thread = std::thread([this, cpu, priority] { run(cpu, priority); });
+}
+
+SerialReader::UartReader::~UartReader() {
+  stop = true;
+  spaceReady.notify_all();
+  thread.join();
+}
+
+void SerialReader::UartReader::run(const int cpu, const int priority) {
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); ret != 0) {
+      std::cerr << "Could not pin reader to CPU " << cpu << ": " << std::strerror(ret) << std::endl;
+    }
+  }
+  if (priority > 0) {
+    sched_param param{};
+    param.sched_priority = priority;
+    if (const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); ret != 0) {
+      std::cerr << "Could not switch reader to SCHED_FIFO: " << std::strerror(ret) << std::endl;
+    }
+  }
+  pollfd pfd{fd, POLLIN, 0};
+  while (!stop) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t free = READER_RING_SIZE - (h - tail.load(std::memory_order_acquire));
+    if (free < chunkSize) {
+      // The consumer fell behind by READER_RING_SIZE bytes, the kernel buffer has to bridge the gap now
+      std::unique_lock lock(mutex);
+      spaceReady.wait_for(lock, std::chrono::milliseconds(10));
+      continue;
+    }
+    if (poll(&pfd, 1, 100) <= 0) continue;
+    // Never read across the end of the ring, the next read starts at its beginning again
+    const size_t offset = h % READER_RING_SIZE;
+    const size_t size = std::min(chunkSize, READER_RING_SIZE - offset);
+    const ssize_t n = ::read(fd, ring.get() + offset, size);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      error = errno;
+    } else if (n > 0) {
+      head.store(h + n, std::memory_order_release);
+    }
+    std::lock_guard lock(mutex);
+    dataReady.notify_one();
+    if (n < 0) break;
+  }
+}
+
+ssize_t SerialReader::UartReader::read(char* buf, const size_t size) {
+  const size_t t = tail.load(std::memory_order_relaxed);
+  size_t available = head.load(std::memory_order_acquire) - t;
+  if (available == 0) {
+    std::unique_lock lock(mutex);
+    dataReady.wait_for(lock, std::chrono::seconds(READER_TIMEOUT), [this, t] {
+      return head.load(std::memory_order_acquire) != t || error != 0;
+    });
+    available = head.load(std::memory_order_acquire) - t;
+    if (available == 0) {
+      if (error != 0) {
+        errno = error;
+        return -1;
+      }
+      return 0;
+    }
+  }
+  const size_t offset = t % READER_RING_SIZE;
+  const size_t n = std::min({size, available, READER_RING_SIZE - offset});
+  std::memcpy(buf, ring.get() + offset, n);
+  tail.store(t + n, std::memory_order_release);
+  spaceReady.notify_one();
+  return static_cast<ssize_t>(n);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#define READER_RING_SIZE (1 << 22)
+#define READER_TIMEOUT 10
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sys/types.h>
+
+namespace SerialReader {
+  /*
+   * Drains the serial port on a dedicated (optionally pinned and SCHED_FIFO) thread into a ring buffer,
+   * so logging, disk flushes and the JVM cannot delay the read() calls long enough to overrun the UART.
+   */
+  class UartReader {
+  private:
+    const int fd;
+    const size_t chunkSize;
+    const std::unique_ptr<char[]> ring;
+    std::atomic<size_t> head = 0; // Written by the reader thread only
+    std::atomic<size_t> tail = 0; // Written by the consumer only
+    std::atomic<bool> stop = false;
+    std::atomic<int> error = 0;
+    std::mutex mutex;
+    std::condition_variable dataReady;
+    std::condition_variable spaceReady;
+    std::thread thread;
+
+    void run(int cpu, int priority);
+
+  public:
+    // cpu < 0 leaves the affinity alone, priority <= 0 keeps the default scheduler
+    UartReader(int _fd, int baud, int cpu, int priority);
+
+    ~UartReader();
+
+    UartReader(const UartReader&) = delete;
+
+    UartReader& operator=(const UartReader&) = delete;
+
+    // Behaves like read() on the serial port: returns 0 after READER_TIMEOUT seconds without data
+    ssize_t read(char* buf, size_t size);
+  };
+}
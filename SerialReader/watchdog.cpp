@@ -0,0 +1,61 @@
+#include "survey.h"
+#include "watchdog.h"
+
+const char* SerialReader::phaseName(const Phase phase) {
+  switch (phase) {
+  case Phase::BOOT:
+    return "boot";
+  case Phase::PROMPT:
+    return "prompt";
+  case Phase::DECAY:
+    return "decay";
+  case Phase::TRANSFER:
+    return "transfer";
+  case Phase::FINISH:
+    return "finish";
+  }
+  return "unknown";
+}
+
+SerialReader::Watchdog::Watchdog(const Challenge& _challenge, const int _baud)
+  : challenge(_challenge), baud(_baud > 0 ? _baud : 115200) {
+  enter(Phase::BOOT);
+}
+
+std::chrono::seconds SerialReader::Watchdog::timeout(const Phase phase) const {
+  switch (phase) {
+  case Phase::BOOT:
+    return std::chrono::seconds(BOOT_TIMEOUT);
+  case Phase::PROMPT:
+    return std::chrono::seconds(PROMPT_TIMEOUT);
+  case Phase::DECAY:
+    // The decay only starts after initialising the whole region, which is covered by the margin
+    return std::chrono::seconds(challenge.decay + challenge.decay / 10 + DECAY_MARGIN);
+  case Phase::TRANSFER: {
+    // 8N1 means 10 bits per byte, summaries send at most 14 characters per word and surveys a short line per row
+    const size_t bytes = challenge.isSurvey() ? SURVEY_MAX_ROWS * SURVEY_TOKEN_SIZE
+                         : challenge.isDump() ? challenge.payloadSize() : challenge.payloadSize() / 4 * 14;
+    const auto seconds = static_cast<long long>(bytes * 10 / baud);
+    return std::chrono::seconds(seconds + seconds / 4 + TRANSFER_MARGIN);
+  }
+  case Phase::FINISH:
+    return std::chrono::seconds(FINISH_TIMEOUT);
+  }
+  return std::chrono::seconds(BOOT_TIMEOUT);
+}
+
+void SerialReader::Watchdog::enter(const Phase phase) {
+  current = phase;
+  lastActivity = Clock::now();
+  deadline = lastActivity + timeout(phase);
+}
+
+void SerialReader::Watchdog::feed() {
+  lastActivity = Clock::now();
+}
+
+bool SerialReader::Watchdog::expired() const {
+  const auto now = Clock::now();
+  if (now > deadline) return true;
+  return current == Phase::TRANSFER && now - lastActivity > std::chrono::seconds(IDLE_TIMEOUT);
+}
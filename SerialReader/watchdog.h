@@ -0,0 +1,49 @@
+#pragma once
+
+#define BOOT_TIMEOUT 60
+#define PROMPT_TIMEOUT 30
+#define DECAY_MARGIN 60
+#define TRANSFER_MARGIN 30
+#define IDLE_TIMEOUT 60
+#define FINISH_TIMEOUT 30
+#define MAX_BACKOFF 900
+
+#include <chrono>
+#include "challenge.h"
+
+namespace SerialReader {
+  enum class Phase { BOOT, PROMPT, DECAY, TRANSFER, FINISH };
+
+  const char* phaseName(Phase phase);
+
+  /*
+   * Tracks which phase of a measurement the firmware is in and how long that phase may take at most.
+   * All timeouts are derived from the challenge, so a 60 min decay is not mistaken for a hang.
+   */
+  class Watchdog {
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    const Challenge challenge;
+    const int baud;
+    Phase current = Phase::BOOT;
+    Clock::time_point deadline;
+    Clock::time_point lastActivity;
+
+    [[nodiscard]] std::chrono::seconds timeout(Phase phase) const;
+
+  public:
+    Watchdog(const Challenge& _challenge, int _baud);
+
+    void enter(Phase phase);
+
+    // Called whenever bytes were received, only the transfer phase cares about idle time
+    void feed();
+
+    [[nodiscard]] bool expired() const;
+
+    [[nodiscard]] Phase phase() const {
+      return current;
+    }
+  };
+}
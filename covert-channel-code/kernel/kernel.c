@@ -50,7 +50,7 @@ void kernel_main(uint32_t r0, uint32_t r1, uint32_t atags) {
     uart_putc(0x16);
     uart_putc(0x16);
     uart_putc(0x16);
-    uart_puts("$|Choose mode:\r\n 0: memory dump (bit)\r\n 1: test all addresses (cell)\r\n 2: test all addresses (bitflip summary)\r\n 3: extract at interval\r\n 4: test params from kernel|: ");
+    uart_puts("$|Choose mode:\r\n 0: memory dump (bit)\r\n 1: test all addresses (cell)\r\n 2: test all addresses (bitflip summary)\r\n 3: extract at interval\r\n 4: test params from kernel\r\n 5: survey flip density|: ");
     int input = get_mode();
     switch(input) {
         case 0:
@@ -73,6 +73,10 @@ void kernel_main(uint32_t r0, uint32_t r1, uint32_t atags) {
             sendFlag(0);
             TestCustom();
             break;
+        case 5:
+            sendFlag(5);
+            TestPuf();
+            break;
         default:
             sendFlag(input);
             TestPuf();
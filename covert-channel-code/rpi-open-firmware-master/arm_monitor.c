@@ -44,6 +44,8 @@ int get_mode()
 				 break;
 		case  4: printf("\nTest parameters from kernel\n\n");
 				 break;
+		case  5: printf("\nSurvey flip density\n\n");
+				 break;
 		default: printf("\nUnknown value\n\n");
 				 break;
 	}
@@ -167,6 +169,8 @@ void execute_puf(int mode)
 		puf_extract_itvl(stradd,endadd,initvalue,decaytime, addmode, funcloc, dcyfunc, nfreq);
 	} else if (mode==4) {
 		cpu_code();
+	} else if (mode==5) {
+		puf_extract_survey(stradd, endadd, initvalue, decaytime, addmode, funcloc, dcyfunc, nfreq);
 	}
 	//reboot();
 }
@@ -387,6 +387,145 @@ void puf_read_ext(unsigned long start_addr, unsigned long end_addr, unsigned int
 	delay_ms(100);
 }
 
+#define SURVEY_ROW 0x1000
+#define SURVEY_COARSE 128
+#define SURVEY_MAX_ROWS 1024
+#define SURVEY_MARK 0x80000000
+
+/* Sampled rows of the survey, sorted by address; SURVEY_MARK flags a gap to split */
+unsigned long survey_addr[SURVEY_MAX_ROWS];
+unsigned long survey_flips[SURVEY_MAX_ROWS];
+
+/**
+ * Description: Count the bits of one row that differ
+ * from the init value
+ *
+ * Input: row_addr, puf_init_value
+**/
+unsigned long survey_row(unsigned long addr, unsigned long init_value)
+{
+	unsigned long flips=0;
+	for (unsigned long a=addr; a<addr+SURVEY_ROW; a+=4)
+		flips+=cal(mmio_read32(a)^init_value);
+	return flips;
+}
+
+/**
+ * Description: First row at or after addr that was initialised,
+ * 0 if there is none before end_addr
+ *
+ * Input: addr, end_addr
+**/
+unsigned long survey_next(unsigned long addr, unsigned long end_addr)
+{
+	addr=(addr+SURVEY_ROW-1)&~(SURVEY_ROW-1);
+	while (addr+SURVEY_ROW<=end_addr)
+	{
+		if (addr<0xc3000000)
+			addr=0xc3000000;
+		else if (addr>=0xcf000000&&addr<0xd0000000)
+			addr=0xd0000000;
+		else if (addr>=0xe0000000)
+			return 0;
+		else if (inArray(addr))
+			addr+=SURVEY_ROW;
+		else
+			return addr;
+	}
+	return 0;
+}
+
+/* Weight of the gap after row i: dense rows and rows that differ a lot from their neighbour */
+unsigned long survey_score(int i)
+{
+	unsigned long a=survey_flips[i]&~SURVEY_MARK, b=survey_flips[i+1]&~SURVEY_MARK;
+	return (a>b ? a : b)+(a>b ? a-b : b-a);
+}
+
+/* Row in the middle of the gap after row i, 0 if the gap cannot be split */
+unsigned long survey_middle(int i)
+{
+	unsigned long mid=survey_next(((survey_addr[i]+survey_addr[i+1])/2)&~(SURVEY_ROW-1), survey_addr[i+1]);
+	return mid>survey_addr[i]&&mid<survey_addr[i+1] ? mid : 0;
+}
+
+/**
+ * Description: Survey the flip density of a decayed region: sample
+ * SURVEY_COARSE evenly spaced rows, then keep splitting the gaps
+ * around dense or uneven rows until SURVEY_MAX_ROWS rows are read.
+ * Every row is printed as "level@address=flips", separated by ","
+ *
+ * Input: start_addr, end_addr, puf_init_value
+**/
+void puf_read_survey(unsigned long start_addr, unsigned long end_addr, unsigned long init_value)
+{
+	putchar(0x16); // SYN
+	putchar(0x16); // SYN
+	putchar(0x16); // SYN
+	printf("&|");
+	int n=0;
+	unsigned long step=((end_addr-start_addr)/SURVEY_COARSE)&~(SURVEY_ROW-1);
+	if (step<SURVEY_ROW)
+		step=SURVEY_ROW;
+	for (unsigned long addr=start_addr; addr<end_addr&&n<SURVEY_COARSE; addr+=step)
+	{
+		unsigned long row=survey_next(addr, end_addr);
+		if (row==0||(n>0&&row<=survey_addr[n-1]))
+			continue;
+		survey_addr[n]=row;
+		survey_flips[n]=survey_row(row, init_value);
+		printf(n==0 ? "0@%08X=%d" : ",0@%08X=%d", row, survey_flips[n]);
+		n++;
+	}
+
+	for (int level=1; n<SURVEY_MAX_ROWS; level++)
+	{
+		/* Split the gaps that score at least the average, the first ones that fit */
+		unsigned long sum=0;
+		int gaps=0;
+		for (int i=0; i+1<n; i++)
+		{
+			if (survey_middle(i)!=0)
+			{
+				sum+=survey_score(i);
+				gaps++;
+			}
+		}
+		if (gaps==0)
+			break;
+		int splits=0;
+		for (int i=0; i+1<n; i++)
+		{
+			if (n+splits<SURVEY_MAX_ROWS&&survey_middle(i)!=0&&survey_score(i)*gaps>=sum)
+			{
+				survey_flips[i]|=SURVEY_MARK;
+				splits++;
+			}
+		}
+
+		/* Insert from the back, so that the rows stay sorted in place */
+		int j=n+splits-1;
+		for (int i=n-1; i>=0; i--)
+		{
+			if (survey_flips[i]&SURVEY_MARK)
+			{
+				survey_flips[i]&=~SURVEY_MARK;
+				unsigned long mid=survey_middle(i);
+				survey_addr[j]=mid;
+				survey_flips[j]=survey_row(mid, init_value);
+				printf(",%d@%08X=%d", level, mid, survey_flips[j]);
+				j--;
+			}
+			survey_addr[j]=survey_addr[i];
+			survey_flips[j]=survey_flips[i];
+			j--;
+		}
+		n+=splits;
+	}
+	printf("|&%d|$\n", n);
+	delay_ms(100);
+}
+
 /**
  * Description: Read the value of puf of one cell to 
  * the specified address segment
@@ -563,3 +702,36 @@ void puf_extract_itvl(unsigned long start_addr,unsigned long end_addr, unsigned
 	puf_read_itvl(start_addr, end_addr, add_mode);
 }
 
+/** 
+ * Function: Survey the flip density of a region
+ *
+ * Input: puf_start_address, puf_end_address, puf_init_value, decay_time
+ *
+ * P.S. Every row is read once after a single decay
+**/
+void puf_extract_survey(unsigned long start_addr,unsigned long end_addr, unsigned long puf_init_value,int decay_time, int add_mode, int func_loc, int dcy_func, int nfreq)
+{
+	/* PUF Init */
+	puf_init_all(start_addr,end_addr,puf_init_value);
+	printf("puf init complete\n");
+
+	/* Decay & Manually Refresh */
+	printf("disable Refresh\n");
+	SD_SA =
+	    (0 << SD_SA_RFSH_T_LSB)
+	    | SD_SA_PGEHLDE_SET
+	    | SD_SA_CLKSTOP_SET
+	    | SD_SA_POWSAVE_SET
+	    | 0x3214;
+	if(func_loc)
+		ManuallyRefresh(decay_time, dcy_func, nfreq);
+	else
+		ManuallyRefresh(decay_time, 0, 0);
+	printf("decay completed\n");
+
+	/* Enable Refresh, the decayed values stay as they are while the rows are chosen */
+	timing_init();
+
+	/* PUF Read */
+	puf_read_survey(start_addr, end_addr, puf_init_value);
+}
@@ -212,7 +212,7 @@ void sleh_irq(vc4_saved_state_t* pcb, uint32_t tp)
 			default: break;
 		}	
 	}
-	else if (mode==3 && flag_m==1 && flag_mm==0)
+	else if ((mode==3 || mode==5) && flag_m==1 && flag_mm==0)
 	{
 		time++;
 		switch (time%PUF_ARGS_AMT)